@@ -278,6 +278,18 @@ REQUIRE_OBJECT ( ipstat_cmd );
 #ifdef PROFSTAT_CMD
 REQUIRE_OBJECT ( profstat_cmd );
 #endif
+#ifdef CERT_CMD
+REQUIRE_OBJECT ( cert_cmd );
+#endif
+#ifdef PROCSTAT_CMD
+REQUIRE_OBJECT ( procstat_cmd );
+#endif
+#ifdef TRACEDUMP_CMD
+REQUIRE_OBJECT ( tracedump_cmd );
+#endif
+#ifdef PEERSTAT_CMD
+REQUIRE_OBJECT ( peerstat_cmd );
+#endif
 
 /*
  * Drag in miscellaneous objects
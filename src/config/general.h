@@ -144,6 +144,10 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 //#define CONSOLE_CMD		/* Console command */
 //#define IPSTAT_CMD		/* IP statistics commands */
 //#define PROFSTAT_CMD		/* Profiling commands */
+//#define CERT_CMD		/* Certificate management commands */
+//#define PROCSTAT_CMD		/* Process statistics commands */
+//#define TRACEDUMP_CMD		/* Event tracing commands */
+//#define PEERSTAT_CMD		/* PeerDist statistics commands */
 
 /*
  * ROM-specific options
@@ -0,0 +1,22 @@
+#ifndef CONFIG_TRACE_H
+#define CONFIG_TRACE_H
+
+/** @file
+ *
+ * Event tracing
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <config/defaults.h>
+
+/* Number of events held in trace ring buffer (zero to disable tracing)
+ *
+ * Must be a power of two.
+ */
+#define TRACE_EVENTS 0
+
+#include <config/local/trace.h>
+
+#endif /* CONFIG_TRACE_H */
@@ -33,6 +33,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/uaccess.h>
 #include <ipxe/umalloc.h>
 #include <ipxe/image.h>
+#include <ipxe/trace.h>
 #include <ipxe/xferbuf.h>
 #include <ipxe/downloader.h>
 
@@ -79,6 +80,9 @@ static void downloader_free ( struct refcnt *refcnt ) {
  */
 static void downloader_finished ( struct downloader *downloader, int rc ) {
 
+	/* Record end of download */
+	trace ( TRACE_IMAGE_DONE, downloader->image, rc );
+
 	/* Log download status */
 	if ( rc == 0 ) {
 		syslog ( LOG_NOTICE, "Downloaded \"%s\"\n",
@@ -260,6 +264,9 @@ int create_downloader ( struct interface *job, struct image *image ) {
 	downloader->image = image_get ( image );
 	xferbuf_umalloc_init ( &downloader->buffer, &image->data );
 
+	/* Record start of download */
+	trace ( TRACE_IMAGE_START, image, 0 );
+
 	/* Instantiate child objects and attach to our interfaces */
 	if ( ( rc = xfer_open_uri ( &downloader->xfer, image->uri ) ) != 0 )
 		goto err;
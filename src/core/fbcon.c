@@ -29,6 +29,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
@@ -107,6 +108,9 @@ static void fbcon_set_default_background ( struct fbcon *fbcon ) {
  *
  * @v fbcon		Frame buffer console
  * @v ypos		Starting Y position
+ *
+ * Any rows whose contents are changed will be marked as requiring
+ * redraw.
  */
 static void fbcon_clear ( struct fbcon *fbcon, unsigned int ypos ) {
 	struct fbcon_text_cell cell = {
@@ -114,6 +118,7 @@ static void fbcon_clear ( struct fbcon *fbcon, unsigned int ypos ) {
 		.background = fbcon->background,
 		.character = ' ',
 	};
+	struct fbcon_text_cell old;
 	size_t offset;
 	unsigned int xpos;
 
@@ -121,13 +126,51 @@ static void fbcon_clear ( struct fbcon *fbcon, unsigned int ypos ) {
 	for ( ; ypos < fbcon->character.height ; ypos++ ) {
 		offset = ( ypos * fbcon->character.width * sizeof ( cell ) );
 		for ( xpos = 0 ; xpos < fbcon->character.width ; xpos++ ) {
-			copy_to_user ( fbcon->text.start, offset, &cell,
-				       sizeof ( cell ) );
+			copy_from_user ( &old, fbcon->text.start, offset,
+					 sizeof ( old ) );
+			if ( memcmp ( &old, &cell, sizeof ( cell ) ) != 0 ) {
+				copy_to_user ( fbcon->text.start, offset,
+					       &cell, sizeof ( cell ) );
+				fbcon->dirty[ypos] = 1;
+			}
 			offset += sizeof ( cell );
 		}
 	}
 }
 
+/**
+ * Check if two rows of characters differ
+ *
+ * @v fbcon		Frame buffer console
+ * @v ypos		Y position
+ * @v other		Other Y position
+ * @ret differ		Rows differ
+ */
+static int fbcon_differ ( struct fbcon *fbcon, unsigned int ypos,
+			  unsigned int other ) {
+	struct fbcon_text_cell cell;
+	struct fbcon_text_cell other_cell;
+	size_t offset;
+	size_t other_offset;
+	unsigned int xpos;
+
+	/* Compare stored character array rows */
+	offset = ( ypos * fbcon->character.width * sizeof ( cell ) );
+	other_offset = ( other * fbcon->character.width * sizeof ( cell ) );
+	for ( xpos = 0 ; xpos < fbcon->character.width ; xpos++ ) {
+		copy_from_user ( &cell, fbcon->text.start, offset,
+				 sizeof ( cell ) );
+		copy_from_user ( &other_cell, fbcon->text.start, other_offset,
+				 sizeof ( other_cell ) );
+		if ( memcmp ( &cell, &other_cell, sizeof ( cell ) ) != 0 )
+			return 1;
+		offset += sizeof ( cell );
+		other_offset += sizeof ( other_cell );
+	}
+
+	return 0;
+}
+
 /**
  * Store character at specified position
  *
@@ -147,17 +190,21 @@ static void fbcon_store ( struct fbcon *fbcon, struct fbcon_text_cell *cell,
 }
 
 /**
- * Draw character at specified position
+ * Render character
  *
  * @v fbcon		Frame buffer console
  * @v cell		Text cell
- * @v xpos		X position
- * @v ypos		Y position
+ * @v start		Start address
+ * @v offset		Offset to first pixel
+ * @v stride		Offset between vertically adjacent pixels
+ *
+ * A text cell with a transparent background may be rendered only
+ * directly to the frame buffer, since the background picture must
+ * be drawn behind the character.
  */
-static void fbcon_draw ( struct fbcon *fbcon, struct fbcon_text_cell *cell,
-			 unsigned int xpos, unsigned int ypos ) {
+static void fbcon_render ( struct fbcon *fbcon, struct fbcon_text_cell *cell,
+			   userptr_t start, size_t offset, size_t stride ) {
 	uint8_t glyph[fbcon->font->height];
-	size_t offset;
 	size_t pixel_len;
 	size_t skip_len;
 	unsigned int row;
@@ -170,28 +217,22 @@ static void fbcon_draw ( struct fbcon *fbcon, struct fbcon_text_cell *cell,
 	fbcon->font->glyph ( cell->character, glyph );
 
 	/* Calculate pixel geometry */
-	offset = ( fbcon->indent +
-		   ( ypos * fbcon->character.stride ) +
-		   ( xpos * fbcon->character.len ) );
 	pixel_len = fbcon->pixel->len;
-	skip_len = ( fbcon->pixel->stride - fbcon->character.len );
+	skip_len = ( stride - fbcon->character.len );
 
 	/* Check for transparent background colour */
 	transparent = ( cell->background == FBCON_TRANSPARENT );
+	assert ( ( ! transparent ) ||
+		 ( fbcon->picture.start && ( start == fbcon->start ) ) );
 
 	/* Draw character rows */
 	for ( row = 0 ; row < fbcon->font->height ; row++ ) {
 
 		/* Draw background picture, if applicable */
 		if ( transparent ) {
-			if ( fbcon->picture.start ) {
-				memcpy_user ( fbcon->start, offset,
-					      fbcon->picture.start, offset,
-					      fbcon->character.len );
-			} else {
-				memset_user ( fbcon->start, offset, 0,
-					      fbcon->character.len );
-			}
+			memcpy_user ( fbcon->start, offset,
+				      fbcon->picture.start, offset,
+				      fbcon->character.len );
 		}
 
 		/* Draw character row */
@@ -204,7 +245,7 @@ static void fbcon_draw ( struct fbcon *fbcon, struct fbcon_text_cell *cell,
 			} else {
 				continue;
 			}
-			copy_to_user ( fbcon->start, offset, src, pixel_len );
+			copy_to_user ( start, offset, src, pixel_len );
 		}
 
 		/* Move to next row */
@@ -213,24 +254,110 @@ static void fbcon_draw ( struct fbcon *fbcon, struct fbcon_text_cell *cell,
 }
 
 /**
- * Redraw all characters
+ * Get rendered character from glyph cache
+ *
+ * @v fbcon		Frame buffer console
+ * @v cell		Text cell (with an opaque background colour)
+ * @ret offset		Offset to rendered glyph within glyph cache
+ */
+static size_t fbcon_glyph ( struct fbcon *fbcon,
+			    struct fbcon_text_cell *cell ) {
+	struct fbcon_glyph_cache *cache = &fbcon->cache;
+	struct fbcon_text_cell *cached;
+	unsigned int index;
+	size_t offset;
+
+	/* Sanity check */
+	assert ( cell->background != FBCON_TRANSPARENT );
+
+	/* Identify cache entry */
+	index = ( ( cell->character +
+		    ( ( cell->foreground ^ ( cell->background << 1 ) ) * 31 ) )
+		  & ( FBCON_GLYPH_CACHE - 1 ) );
+	cached = &cache->cells[index];
+	offset = ( index * cache->len );
+
+	/* Render character into cache entry, if not already present */
+	if ( memcmp ( cached, cell, sizeof ( *cached ) ) != 0 ) {
+		fbcon_render ( fbcon, cell, cache->start, offset,
+			       fbcon->character.len );
+		memcpy ( cached, cell, sizeof ( *cached ) );
+	}
+
+	return offset;
+}
+
+/**
+ * Draw character at specified position
+ *
+ * @v fbcon		Frame buffer console
+ * @v cell		Text cell
+ * @v xpos		X position
+ * @v ypos		Y position
+ */
+static void fbcon_draw ( struct fbcon *fbcon, struct fbcon_text_cell *cell,
+			 unsigned int xpos, unsigned int ypos ) {
+	struct fbcon_text_cell opaque;
+	size_t offset;
+	size_t glyph;
+	unsigned int row;
+
+	/* Calculate pixel offset */
+	offset = ( fbcon->indent +
+		   ( ypos * fbcon->character.stride ) +
+		   ( xpos * fbcon->character.len ) );
+
+	/* A transparent background with no background picture is
+	 * indistinguishable from a black background.
+	 */
+	if ( ( cell->background == FBCON_TRANSPARENT ) &&
+	     ( ! fbcon->picture.start ) ) {
+		memcpy ( &opaque, cell, sizeof ( opaque ) );
+		opaque.background = 0;
+		cell = &opaque;
+	}
+
+	/* Render directly to frame buffer if glyph cache cannot be used */
+	if ( ( cell->background == FBCON_TRANSPARENT ) ||
+	     ( ! fbcon->cache.cells ) ) {
+		fbcon_render ( fbcon, cell, fbcon->start, offset,
+			       fbcon->pixel->stride );
+		return;
+	}
+
+	/* Copy rendered character rows from glyph cache */
+	glyph = fbcon_glyph ( fbcon, cell );
+	for ( row = 0 ; row < fbcon->font->height ; row++ ) {
+		memcpy_user ( fbcon->start, offset, fbcon->cache.start, glyph,
+			      fbcon->character.len );
+		offset += fbcon->pixel->stride;
+		glyph += fbcon->character.len;
+	}
+}
+
+/**
+ * Redraw all rows marked as requiring redraw
  *
  * @v fbcon		Frame buffer console
  */
 static void fbcon_redraw ( struct fbcon *fbcon ) {
 	struct fbcon_text_cell cell;
-	size_t offset = 0;
+	size_t offset;
 	unsigned int xpos;
 	unsigned int ypos;
 
 	/* Redraw characters */
 	for ( ypos = 0 ; ypos < fbcon->character.height ; ypos++ ) {
+		if ( ! fbcon->dirty[ypos] )
+			continue;
+		offset = ( ypos * fbcon->character.width * sizeof ( cell ) );
 		for ( xpos = 0 ; xpos < fbcon->character.width ; xpos++ ) {
 			copy_from_user ( &cell, fbcon->text.start, offset,
 					 sizeof ( cell ) );
 			fbcon_draw ( fbcon, &cell, xpos, ypos );
 			offset += sizeof ( cell );
 		}
+		fbcon->dirty[ypos] = 0;
 	}
 }
 
@@ -240,21 +367,44 @@ static void fbcon_redraw ( struct fbcon *fbcon ) {
  * @v fbcon		Frame buffer console
  */
 static void fbcon_scroll ( struct fbcon *fbcon ) {
+	unsigned int height = fbcon->character.height;
+	unsigned int ypos;
 	size_t row_len;
+	size_t top;
 
 	/* Sanity check */
-	assert ( fbcon->ypos == fbcon->character.height );
+	assert ( fbcon->ypos == height );
+
+	/* Scroll up frame buffer contents, if possible.  If there is
+	 * a background picture then characters with a transparent
+	 * background cannot be moved, and so we must instead redraw
+	 * any rows whose contents are about to change.
+	 */
+	if ( fbcon->picture.start ) {
+		for ( ypos = 0 ; ypos < ( height - 1 ) ; ypos++ ) {
+			if ( fbcon_differ ( fbcon, ypos, ( ypos + 1 ) ) )
+				fbcon->dirty[ypos] = 1;
+		}
+	} else {
+		top = ( fbcon->margin.top * fbcon->pixel->stride );
+		memmove_user ( fbcon->start, top, fbcon->start,
+			       ( top + fbcon->character.stride ),
+			       ( fbcon->character.stride * ( height - 1 ) ) );
+	}
 
-	/* Scroll up character array */
+	/* Scroll up character array.  The final row remains
+	 * unchanged (in both the character array and the frame
+	 * buffer) until it is cleared.
+	 */
 	row_len = ( fbcon->character.width * sizeof ( struct fbcon_text_cell ));
 	memmove_user ( fbcon->text.start, 0, fbcon->text.start, row_len,
-		       ( row_len * ( fbcon->character.height - 1 ) ) );
-	fbcon_clear ( fbcon, ( fbcon->character.height - 1 ) );
+		       ( row_len * ( height - 1 ) ) );
+	fbcon_clear ( fbcon, ( height - 1 ) );
 
 	/* Update cursor position */
 	fbcon->ypos--;
 
-	/* Redraw all characters */
+	/* Redraw changed rows */
 	fbcon_redraw ( fbcon );
 }
 
@@ -318,10 +468,13 @@ static void fbcon_handle_ed ( struct ansiesc_context *ctx,
 	/* We assume that we always clear the whole screen */
 	assert ( params[0] == ANSIESC_ED_ALL );
 
+	/* Hide cursor, since only changed rows will be redrawn */
+	fbcon_draw_cursor ( fbcon, 0 );
+
 	/* Clear character array */
 	fbcon_clear ( fbcon, 0 );
 
-	/* Redraw all characters */
+	/* Redraw changed rows */
 	fbcon_redraw ( fbcon );
 
 	/* Reset cursor position */
@@ -569,6 +722,42 @@ static int fbcon_picture_init ( struct fbcon *fbcon,
 	return rc;
 }
 
+/**
+ * Initialise glyph cache
+ *
+ * @v fbcon		Frame buffer console
+ *
+ * The glyph cache is an optimisation: if it cannot be allocated then
+ * characters will be rendered directly to the frame buffer.
+ */
+static void fbcon_cache_init ( struct fbcon *fbcon ) {
+	struct fbcon_glyph_cache *cache = &fbcon->cache;
+	unsigned int i;
+
+	/* Allocate rendered glyph pixel data */
+	cache->len = ( fbcon->font->height * fbcon->character.len );
+	cache->start = umalloc ( FBCON_GLYPH_CACHE * cache->len );
+	if ( ! cache->start )
+		goto err_umalloc;
+
+	/* Allocate and invalidate cached text cells */
+	cache->cells = malloc ( FBCON_GLYPH_CACHE *
+				sizeof ( cache->cells[0] ) );
+	if ( ! cache->cells )
+		goto err_malloc;
+	for ( i = 0 ; i < FBCON_GLYPH_CACHE ; i++ )
+		cache->cells[i].background = FBCON_TRANSPARENT;
+
+	return;
+
+	free ( cache->cells );
+ err_malloc:
+	ufree ( cache->start );
+	cache->start = UNULL;
+ err_umalloc:
+	DBGC ( fbcon, "FBCON %p could not allocate glyph cache\n", fbcon );
+}
+
 /**
  * Initialise frame buffer console
  *
@@ -668,6 +857,13 @@ int fbcon_init ( struct fbcon *fbcon, userptr_t start,
 	fbcon_set_default_foreground ( fbcon );
 	fbcon_set_default_background ( fbcon );
 
+	/* Allocate row redraw flags */
+	fbcon->dirty = zalloc ( fbcon->character.height );
+	if ( ! fbcon->dirty ) {
+		rc = -ENOMEM;
+		goto err_dirty;
+	}
+
 	/* Allocate and initialise stored character array */
 	fbcon->text.start = umalloc ( fbcon->character.width *
 				      fbcon->character.height *
@@ -692,6 +888,12 @@ int fbcon_init ( struct fbcon *fbcon, userptr_t start,
 			      fbcon->len );
 	}
 
+	/* Frame buffer now matches the (empty) stored character array */
+	memset ( fbcon->dirty, 0, fbcon->character.height );
+
+	/* Initialise glyph cache */
+	fbcon_cache_init ( fbcon );
+
 	/* Update console width and height */
 	console_set_size ( fbcon->character.width, fbcon->character.height );
 
@@ -701,6 +903,8 @@ int fbcon_init ( struct fbcon *fbcon, userptr_t start,
  err_picture:
 	ufree ( fbcon->text.start );
  err_text:
+	free ( fbcon->dirty );
+ err_dirty:
  err_margin:
 	return rc;
 }
@@ -712,6 +916,9 @@ int fbcon_init ( struct fbcon *fbcon, userptr_t start,
  */
 void fbcon_fini ( struct fbcon *fbcon ) {
 
+	free ( fbcon->cache.cells );
+	ufree ( fbcon->cache.start );
 	ufree ( fbcon->text.start );
 	ufree ( fbcon->picture.start );
+	free ( fbcon->dirty );
 }
@@ -55,6 +55,13 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** List of registered images */
 struct list_head images = LIST_HEAD_INIT ( images );
 
+/** Image list generation counter
+ *
+ * This is incremented whenever an image is registered, unregistered,
+ * or renamed, and may be used to validate cached image lookups.
+ */
+unsigned int images_generation;
+
 /** Currently-executing image */
 struct image *current_image;
 
@@ -152,6 +159,7 @@ int image_set_name ( struct image *image, const char *name ) {
 	/* Replace existing name */
 	free ( image->name );
 	image->name = name_copy;
+	images_generation++;
 
 	return 0;
 }
@@ -229,6 +237,7 @@ int register_image ( struct image *image ) {
 	image_get ( image );
 	image->flags |= IMAGE_REGISTERED;
 	list_add_tail ( &image->list, &images );
+	images_generation++;
 	DBGC ( image, "IMAGE %s at [%lx,%lx) registered\n",
 	       image->name, user_to_phys ( image->data, 0 ),
 	       user_to_phys ( image->data, image->len ) );
@@ -258,6 +267,7 @@ void unregister_image ( struct image *image ) {
 	DBGC ( image, "IMAGE %s unregistered\n", image->name );
 	list_del ( &image->list );
 	image->flags &= ~IMAGE_REGISTERED;
+	images_generation++;
 	image_put ( image );
 }
 
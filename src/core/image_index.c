@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Image name index
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <ipxe/image.h>
+#include <ipxe/image_index.h>
+
+/** Minimum number of entries in the image name index
+ *
+ * Must be a power of two.  This is a policy decision.
+ */
+#define IMAGE_INDEX_MIN_SIZE 16
+
+/** Image name index (open-addressed hash table) */
+static struct image **image_index;
+
+/** Number of entries in the image name index (zero if unusable) */
+static unsigned int image_index_size;
+
+/** Image list generation counter at which the name index was built */
+static unsigned int image_index_generation;
+
+/**
+ * Calculate image name index hash
+ *
+ * @v name		Name
+ * @ret hash		Hash (case-insensitive)
+ */
+static unsigned int image_index_hash ( const char *name ) {
+	unsigned int hash = 0;
+
+	while ( *name )
+		hash = ( ( hash * 31 ) + tolower ( *(name++) ) );
+	return ( hash & ( image_index_size - 1 ) );
+}
+
+/**
+ * Rebuild image name index, if applicable
+ *
+ * The index is sized to be at most half occupied.  If the index
+ * cannot be allocated, then lookups will fall back to a linear search
+ * of the image list.
+ */
+static void image_index_rebuild ( void ) {
+	struct image *image;
+	unsigned int count = 0;
+	unsigned int size;
+	unsigned int index;
+
+	/* Do nothing if index is up to date */
+	if ( image_index && ( image_index_generation == images_generation ) )
+		return;
+
+	/* Calculate required index size */
+	for_each_image ( image )
+		count++;
+	size = IMAGE_INDEX_MIN_SIZE;
+	while ( size < ( 2 * count ) )
+		size <<= 1;
+
+	/* Reallocate index, if applicable */
+	if ( size != image_index_size ) {
+		free ( image_index );
+		image_index = malloc ( size * sizeof ( image_index[0] ) );
+		if ( ! image_index ) {
+			image_index_size = 0;
+			return;
+		}
+		image_index_size = size;
+	}
+	memset ( image_index, 0, ( size * sizeof ( image_index[0] ) ) );
+	image_index_generation = images_generation;
+
+	/* Add each image in list order, so that lookups return the
+	 * first matching image (as for a linear search).
+	 */
+	for_each_image ( image ) {
+		index = image_index_hash ( image->name );
+		while ( image_index[index] )
+			index = ( ( index + 1 ) & ( size - 1 ) );
+		image_index[index] = image;
+	}
+}
+
+/**
+ * Find image by name, ignoring case
+ *
+ * @v name		Image name
+ * @ret image		Image, or NULL
+ *
+ * If several images have names differing only in case, then the
+ * first such image in the image list is returned.
+ */
+struct image * find_image_nocase ( const char *name ) {
+	struct image *image;
+	unsigned int index;
+
+	/* Rebuild index, if applicable */
+	image_index_rebuild();
+
+	/* Find image using index, if available */
+	if ( image_index ) {
+		index = image_index_hash ( name );
+		while ( ( image = image_index[index] ) ) {
+			if ( strcasecmp ( image->name, name ) == 0 )
+				return image;
+			index = ( ( index + 1 ) & ( image_index_size - 1 ) );
+		}
+		return NULL;
+	}
+
+	/* Otherwise, fall back to a linear search */
+	for_each_image ( image ) {
+		if ( strcasecmp ( image->name, name ) == 0 )
+			return image;
+	}
+
+	return NULL;
+}
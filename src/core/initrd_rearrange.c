@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2012 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <errno.h>
+#include <assert.h>
+#include <ipxe/initrd.h>
+#include <ipxe/image.h>
+#include <ipxe/uaccess.h>
+
+/** @file
+ *
+ * Initial ramdisk (initrd) rearrangement
+ *
+ */
+
+/** Number of bytes moved during the most recent reshuffle */
+static size_t initrd_moved;
+
+/**
+ * Calculate padded length of initrd
+ *
+ * @v initrd		initrd
+ * @ret len		Length rounded up to INITRD_ALIGN
+ */
+static inline size_t initrd_align ( struct image *initrd ) {
+
+	return ( ( initrd->len + INITRD_ALIGN - 1 ) & ~( INITRD_ALIGN - 1 ) );
+}
+
+/**
+ * Move initrd to a new location
+ *
+ * @v initrd		initrd
+ * @v dest		New location
+ * @v action		Description of move (for debugging)
+ */
+static void initrd_move ( struct image *initrd, userptr_t dest,
+			  const char *action ) {
+
+	DBGC ( &images, "INITRD %s %s [%#08lx,%#08lx)->[%#08lx,%#08lx)\n",
+	       action, initrd->name, user_to_phys ( initrd->data, 0 ),
+	       user_to_phys ( initrd->data, initrd->len ),
+	       user_to_phys ( dest, 0 ), user_to_phys ( dest, initrd->len ) );
+	memmove_user ( dest, 0, initrd->data, 0, initrd->len );
+	initrd->data = dest;
+	initrd_moved += initrd->len;
+}
+
+/**
+ * Squash initrds as high as possible in memory
+ *
+ * @v top		Highest possible address
+ * @ret used		Lowest address used by initrds
+ */
+static userptr_t initrd_squash_high ( userptr_t top ) {
+	userptr_t current = top;
+	struct image *initrd;
+	struct image *highest;
+	size_t len;
+
+	/* Squash up any initrds already within or below the region */
+	while ( 1 ) {
+
+		/* Find the highest image not yet in its final position */
+		highest = NULL;
+		for_each_image ( initrd ) {
+			if ( ( userptr_sub ( initrd->data, current ) < 0 ) &&
+			     ( ( highest == NULL ) ||
+			       ( userptr_sub ( initrd->data,
+					       highest->data ) > 0 ) ) ) {
+				highest = initrd;
+			}
+		}
+		if ( ! highest )
+			break;
+
+		/* Move this image to its final position (unless
+		 * already there)
+		 */
+		len = initrd_align ( highest );
+		current = userptr_sub ( current, len );
+		if ( highest->data != current )
+			initrd_move ( highest, current, "squashing" );
+	}
+
+	/* Copy any remaining initrds (e.g. embedded images) to the region */
+	for_each_image ( initrd ) {
+		if ( userptr_sub ( initrd->data, top ) >= 0 ) {
+			len = initrd_align ( initrd );
+			current = userptr_sub ( current, len );
+			initrd_move ( initrd, current, "copying" );
+		}
+	}
+
+	return current;
+}
+
+/**
+ * Rearrange initrds into desired order using a scratch area
+ *
+ * @v used		Lowest address used by initrds
+ * @v scratch		Scratch area
+ * @v scratch_len	Length of scratch area
+ * @ret rc		Return status code
+ *
+ * The initrds must already have been squashed into a contiguous
+ * block starting at @c used.  The final location of each initrd is
+ * calculated in a single pass.  Each initrd not already in its final
+ * location is then copied out to the scratch area, and subsequently
+ * copied back to its final location.  No initrd is therefore moved
+ * more than twice.
+ */
+static int initrd_reorder ( userptr_t used, userptr_t scratch,
+			    size_t scratch_len ) {
+	struct image *initrd;
+	userptr_t current;
+	size_t misplaced_len = 0;
+	size_t len;
+
+	/* Calculate total length of initrds not in their final location */
+	current = used;
+	for_each_image ( initrd ) {
+		len = initrd_align ( initrd );
+		if ( initrd->data != current )
+			misplaced_len += len;
+		current = userptr_add ( current, len );
+	}
+
+	/* Check that scratch area is large enough */
+	if ( misplaced_len > scratch_len ) {
+		DBGC ( &images, "INITRD cannot reorder %#zx bytes via "
+		       "%#zx-byte scratch area\n", misplaced_len, scratch_len );
+		return -ENOSPC;
+	}
+
+	/* Copy misplaced initrds out to scratch area */
+	current = used;
+	len = 0;
+	for_each_image ( initrd ) {
+		if ( initrd->data != current ) {
+			initrd_move ( initrd, userptr_add ( scratch, len ),
+				      "evacuating" );
+			len += initrd_align ( initrd );
+		}
+		current = userptr_add ( current, initrd_align ( initrd ) );
+	}
+
+	/* Copy misplaced initrds back to their final locations */
+	current = used;
+	for_each_image ( initrd ) {
+		if ( initrd->data != current )
+			initrd_move ( initrd, current, "placing" );
+		current = userptr_add ( current, initrd_align ( initrd ) );
+	}
+
+	return 0;
+}
+
+/**
+ * Swap position of two adjacent initrds
+ *
+ * @v low		Lower initrd
+ * @v high		Higher initrd
+ * @v free		Free space
+ * @v free_len		Length of free space
+ */
+static void initrd_swap ( struct image *low, struct image *high,
+			  userptr_t free, size_t free_len ) {
+	size_t len = 0;
+	size_t frag_len;
+	size_t new_len;
+
+	DBGC ( &images, "INITRD swapping %s [%#08lx,%#08lx)<->[%#08lx,%#08lx) "
+	       "%s\n", low->name, user_to_phys ( low->data, 0 ),
+	       user_to_phys ( low->data, low->len ),
+	       user_to_phys ( high->data, 0 ),
+	       user_to_phys ( high->data, high->len ), high->name );
+
+	/* Round down length of free space */
+	free_len &= ~( INITRD_ALIGN - 1 );
+	assert ( free_len > 0 );
+
+	/* Swap image data */
+	while ( len < high->len ) {
+
+		/* Calculate maximum fragment length */
+		frag_len = ( high->len - len );
+		if ( frag_len > free_len )
+			frag_len = free_len;
+		new_len = ( ( len + frag_len + INITRD_ALIGN - 1 ) &
+			    ~( INITRD_ALIGN - 1 ) );
+
+		/* Swap fragments */
+		memcpy_user ( free, 0, high->data, len, frag_len );
+		memmove_user ( low->data, new_len, low->data, len, low->len );
+		memcpy_user ( low->data, len, free, 0, frag_len );
+		initrd_moved += ( ( 2 * frag_len ) + low->len );
+		len = new_len;
+	}
+
+	/* Adjust data pointers */
+	high->data = low->data;
+	low->data = userptr_add ( low->data, len );
+}
+
+/**
+ * Swap position of any two adjacent initrds not currently in the correct order
+ *
+ * @v free		Free space
+ * @v free_len		Length of free space
+ * @ret swapped		A pair of initrds was swapped
+ */
+static int initrd_swap_any ( userptr_t free, size_t free_len ) {
+	struct image *low;
+	struct image *high;
+	size_t padded_len;
+	userptr_t adjacent;
+
+	/* Find any pair of initrds that can be swapped */
+	for_each_image ( low ) {
+
+		/* Calculate location of adjacent image (if any) */
+		padded_len = initrd_align ( low );
+		adjacent = userptr_add ( low->data, padded_len );
+
+		/* Search for adjacent image */
+		for_each_image ( high ) {
+
+			/* Stop search if all remaining potential
+			 * adjacent images are already in the correct
+			 * order.  (Checking this first also prevents a
+			 * zero-length image from being considered
+			 * adjacent to itself.)
+			 */
+			if ( high == low )
+				break;
+
+			/* If we have found the adjacent image, swap and exit */
+			if ( high->data == adjacent ) {
+				initrd_swap ( low, high, free, free_len );
+				return 1;
+			}
+		}
+	}
+
+	/* Nothing swapped */
+	return 0;
+}
+
+/**
+ * Dump initrd locations (for debug)
+ *
+ */
+static void initrd_dump ( void ) {
+	struct image *initrd;
+
+	/* Do nothing unless debugging is enabled */
+	if ( ! DBG_LOG )
+		return;
+
+	/* Dump initrd locations */
+	for_each_image ( initrd ) {
+		DBGC ( &images, "INITRD %s at [%#08lx,%#08lx)\n",
+		       initrd->name, user_to_phys ( initrd->data, 0 ),
+		       user_to_phys ( initrd->data, initrd->len ) );
+		DBGC2_MD5A ( &images, user_to_phys ( initrd->data, 0 ),
+			     user_to_virt ( initrd->data, 0 ), initrd->len );
+	}
+}
+
+/**
+ * Rearrange initrds into desired order within a memory region
+ *
+ * @v bottom		Lowest address available for initrds
+ * @v top		Highest address available for initrds
+ * @ret moved		Number of bytes moved
+ *
+ * The initrds are squashed into a contiguous block at the top of the
+ * region, in the order in which they appear in the image list.
+ */
+size_t initrd_rearrange ( userptr_t bottom, userptr_t top ) {
+	userptr_t used;
+	userptr_t free;
+	size_t free_len;
+
+	/* Debug */
+	DBGC ( &images, "INITRD region [%#08lx,%#08lx)\n",
+	       user_to_phys ( bottom, 0 ), user_to_phys ( top, 0 ) );
+	initrd_dump();
+	initrd_moved = 0;
+
+	/* Squash initrds as high as possible in memory */
+	used = initrd_squash_high ( top );
+
+	/* Calculate available free space */
+	free = bottom;
+	free_len = userptr_sub ( used, free );
+
+	/* Move initrds directly to their final locations via the free
+	 * space if possible, otherwise fall back to bubble-sorting
+	 * initrds into desired order.
+	 */
+	if ( initrd_reorder ( used, free, free_len ) != 0 )
+		while ( initrd_swap_any ( free, free_len ) ) {}
+
+	/* Debug */
+	DBGC ( &images, "INITRD reshuffling moved %#zx bytes\n",
+	       initrd_moved );
+	initrd_dump();
+
+	return initrd_moved;
+}
@@ -64,6 +64,68 @@ struct interface_descriptor null_intf_desc =
 /** The null interface */
 struct interface null_intf = INTF_INIT ( null_intf_desc );
 
+/*****************************************************************************
+ *
+ * Object interface operation cache
+ *
+ */
+
+/** Number of entries in the operation cache
+ *
+ * Must be a power of two.
+ */
+#define INTF_CACHE_SIZE 64
+
+/** An object interface operation cache entry */
+struct interface_cache_entry {
+	/** Source interface */
+	struct interface *intf;
+	/** Operation type */
+	void *type;
+	/** Destination interface (after any pass-through) */
+	struct interface *dest;
+	/** Implementing method, or NULL */
+	void *func;
+	/** Interface generation counter at time of lookup */
+	unsigned int generation;
+};
+
+/** Object interface operation cache
+ *
+ * Resolving an operation requires a linear scan of the destination
+ * interface's operation table and, where pass-through interfaces are
+ * present, a walk along the pass-through chain.  Data transfer
+ * operations are invoked several times for each received packet, so
+ * we cache the result of each lookup.
+ *
+ * Any change to the plumbing (i.e. any change to an interface's
+ * destination or descriptor) increments the interface generation
+ * counter, thereby invalidating all cached entries.
+ */
+static struct interface_cache_entry intf_cache[INTF_CACHE_SIZE];
+
+/** Interface generation counter
+ *
+ * Starts at one so that empty cache entries are never valid.
+ */
+unsigned int intf_generation = 1;
+
+/**
+ * Get operation cache entry
+ *
+ * @v intf		Object interface
+ * @v type		Operation type
+ * @ret entry		Operation cache entry
+ */
+static inline struct interface_cache_entry *
+intf_cache_entry ( struct interface *intf, void *type ) {
+	unsigned int index;
+
+	index = ( ( ( ( intptr_t ) intf ) >> 3 ) ^
+		  ( ( ( intptr_t ) type ) >> 2 ) );
+	return &intf_cache[ index & ( INTF_CACHE_SIZE - 1 ) ];
+}
+
 /*****************************************************************************
  *
  * Object interface plumbing
@@ -90,6 +152,7 @@ void intf_plug ( struct interface *intf, struct interface *dest ) {
 	intf_get ( dest );
 	intf_put ( intf->dest );
 	intf->dest = dest;
+	intf_generation++;
 }
 
 /**
@@ -123,6 +186,7 @@ void intf_unplug ( struct interface *intf ) {
  */
 void intf_nullify ( struct interface *intf ) {
 	intf->desc = &null_intf_desc;
+	intf_generation++;
 }
 
 /**
@@ -206,8 +270,17 @@ void * intf_get_dest_op_no_passthru_untyped ( struct interface *intf,
  */
 void * intf_get_dest_op_untyped ( struct interface *intf, void *type,
 				  struct interface **dest ) {
+	struct interface_cache_entry *entry = intf_cache_entry ( intf, type );
+	struct interface *origin = intf;
 	void *func;
 
+	/* Use cached result, if still valid */
+	if ( ( entry->intf == intf ) && ( entry->type == type ) &&
+	     ( entry->generation == intf_generation ) ) {
+		*dest = intf_get ( entry->dest );
+		return entry->func;
+	}
+
 	while ( 1 ) {
 
 		/* Search for an implementing method provided by the
@@ -215,13 +288,22 @@ void * intf_get_dest_op_untyped ( struct interface *intf, void *type,
 		 */
 		func = intf_get_dest_op_no_passthru_untyped( intf, type, dest );
 		if ( func )
-			return func;
+			break;
 
 		/* Pass through to the underlying interface, if applicable */
 		if ( ! ( intf = intf_get_passthru ( *dest ) ) )
-			return NULL;
+			break;
 		intf_put ( *dest );
 	}
+
+	/* Record result in cache */
+	entry->intf = origin;
+	entry->type = type;
+	entry->dest = *dest;
+	entry->func = func;
+	entry->generation = intf_generation;
+
+	return func;
 }
 
 /*****************************************************************************
@@ -310,6 +392,7 @@ void intf_restart ( struct interface *intf, int rc ) {
 	 * of the link call each other recursively.
 	 */
 	intf->desc = desc;
+	intf_generation++;
 }
 
 /**
@@ -87,6 +87,7 @@ struct io_buffer * alloc_iob_raw ( size_t len, size_t align, size_t offset ) {
 	/* Populate descriptor */
 	iobuf->head = iobuf->data = iobuf->tail = data;
 	iobuf->end = ( data + len );
+	iobuf->csum_flags = 0;
 
 	return iobuf;
 }
@@ -137,6 +137,9 @@ int monojob_wait ( const char *string, unsigned long timeout ) {
 			}
 			last_display = now;
 		}
+
+		/* Sleep until the next interrupt, if nothing is runnable */
+		process_nap();
 	}
 	rc = monojob_rc;
 	monojob_close ( &monojob, rc );
@@ -25,6 +25,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <ipxe/list.h>
 #include <ipxe/init.h>
+#include <ipxe/nap.h>
+#include <ipxe/timer.h>
+#include <ipxe/profile.h>
 #include <ipxe/process.h>
 
 /** @file
@@ -33,11 +36,18 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  * We implement a trivial form of cooperative multitasking, in which
  * all processes share a single stack and address space.
+ *
+ * A running process may declare itself to be idle, in which case it
+ * will not be scheduled again until it is woken (either explicitly,
+ * or automatically once a specified time has been reached).
  */
 
 /** Process run queue */
 static LIST_HEAD ( run_queue );
 
+/** Idle process queue */
+static LIST_HEAD ( idle_queue );
+
 /**
  * Get pointer to object containing process
  *
@@ -62,6 +72,7 @@ void process_add ( struct process *process ) {
 		       " starting\n", PROC_DBG ( process ) );
 		ref_get ( process->refcnt );
 		list_add_tail ( &process->list, &run_queue );
+		process->idle = 0;
 	} else {
 		DBGC ( PROC_COL ( process ), "PROCESS " PROC_FMT
 		       " already started\n", PROC_DBG ( process ) );
@@ -82,6 +93,8 @@ void process_del ( struct process *process ) {
 		       " stopping\n", PROC_DBG ( process ) );
 		list_del ( &process->list );
 		INIT_LIST_HEAD ( &process->list );
+		process->idle = 0;
+		process->sleeping = 0;
 		ref_put ( process->refcnt );
 	} else {
 		DBGC ( PROC_COL ( process ), "PROCESS " PROC_FMT
@@ -89,17 +102,137 @@ void process_del ( struct process *process ) {
 	}
 }
 
+/**
+ * Mark process as idle
+ *
+ * @v process		Process
+ *
+ * An idle process remains running (i.e. process_running() will still
+ * return true), but will not be scheduled until process_wake() is
+ * called.  This is typically called by a process from within its own
+ * step() method, when it has no further work to do until some
+ * external event occurs.
+ */
+void process_idle ( struct process *process ) {
+
+	/* Do nothing unless process is running and not already idle */
+	if ( ( ! process_running ( process ) ) || process->idle )
+		return;
+
+	/* Move to idle queue */
+	DBGC2 ( PROC_COL ( process ), "PROCESS " PROC_FMT " idle\n",
+		PROC_DBG ( process ) );
+	list_del ( &process->list );
+	list_add_tail ( &process->list, &idle_queue );
+	process->idle = 1;
+	process->sleeping = 0;
+}
+
+/**
+ * Mark process as idle until a specified time
+ *
+ * @v process		Process
+ * @v timeout		Time to sleep, in ticks
+ *
+ * The process will be woken automatically once the timeout has
+ * elapsed, or earlier if process_wake() is called.
+ */
+void process_sleep ( struct process *process, unsigned long timeout ) {
+
+	/* Mark as idle */
+	process_idle ( process );
+
+	/* Record wake time, if process is now idle */
+	if ( process->idle ) {
+		process->wake = ( currticks() + timeout );
+		process->sleeping = 1;
+	}
+}
+
+/**
+ * Wake idle process
+ *
+ * @v process		Process
+ *
+ * It is safe to call process_wake() for a process that is not idle;
+ * the call will have no effect.
+ */
+void process_wake ( struct process *process ) {
+
+	/* Do nothing unless process is idle */
+	if ( ! process->idle )
+		return;
+
+	/* Move to end of run queue */
+	DBGC2 ( PROC_COL ( process ), "PROCESS " PROC_FMT " woken\n",
+		PROC_DBG ( process ) );
+	list_del ( &process->list );
+	list_add_tail ( &process->list, &run_queue );
+	process->idle = 0;
+	process->sleeping = 0;
+}
+
+/**
+ * Wake any sleeping processes whose wake time has been reached
+ *
+ */
+static void process_wake_expired ( void ) {
+	struct process *process;
+	struct process *tmp;
+	unsigned long now;
+
+	/* Avoid reading the current time unless necessary */
+	if ( list_empty ( &idle_queue ) )
+		return;
+
+	/* Wake any expired sleeping processes */
+	now = currticks();
+	list_for_each_entry_safe ( process, tmp, &idle_queue, list ) {
+		if ( process->sleeping &&
+		     ( ( ( long ) ( now - process->wake ) ) >= 0 ) ) {
+			process_wake ( process );
+		}
+	}
+}
+
+/**
+ * Visit each running process
+ *
+ * @v visit		Method to call for each process
+ *
+ * Runnable processes are visited before idle processes.  The visit
+ * method must not add, remove, or change the state of any process.
+ */
+void process_for_each ( void ( * visit ) ( struct process *process ) ) {
+	struct process *process;
+
+	list_for_each_entry ( process, &run_queue, list )
+		visit ( process );
+	list_for_each_entry ( process, &idle_queue, list )
+		visit ( process );
+}
+
 /**
  * Single-step a single process
  *
  * This executes a single step of the first process in the run queue,
- * and moves the process to the end of the run queue.
+ * and moves the process to the end of the run queue.  Any sleeping
+ * processes whose wake time has been reached will first be woken.
+ *
+ * This function never sleeps, and so may be called from any context
+ * that is prepared to execute background processes (including
+ * externally invoked APIs such as PXE or INT 13 calls).
  */
 void step ( void ) {
 	struct process *process;
 	struct process_descriptor *desc;
+	unsigned long started;
 	void *object;
 
+	/* Wake any expired sleeping processes */
+	process_wake_expired();
+
+	/* Execute first runnable process, if any */
 	if ( ( process = list_first_entry ( &run_queue, struct process,
 					    list ) ) ) {
 		ref_get ( process->refcnt ); /* Inhibit destruction mid-step */
@@ -113,13 +246,44 @@ void step ( void ) {
 		}
 		DBGC2 ( PROC_COL ( process ), "PROCESS " PROC_FMT
 			" executing\n", PROC_DBG ( process ) );
+		started = profile_timestamp();
 		desc->step ( object );
+		process->cycles += ( profile_timestamp() - started );
+		process->steps++;
 		DBGC2 ( PROC_COL ( process ), "PROCESS " PROC_FMT
 			" finished executing\n", PROC_DBG ( process ) );
 		ref_put ( process->refcnt ); /* Allow destruction */
 	}
 }
 
+/**
+ * Sleep until a process may be runnable
+ *
+ * If no process is currently runnable, then the CPU will sleep until
+ * the next interrupt.  Since a sleeping process is woken only by the
+ * passage of time, the timer interrupt will always bring the CPU out
+ * of the sleep in time to wake the process.
+ *
+ * This must be called only from top-level wait loops (such as
+ * waiting for a download to complete), in which it is safe to halt
+ * the CPU.  It must not be called from within an externally invoked
+ * API (such as a PXE or INT 13 call), since the caller may not be
+ * expecting the CPU to halt and may even have disabled interrupts.
+ *
+ * The CPU will never sleep while any network device is open, since
+ * the networking stack process remains runnable in order to poll for
+ * received packets.
+ */
+void process_nap ( void ) {
+
+	/* Wake any expired sleeping processes */
+	process_wake_expired();
+
+	/* Sleep until the next interrupt, if nothing is runnable */
+	if ( list_empty ( &run_queue ) )
+		cpu_nap();
+}
+
 /**
  * Initialise processes
  *
@@ -25,6 +25,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <strings.h>
 #include <assert.h>
 #include <ipxe/isqrt.h>
@@ -39,6 +40,10 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  * these statistics need not be completely accurate; it is sufficient
  * to give a rough approximation.
  *
+ * The profiler also records the minimum and maximum sample values,
+ * and a histogram of sample values using logarithmically-sized
+ * buckets, from which approximate percentiles may be obtained.
+ *
  * The algorithm for updating the mean and variance estimators is from
  * The Art of Computer Programming (via Wikipedia), with adjustments
  * to avoid the use of floating-point instructions.
@@ -116,6 +121,7 @@ void profile_update ( struct profiler *profiler, unsigned long sample ) {
 	unsigned int accvar_delta_shift;
 	unsigned int accvar_delta_msb;
 	unsigned int accvar_shift;
+	unsigned int bucket;
 
 	/* Our scaling logic assumes that sample values never overflow
 	 * a signed long (i.e. that the high bit is always zero).
@@ -125,6 +131,18 @@ void profile_update ( struct profiler *profiler, unsigned long sample ) {
 	/* Update sample count */
 	profiler->count++;
 
+	/* Update minimum and maximum sample values */
+	if ( ( profiler->count == 1 ) || ( sample < profiler->min ) )
+		profiler->min = sample;
+	if ( sample > profiler->max )
+		profiler->max = sample;
+
+	/* Update histogram */
+	bucket = flsl ( sample );
+	if ( bucket >= PROFILE_BUCKETS )
+		bucket = ( PROFILE_BUCKETS - 1 );
+	profiler->buckets[bucket]++;
+
 	/* Adjust mean sample value scale if necessary.  Skip if
 	 * sample is zero (in which case flsl(sample)-1 would
 	 * underflow): in the case of a zero sample we have no need to
@@ -274,3 +292,96 @@ unsigned long profile_stddev ( struct profiler *profiler ) {
 
 	return isqrt ( profile_variance ( profiler ) );
 }
+
+/**
+ * Get approximate sample percentile
+ *
+ * @v profiler		Profiler
+ * @v percent		Percentile (e.g. 99 for the 99th percentile)
+ * @ret value		Approximate percentile sample value
+ *
+ * The histogram bucket containing the requested percentile is found,
+ * and the value is obtained by linear interpolation between the
+ * bounds of that bucket (limited to the range of observed sample
+ * values), assuming that the samples within the bucket are evenly
+ * spaced.
+ */
+unsigned long profile_percentile ( struct profiler *profiler,
+				   unsigned int percent ) {
+	unsigned int count = profiler->count;
+	unsigned int threshold;
+	unsigned int total;
+	unsigned int rank;
+	unsigned int samples;
+	unsigned long lower;
+	unsigned long upper;
+	unsigned int i;
+
+	/* Handle empty data set */
+	if ( ! count )
+		return 0;
+
+	/* Calculate rank of required sample (rounding up), avoiding
+	 * overflow for large sample counts.
+	 */
+	threshold = ( ( ( count / 100 ) * percent ) +
+		      ( ( ( ( count % 100 ) * percent ) + 99 ) / 100 ) );
+	if ( ! threshold )
+		threshold = 1;
+
+	/* Find bucket containing required sample */
+	total = 0;
+	for ( i = 0 ; i < ( PROFILE_BUCKETS - 1 ) ; i++ ) {
+		total += profiler->buckets[i];
+		if ( total >= threshold )
+			break;
+	}
+	if ( i == ( PROFILE_BUCKETS - 1 ) )
+		total += profiler->buckets[i];
+	samples = profiler->buckets[i];
+	rank = ( threshold - ( total - samples ) );
+
+	/* Calculate bounds of bucket, limited to observed range */
+	lower = ( i ? ( 1UL << ( i - 1 ) ) : 0 );
+	upper = ( i ? ( ( 2UL << ( i - 1 ) ) - 1 ) : 0 );
+	if ( ( i == ( PROFILE_BUCKETS - 1 ) ) || ( upper > profiler->max ) )
+		upper = profiler->max;
+	if ( lower < profiler->min )
+		lower = profiler->min;
+
+	/* Interpolate within bucket.  A bucket containing only a
+	 * single sample can be resolved exactly if it contains the
+	 * minimum or maximum observed sample value.
+	 */
+	if ( samples > 1 ) {
+		return ( lower + ( ( ( upper - lower ) *
+				     ( ( unsigned long long ) ( rank - 1 ) ) ) /
+				   ( samples - 1 ) ) );
+	} else if ( upper == profiler->max ) {
+		return upper;
+	} else if ( lower == profiler->min ) {
+		return lower;
+	} else {
+		return ( lower + ( ( upper - lower ) / 2 ) );
+	}
+}
+
+/**
+ * Reset profiler statistics
+ *
+ * @v profiler		Profiler
+ */
+void profile_reset ( struct profiler *profiler ) {
+
+	/* Discard all recorded samples, leaving any ongoing
+	 * measurement (i.e. the start and stop timestamps) intact.
+	 */
+	profiler->count = 0;
+	profiler->mean = 0;
+	profiler->mean_msb = 0;
+	profiler->accvar = 0;
+	profiler->accvar_msb = 0;
+	profiler->min = 0;
+	profiler->max = 0;
+	memset ( profiler->buckets, 0, sizeof ( profiler->buckets ) );
+}
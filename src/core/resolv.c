@@ -27,10 +27,14 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <assert.h>
 #include <ipxe/xfer.h>
 #include <ipxe/open.h>
 #include <ipxe/process.h>
 #include <ipxe/socket.h>
+#include <ipxe/retry.h>
+#include <ipxe/timer.h>
+#include <ipxe/tcpip.h>
 #include <ipxe/resolv.h>
 
 /** @file
@@ -291,7 +295,39 @@ int resolv ( struct interface *resolv, const char *name,
  ***************************************************************************
  */
 
-/** A named socket */
+/** Maximum number of concurrent connection attempts for a named socket */
+#define NAMED_MAX_ATTEMPTS 4
+
+/** Delay before starting the next connection attempt
+ *
+ * RFC 8305 section 5 recommends a delay of 250ms.
+ */
+#define NAMED_ATTEMPT_DELAY ( TICKS_PER_SEC / 4 )
+
+/** A named socket connection attempt */
+struct named_attempt {
+	/** Named socket */
+	struct named_socket *named;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Peer socket address */
+	struct sockaddr peer;
+};
+
+/** A named socket
+ *
+ * Stream sockets are opened using a "happy eyeballs" algorithm (as
+ * described in RFC 8305): the name is resolved separately for each
+ * address family, a connection attempt is started to the first
+ * address found, and attempts to any subsequently found addresses
+ * are started at intervals of NAMED_ATTEMPT_DELAY (or immediately
+ * upon failure of the previous attempt).  The first attempt to
+ * become ready for data is handed over to the parent interface, and
+ * all other attempts are abandoned.
+ *
+ * Other sockets are redirected to the single address returned by
+ * the name resolver.
+ */
 struct named_socket {
 	/** Reference counter */
 	struct refcnt refcnt;
@@ -299,12 +335,29 @@ struct named_socket {
 	struct interface xfer;
 	/** Name resolution interface */
 	struct interface resolv;
+	/** IPv6 name resolution interface (for stream sockets) */
+	struct interface resolv6;
 	/** Communication semantics (e.g. SOCK_STREAM) */
 	int semantics;
 	/** Stored local socket address, if applicable */
 	struct sockaddr local;
 	/** Stored local socket address exists */
 	int have_local;
+
+	/** Number of name resolutions in progress */
+	unsigned int resolving;
+	/** Connection attempt delay timer */
+	struct retry_timer timer;
+	/** Connection attempts */
+	struct named_attempt attempts[NAMED_MAX_ATTEMPTS];
+	/** Number of peer addresses found */
+	unsigned int count;
+	/** Number of connection attempts started */
+	unsigned int started;
+	/** Number of connection attempts failed */
+	unsigned int failed;
+	/** Most recent failure status code */
+	int rc;
 };
 
 /**
@@ -314,11 +367,89 @@ struct named_socket {
  * @v rc		Reason for termination
  */
 static void named_close ( struct named_socket *named, int rc ) {
+	unsigned int i;
+
+	/* Stop timer */
+	stop_timer ( &named->timer );
+
 	/* Shut down interfaces */
+	for ( i = 0 ; i < NAMED_MAX_ATTEMPTS ; i++ )
+		intf_shutdown ( &named->attempts[i].xfer, rc );
+	intf_shutdown ( &named->resolv6, rc );
 	intf_shutdown ( &named->resolv, rc );
 	intf_shutdown ( &named->xfer, rc );
 }
 
+/**
+ * Check for named socket failure
+ *
+ * @v named		Named socket
+ */
+static void named_check ( struct named_socket *named ) {
+
+	/* Fail once name resolution has finished and every
+	 * connection attempt has failed.
+	 */
+	if ( ( ! named->resolving ) && ( named->failed == named->count ) ) {
+		DBGC ( named, "NAMED %p failed: %s\n",
+		       named, strerror ( named->rc ) );
+		named_close ( named, named->rc );
+	}
+}
+
+/**
+ * Start next connection attempt
+ *
+ * @v named		Named socket
+ */
+static void named_attempt ( struct named_socket *named ) {
+	struct sockaddr *local =
+		( named->have_local ? &named->local : NULL );
+	struct named_attempt *attempt;
+	int rc;
+
+	while ( named->started < named->count ) {
+
+		/* Open connection */
+		attempt = &named->attempts[ named->started++ ];
+		DBGC ( named, "NAMED %p attempting %s\n",
+		       named, sock_ntoa ( &attempt->peer ) );
+		rc = xfer_open_socket ( &attempt->xfer, named->semantics,
+					&attempt->peer, local );
+		if ( rc != 0 ) {
+			DBGC ( named, "NAMED %p could not open %s: %s\n",
+			       named, sock_ntoa ( &attempt->peer ),
+			       strerror ( rc ) );
+			named->rc = rc;
+			named->failed++;
+			continue;
+		}
+
+		/* Allow time for this attempt to succeed before
+		 * starting the next.
+		 */
+		start_timer_fixed ( &named->timer, NAMED_ATTEMPT_DELAY );
+		return;
+	}
+
+	/* Check for failure, since there is nothing left to try */
+	named_check ( named );
+}
+
+/**
+ * Handle connection attempt delay timer expiry
+ *
+ * @v timer		Connection attempt delay timer
+ * @v fail		Failure indicator
+ */
+static void named_expired ( struct retry_timer *timer, int fail __unused ) {
+	struct named_socket *named =
+		container_of ( timer, struct named_socket, timer );
+
+	/* Start next connection attempt, if any */
+	named_attempt ( named );
+}
+
 /**
  * Check flow control window
  *
@@ -340,6 +471,73 @@ static struct interface_operation named_xfer_ops[] = {
 static struct interface_descriptor named_xfer_desc =
 	INTF_DESC ( struct named_socket, xfer, named_xfer_ops );
 
+/**
+ * Handle connection attempt window change
+ *
+ * @v attempt		Connection attempt
+ */
+static void named_attempt_window_changed ( struct named_attempt *attempt ) {
+	struct named_socket *named = attempt->named;
+	struct interface *parent;
+	struct interface *conn;
+
+	/* Wait until connection is ready for data */
+	if ( ! xfer_window ( &attempt->xfer ) )
+		return;
+	DBGC ( named, "NAMED %p connected to %s\n",
+	       named, sock_ntoa ( &attempt->peer ) );
+
+	/* Connect parent interface directly to this connection */
+	parent = intf_get ( named->xfer.dest );
+	conn = intf_get ( attempt->xfer.dest );
+	intf_unplug ( &named->xfer );
+	intf_unplug ( &attempt->xfer );
+	intf_plug_plug ( parent, conn );
+
+	/* Notify parent that connection is ready for data */
+	xfer_window_changed ( conn );
+	intf_put ( conn );
+	intf_put ( parent );
+
+	/* Terminate named socket opener and any other attempts */
+	named_close ( named, 0 );
+}
+
+/**
+ * Handle connection attempt failure
+ *
+ * @v attempt		Connection attempt
+ * @v rc		Reason for close
+ */
+static void named_attempt_close ( struct named_attempt *attempt, int rc ) {
+	struct named_socket *named = attempt->named;
+
+	/* Treat a premature close as a failure */
+	if ( ! rc )
+		rc = -ECONNABORTED;
+
+	DBGC ( named, "NAMED %p could not connect to %s: %s\n",
+	       named, sock_ntoa ( &attempt->peer ), strerror ( rc ) );
+	intf_restart ( &attempt->xfer, rc );
+	named->rc = rc;
+	named->failed++;
+
+	/* Start next connection attempt immediately */
+	stop_timer ( &named->timer );
+	named_attempt ( named );
+}
+
+/** Named socket connection attempt interface operations */
+static struct interface_operation named_attempt_ops[] = {
+	INTF_OP ( xfer_window_changed, struct named_attempt *,
+		  named_attempt_window_changed ),
+	INTF_OP ( intf_close, struct named_attempt *, named_attempt_close ),
+};
+
+/** Named socket connection attempt interface descriptor */
+static struct interface_descriptor named_attempt_desc =
+	INTF_DESC ( struct named_attempt, xfer, named_attempt_ops );
+
 /**
  * Name resolved
  *
@@ -348,8 +546,48 @@ static struct interface_descriptor named_xfer_desc =
  */
 static void named_resolv_done ( struct named_socket *named,
 				struct sockaddr *sa ) {
+	struct named_attempt *attempt;
+	unsigned int i;
 	int rc;
 
+	/* Stream sockets race connection attempts to each address */
+	if ( named->semantics == SOCK_STREAM ) {
+
+		/* Ignore duplicate addresses (e.g. a numeric address
+		 * returned by the resolution for each family).
+		 */
+		for ( i = 0 ; i < named->count ; i++ ) {
+			attempt = &named->attempts[i];
+			if ( memcmp ( &attempt->peer, sa,
+				      sizeof ( attempt->peer ) ) == 0 )
+				return;
+		}
+
+		/* Ignore addresses that we have no route to */
+		if ( ! tcpip_netdev ( ( struct sockaddr_tcpip * ) sa ) ) {
+			DBGC ( named, "NAMED %p ignoring unroutable %s\n",
+			       named, sock_ntoa ( sa ) );
+			named->rc = -ENETUNREACH;
+			return;
+		}
+
+		/* Record address */
+		if ( named->count >= NAMED_MAX_ATTEMPTS ) {
+			DBGC ( named, "NAMED %p ignoring excess %s\n",
+			       named, sock_ntoa ( sa ) );
+			return;
+		}
+		attempt = &named->attempts[ named->count++ ];
+		memcpy ( &attempt->peer, sa, sizeof ( attempt->peer ) );
+
+		/* Start connection attempt now, unless we are still
+		 * allowing time for a previous attempt to succeed.
+		 */
+		if ( ! timer_running ( &named->timer ) )
+			named_attempt ( named );
+		return;
+	}
+
 	/* Nullify data transfer interface */
 	intf_nullify ( &named->xfer );
 
@@ -371,9 +609,52 @@ static void named_resolv_done ( struct named_socket *named,
 	named_close ( named, rc );
 }
 
+/**
+ * Name resolution finished
+ *
+ * @v named		Named socket
+ * @v intf		Name resolution interface
+ * @v rc		Reason for close
+ */
+static void named_resolv_finished ( struct named_socket *named,
+				    struct interface *intf, int rc ) {
+
+	/* Record completion of name resolution */
+	intf_restart ( intf, rc );
+	assert ( named->resolving > 0 );
+	named->resolving--;
+	if ( rc != 0 )
+		named->rc = rc;
+
+	/* Check for failure */
+	named_check ( named );
+}
+
+/**
+ * Name resolution finished
+ *
+ * @v named		Named socket
+ * @v rc		Reason for close
+ */
+static void named_resolv_close ( struct named_socket *named, int rc ) {
+
+	named_resolv_finished ( named, &named->resolv, rc );
+}
+
+/**
+ * IPv6 name resolution finished
+ *
+ * @v named		Named socket
+ * @v rc		Reason for close
+ */
+static void named_resolv6_close ( struct named_socket *named, int rc ) {
+
+	named_resolv_finished ( named, &named->resolv6, rc );
+}
+
 /** Named socket opener resolver interface operations */
 static struct interface_operation named_resolv_op[] = {
-	INTF_OP ( intf_close, struct named_socket *, named_close ),
+	INTF_OP ( intf_close, struct named_socket *, named_resolv_close ),
 	INTF_OP ( resolv_done, struct named_socket *, named_resolv_done ),
 };
 
@@ -381,6 +662,16 @@ static struct interface_operation named_resolv_op[] = {
 static struct interface_descriptor named_resolv_desc =
 	INTF_DESC ( struct named_socket, resolv, named_resolv_op );
 
+/** Named socket opener IPv6 resolver interface operations */
+static struct interface_operation named_resolv6_op[] = {
+	INTF_OP ( intf_close, struct named_socket *, named_resolv6_close ),
+	INTF_OP ( resolv_done, struct named_socket *, named_resolv_done ),
+};
+
+/** Named socket opener IPv6 resolver interface descriptor */
+static struct interface_descriptor named_resolv6_desc =
+	INTF_DESC ( struct named_socket, resolv6, named_resolv6_op );
+
 /**
  * Open named socket
  *
@@ -394,6 +685,9 @@ int xfer_open_named_socket ( struct interface *xfer, int semantics,
 			     struct sockaddr *peer, const char *name,
 			     struct sockaddr *local ) {
 	struct named_socket *named;
+	struct named_attempt *attempt;
+	struct sockaddr sa;
+	unsigned int i;
 	int rc;
 
 	/* Allocate and initialise structure */
@@ -403,7 +697,16 @@ int xfer_open_named_socket ( struct interface *xfer, int semantics,
 	ref_init ( &named->refcnt, NULL );
 	intf_init ( &named->xfer, &named_xfer_desc, &named->refcnt );
 	intf_init ( &named->resolv, &named_resolv_desc, &named->refcnt );
+	intf_init ( &named->resolv6, &named_resolv6_desc, &named->refcnt );
+	timer_init ( &named->timer, named_expired, &named->refcnt );
+	for ( i = 0 ; i < NAMED_MAX_ATTEMPTS ; i++ ) {
+		attempt = &named->attempts[i];
+		attempt->named = named;
+		intf_init ( &attempt->xfer, &named_attempt_desc,
+			    &named->refcnt );
+	}
 	named->semantics = semantics;
+	named->rc = -ENETUNREACH;
 	if ( local ) {
 		memcpy ( &named->local, local, sizeof ( named->local ) );
 		named->have_local = 1;
@@ -412,8 +715,24 @@ int xfer_open_named_socket ( struct interface *xfer, int semantics,
 	DBGC ( named, "NAMED %p opening \"%s\"\n",
 	       named, name );
 
-	/* Start name resolution */
-	if ( ( rc = resolv ( &named->resolv, name, peer ) ) != 0 )
+	/* Start name resolution.  If no address family is
+	 * specified, then stream sockets resolve each address family
+	 * separately (to allow connection attempts to race), while
+	 * other sockets use the resolver's choice of a single
+	 * address family.
+	 */
+	memset ( &sa, 0, sizeof ( sa ) );
+	if ( peer )
+		memcpy ( &sa, peer, sizeof ( sa ) );
+	if ( ( semantics == SOCK_STREAM ) && ( ! sa.sa_family ) ) {
+		sa.sa_family = AF_INET6;
+		if ( resolv ( &named->resolv6, name, &sa ) == 0 )
+			named->resolving++;
+		sa.sa_family = AF_INET;
+	}
+	if ( ( rc = resolv ( &named->resolv, name, &sa ) ) == 0 )
+		named->resolving++;
+	if ( ! named->resolving )
 		goto err;
 
 	/* Attach parent interface, mortalise self, and return */
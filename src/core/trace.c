@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <ipxe/profile.h>
+#include <ipxe/trace.h>
+
+/** @file
+ *
+ * Event tracing
+ *
+ * Trace events are recorded into a fixed-size ring buffer, with the
+ * oldest events being overwritten once the ring is full.  Recording
+ * an event involves no allocation and no output, and so perturbs
+ * timing far less than debug messages.
+ */
+
+/** Trace ring buffer */
+struct trace_event trace_events[TRACE_EVENTS];
+
+/** Total number of trace events recorded */
+unsigned int trace_count;
+
+/**
+ * Record trace event
+ *
+ * @v type		Event type
+ * @v object		Object to which the event relates
+ * @v data		Event-specific data
+ */
+void trace_record ( unsigned int type, void *object, unsigned long data ) {
+	struct trace_event *event;
+
+	/* Do nothing if tracing is disabled */
+	if ( ! TRACE_EVENTS )
+		return;
+
+	/* Overwrite oldest event, if applicable */
+	event = &trace_events[ trace_count++ & ( TRACE_EVENTS - 1 ) ];
+	event->timestamp = profile_timestamp();
+	event->object = object;
+	event->data = data;
+	event->type = type;
+}
@@ -32,6 +32,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/crypto.h>
 #include <ipxe/asn1.h>
 #include <ipxe/x509.h>
+#include <ipxe/crc32.h>
 #include <ipxe/certstore.h>
 
 /** @file
@@ -75,6 +76,76 @@ struct x509_chain certstore = {
 	.links = LIST_HEAD_INIT ( certstore.links ),
 };
 
+/** Number of certificate store index buckets (must be a power of two) */
+#define CERTSTORE_HASH_SIZE 64
+
+/** Length of raw certificate tail used to select an index bucket
+ *
+ * A certificate ends with its signature value, which is effectively
+ * random.  Hashing only the tail of the raw certificate is therefore
+ * sufficient to spread certificates evenly across the buckets.
+ */
+#define CERTSTORE_RAW_HASH_LEN 16
+
+/** Certificate store raw certificate index */
+static struct list_head certstore_raw_index[CERTSTORE_HASH_SIZE];
+
+/** Certificate store subject index */
+static struct list_head certstore_subject_index[CERTSTORE_HASH_SIZE];
+
+/**
+ * Get certificate store index bucket
+ *
+ * @v index		Certificate store index
+ * @v data		Data to hash
+ * @v len		Length of data to hash
+ * @ret bucket		Index bucket
+ */
+static struct list_head * certstore_bucket ( struct list_head *index,
+					     const void *data, size_t len ) {
+	struct list_head *bucket;
+
+	/* Identify bucket */
+	bucket = &index[ crc32_le ( 0, data, len ) &
+			 ( CERTSTORE_HASH_SIZE - 1 ) ];
+
+	/* Initialise bucket on first use */
+	if ( ! bucket->next )
+		INIT_LIST_HEAD ( bucket );
+
+	return bucket;
+}
+
+/**
+ * Get certificate store raw certificate index bucket
+ *
+ * @v raw		Raw certificate data
+ * @ret bucket		Index bucket
+ */
+static struct list_head *
+certstore_raw_bucket ( const struct asn1_cursor *raw ) {
+	size_t len = raw->len;
+
+	/* Hash only the tail of the raw certificate */
+	if ( len > CERTSTORE_RAW_HASH_LEN )
+		len = CERTSTORE_RAW_HASH_LEN;
+	return certstore_bucket ( certstore_raw_index,
+				  ( raw->data + raw->len - len ), len );
+}
+
+/**
+ * Get certificate store subject index bucket
+ *
+ * @v subject		Raw subject
+ * @ret bucket		Index bucket
+ */
+static struct list_head *
+certstore_subject_bucket ( const struct asn1_cursor *subject ) {
+
+	return certstore_bucket ( certstore_subject_index, subject->data,
+				  subject->len );
+}
+
 /**
  * Mark stored certificate as most recently used
  *
@@ -84,9 +155,16 @@ struct x509_chain certstore = {
 static struct x509_certificate *
 certstore_found ( struct x509_certificate *cert ) {
 
-	/* Mark as most recently used */
+	/* Mark as most recently used, preserving the relative order
+	 * of certificates within each index bucket.
+	 */
 	list_del ( &cert->store.list );
 	list_add ( &cert->store.list, &certstore.links );
+	list_del ( &cert->store_raw );
+	list_add ( &cert->store_raw, certstore_raw_bucket ( &cert->raw ) );
+	list_del ( &cert->store_subject );
+	list_add ( &cert->store_subject,
+		   certstore_subject_bucket ( &cert->subject.raw ) );
 	DBGC2 ( &certstore, "CERTSTORE found certificate %s\n",
 		x509_name ( cert ) );
 
@@ -100,16 +178,39 @@ certstore_found ( struct x509_certificate *cert ) {
  * @ret cert		X.509 certificate, or NULL if not found
  */
 struct x509_certificate * certstore_find ( struct asn1_cursor *raw ) {
+	struct list_head *bucket = certstore_raw_bucket ( raw );
 	struct x509_certificate *cert;
 
-	/* Search for certificate within store */
-	list_for_each_entry ( cert, &certstore.links, store.list ) {
+	/* Search for certificate within index bucket */
+	list_for_each_entry ( cert, bucket, store_raw ) {
 		if ( asn1_compare ( raw, &cert->raw ) == 0 )
 			return certstore_found ( cert );
 	}
 	return NULL;
 }
 
+/**
+ * Find certificate in store by subject
+ *
+ * @v subject		Raw subject
+ * @ret cert		X.509 certificate, or NULL if not found
+ *
+ * If several stored certificates share the same subject, the most
+ * recently used certificate will be returned.
+ */
+struct x509_certificate *
+certstore_find_subject ( const struct asn1_cursor *subject ) {
+	struct list_head *bucket = certstore_subject_bucket ( subject );
+	struct x509_certificate *cert;
+
+	/* Search for certificate within index bucket */
+	list_for_each_entry ( cert, bucket, store_subject ) {
+		if ( asn1_compare ( subject, &cert->subject.raw ) == 0 )
+			return cert;
+	}
+	return NULL;
+}
+
 /**
  * Find certificate in store corresponding to a private key
  *
@@ -141,10 +242,29 @@ void certstore_add ( struct x509_certificate *cert ) {
 	cert->store.cert = cert;
 	x509_get ( cert );
 	list_add ( &cert->store.list, &certstore.links );
+	list_add ( &cert->store_raw, certstore_raw_bucket ( &cert->raw ) );
+	list_add ( &cert->store_subject,
+		   certstore_subject_bucket ( &cert->subject.raw ) );
 	DBGC ( &certstore, "CERTSTORE added certificate %s\n",
 	       x509_name ( cert ) );
 }
 
+/**
+ * Remove certificate from store
+ *
+ * @v cert		X.509 certificate
+ */
+void certstore_del ( struct x509_certificate *cert ) {
+
+	/* Remove certificate from store */
+	DBGC ( &certstore, "CERTSTORE removed certificate %s\n",
+	       x509_name ( cert ) );
+	list_del ( &cert->store.list );
+	list_del ( &cert->store_raw );
+	list_del ( &cert->store_subject );
+	x509_put ( cert );
+}
+
 /**
  * Discard a stored certificate
  *
@@ -160,8 +280,7 @@ static unsigned int certstore_discard ( void ) {
 		if ( cert->refcnt.count == 0 ) {
 			DBGC ( &certstore, "CERTSTORE discarded certificate "
 			       "%s\n", x509_name ( cert ) );
-			list_del ( &cert->store.list );
-			x509_put ( cert );
+			certstore_del ( cert );
 			return 1;
 		}
 	}
@@ -28,6 +28,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <errno.h>
 #include <assert.h>
 #include <ipxe/list.h>
+#include <ipxe/malloc.h>
 #include <ipxe/base16.h>
 #include <ipxe/asn1.h>
 #include <ipxe/crypto.h>
@@ -1306,11 +1307,13 @@ int x509_check_time ( struct x509_certificate *cert, time_t time ) {
  *
  * Validation results are cached: if a certificate has already been
  * successfully validated then @c issuer, @c time, and @c root will be
- * ignored.
+ * ignored.  The exception is a certificate validated using OCSP,
+ * which must be revalidated once the OCSP response becomes stale.
  */
 int x509_validate ( struct x509_certificate *cert,
 		    struct x509_certificate *issuer,
 		    time_t time, struct x509_root *root ) {
+	struct x509_ocsp_responder *ocsp = &cert->extensions.auth_info.ocsp;
 	unsigned int max_path_remaining;
 	int rc;
 
@@ -1318,6 +1321,17 @@ int x509_validate ( struct x509_certificate *cert,
 	if ( ! root )
 		root = &root_certificates;
 
+	/* Discard cached OCSP status (and hence any cached validation
+	 * result) once stale, allowing some margin of error.
+	 */
+	if ( ocsp->good &&
+	     ( ocsp->expiry < ( time - TIMESTAMP_ERROR_MARGIN ) ) ) {
+		DBGC ( cert, "X509 %p \"%s\" OCSP status is stale\n",
+		       cert, x509_name ( cert ) );
+		ocsp->good = 0;
+		x509_invalidate ( cert );
+	}
+
 	/* Return success if certificate has already been validated */
 	if ( cert->valid )
 		return 0;
@@ -1361,8 +1375,7 @@ int x509_validate ( struct x509_certificate *cert,
 	}
 
 	/* Fail if OCSP is required */
-	if ( cert->extensions.auth_info.ocsp.uri.len &&
-	     ( ! cert->extensions.auth_info.ocsp.good ) ) {
+	if ( ocsp->uri.len && ( ! ocsp->good ) ) {
 		DBGC ( cert, "X509 %p \"%s\" requires an OCSP check\n",
 		       cert, x509_name ( cert ) );
 		return -EACCES_OCSP_REQUIRED;
@@ -1658,6 +1671,10 @@ x509_find_subject ( struct x509_chain *certs,
 	struct x509_link *link;
 	struct x509_certificate *cert;
 
+	/* Use certificate store index, if applicable */
+	if ( certs == &certstore )
+		return certstore_find_subject ( subject );
+
 	/* Scan through certificate list */
 	list_for_each_entry ( link, &certs->links, list ) {
 
@@ -1711,6 +1728,224 @@ int x509_auto_append ( struct x509_chain *chain, struct x509_chain *certs ) {
 	return 0;
 }
 
+/** Fingerprint algorithm used for the validated certificate cache */
+#define x509_cache_algorithm sha256_algorithm
+
+/** A validated certificate cache entry
+ *
+ * A cache entry records that a certificate (identified by its
+ * fingerprint) has previously been validated via a complete chain of
+ * signatures up to a root certificate list.  Entries are independent
+ * of the certificate structures themselves, and so remain usable
+ * even after the certificate has been discarded from the certificate
+ * store and subsequently reparsed.
+ */
+struct x509_cache_entry {
+	/** List of cache entries */
+	struct list_head list;
+	/** Root certificate list */
+	struct x509_root *root;
+	/** Start of validity window */
+	time_t not_before;
+	/** End of validity window */
+	time_t not_after;
+	/** Maximum number of subsequent certificates in chain */
+	unsigned int path_remaining;
+	/** Certificate fingerprint */
+	uint8_t fingerprint[SHA256_DIGEST_SIZE];
+};
+
+/** Validated certificate cache, in order of most recent use */
+static LIST_HEAD ( x509_cache );
+
+/** Validated certificate cache statistics */
+struct x509_cache_statistics x509_cache_stats;
+
+/**
+ * Remove entry from validated certificate cache
+ *
+ * @v entry		Cache entry
+ */
+static void x509_cache_del ( struct x509_cache_entry *entry ) {
+
+	list_del ( &entry->list );
+	free ( entry );
+	x509_cache_stats.entries--;
+}
+
+/**
+ * Check validated certificate cache
+ *
+ * @v cert		X.509 certificate
+ * @v time		Time at which to validate certificate
+ * @v root		Root certificate list
+ * @ret rc		Return status code
+ *
+ * On success, the certificate is marked as valid.
+ */
+static int x509_cache_validate ( struct x509_certificate *cert, time_t time,
+				 struct x509_root *root ) {
+	uint8_t fingerprint[ sizeof ( ( ( struct x509_cache_entry * )
+					  NULL )->fingerprint ) ];
+	struct x509_cache_entry *entry;
+
+	/* Calculate fingerprint */
+	x509_fingerprint ( cert, &x509_cache_algorithm, fingerprint );
+
+	/* Search for a matching entry */
+	list_for_each_entry ( entry, &x509_cache, list ) {
+
+		/* Check certificate and root certificate list */
+		if ( ( entry->root != root ) ||
+		     ( memcmp ( entry->fingerprint, fingerprint,
+				sizeof ( fingerprint ) ) != 0 ) )
+			continue;
+
+		/* Discard entry if validity window does not include
+		 * the specified time.  (Time is assumed to move
+		 * forwards, so an entry that is not yet valid is
+		 * discarded along with an expired entry.)
+		 */
+		if ( ( entry->not_before >
+		       ( time + TIMESTAMP_ERROR_MARGIN ) ) ||
+		     ( entry->not_after < ( time - TIMESTAMP_ERROR_MARGIN ) ) ){
+			DBGC ( cert, "X509 %p \"%s\" cached validation has "
+			       "expired\n", cert, x509_name ( cert ) );
+			x509_cache_del ( entry );
+			break;
+		}
+
+		/* Mark as most recently used */
+		list_del ( &entry->list );
+		list_add ( &entry->list, &x509_cache );
+
+		/* Mark certificate as valid */
+		cert->valid = 1;
+		cert->path_remaining = entry->path_remaining;
+		x509_cache_stats.hits++;
+		DBGC ( cert, "X509 %p \"%s\" validated using cache\n",
+		       cert, x509_name ( cert ) );
+		return 0;
+	}
+
+	x509_cache_stats.misses++;
+	return -ENOENT;
+}
+
+/**
+ * Record validated certificate chain in validated certificate cache
+ *
+ * @v chain		X.509 certificate chain
+ * @v anchor		Certificate validated as a standalone
+ * @v root		Root certificate list
+ */
+static void x509_cache_add ( struct x509_chain *chain,
+			     struct x509_certificate *anchor,
+			     struct x509_root *root ) {
+	struct x509_certificate *first = x509_first ( chain );
+	struct x509_ocsp_responder *ocsp;
+	struct x509_validity *validity;
+	struct x509_cache_entry *entry;
+	struct x509_link *link;
+
+	/* Discard least recently used entry if cache is full */
+	if ( x509_cache_stats.entries >= X509_CACHE_MAX ) {
+		entry = list_last_entry ( &x509_cache, struct x509_cache_entry,
+					  list );
+		x509_cache_del ( entry );
+	}
+
+	/* Allocate and initialise entry */
+	entry = zalloc ( sizeof ( *entry ) );
+	if ( ! entry )
+		return;
+	entry->root = root;
+	entry->not_after = first->validity.not_after.time;
+	entry->path_remaining = first->path_remaining;
+	x509_fingerprint ( first, &x509_cache_algorithm, entry->fingerprint );
+
+	/* Restrict validity window to that of each certificate used
+	 * (and of any OCSP responses used), up to and including the
+	 * standalone certificate.
+	 */
+	list_for_each_entry ( link, &chain->links, list ) {
+		validity = &link->cert->validity;
+		if ( entry->not_before < validity->not_before.time )
+			entry->not_before = validity->not_before.time;
+		if ( entry->not_after > validity->not_after.time )
+			entry->not_after = validity->not_after.time;
+		ocsp = &link->cert->extensions.auth_info.ocsp;
+		if ( ocsp->good && ( entry->not_after > ocsp->expiry ) )
+			entry->not_after = ocsp->expiry;
+		if ( link->cert == anchor )
+			break;
+	}
+
+	/* Add to cache */
+	list_add ( &entry->list, &x509_cache );
+	x509_cache_stats.entries++;
+	DBGC ( first, "X509 %p \"%s\" cached validation until %lld\n",
+	       first, x509_name ( first ), entry->not_after );
+}
+
+/**
+ * Discard a validated certificate cache entry
+ *
+ * @ret discarded	Number of cached items discarded
+ */
+static unsigned int x509_cache_discard ( void ) {
+	struct x509_cache_entry *entry;
+
+	/* Discard least recently used entry, if any */
+	entry = list_last_entry ( &x509_cache, struct x509_cache_entry, list );
+	if ( entry ) {
+		x509_cache_del ( entry );
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+/**
+ * Validated certificate cache discarder
+ *
+ * Cached validation results are deemed to have a high replacement
+ * cost, since recreating a result requires a public-key signature
+ * verification for each certificate in the chain.
+ */
+struct cache_discarder x509_discarder __cache_discarder ( CACHE_EXPENSIVE ) = {
+	.discard = x509_cache_discard,
+};
+
+/**
+ * Invalidate X.509 certificate
+ *
+ * @v cert		X.509 certificate
+ *
+ * Any cached validation result for the certificate will also be
+ * discarded.
+ */
+void x509_invalidate ( struct x509_certificate *cert ) {
+	uint8_t fingerprint[ sizeof ( ( ( struct x509_cache_entry * )
+					  NULL )->fingerprint ) ];
+	struct x509_cache_entry *entry;
+	struct x509_cache_entry *tmp;
+
+	/* Mark certificate as not validated */
+	cert->valid = 0;
+	cert->path_remaining = 0;
+
+	/* Discard any cached validation results */
+	if ( list_empty ( &x509_cache ) )
+		return;
+	x509_fingerprint ( cert, &x509_cache_algorithm, fingerprint );
+	list_for_each_entry_safe ( entry, tmp, &x509_cache, list ) {
+		if ( memcmp ( entry->fingerprint, fingerprint,
+			      sizeof ( fingerprint ) ) == 0 )
+			x509_cache_del ( entry );
+	}
+}
+
 /**
  * Validate X.509 certificate chain
  *
@@ -1723,13 +1958,27 @@ int x509_auto_append ( struct x509_chain *chain, struct x509_chain *certs ) {
 int x509_validate_chain ( struct x509_chain *chain, time_t time,
 			  struct x509_chain *store, struct x509_root *root ) {
 	struct x509_certificate *issuer = NULL;
+	struct x509_certificate *anchor;
+	struct x509_certificate *first;
 	struct x509_link *link;
+	int was_valid;
 	int rc;
 
 	/* Use default certificate store if none specified */
 	if ( ! store )
 		store = &certstore;
 
+	/* Use default root certificate store if none specified */
+	if ( ! root )
+		root = &root_certificates;
+
+	/* Use cached validation result, if available */
+	first = x509_first ( chain );
+	was_valid = ( first && first->valid );
+	if ( first && ( ! was_valid ) &&
+	     ( x509_cache_validate ( first, time, root ) == 0 ) )
+		return 0;
+
 	/* Append any applicable certificates from the certificate store */
 	if ( ( rc = x509_auto_append ( chain, store ) ) != 0 )
 		return rc;
@@ -1748,7 +1997,8 @@ int x509_validate_chain ( struct x509_chain *chain, time_t time,
 		/* Work back up to start of chain, performing pairwise
 		 * validation.
 		 */
-		issuer = link->cert;
+		anchor = link->cert;
+		issuer = anchor;
 		list_for_each_entry_continue_reverse ( link, &chain->links,
 						       list ) {
 
@@ -1759,6 +2009,10 @@ int x509_validate_chain ( struct x509_chain *chain, time_t time,
 			issuer = link->cert;
 		}
 
+		/* Record validation result, if not already valid */
+		if ( ! was_valid )
+			x509_cache_add ( chain, anchor, root );
+
 		return 0;
 	}
 
@@ -11,16 +11,53 @@
  *
  */
 
+#include "errno.h"
+#include "byteswap.h"
 #include "etherboot.h"
 #include "ipxe/io.h"
+#include "ipxe/malloc.h"
+#include "ipxe/pci.h"
 #include "ipxe/virtio-ring.h"
 #include "ipxe/virtio-pci.h"
 
+static int vp_alloc_vq(struct vring_virtqueue *vq, u16 num)
+{
+   size_t queue_size = PAGE_MASK + vring_size(num);
+   size_t vdata_size = num * sizeof(void *);
+
+   vq->queue = malloc_dma(queue_size, PAGE_SIZE);
+   if (!vq->queue) {
+      return -ENOMEM;
+   }
+   memset(vq->queue, 0, queue_size);
+   vq->queue_size = queue_size;
+
+   vq->vdata = zalloc(vdata_size);
+   if (!vq->vdata) {
+      vp_free_vq(vq);
+      return -ENOMEM;
+   }
+   return 0;
+}
+
+void vp_free_vq(struct vring_virtqueue *vq)
+{
+   if (vq->queue && vq->queue_size) {
+      free_dma(vq->queue, vq->queue_size);
+   }
+   free(vq->vdata);
+   virtio_pci_unmap_capability(&vq->notification);
+   vq->queue = NULL;
+   vq->queue_size = 0;
+   vq->vdata = NULL;
+}
+
 int vp_find_vq(unsigned int ioaddr, int queue_index,
                struct vring_virtqueue *vq)
 {
    struct vring * vr = &vq->vring;
    u16 num;
+   int rc;
 
    /* select the queue */
 
@@ -34,11 +71,6 @@ int vp_find_vq(unsigned int ioaddr, int queue_index,
            return -1;
    }
 
-   if (num > MAX_QUEUE_NUM) {
-           printf("ERROR: queue size %d > %d\n", num, MAX_QUEUE_NUM);
-           return -1;
-   }
-
    /* check if the queue is already active */
 
    if (inl(ioaddr + VIRTIO_PCI_QUEUE_PFN)) {
@@ -50,7 +82,12 @@ int vp_find_vq(unsigned int ioaddr, int queue_index,
 
    /* initialize the queue */
 
-   vring_init(vr, num, (unsigned char*)&vq->queue);
+   rc = vp_alloc_vq(vq, num);
+   if (rc) {
+           printf("ERROR: failed to allocate queue memory\n");
+           return rc;
+   }
+   vring_init(vr, num, vq->queue);
 
    /* activate the queue
     *
@@ -62,3 +99,208 @@ int vp_find_vq(unsigned int ioaddr, int queue_index,
 
    return num;
 }
+
+int virtio_pci_find_capability(struct pci_device *pci, uint8_t cfg_type)
+{
+   int pos;
+   uint8_t type, bar;
+
+   for (pos = pci_find_capability(pci, PCI_CAP_ID_VNDR);
+        pos > 0;
+        pos = pci_find_next_capability(pci, pos, PCI_CAP_ID_VNDR)) {
+
+      pci_read_config_byte(pci, pos + VIRTIO_PCI_CAP_CFG_TYPE, &type);
+      pci_read_config_byte(pci, pos + VIRTIO_PCI_CAP_BAR, &bar);
+
+      /* Ignore structures with reserved BAR values */
+      if (bar > 0x5) {
+         continue;
+      }
+
+      if (type == cfg_type) {
+         return pos;
+      }
+   }
+   return 0;
+}
+
+int virtio_pci_map_capability(struct pci_device *pci, int cap, size_t minlen,
+                              u32 align, u32 start, u32 size,
+                              struct virtio_pci_region *region)
+{
+   u8 bar;
+   u32 offset, length, base_raw;
+   unsigned long base;
+
+   pci_read_config_byte(pci, cap + VIRTIO_PCI_CAP_BAR, &bar);
+   pci_read_config_dword(pci, cap + VIRTIO_PCI_CAP_OFFSET, &offset);
+   pci_read_config_dword(pci, cap + VIRTIO_PCI_CAP_LENGTH, &length);
+
+   if (length <= start) {
+      DBG("VIRTIO-PCI bad capability len %d (>%d expected)\n", length, start);
+      return -EINVAL;
+   }
+   if (length - start < minlen) {
+      DBG("VIRTIO-PCI bad capability len %d (>=%zd expected)\n", length, minlen);
+      return -EINVAL;
+   }
+   length -= start;
+   if (start + offset < offset) {
+      DBG("VIRTIO-PCI map wrap-around %d+%d\n", start, offset);
+      return -EINVAL;
+   }
+   offset += start;
+   if (offset & (align - 1)) {
+      DBG("VIRTIO-PCI offset %d not aligned to %d\n", offset, align);
+      return -EINVAL;
+   }
+   if (length > size) {
+      length = size;
+   }
+
+   if (minlen + offset < minlen ||
+       minlen + offset > pci_bar_size(pci, PCI_BASE_ADDRESS(bar))) {
+      DBG("VIRTIO-PCI map virtio %zd@%d out of range on bar %i length %ld\n",
+          minlen, offset,
+          bar, pci_bar_size(pci, PCI_BASE_ADDRESS(bar)));
+      return -EINVAL;
+   }
+
+   region->base = NULL;
+   region->length = length;
+   region->bar = bar;
+   region->flags = 0;
+
+   base = pci_bar_start(pci, PCI_BASE_ADDRESS(bar));
+   if (base) {
+      pci_read_config_dword(pci, PCI_BASE_ADDRESS(bar), &base_raw);
+
+      if (base_raw & PCI_BASE_ADDRESS_SPACE_IO) {
+         /* Region accessed using port I/O */
+         region->base = (void *)(base + offset);
+         region->flags = VIRTIO_PCI_REGION_PORT;
+      } else {
+         /* Region mapped into memory space */
+         region->base = ioremap(base + offset, length);
+         region->flags = VIRTIO_PCI_REGION_MEMORY;
+      }
+   }
+   if (!region->base) {
+      region->flags = 0;
+      return -ENOMEM;
+   }
+   return 0;
+}
+
+void virtio_pci_unmap_capability(struct virtio_pci_region *region)
+{
+   unsigned region_type = region->flags & VIRTIO_PCI_REGION_TYPE_MASK;
+   if (region_type == VIRTIO_PCI_REGION_MEMORY) {
+      iounmap(region->base);
+   }
+   region->base = NULL;
+   region->flags = 0;
+}
+
+void vpm_notify(struct virtio_pci_modern_device *vdev,
+                struct vring_virtqueue *vq)
+{
+   vpm_iowrite16(vdev, &vq->notification, (u16)vq->queue_index, 0);
+}
+
+int vpm_find_vqs(struct virtio_pci_modern_device *vdev,
+                 unsigned nvqs, struct vring_virtqueue *vqs)
+{
+   unsigned i;
+   struct vring_virtqueue *vq;
+   u16 size, off;
+   u32 notify_offset_multiplier;
+   int err;
+
+   if (nvqs > vpm_ioread16(vdev, &vdev->common, COMMON_OFFSET(num_queues))) {
+      return -ENOENT;
+   }
+
+   /* Read notify_off_multiplier from config space. */
+   pci_read_config_dword(vdev->pci,
+      vdev->notify_cap_pos + VIRTIO_PCI_NOTIFY_CAP_MULT,
+      &notify_offset_multiplier);
+
+   for (i = 0; i < nvqs; i++) {
+      /* Select the queue we're interested in */
+      vpm_iowrite16(vdev, &vdev->common, (u16)i, COMMON_OFFSET(queue_select));
+
+      /* Check if queue is available.  (Some versions of QEMU fail
+       * to clear queue_enable on device reset, so we cannot check
+       * whether or not the queue is already active.)
+       */
+      size = vpm_ioread16(vdev, &vdev->common, COMMON_OFFSET(queue_size));
+      if (!size) {
+         err = -ENOENT;
+         goto err_queue;
+      }
+
+      if (size & (size - 1)) {
+         DBG("VIRTIO-PCI %p: bad queue size %d\n", vdev, size);
+         err = -EINVAL;
+         goto err_queue;
+      }
+
+      /* A virtio 1.0 device allows us to use a smaller queue */
+      if (size > MAX_QUEUE_NUM) {
+         size = MAX_QUEUE_NUM;
+      }
+
+      vq = &vqs[i];
+      vq->queue_index = i;
+
+      /* get offset of notification word for this vq */
+      off = vpm_ioread16(vdev, &vdev->common, COMMON_OFFSET(queue_notify_off));
+
+      err = vp_alloc_vq(vq, size);
+      if (err) {
+         DBG("VIRTIO-PCI %p: failed to allocate queue memory\n", vdev);
+         goto err_queue;
+      }
+      vring_init(&vq->vring, size, vq->queue);
+
+      /* activate the queue */
+      vpm_iowrite16(vdev, &vdev->common, size, COMMON_OFFSET(queue_size));
+
+      vpm_iowrite64(vdev, &vdev->common, virt_to_phys(vq->vring.desc),
+                    COMMON_OFFSET(queue_desc_lo),
+                    COMMON_OFFSET(queue_desc_hi));
+      vpm_iowrite64(vdev, &vdev->common, virt_to_phys(vq->vring.avail),
+                    COMMON_OFFSET(queue_avail_lo),
+                    COMMON_OFFSET(queue_avail_hi));
+      vpm_iowrite64(vdev, &vdev->common, virt_to_phys(vq->vring.used),
+                    COMMON_OFFSET(queue_used_lo),
+                    COMMON_OFFSET(queue_used_hi));
+
+      err = virtio_pci_map_capability(vdev->pci,
+         vdev->notify_cap_pos, 2, 2,
+         off * notify_offset_multiplier, 2,
+         &vq->notification);
+      if (err) {
+         i++;
+         goto err_queue;
+      }
+   }
+
+   /* Select and activate all queues. Has to be done last: once we do
+    * this, there's no way to go back except reset.
+    */
+   for (i = 0; i < nvqs; i++) {
+      vq = &vqs[i];
+      vpm_iowrite16(vdev, &vdev->common, (u16)vq->queue_index,
+                    COMMON_OFFSET(queue_select));
+      vpm_iowrite16(vdev, &vdev->common, 1, COMMON_OFFSET(queue_enable));
+   }
+   return 0;
+
+err_queue:
+   /* Free any queues allocated so far */
+   while (i--)
+      vp_free_vq(&vqs[i]);
+   return err;
+}
@@ -80,6 +80,13 @@ void *vring_get_buf(struct vring_virtqueue *vq, unsigned int *len)
 
    vq->last_used_idx++;
 
+   /* request an interrupt for the next used buffer, if enabled */
+
+   if (vq->event && !(vr->avail->flags & VRING_AVAIL_F_NO_INTERRUPT)) {
+           vring_used_event(vr) = vq->last_used_idx;
+           mb();
+   }
+
    return opaque;
 }
 
@@ -122,15 +129,33 @@ void vring_add_buf(struct vring_virtqueue *vq,
    wmb();
 }
 
-void vring_kick(unsigned int ioaddr, struct vring_virtqueue *vq, int num_added)
+void vring_kick(struct virtio_pci_modern_device *vdev, unsigned int ioaddr,
+                struct vring_virtqueue *vq, int num_added)
 {
    struct vring *vr = &vq->vring;
+   u16 prev_idx;
+   u16 new_idx;
+   int notify;
 
    wmb();
-   vr->avail->idx += num_added;
+   prev_idx = vr->avail->idx;
+   new_idx = prev_idx + num_added;
+   vr->avail->idx = new_idx;
+
+   /* notify only if the host has asked for it */
 
    mb();
-   if (!(vr->used->flags & VRING_USED_F_NO_NOTIFY))
-           vp_notify(ioaddr, vq->queue_index);
+   if (vq->event) {
+           notify = vring_need_event(vring_avail_event(vr),
+                                     new_idx, prev_idx);
+   } else {
+           notify = !(vr->used->flags & VRING_USED_F_NO_NOTIFY);
+   }
+   if (notify) {
+           if (vdev)
+                   vpm_notify(vdev, vq);
+           else
+                   vp_notify(ioaddr, vq->queue_index);
+   }
 }
 
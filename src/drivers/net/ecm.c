@@ -316,6 +316,13 @@ static int ecm_open ( struct net_device *netdev ) {
 	unsigned int filter;
 	int rc;
 
+	/* Prefill I/O buffers */
+	if ( ( rc = usb_prefill ( &ecm->usbnet.in ) ) != 0 ) {
+		DBGC ( ecm, "ECM %p could not prefill bulk IN: %s\n",
+		       ecm, strerror ( rc ) );
+		goto err_prefill;
+	}
+
 	/* Open USB network device */
 	if ( ( rc = usbnet_open ( &ecm->usbnet ) ) != 0 ) {
 		DBGC ( ecm, "ECM %p could not open: %s\n",
@@ -340,6 +347,8 @@ static int ecm_open ( struct net_device *netdev ) {
  err_set_filter:
 	usbnet_close ( &ecm->usbnet );
  err_open:
+	usb_flush ( &ecm->usbnet.in );
+ err_prefill:
 	return rc;
 }
 
@@ -73,9 +73,10 @@ struct ecm_device {
 
 /** Bulk IN maximum fill level
  *
- * This is a policy decision.
+ * This is a policy decision, constrained by the smallest transfer
+ * ring supported by any USB host controller driver.
  */
-#define ECM_IN_MAX_FILL 8
+#define ECM_IN_MAX_FILL 16
 
 /** Bulk IN buffer size
  *
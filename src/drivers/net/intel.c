@@ -607,6 +607,12 @@ static int intel_open ( struct net_device *netdev ) {
 		  INTEL_RCTL_BAM | INTEL_RCTL_BSIZE_2048 | INTEL_RCTL_SECRC );
 	writel ( rctl, intel->regs + INTEL_RCTL );
 
+	/* Enable receive checksum offload, if applicable */
+	if ( netdev->offloads & NETDEV_OFFLOAD_RX_CSUM ) {
+		writel ( ( INTEL_RXCSUM_IPOFL | INTEL_RXCSUM_TUOFL ),
+			 intel->regs + INTEL_RXCSUM );
+	}
+
 	/* Fill receive ring */
 	intel_refill_rx ( intel );
 
@@ -669,6 +675,7 @@ int intel_transmit ( struct net_device *netdev, struct io_buffer *iobuf ) {
 	unsigned int tx_idx;
 	unsigned int tx_tail;
 	physaddr_t address;
+	size_t css;
 	size_t len;
 
 	/* Get next transmit descriptor */
@@ -684,6 +691,14 @@ int intel_transmit ( struct net_device *netdev, struct io_buffer *iobuf ) {
 	address = virt_to_bus ( iobuf->data );
 	len = iob_len ( iobuf );
 	intel->tx.describe ( tx, address, len );
+
+	/* Request checksum insertion, if applicable */
+	if ( iobuf->csum_flags & IOB_CSUM_PARTIAL ) {
+		css = ( iobuf->csum_start - iobuf->data );
+		tx->flags = ( css + iobuf->csum_offset );
+		tx->command |= INTEL_DESC_CMD_IC;
+		tx->status |= cpu_to_le32 ( INTEL_DESC_STATUS_CSS ( css ) );
+	}
 	wmb();
 
 	/* Notify card that there are packets ready to transmit */
@@ -728,6 +743,24 @@ void intel_poll_tx ( struct net_device *netdev ) {
 	}
 }
 
+/**
+ * Check whether received packet checksum was verified by hardware
+ *
+ * @v netdev		Network device
+ * @v rx		Receive descriptor
+ * @ret ok		Transport-layer checksum was verified
+ */
+static int intel_rx_csum_ok ( struct net_device *netdev,
+			      struct intel_descriptor *rx ) {
+	uint32_t status = le32_to_cpu ( rx->status );
+
+	return ( ( netdev->offloads & NETDEV_OFFLOAD_RX_CSUM ) &&
+		 ( status & ( INTEL_DESC_STATUS_TCPCS |
+			      INTEL_DESC_STATUS_UDPCS ) ) &&
+		 ( ! ( status & ( INTEL_DESC_STATUS_IXSM |
+				  INTEL_DESC_STATUS_TCPE ) ) ) );
+}
+
 /**
  * Poll for received packets
  *
@@ -766,6 +799,8 @@ void intel_poll_rx ( struct net_device *netdev ) {
 		} else {
 			DBGC2 ( intel, "INTEL %p RX %d complete (length %zd)\n",
 				intel, rx_idx, len );
+			if ( intel_rx_csum_ok ( netdev, rx ) )
+				iobuf->csum_flags |= IOB_CSUM_VALID;
 			netdev_rx ( netdev, iobuf );
 		}
 		intel->rx.cons++;
@@ -880,6 +915,10 @@ static int intel_probe ( struct pci_device *pci ) {
 			  intel_describe_tx );
 	intel_init_ring ( &intel->rx, INTEL_NUM_RX_DESC, INTEL_RD,
 			  intel_describe_rx );
+	if ( ! ( intel->flags & INTEL_NO_CSUM ) ) {
+		netdev->offloads = ( NETDEV_OFFLOAD_RX_CSUM |
+				     NETDEV_OFFLOAD_TX_CSUM );
+	}
 
 	/* Fix up PCI device */
 	adjust_pci_device ( pci );
@@ -948,7 +987,7 @@ static struct pci_device_id intel_nics[] = {
 	PCI_ROM ( 0x8086, 0x043a, "dh8900cc-f", "DH8900CC Fiber", 0 ),
 	PCI_ROM ( 0x8086, 0x043c, "dh8900cc-b", "DH8900CC Backplane", 0 ),
 	PCI_ROM ( 0x8086, 0x0440, "dh8900cc-s", "DH8900CC SFP", 0 ),
-	PCI_ROM ( 0x8086, 0x1000, "82542-f", "82542 (Fiber)", 0 ),
+	PCI_ROM ( 0x8086, 0x1000, "82542-f", "82542 (Fiber)", INTEL_NO_CSUM ),
 	PCI_ROM ( 0x8086, 0x1001, "82543gc-f", "82543GC (Fiber)", 0 ),
 	PCI_ROM ( 0x8086, 0x1004, "82543gc", "82543GC (Copper)", 0 ),
 	PCI_ROM ( 0x8086, 0x1008, "82544ei", "82544EI (Copper)", 0 ),
@@ -40,6 +40,9 @@ struct intel_descriptor {
 /** Report status */
 #define INTEL_DESC_CMD_RS 0x08
 
+/** Insert TCP/UDP checksum */
+#define INTEL_DESC_CMD_IC 0x04
+
 /** Insert frame checksum (CRC) */
 #define INTEL_DESC_CMD_IFCS 0x02
 
@@ -49,9 +52,24 @@ struct intel_descriptor {
 /** Descriptor done */
 #define INTEL_DESC_STATUS_DD 0x00000001UL
 
+/** Ignore checksum indication */
+#define INTEL_DESC_STATUS_IXSM 0x00000004UL
+
+/** UDP checksum calculated */
+#define INTEL_DESC_STATUS_UDPCS 0x00000010UL
+
+/** TCP checksum calculated */
+#define INTEL_DESC_STATUS_TCPCS 0x00000020UL
+
 /** Receive error */
 #define INTEL_DESC_STATUS_RXE 0x00000100UL
 
+/** TCP/UDP checksum error */
+#define INTEL_DESC_STATUS_TCPE 0x00002000UL
+
+/** Checksum start (legacy transmit descriptor) */
+#define INTEL_DESC_STATUS_CSS( css ) ( (css) << 8 )
+
 /** Payload length */
 #define INTEL_DESC_STATUS_PAYLEN( len ) ( (len) << 14 )
 
@@ -185,6 +203,11 @@ struct intel_descriptor {
 #define INTEL_xDCTL 0x28
 #define INTEL_xDCTL_ENABLE	0x02000000UL	/**< Queue enable */
 
+/** Receive Checksum Control Register */
+#define INTEL_RXCSUM 0x05000UL
+#define INTEL_RXCSUM_IPOFL	0x00000100UL	/**< IP checksum offload */
+#define INTEL_RXCSUM_TUOFL	0x00000200UL	/**< TCP/UDP checksum offload */
+
 /** Receive Address Low */
 #define INTEL_RAL0 0x05400UL
 
@@ -303,6 +326,8 @@ enum intel_flags {
 	INTEL_VMWARE = 0x0002,
 	/** PHY reset is broken */
 	INTEL_NO_PHY_RST = 0x0004,
+	/** Checksum offload is not supported */
+	INTEL_NO_CSUM = 0x0008,
 };
 
 /**
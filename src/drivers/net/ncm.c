@@ -25,6 +25,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <string.h>
 #include <errno.h>
+#include <assert.h>
 #include <ipxe/netdevice.h>
 #include <ipxe/ethernet.h>
 #include <ipxe/if_ether.h>
@@ -184,6 +185,8 @@ static int ncm_in_prefill ( struct ncm_device *ncm ) {
 		count = ( NCM_IN_MIN_SIZE / mtu );
 		if ( count < NCM_IN_MIN_COUNT )
 			count = NCM_IN_MIN_COUNT;
+		if ( count > NCM_IN_MAX_COUNT )
+			count = NCM_IN_MAX_COUNT;
 		if ( ( count * mtu ) > NCM_IN_MAX_SIZE )
 			continue;
 		usb_refill_init ( &ncm->usbnet.in, 0, mtu, count );
@@ -223,7 +226,6 @@ static void ncm_in_complete ( struct usb_endpoint *ep, struct io_buffer *iobuf,
 	size_t ndp_len;
 	size_t pkt_offset;
 	size_t pkt_len;
-	size_t headroom;
 	size_t len;
 
 	/* Profile overall bulk IN completion */
@@ -300,21 +302,13 @@ static void ncm_in_complete ( struct usb_endpoint *ep, struct io_buffer *iobuf,
 		 * while the device is running.  We therefore copy the
 		 * data to a new I/O buffer even if this is the only
 		 * (or last) packet within the buffer.
-		 *
-		 * We reserve enough space at the start of each buffer
-		 * to allow for our own transmission header, to
-		 * support protocols such as ARP which may modify the
-		 * received packet and reuse the same I/O buffer for
-		 * transmission.
 		 */
-		headroom = ( sizeof ( struct ncm_ntb_header ) + ncm->padding );
-		pkt = alloc_iob ( headroom + pkt_len );
+		pkt = alloc_iob ( pkt_len );
 		if ( ! pkt ) {
 			/* Record error and continue */
 			netdev_rx_err ( netdev, NULL, -ENOMEM );
 			continue;
 		}
-		iob_reserve ( pkt, headroom );
 		memcpy ( iob_put ( pkt, pkt_len ),
 			 ( iobuf->data + pkt_offset ), pkt_len );
 
@@ -346,49 +340,172 @@ static struct usb_endpoint_driver_operations ncm_in_operations = {
 	.complete = ncm_in_complete,
 };
 
+/**
+ * Calculate padding required before next transmitted datagram
+ *
+ * @v ncm		CDC-NCM device
+ * @v offset		Offset within NTB
+ * @ret pad		Length of padding
+ */
+static inline size_t ncm_out_pad ( struct ncm_device *ncm, size_t offset ) {
+
+	return ( ( ncm->remainder - offset ) & ( ncm->divisor - 1 ) );
+}
+
+/**
+ * Discard NTB under construction
+ *
+ * @v ncm		CDC-NCM device
+ * @v rc		Completion status code
+ */
+static void ncm_out_discard ( struct ncm_device *ncm, int rc ) {
+	unsigned int i;
+
+	/* Complete all packets copied into the NTB */
+	for ( i = 0 ; i < ncm->count ; i++ )
+		netdev_tx_complete_err ( ncm->netdev, ncm->pending[i], rc );
+	ncm->count = 0;
+
+	/* Free NTB */
+	free_iob ( ncm->ntb );
+	ncm->ntb = NULL;
+}
+
+/**
+ * Transmit NTB under construction
+ *
+ * @v ncm		CDC-NCM device
+ * @ret rc		Return status code
+ *
+ * The packets within the NTB are reported as transmitted only when
+ * the NTB itself completes.
+ */
+static int ncm_out_flush ( struct ncm_device *ncm ) {
+	struct io_buffer *ntb = ncm->ntb;
+	struct ncm_transfer_header *nth;
+	struct ncm_datagram_pointer *ndp;
+	size_t ndp_offset;
+	size_t ndp_len;
+	size_t pad;
+	int terminate;
+	int rc;
+
+	/* Do nothing unless an NTB is under construction */
+	if ( ! ntb )
+		return 0;
+
+	/* Leave NTB under construction if the OUT ring is full */
+	if ( ( ncm->prod - ncm->cons ) >= NCM_OUT_MAX_FILL )
+		return -ENOBUFS;
+
+	/* Append datagram pointer */
+	pad = ( ( -iob_len ( ntb ) ) & ( ncm->align - 1 ) );
+	memset ( iob_put ( ntb, pad ), 0, pad );
+	ndp_offset = iob_len ( ntb );
+	ndp_len = ( sizeof ( *ndp ) +
+		    ( ( ncm->count + 1 /* terminator */ ) *
+		      sizeof ( ndp->desc[0] ) ) );
+	ndp = iob_put ( ntb, ndp_len );
+	ndp->magic = cpu_to_le32 ( NCM_DATAGRAM_POINTER_MAGIC );
+	ndp->header_len = cpu_to_le16 ( ndp_len );
+	ndp->offset = cpu_to_le16 ( 0 );
+	memcpy ( ndp->desc, ncm->desc,
+		 ( ncm->count * sizeof ( ndp->desc[0] ) ) );
+	memset ( &ndp->desc[ncm->count], 0, sizeof ( ndp->desc[0] ) );
+
+	/* Populate transfer header */
+	nth = ntb->data;
+	nth->magic = cpu_to_le32 ( NCM_TRANSFER_HEADER_MAGIC );
+	nth->header_len = cpu_to_le16 ( sizeof ( *nth ) );
+	nth->sequence = cpu_to_le16 ( ncm->sequence );
+	nth->len = cpu_to_le16 ( iob_len ( ntb ) );
+	nth->offset = cpu_to_le16 ( ndp_offset );
+
+	/* Enqueue I/O buffer.  The device recognises the end of an
+	 * NTB shorter than its maximum NTB size only by a short
+	 * packet, so a zero-length packet must follow any such NTB
+	 * that is an exact multiple of the endpoint packet size.
+	 */
+	terminate = ( iob_len ( ntb ) < ncm->out_limit );
+	if ( ( rc = usb_stream ( &ncm->usbnet.out, ntb, terminate ) ) != 0 ) {
+		ncm_out_discard ( ncm, rc );
+		return rc;
+	}
+	ncm->ntb = NULL;
+
+	/* Record number of packets awaiting completion */
+	ncm->fill[ ncm->prod++ % NCM_OUT_MAX_FILL ] = ncm->count;
+	ncm->count = 0;
+
+	/* Increment sequence number */
+	ncm->sequence++;
+
+	return 0;
+}
+
 /**
  * Transmit packet
  *
  * @v ncm		CDC-NCM device
  * @v iobuf		I/O buffer
  * @ret rc		Return status code
+ *
+ * Packets are copied into an NTB under construction, which is
+ * transmitted when full or when the device is next polled.  This
+ * allows several packets to be aggregated into a single USB
+ * transfer.  Packets remain on the network device's transmit queue
+ * until the NTB containing them has completed.
  */
 static int ncm_out_transmit ( struct ncm_device *ncm,
 			      struct io_buffer *iobuf ) {
-	struct ncm_ntb_header *header;
+	struct ncm_datagram_descriptor *desc;
+	struct io_buffer *ntb;
 	size_t len = iob_len ( iobuf );
-	size_t header_len = ( sizeof ( *header ) + ncm->padding );
+	size_t offset;
+	size_t pad;
 	int rc;
 
 	/* Profile transmissions */
 	profile_start ( &ncm_out_profiler );
 
-	/* Prepend header */
-	if ( ( rc = iob_ensure_headroom ( iobuf, header_len ) ) != 0 )
-		return rc;
-	header = iob_push ( iobuf, header_len );
-
-	/* Populate header */
-	header->nth.magic = cpu_to_le32 ( NCM_TRANSFER_HEADER_MAGIC );
-	header->nth.header_len = cpu_to_le16 ( sizeof ( header->nth ) );
-	header->nth.sequence = cpu_to_le16 ( ncm->sequence );
-	header->nth.len = cpu_to_le16 ( iob_len ( iobuf ) );
-	header->nth.offset =
-		cpu_to_le16 ( offsetof ( typeof ( *header ), ndp ) );
-	header->ndp.magic = cpu_to_le32 ( NCM_DATAGRAM_POINTER_MAGIC );
-	header->ndp.header_len = cpu_to_le16 ( sizeof ( header->ndp ) +
-					       sizeof ( header->desc ) );
-	header->ndp.offset = cpu_to_le16 ( 0 );
-	header->desc[0].offset = cpu_to_le16 ( header_len );
-	header->desc[0].len = cpu_to_le16 ( len );
-	memset ( &header->desc[1], 0, sizeof ( header->desc[1] ) );
-
-	/* Enqueue I/O buffer */
-	if ( ( rc = usb_stream ( &ncm->usbnet.out, iobuf, 0 ) ) != 0 )
-		return rc;
+	/* Transmit NTB under construction if packet would not fit */
+	if ( ( ntb = ncm->ntb ) ) {
+		offset = iob_len ( ntb );
+		pad = ncm_out_pad ( ncm, offset );
+		if ( ( ncm->count >= ncm->out_max ) ||
+		     ( ( offset + pad + len + ( ncm->align - 1 ) +
+			 NCM_OUT_MAX_NDP_LEN ) > ncm->out_mtu ) ) {
+			if ( ( rc = ncm_out_flush ( ncm ) ) != 0 )
+				return rc;
+		}
+	}
 
-	/* Increment sequence number */
-	ncm->sequence++;
+	/* Start new NTB, if applicable */
+	if ( ! ( ntb = ncm->ntb ) ) {
+		offset = sizeof ( struct ncm_transfer_header );
+		pad = ncm_out_pad ( ncm, offset );
+		if ( ( offset + pad + len + ( ncm->align - 1 ) +
+		       NCM_OUT_MAX_NDP_LEN ) > ncm->out_mtu ) {
+			DBGC ( ncm, "NCM %p cannot transmit %zd-byte packet\n",
+			       ncm, len );
+			return -ERANGE;
+		}
+		ntb = alloc_iob ( ncm->out_mtu );
+		if ( ! ntb )
+			return -ENOMEM;
+		iob_put ( ntb, offset );
+		ncm->ntb = ntb;
+		ncm->count = 0;
+	}
+
+	/* Append packet */
+	pad = ncm_out_pad ( ncm, iob_len ( ntb ) );
+	memset ( iob_put ( ntb, pad ), 0, pad );
+	ncm->pending[ncm->count] = iobuf;
+	desc = &ncm->desc[ ncm->count++ ];
+	desc->offset = cpu_to_le16 ( iob_len ( ntb ) );
+	desc->len = cpu_to_le16 ( len );
+	memcpy ( iob_put ( ntb, len ), iobuf->data, len );
 
 	profile_stop ( &ncm_out_profiler );
 	return 0;
@@ -406,9 +523,27 @@ static void ncm_out_complete ( struct usb_endpoint *ep, struct io_buffer *iobuf,
 	struct ncm_device *ncm = container_of ( ep, struct ncm_device,
 						usbnet.out );
 	struct net_device *netdev = ncm->netdev;
+	unsigned int count;
 
-	/* Report TX completion */
-	netdev_tx_complete_err ( netdev, iobuf, rc );
+	/* Report USB errors, ignoring transfers cancelled when the
+	 * endpoint closes.
+	 */
+	if ( ( rc != 0 ) && ep->open ) {
+		DBGC ( ncm, "NCM %p bulk OUT failed: %s\n",
+		       ncm, strerror ( rc ) );
+	}
+
+	/* Complete packets contained within the NTB.  NTBs complete
+	 * in the order in which they were enqueued, and so the
+	 * contained packets are the oldest on the transmit queue.
+	 */
+	assert ( ncm->prod != ncm->cons );
+	count = ncm->fill[ ncm->cons++ % NCM_OUT_MAX_FILL ];
+	while ( count-- )
+		netdev_tx_complete_next_err ( netdev, rc );
+
+	/* Free NTB */
+	free_iob ( iobuf );
 }
 
 /** Bulk OUT endpoint operations */
@@ -435,8 +570,12 @@ static int ncm_open ( struct net_device *netdev ) {
 	struct ncm_set_ntb_input_size size;
 	int rc;
 
-	/* Reset sequence number */
+	/* Reset sequence number and transmit state */
 	ncm->sequence = 0;
+	ncm->ntb = NULL;
+	ncm->count = 0;
+	ncm->prod = 0;
+	ncm->cons = 0;
 
 	/* Prefill I/O buffers */
 	if ( ( rc = ncm_in_prefill ( ncm ) ) != 0 )
@@ -489,6 +628,9 @@ static void ncm_close ( struct net_device *netdev ) {
 
 	/* Close USB network device */
 	usbnet_close ( &ncm->usbnet );
+
+	/* Discard any NTB under construction */
+	ncm_out_discard ( ncm, -ECANCELED );
 }
 
 /**
@@ -519,6 +661,12 @@ static void ncm_poll ( struct net_device *netdev ) {
 	struct ncm_device *ncm = netdev->priv;
 	int rc;
 
+	/* Transmit any NTB under construction, leaving it in place
+	 * if the OUT ring is full.
+	 */
+	if ( ( ( rc = ncm_out_flush ( ncm ) ) != 0 ) && ( rc != -ENOBUFS ) )
+		netdev_tx_err ( netdev, NULL, rc );
+
 	/* Poll USB bus */
 	usb_poll ( ncm->bus );
 
@@ -615,15 +763,24 @@ static int ncm_probe ( struct usb_function *func,
 	ncm->mtu = le32_to_cpu ( params.in.mtu );
 	DBGC2 ( ncm, "NCM %p maximum IN size is %zd bytes\n", ncm, ncm->mtu );
 
-	/* Calculate transmit padding */
-	ncm->padding = ( ( le16_to_cpu ( params.out.remainder ) -
-			   sizeof ( struct ncm_ntb_header ) - ETH_HLEN ) &
-			 ( le16_to_cpu ( params.out.divisor ) - 1 ) );
-	DBGC2 ( ncm, "NCM %p using %zd-byte transmit padding\n",
-		ncm, ncm->padding );
-	assert ( ( ( sizeof ( struct ncm_ntb_header ) + ncm->padding +
-		     ETH_HLEN ) % le16_to_cpu ( params.out.divisor ) ) ==
-		 le16_to_cpu ( params.out.remainder ) );
+	/* Get transmit parameters */
+	ncm->out_limit = le32_to_cpu ( params.out.mtu );
+	ncm->out_mtu = ncm->out_limit;
+	if ( ncm->out_mtu > NCM_OUT_MAX_SIZE )
+		ncm->out_mtu = NCM_OUT_MAX_SIZE;
+	ncm->out_max = le16_to_cpu ( params.max );
+	if ( ( ncm->out_max == 0 ) || ( ncm->out_max > NCM_OUT_MAX_COUNT ) )
+		ncm->out_max = NCM_OUT_MAX_COUNT;
+	ncm->divisor = le16_to_cpu ( params.out.divisor );
+	if ( ! ncm->divisor )
+		ncm->divisor = 1;
+	ncm->remainder = le16_to_cpu ( params.out.remainder );
+	ncm->align = le16_to_cpu ( params.out.modulus );
+	if ( ncm->align < sizeof ( uint32_t ) )
+		ncm->align = sizeof ( uint32_t );
+	DBGC2 ( ncm, "NCM %p using up to %ux datagrams in %zu-byte OUT NTBs "
+		"(offset%%%zu=%zu, NDP align %zu)\n", ncm, ncm->out_max,
+		ncm->out_mtu, ncm->divisor, ncm->remainder, ncm->align );
 
 	/* Register network device */
 	if ( ( rc = register_netdev ( netdev ) ) != 0 )
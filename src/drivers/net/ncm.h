@@ -119,18 +119,30 @@ struct ncm_datagram_pointer {
 /** CDC-NCM datagram pointer CRC present flag */
 #define NCM_DATAGRAM_POINTER_MAGIC_CRC 0x01000000UL
 
-/** NTB constructed for transmitted packets (excluding padding)
+/** Maximum number of datagrams per transmitted NTB
  *
  * This is a policy decision.
  */
-struct ncm_ntb_header {
-	/** Transfer header */
-	struct ncm_transfer_header nth;
-	/** Datagram pointer */
-	struct ncm_datagram_pointer ndp;
-	/** Datagram descriptors */
-	struct ncm_datagram_descriptor desc[2];
-} __attribute__ (( packed ));
+#define NCM_OUT_MAX_COUNT 16
+
+/** Maximum size of transmitted NTB
+ *
+ * This is a policy decision.
+ */
+#define NCM_OUT_MAX_SIZE 16384
+
+/** Maximum number of transmitted NTBs in flight
+ *
+ * This is a policy decision, constrained by the smallest transfer
+ * ring supported by any USB host controller driver.
+ */
+#define NCM_OUT_MAX_FILL 8
+
+/** Maximum length of datagram pointer for transmitted NTBs */
+#define NCM_OUT_MAX_NDP_LEN						\
+	( sizeof ( struct ncm_datagram_pointer ) +			\
+	  ( ( NCM_OUT_MAX_COUNT + 1 /* terminator */ ) *		\
+	    sizeof ( struct ncm_datagram_descriptor ) ) )
 
 /** A CDC-NCM network device */
 struct ncm_device {
@@ -147,27 +159,59 @@ struct ncm_device {
 	size_t mtu;
 	/** Transmitted packet sequence number */
 	uint16_t sequence;
-	/** Alignment padding required on transmitted packets */
-	size_t padding;
+
+	/** Maximum transmitted NTB size */
+	size_t out_mtu;
+	/** Maximum transmitted NTB size supported by device */
+	size_t out_limit;
+	/** Maximum number of datagrams per transmitted NTB */
+	unsigned int out_max;
+	/** Transmitted datagram alignment divisor */
+	size_t divisor;
+	/** Transmitted datagram alignment remainder */
+	size_t remainder;
+	/** Transmitted datagram pointer alignment */
+	size_t align;
+	/** Transmitted NTB under construction, if any */
+	struct io_buffer *ntb;
+	/** Number of datagrams in transmitted NTB under construction */
+	unsigned int count;
+	/** Datagram descriptors for transmitted NTB under construction */
+	struct ncm_datagram_descriptor desc[NCM_OUT_MAX_COUNT];
+	/** Packets copied into transmitted NTB under construction */
+	struct io_buffer *pending[NCM_OUT_MAX_COUNT];
+	/** Number of datagrams in each transmitted NTB in flight */
+	unsigned int fill[NCM_OUT_MAX_FILL];
+	/** Transmitted NTB in flight producer counter */
+	unsigned int prod;
+	/** Transmitted NTB in flight consumer counter */
+	unsigned int cons;
 };
 
 /** Bulk IN ring minimum buffer count
  *
  * This is a policy decision.
  */
-#define NCM_IN_MIN_COUNT 3
+#define NCM_IN_MIN_COUNT 4
+
+/** Bulk IN ring maximum buffer count
+ *
+ * This is a policy decision, constrained by the smallest transfer
+ * ring supported by any USB host controller driver.
+ */
+#define NCM_IN_MAX_COUNT 16
 
 /** Bulk IN ring minimum total buffer size
  *
  * This is a policy decision.
  */
-#define NCM_IN_MIN_SIZE 16384
+#define NCM_IN_MIN_SIZE 65536
 
 /** Bulk IN ring maximum total buffer size
  *
  * This is a policy decision.
  */
-#define NCM_IN_MAX_SIZE 131072
+#define NCM_IN_MAX_SIZE 262144
 
 /** Interrupt ring buffer count
  *
@@ -24,12 +24,15 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
+#include <byteswap.h>
 #include <ipxe/list.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/netdevice.h>
 #include <ipxe/pci.h>
 #include <ipxe/if_ether.h>
 #include <ipxe/ethernet.h>
+#include <ipxe/tcpip.h>
 #include <ipxe/virtio-ring.h>
 #include <ipxe/virtio-pci.h>
 #include "virtio-net.h"
@@ -43,6 +46,8 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  * The virtio network device is supported by Linux virtualization software
  * including QEMU/KVM and lguest.  This driver supports the virtio over PCI
  * transport; virtual machines have one virtio-net PCI adapter per NIC.
+ * Both the legacy (I/O port) transport and the virtio 1.0 (capability
+ * based) transport are supported.
  *
  * Virtio-net is different from hardware NICs because virtio devices
  * communicate with the hypervisor via virtqueues, not traditional descriptor
@@ -84,46 +89,68 @@ enum {
 	RX_BUF_SIZE = 1522,
 };
 
+/** Features that we may negotiate */
+#define VIRTNET_FEATURES ( ( 1ULL << VIRTIO_NET_F_MAC ) |		\
+			   ( 1ULL << VIRTIO_NET_F_CSUM ) |		\
+			   ( 1ULL << VIRTIO_NET_F_GUEST_CSUM ) |	\
+			   ( 1ULL << VIRTIO_NET_F_MRG_RXBUF ) |		\
+			   ( 1ULL << VIRTIO_RING_F_EVENT_IDX ) )
+
 struct virtnet_nic {
 	/** Base pio register address */
 	unsigned long ioaddr;
 
+	/** 0 for legacy, 1 for virtio 1.0 */
+	int virtio_version;
+
+	/** Virtio 1.0 device data */
+	struct virtio_pci_modern_device vdev;
+
 	/** RX/TX virtqueues */
 	struct vring_virtqueue *virtqueue;
 
+	/** Negotiated features */
+	uint64_t features;
+
+	/** Length of virtio net packet header */
+	size_t header_len;
+
 	/** RX packets handed to the NIC waiting to be filled in */
 	struct list_head rx_iobufs;
 
 	/** Pending rx packet count */
 	unsigned int rx_num_iobufs;
 
-	/** Virtio net packet header, we only need one */
-	struct virtio_net_hdr empty_header;
+	/** Number of rx buffers remaining in a discarded packet */
+	unsigned int rx_discard;
+
+	/** Virtio net transmit packet headers, indexed by descriptor */
+	struct virtio_net_hdr_modern *tx_header;
 };
 
 /** Add an iobuf to a virtqueue
  *
  * @v netdev		Network device
  * @v vq_idx		Virtqueue index (RX_INDEX or TX_INDEX)
+ * @v header		Virtio net packet header
  * @v iobuf		I/O buffer
+ * @v num_added		Number of buffers already added since last kick
  *
- * The virtqueue is kicked after the iobuf has been added.
+ * The virtqueue is not kicked; the caller must call virtnet_kick()
+ * after adding all outstanding buffers.
  */
-static void virtnet_enqueue_iob ( struct net_device *netdev,
-				  int vq_idx, struct io_buffer *iobuf ) {
+static void virtnet_enqueue_iob ( struct net_device *netdev, int vq_idx,
+				  void *header, struct io_buffer *iobuf,
+				  unsigned int num_added ) {
 	struct virtnet_nic *virtnet = netdev->priv;
 	struct vring_virtqueue *vq = &virtnet->virtqueue[vq_idx];
-	unsigned int out = ( vq_idx == TX_INDEX ) ? 2 : 0;
-	unsigned int in = ( vq_idx == TX_INDEX ) ? 0 : 2;
+	unsigned int count = 2;
+	unsigned int out;
+	unsigned int in;
 	struct vring_list list[] = {
 		{
-			/* Share a single zeroed virtio net header between all
-			 * rx and tx packets.  This works because this driver
-			 * does not use any advanced features so none of the
-			 * header fields get used.
-			 */
-			.addr = ( char* ) &virtnet->empty_header,
-			.length = sizeof ( virtnet->empty_header ),
+			.addr = ( char* ) header,
+			.length = virtnet->header_len,
 		},
 		{
 			.addr = ( char* ) iobuf->data,
@@ -131,11 +158,37 @@ static void virtnet_enqueue_iob ( struct net_device *netdev,
 		},
 	};
 
+	/* Mergeable receive buffers hold the packet header immediately
+	 * before the packet data, and so may be described using a
+	 * single descriptor.
+	 */
+	if ( ( vq_idx == RX_INDEX ) &&
+	     ( virtnet->features & ( 1ULL << VIRTIO_NET_F_MRG_RXBUF ) ) ) {
+		list[0].length += iob_len ( iobuf );
+		count = 1;
+	}
+	out = ( ( vq_idx == TX_INDEX ) ? count : 0 );
+	in = ( ( vq_idx == TX_INDEX ) ? 0 : count );
+
 	DBGC2 ( virtnet, "VIRTIO-NET %p enqueuing iobuf %p on vq %d\n",
 		virtnet, iobuf, vq_idx );
 
-	vring_add_buf ( vq, list, out, in, iobuf, 0 );
-	vring_kick ( virtnet->ioaddr, vq, 1 );
+	vring_add_buf ( vq, list, out, in, iobuf, num_added );
+}
+
+/** Notify device of newly added buffers
+ *
+ * @v netdev		Network device
+ * @v vq_idx		Virtqueue index (RX_INDEX or TX_INDEX)
+ * @v num_added		Number of buffers added
+ */
+static void virtnet_kick ( struct net_device *netdev, int vq_idx,
+			   unsigned int num_added ) {
+	struct virtnet_nic *virtnet = netdev->priv;
+	struct vring_virtqueue *vq = &virtnet->virtqueue[vq_idx];
+
+	vring_kick ( ( virtnet->virtio_version ? &virtnet->vdev : NULL ),
+		     virtnet->ioaddr, vq, num_added );
 }
 
 /** Try to keep rx virtqueue filled with iobufs
@@ -144,70 +197,239 @@ static void virtnet_enqueue_iob ( struct net_device *netdev,
  */
 static void virtnet_refill_rx_virtqueue ( struct net_device *netdev ) {
 	struct virtnet_nic *virtnet = netdev->priv;
+	unsigned int num_added = 0;
 
 	while ( virtnet->rx_num_iobufs < NUM_RX_BUF ) {
 		struct io_buffer *iobuf;
+		void *header;
 
 		/* Try to allocate a buffer, stop for now if out of memory */
-		iobuf = alloc_iob ( RX_BUF_SIZE );
+		iobuf = alloc_iob ( virtnet->header_len + RX_BUF_SIZE );
 		if ( ! iobuf )
 			break;
 
 		/* Keep track of iobuf so close() can free it */
 		list_add ( &iobuf->list, &virtnet->rx_iobufs );
 
+		/* Reserve space for the packet header, which is received
+		 * into the start of the buffer.
+		 */
+		header = iobuf->data;
+		iob_reserve ( iobuf, virtnet->header_len );
+
 		/* Mark packet length until we know the actual size */
 		iob_put ( iobuf, RX_BUF_SIZE );
 
-		virtnet_enqueue_iob ( netdev, RX_INDEX, iobuf );
+		virtnet_enqueue_iob ( netdev, RX_INDEX, header, iobuf,
+				      num_added++ );
 		virtnet->rx_num_iobufs++;
 	}
+
+	/* Notify device of all new buffers at once */
+	if ( num_added )
+		virtnet_kick ( netdev, RX_INDEX, num_added );
 }
 
-/** Open network device
+/** Free virtqueues
+ *
+ * @v netdev		Network device
+ */
+static void virtnet_free_virtqueues ( struct net_device *netdev ) {
+	struct virtnet_nic *virtnet = netdev->priv;
+	int i;
+
+	for ( i = 0; i < QUEUE_NB; i++ )
+		vp_free_vq ( &virtnet->virtqueue[i] );
+	free ( virtnet->virtqueue );
+	virtnet->virtqueue = NULL;
+}
+
+/** Open network device, common parts
  *
  * @v netdev	Network device
  * @ret rc	Return status code
+ *
+ * The virtqueues must already have been allocated.
  */
-static int virtnet_open ( struct net_device *netdev ) {
+static int virtnet_open_common ( struct net_device *netdev ) {
+	struct virtnet_nic *virtnet = netdev->priv;
+	struct vring_virtqueue *tx_vq = &virtnet->virtqueue[TX_INDEX];
+	int i;
+
+	/* Use event index notification suppression, if negotiated */
+	for ( i = 0; i < QUEUE_NB; i++ ) {
+		virtnet->virtqueue[i].event =
+			( !! ( virtnet->features &
+			       ( 1ULL << VIRTIO_RING_F_EVENT_IDX ) ) );
+	}
+
+	/* The packet header includes the buffer count if mergeable
+	 * receive buffers are in use, or for any virtio 1.0 device.
+	 */
+	if ( virtnet->features & ( ( 1ULL << VIRTIO_NET_F_MRG_RXBUF ) |
+				   ( 1ULL << VIRTIO_F_VERSION_1 ) ) ) {
+		virtnet->header_len = sizeof ( struct virtio_net_hdr_modern );
+	} else {
+		virtnet->header_len = sizeof ( struct virtio_net_hdr );
+	}
+
+	/* Allocate transmit packet headers */
+	virtnet->tx_header = zalloc ( tx_vq->vring.num *
+				      sizeof ( virtnet->tx_header[0] ) );
+	if ( ! virtnet->tx_header )
+		return -ENOMEM;
+
+	/* Initialize rx packets */
+	INIT_LIST_HEAD ( &virtnet->rx_iobufs );
+	virtnet->rx_num_iobufs = 0;
+	virtnet->rx_discard = 0;
+	virtnet_refill_rx_virtqueue ( netdev );
+
+	/* Disable interrupts before starting */
+	netdev_irq ( netdev, 0 );
+
+	return 0;
+}
+
+/** Open network device, legacy virtio
+ *
+ * @v netdev	Network device
+ * @ret rc	Return status code
+ */
+static int virtnet_open_legacy ( struct net_device *netdev ) {
 	struct virtnet_nic *virtnet = netdev->priv;
 	unsigned long ioaddr = virtnet->ioaddr;
 	u32 features;
+	int rc;
 	int i;
 
 	/* Reset for sanity */
 	vp_reset ( ioaddr );
 
+	/* Negotiate features */
+	features = vp_get_features ( ioaddr );
+	features &= VIRTNET_FEATURES;
+	vp_set_features ( ioaddr, features );
+	virtnet->features = features;
+
 	/* Allocate virtqueues */
 	virtnet->virtqueue = zalloc ( QUEUE_NB *
 				      sizeof ( *virtnet->virtqueue ) );
-	if ( ! virtnet->virtqueue )
-		return -ENOMEM;
+	if ( ! virtnet->virtqueue ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
 
 	/* Initialize rx/tx virtqueues */
 	for ( i = 0; i < QUEUE_NB; i++ ) {
-		if ( vp_find_vq ( ioaddr, i, &virtnet->virtqueue[i] ) == -1 ) {
+		if ( vp_find_vq ( ioaddr, i, &virtnet->virtqueue[i] ) < 0 ) {
 			DBGC ( virtnet, "VIRTIO-NET %p cannot register queue %d\n",
 			       virtnet, i );
-			free ( virtnet->virtqueue );
-			virtnet->virtqueue = NULL;
-			return -ENOENT;
+			rc = -ENOENT;
+			goto err_find_vq;
 		}
 	}
 
-	/* Initialize rx packets */
-	INIT_LIST_HEAD ( &virtnet->rx_iobufs );
-	virtnet->rx_num_iobufs = 0;
-	virtnet_refill_rx_virtqueue ( netdev );
-
-	/* Disable interrupts before starting */
-	netdev_irq ( netdev, 0 );
+	/* Initialize common parts */
+	if ( ( rc = virtnet_open_common ( netdev ) ) != 0 )
+		goto err_open_common;
 
 	/* Driver is ready */
-	features = vp_get_features ( ioaddr );
-	vp_set_features ( ioaddr, features & ( 1 << VIRTIO_NET_F_MAC ) );
 	vp_set_status ( ioaddr, VIRTIO_CONFIG_S_DRIVER | VIRTIO_CONFIG_S_DRIVER_OK );
 	return 0;
+
+ err_open_common:
+ err_find_vq:
+	vp_reset ( ioaddr );
+	virtnet_free_virtqueues ( netdev );
+ err_alloc:
+	return rc;
+}
+
+/** Open network device, modern virtio
+ *
+ * @v netdev	Network device
+ * @ret rc	Return status code
+ */
+static int virtnet_open_modern ( struct net_device *netdev ) {
+	struct virtnet_nic *virtnet = netdev->priv;
+	struct virtio_pci_modern_device *vdev = &virtnet->vdev;
+	u64 features;
+	u8 status;
+	int rc;
+
+	/* Reset for sanity */
+	vpm_reset ( vdev );
+	vpm_add_status ( vdev, ( VIRTIO_CONFIG_S_ACKNOWLEDGE |
+				 VIRTIO_CONFIG_S_DRIVER ) );
+
+	/* Negotiate features */
+	features = vpm_get_features ( vdev );
+	if ( ! ( features & ( 1ULL << VIRTIO_F_VERSION_1 ) ) ) {
+		DBGC ( virtnet, "VIRTIO-NET %p is not a virtio 1.0 device\n",
+		       virtnet );
+		rc = -EINVAL;
+		goto err_version;
+	}
+	features &= ( VIRTNET_FEATURES | ( 1ULL << VIRTIO_F_VERSION_1 ) );
+	vpm_set_features ( vdev, features );
+	vpm_add_status ( vdev, VIRTIO_CONFIG_S_FEATURES_OK );
+	status = vpm_get_status ( vdev );
+	if ( ! ( status & VIRTIO_CONFIG_S_FEATURES_OK ) ) {
+		DBGC ( virtnet, "VIRTIO-NET %p device didn't accept features\n",
+		       virtnet );
+		rc = -EINVAL;
+		goto err_features;
+	}
+	virtnet->features = features;
+
+	/* Allocate virtqueues */
+	virtnet->virtqueue = zalloc ( QUEUE_NB *
+				      sizeof ( *virtnet->virtqueue ) );
+	if ( ! virtnet->virtqueue ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+
+	/* Initialize rx/tx virtqueues */
+	if ( ( rc = vpm_find_vqs ( vdev, QUEUE_NB,
+				   virtnet->virtqueue ) ) != 0 ) {
+		DBGC ( virtnet, "VIRTIO-NET %p cannot register queues\n",
+		       virtnet );
+		goto err_find_vqs;
+	}
+
+	/* Initialize common parts */
+	if ( ( rc = virtnet_open_common ( netdev ) ) != 0 )
+		goto err_open_common;
+
+	/* Driver is ready */
+	vpm_add_status ( vdev, VIRTIO_CONFIG_S_DRIVER_OK );
+	return 0;
+
+ err_open_common:
+ err_find_vqs:
+	virtnet_free_virtqueues ( netdev );
+ err_alloc:
+ err_features:
+ err_version:
+	vpm_reset ( vdev );
+	return rc;
+}
+
+/** Open network device
+ *
+ * @v netdev	Network device
+ * @ret rc	Return status code
+ */
+static int virtnet_open ( struct net_device *netdev ) {
+	struct virtnet_nic *virtnet = netdev->priv;
+
+	if ( virtnet->virtio_version ) {
+		return virtnet_open_modern ( netdev );
+	} else {
+		return virtnet_open_legacy ( netdev );
+	}
 }
 
 /** Close network device
@@ -219,11 +441,18 @@ static void virtnet_close ( struct net_device *netdev ) {
 	struct io_buffer *iobuf;
 	struct io_buffer *next_iobuf;
 
-	vp_reset ( virtnet->ioaddr );
+	if ( virtnet->virtio_version ) {
+		vpm_reset ( &virtnet->vdev );
+	} else {
+		vp_reset ( virtnet->ioaddr );
+	}
 
 	/* Virtqueues can be freed now that NIC is reset */
-	free ( virtnet->virtqueue );
-	virtnet->virtqueue = NULL;
+	virtnet_free_virtqueues ( netdev );
+
+	/* Free transmit packet headers */
+	free ( virtnet->tx_header );
+	virtnet->tx_header = NULL;
 
 	/* Free rx iobufs */
 	list_for_each_entry_safe ( iobuf, next_iobuf, &virtnet->rx_iobufs, list ) {
@@ -241,7 +470,26 @@ static void virtnet_close ( struct net_device *netdev ) {
  */
 static int virtnet_transmit ( struct net_device *netdev,
 			      struct io_buffer *iobuf ) {
-	virtnet_enqueue_iob ( netdev, TX_INDEX, iobuf );
+	struct virtnet_nic *virtnet = netdev->priv;
+	struct vring_virtqueue *tx_vq = &virtnet->virtqueue[TX_INDEX];
+	struct virtio_net_hdr_modern *header;
+
+	/* Use the header belonging to the first descriptor to be
+	 * used, since this is unique among all in-flight packets.
+	 */
+	header = &virtnet->tx_header[tx_vq->free_head];
+	memset ( header, 0, sizeof ( *header ) );
+
+	/* Request checksum completion, if applicable */
+	if ( iobuf->csum_flags & IOB_CSUM_PARTIAL ) {
+		header->legacy.flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+		header->legacy.csum_start =
+			cpu_to_le16 ( iobuf->csum_start - iobuf->data );
+		header->legacy.csum_offset = cpu_to_le16 ( iobuf->csum_offset );
+	}
+
+	virtnet_enqueue_iob ( netdev, TX_INDEX, header, iobuf, 0 );
+	virtnet_kick ( netdev, TX_INDEX, 1 );
 	return 0;
 }
 
@@ -263,6 +511,39 @@ static void virtnet_process_tx_packets ( struct net_device *netdev ) {
 	}
 }
 
+/** Complete partial checksum of received packet
+ *
+ * @v virtnet	Virtio-net device
+ * @v header	Virtio net packet header
+ * @v iobuf	I/O buffer
+ * @ret rc	Return status code
+ *
+ * The checksum field holds only the pseudo-header checksum, and the
+ * remainder must be calculated over the data from csum_start onwards.
+ */
+static int virtnet_rx_csum ( struct virtnet_nic *virtnet,
+			     struct virtio_net_hdr_modern *header,
+			     struct io_buffer *iobuf ) {
+	size_t start = le16_to_cpu ( header->legacy.csum_start );
+	size_t offset = le16_to_cpu ( header->legacy.csum_offset );
+	uint16_t *csum;
+
+	/* Sanity check */
+	if ( ( start + offset + sizeof ( *csum ) ) > iob_len ( iobuf ) ) {
+		DBGC ( virtnet, "VIRTIO-NET %p rx invalid partial checksum "
+		       "%#zx+%#zx (len %#zx)\n", virtnet, start, offset,
+		       iob_len ( iobuf ) );
+		return -EINVAL;
+	}
+
+	/* Complete checksum */
+	csum = ( iobuf->data + start + offset );
+	*csum = tcpip_chksum ( ( iobuf->data + start ),
+			       ( iob_len ( iobuf ) - start ) );
+
+	return 0;
+}
+
 /** Complete packet reception
  *
  * @v netdev	Network device
@@ -272,20 +553,61 @@ static void virtnet_process_rx_packets ( struct net_device *netdev ) {
 	struct vring_virtqueue *rx_vq = &virtnet->virtqueue[RX_INDEX];
 
 	while ( vring_more_used ( rx_vq ) ) {
+		struct virtio_net_hdr_modern *header;
+		unsigned int num_buffers = 1;
 		unsigned int len;
 		struct io_buffer *iobuf = vring_get_buf ( rx_vq, &len );
+		int rc;
 
 		/* Release ownership of iobuf */
 		list_del ( &iobuf->list );
 		virtnet->rx_num_iobufs--;
 
+		/* Discard any continuation of an oversized packet */
+		if ( virtnet->rx_discard ) {
+			virtnet->rx_discard--;
+			netdev_rx_err ( netdev, iobuf, -ERANGE );
+			continue;
+		}
+
 		/* Update iobuf length */
 		iob_unput ( iobuf, RX_BUF_SIZE );
-		iob_put ( iobuf, len - sizeof ( struct virtio_net_hdr ) );
+		iob_put ( iobuf, len - virtnet->header_len );
 
 		DBGC2 ( virtnet, "VIRTIO-NET %p rx complete iobuf %p len %zd\n",
 			virtnet, iobuf, iob_len ( iobuf ) );
 
+		/* Discard packets spread across multiple buffers.  This
+		 * should never happen, since each buffer is large enough
+		 * to hold any packet that we allow the device to send.
+		 */
+		header = ( iobuf->data - virtnet->header_len );
+		if ( virtnet->features & ( 1ULL << VIRTIO_NET_F_MRG_RXBUF ) )
+			num_buffers = le16_to_cpu ( header->num_buffers );
+		if ( num_buffers > 1 ) {
+			DBGC ( virtnet, "VIRTIO-NET %p rx packet spans %d "
+			       "buffers\n", virtnet, num_buffers );
+			virtnet->rx_discard = ( num_buffers - 1 );
+			netdev_rx_err ( netdev, iobuf, -ERANGE );
+			continue;
+		}
+
+		/* Complete any partial checksum, leaving verification
+		 * to the network stack as for any other packet.  Only
+		 * a packet with a checksum validated by the device may
+		 * be marked as verified.
+		 */
+		if ( header->legacy.flags & VIRTIO_NET_HDR_F_NEEDS_CSUM ) {
+			if ( ( rc = virtnet_rx_csum ( virtnet, header,
+						      iobuf ) ) != 0 ) {
+				netdev_rx_err ( netdev, iobuf, rc );
+				continue;
+			}
+		} else if ( header->legacy.flags &
+			    VIRTIO_NET_HDR_F_DATA_VALID ) {
+			iobuf->csum_flags |= IOB_CSUM_VALID;
+		}
+
 		/* Pass completed packet to the network stack */
 		netdev_rx ( netdev, iobuf );
 	}
@@ -305,7 +627,11 @@ static void virtnet_poll ( struct net_device *netdev ) {
 	 * set (that flag is just a hint and the hypervisor not not have to
 	 * honor it).
 	 */
-	vp_get_isr ( virtnet->ioaddr );
+	if ( virtnet->virtio_version ) {
+		vpm_get_isr ( &virtnet->vdev );
+	} else {
+		vp_get_isr ( virtnet->ioaddr );
+	}
 
 	virtnet_process_tx_packets ( netdev );
 	virtnet_process_rx_packets ( netdev );
@@ -338,13 +664,26 @@ static struct net_device_operations virtnet_operations = {
 };
 
 /**
- * Probe PCI device
+ * Record offload capabilities
+ *
+ * @v netdev	Network device
+ * @v features	Device features
+ */
+static void virtnet_offloads ( struct net_device *netdev, u64 features ) {
+
+	if ( features & ( 1ULL << VIRTIO_NET_F_CSUM ) )
+		netdev->offloads |= NETDEV_OFFLOAD_TX_CSUM;
+	if ( features & ( 1ULL << VIRTIO_NET_F_GUEST_CSUM ) )
+		netdev->offloads |= NETDEV_OFFLOAD_RX_CSUM;
+}
+
+/**
+ * Probe PCI device, legacy virtio 0.9.5
  *
  * @v pci	PCI device
- * @v id	PCI ID
  * @ret rc	Return status code
  */
-static int virtnet_probe ( struct pci_device *pci ) {
+static int virtnet_probe_legacy ( struct pci_device *pci ) {
 	unsigned long ioaddr = pci->ioaddr;
 	struct net_device *netdev;
 	struct virtnet_nic *virtnet;
@@ -377,6 +716,9 @@ static int virtnet_probe ( struct pci_device *pci ) {
 		       eth_ntoa ( netdev->hw_addr ) );
 	}
 
+	/* Record checksum offload capabilities */
+	virtnet_offloads ( netdev, features );
+
 	/* Register network device */
 	if ( ( rc = register_netdev ( netdev ) ) != 0 )
 		goto err_register_netdev;
@@ -394,6 +736,143 @@ static int virtnet_probe ( struct pci_device *pci ) {
 	return rc;
 }
 
+/**
+ * Probe PCI device, modern virtio 1.0
+ *
+ * @v pci	PCI device
+ * @v found_dev	Set to non-zero if modern device was found (probe may still fail)
+ * @ret rc	Return status code
+ */
+static int virtnet_probe_modern ( struct pci_device *pci, int *found_dev ) {
+	struct net_device *netdev;
+	struct virtnet_nic *virtnet;
+	u64 features;
+	int rc, common, isr, notify, device;
+
+	common = virtio_pci_find_capability ( pci, VIRTIO_PCI_CAP_COMMON_CFG );
+	if ( ! common ) {
+		DBG ( "Common virtio capability not found!\n" );
+		return -ENODEV;
+	}
+	*found_dev = 1;
+
+	isr = virtio_pci_find_capability ( pci, VIRTIO_PCI_CAP_ISR_CFG );
+	notify = virtio_pci_find_capability ( pci, VIRTIO_PCI_CAP_NOTIFY_CFG );
+	if ( ! isr || ! notify ) {
+		DBG ( "Missing virtio capabilities %i/%i/%i\n",
+		      common, isr, notify );
+		return -EINVAL;
+	}
+	device = virtio_pci_find_capability ( pci, VIRTIO_PCI_CAP_DEVICE_CFG );
+
+	/* Allocate and hook up net device */
+	netdev = alloc_etherdev ( sizeof ( *virtnet ) );
+	if ( ! netdev )
+		return -ENOMEM;
+	netdev_init ( netdev, &virtnet_operations );
+	virtnet = netdev->priv;
+
+	pci_set_drvdata ( pci, netdev );
+	netdev->dev = &pci->dev;
+
+	DBGC ( virtnet, "VIRTIO-NET modern %p busaddr=%s irq=%d\n",
+	       virtnet, pci->dev.name, pci->irq );
+
+	virtnet->vdev.pci = pci;
+	rc = virtio_pci_map_capability ( pci, common,
+		sizeof ( struct virtio_pci_common_cfg ), 4,
+		0, sizeof ( struct virtio_pci_common_cfg ),
+		&virtnet->vdev.common );
+	if ( rc )
+		goto err_map_common;
+
+	rc = virtio_pci_map_capability ( pci, isr, sizeof ( u8 ), 1,
+		0, 1,
+		&virtnet->vdev.isr );
+	if ( rc )
+		goto err_map_isr;
+
+	virtnet->vdev.notify_cap_pos = notify;
+
+	/* Map the device capability */
+	if ( device ) {
+		rc = virtio_pci_map_capability ( pci, device,
+			0, 4, 0, sizeof ( struct virtio_net_config ),
+			&virtnet->vdev.device );
+		if ( rc )
+			goto err_map_device;
+	}
+
+	/* Enable the PCI device */
+	adjust_pci_device ( pci );
+
+	/* Reset the device and set initial status bits */
+	vpm_reset ( &virtnet->vdev );
+	vpm_add_status ( &virtnet->vdev, ( VIRTIO_CONFIG_S_ACKNOWLEDGE |
+					   VIRTIO_CONFIG_S_DRIVER ) );
+
+	/* Load MAC address */
+	features = vpm_get_features ( &virtnet->vdev );
+	if ( device && ( features & ( 1ULL << VIRTIO_NET_F_MAC ) ) ) {
+		vpm_get ( &virtnet->vdev,
+			  offsetof ( struct virtio_net_config, mac ),
+			  netdev->hw_addr, ETH_ALEN );
+		DBGC ( virtnet, "VIRTIO-NET %p mac=%s\n", virtnet,
+		       eth_ntoa ( netdev->hw_addr ) );
+	}
+
+	/* Record checksum offload capabilities */
+	virtnet_offloads ( netdev, features );
+
+	/* We need a valid MAC address */
+	if ( ! is_valid_ether_addr ( netdev->hw_addr ) ) {
+		rc = -EADDRNOTAVAIL;
+		goto err_mac_address;
+	}
+
+	/* Use modern transport (before the device can be opened) */
+	virtnet->virtio_version = 1;
+
+	/* Register network device */
+	if ( ( rc = register_netdev ( netdev ) ) != 0 )
+		goto err_register_netdev;
+
+	/* Mark link as up, control virtqueue is not used */
+	netdev_link_up ( netdev );
+
+	return 0;
+
+	unregister_netdev ( netdev );
+ err_register_netdev:
+ err_mac_address:
+	vpm_reset ( &virtnet->vdev );
+	virtio_pci_unmap_capability ( &virtnet->vdev.device );
+ err_map_device:
+	virtio_pci_unmap_capability ( &virtnet->vdev.isr );
+ err_map_isr:
+	virtio_pci_unmap_capability ( &virtnet->vdev.common );
+ err_map_common:
+	netdev_nullify ( netdev );
+	netdev_put ( netdev );
+	return rc;
+}
+
+/**
+ * Probe PCI device
+ *
+ * @v pci	PCI device
+ * @ret rc	Return status code
+ */
+static int virtnet_probe ( struct pci_device *pci ) {
+	int found_modern = 0;
+	int rc = virtnet_probe_modern ( pci, &found_modern );
+	if ( ! found_modern && pci->device < 0x1040 ) {
+		/* fall back to the legacy probe */
+		rc = virtnet_probe_legacy ( pci );
+	}
+	return rc;
+}
+
 /**
  * Remove device
  *
@@ -401,14 +880,19 @@ static int virtnet_probe ( struct pci_device *pci ) {
  */
 static void virtnet_remove ( struct pci_device *pci ) {
 	struct net_device *netdev = pci_get_drvdata ( pci );
+	struct virtnet_nic *virtnet = netdev->priv;
 
 	unregister_netdev ( netdev );
+	virtio_pci_unmap_capability ( &virtnet->vdev.device );
+	virtio_pci_unmap_capability ( &virtnet->vdev.isr );
+	virtio_pci_unmap_capability ( &virtnet->vdev.common );
 	netdev_nullify ( netdev );
 	netdev_put ( netdev );
 }
 
 static struct pci_device_id virtnet_nics[] = {
 PCI_ROM(0x1af4, 0x1000, "virtio-net", "Virtio Network Interface", 0),
+PCI_ROM(0x1af4, 0x1041, "virtio-net", "Virtio Network Interface 1.0", 0),
 };
 
 struct pci_driver virtnet_driver __pci_driver = {
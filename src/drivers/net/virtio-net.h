@@ -14,6 +14,7 @@
 #define VIRTIO_NET_F_HOST_TSO6  12      /* Host can handle TSOv6 in. */
 #define VIRTIO_NET_F_HOST_ECN   13      /* Host can handle TSO[6] w/ ECN in. */
 #define VIRTIO_NET_F_HOST_UFO   14      /* Host can handle UFO in. */
+#define VIRTIO_NET_F_MRG_RXBUF  15      /* Driver can merge receive buffers. */
 
 struct virtio_net_config
 {
@@ -27,6 +28,7 @@ struct virtio_net_config
 struct virtio_net_hdr
 {
 #define VIRTIO_NET_HDR_F_NEEDS_CSUM     1       // Use csum_start, csum_offset
+#define VIRTIO_NET_HDR_F_DATA_VALID     2       // Csum is valid
    uint8_t flags;
 #define VIRTIO_NET_HDR_GSO_NONE         0       // Not a GSO frame
 #define VIRTIO_NET_HDR_GSO_TCPV4        1       // GSO frame, IPv4 TCP (TSO)
@@ -41,4 +43,14 @@ struct virtio_net_hdr
    uint16_t csum_start;
    uint16_t csum_offset;
 };
+
+/* Virtio 1.0 or mergeable buffer version of the first element of the
+ * scatter-gather list. */
+struct virtio_net_hdr_modern
+{
+   struct virtio_net_hdr legacy;
+
+   /* Used only if VIRTIO_NET_F_MRG_RXBUF: */
+   uint16_t num_buffers;
+};
 #endif /* _VIRTIO_NET_H_ */
@@ -1392,6 +1392,43 @@ xhci_doorbell ( struct xhci_trb_ring *ring ) {
 	writel ( ring->dbval, ring->db );
 }
 
+/**
+ * Schedule doorbell for transfer ring
+ *
+ * @v endpoint		Endpoint
+ *
+ * The doorbell will be rung at the end of the current bus poll (if
+ * called while handling completions), or at the start of the next bus
+ * poll.  This allows several transfers enqueued in quick succession
+ * (e.g. when refilling a bulk IN endpoint) to be started by a single
+ * doorbell write.
+ */
+static void xhci_doorbell_defer ( struct xhci_endpoint *endpoint ) {
+	struct xhci_device *xhci = endpoint->xhci;
+
+	/* Add to list of pending doorbells, if not already present */
+	if ( list_empty ( &endpoint->doorbell ) )
+		list_add_tail ( &endpoint->doorbell, &xhci->doorbells );
+}
+
+/**
+ * Ring all pending doorbells
+ *
+ * @v xhci		xHCI device
+ */
+static void xhci_doorbell_flush ( struct xhci_device *xhci ) {
+	struct xhci_endpoint *endpoint;
+	struct xhci_endpoint *tmp;
+
+	/* Ring each pending doorbell */
+	list_for_each_entry_safe ( endpoint, tmp, &xhci->doorbells,
+				   doorbell ) {
+		list_del ( &endpoint->doorbell );
+		INIT_LIST_HEAD ( &endpoint->doorbell );
+		xhci_doorbell ( &endpoint->ring );
+	}
+}
+
 /******************************************************************************
  *
  * Command and event rings
@@ -2336,6 +2373,7 @@ static int xhci_endpoint_open ( struct usb_endpoint *ep ) {
 	unsigned int ctx;
 	unsigned int type;
 	unsigned int interval;
+	unsigned int shift;
 	int rc;
 
 	/* Calculate context index */
@@ -2372,10 +2410,13 @@ static int xhci_endpoint_open ( struct usb_endpoint *ep ) {
 	endpoint->interval = interval;
 	endpoint->context = ( ( ( void * ) slot->context ) +
 			      xhci_device_context_offset ( xhci, ctx ) );
+	INIT_LIST_HEAD ( &endpoint->doorbell );
 
 	/* Allocate transfer ring */
-	if ( ( rc = xhci_ring_alloc ( xhci, &endpoint->ring,
-				      XHCI_TRANSFER_TRBS_LOG2,
+	shift = ( ( ( ep->attributes & USB_ENDPOINT_ATTR_TYPE_MASK ) ==
+		    USB_ENDPOINT_ATTR_BULK ) ?
+		  XHCI_BULK_TRBS_LOG2 : XHCI_TRANSFER_TRBS_LOG2 );
+	if ( ( rc = xhci_ring_alloc ( xhci, &endpoint->ring, shift,
 				      slot->id, ctx, 0 ) ) != 0 )
 		goto err_ring_alloc;
 
@@ -2411,6 +2452,9 @@ static void xhci_endpoint_close ( struct usb_endpoint *ep ) {
 	struct io_buffer *iobuf;
 	unsigned int ctx = endpoint->ctx;
 
+	/* Cancel any pending doorbell */
+	list_del ( &endpoint->doorbell );
+
 	/* Deconfigure endpoint, if applicable */
 	if ( ctx != XHCI_CTX_EP0 )
 		xhci_deconfigure_endpoint ( xhci, slot, endpoint );
@@ -2544,15 +2588,20 @@ static int xhci_endpoint_message ( struct usb_endpoint *ep,
 /**
  * Calculate number of TRBs
  *
+ * @v phys		Physical address of data
  * @v len		Length of data
  * @v zlp		Append a zero-length packet
  * @ret count		Number of transfer descriptors
  */
-static unsigned int xhci_endpoint_count ( size_t len, int zlp ) {
-	unsigned int count;
+static unsigned int xhci_endpoint_count ( physaddr_t phys, size_t len,
+					  int zlp ) {
+	unsigned int count = 0;
 
-	/* Split into 64kB TRBs */
-	count = ( ( len + XHCI_MTU - 1 ) / XHCI_MTU );
+	/* Split into TRBs at each 64kB boundary */
+	if ( len ) {
+		count = ( ( ( phys + len - 1 ) / XHCI_TRB_BOUNDARY ) -
+			  ( phys / XHCI_TRB_BOUNDARY ) + 1 );
+	}
 
 	/* Append a zero-length TRB if applicable */
 	if ( zlp || ( count == 0 ) )
@@ -2572,9 +2621,9 @@ static unsigned int xhci_endpoint_count ( size_t len, int zlp ) {
 static int xhci_endpoint_stream ( struct usb_endpoint *ep,
 				  struct io_buffer *iobuf, int zlp ) {
 	struct xhci_endpoint *endpoint = usb_endpoint_get_hostdata ( ep );
-	void *data = iobuf->data;
+	physaddr_t phys = virt_to_phys ( iobuf->data );
 	size_t len = iob_len ( iobuf );
-	unsigned int count = xhci_endpoint_count ( len, zlp );
+	unsigned int count = xhci_endpoint_count ( phys, len, zlp );
 	union xhci_trb trbs[count];
 	union xhci_trb *trb = trbs;
 	struct xhci_trb_normal *normal;
@@ -2589,20 +2638,23 @@ static int xhci_endpoint_stream ( struct usb_endpoint *ep,
 	memset ( &trbs, 0, sizeof ( trbs ) );
 	for ( i = 0 ; i < count ; i ++ ) {
 
-		/* Calculate TRB length */
-		trb_len = XHCI_MTU;
+		/* Calculate TRB length, stopping at the next 64kB
+		 * boundary
+		 */
+		trb_len = ( XHCI_TRB_BOUNDARY -
+			    ( phys & ( XHCI_TRB_BOUNDARY - 1 ) ) );
 		if ( trb_len > len )
 			trb_len = len;
 
 		/* Construct normal TRB */
 		normal = &trb->normal;
-		normal->data = cpu_to_le64 ( virt_to_phys ( data ) );
+		normal->data = cpu_to_le64 ( phys );
 		normal->len = cpu_to_le32 ( trb_len );
 		normal->type = XHCI_TRB_NORMAL;
 		normal->flags = XHCI_TRB_CH;
 
 		/* Move to next TRB */
-		data += trb_len;
+		phys += trb_len;
 		len -= trb_len;
 		trb++;
 	}
@@ -2619,8 +2671,8 @@ static int xhci_endpoint_stream ( struct usb_endpoint *ep,
 					 count ) ) != 0 )
 		return rc;
 
-	/* Ring the doorbell */
-	xhci_doorbell ( &endpoint->ring );
+	/* Ring the doorbell when the bus is next polled */
+	xhci_doorbell_defer ( endpoint );
 
 	profile_stop ( &xhci_stream_profiler );
 	return 0;
@@ -2874,8 +2926,16 @@ static void xhci_bus_close ( struct usb_bus *bus ) {
 static void xhci_bus_poll ( struct usb_bus *bus ) {
 	struct xhci_device *xhci = usb_bus_get_hostdata ( bus );
 
+	/* Ring any doorbells deferred since the previous poll */
+	xhci_doorbell_flush ( xhci );
+
 	/* Poll event ring */
 	xhci_event_poll ( xhci );
+
+	/* Ring any doorbells deferred while handling completions
+	 * (e.g. by refilling a bulk IN endpoint)
+	 */
+	xhci_doorbell_flush ( xhci );
 }
 
 /******************************************************************************
@@ -3239,6 +3299,7 @@ static int xhci_probe ( struct pci_device *pci ) {
 	}
 	xhci->name = pci->dev.name;
 	xhci->quirks = pci->id->driver_data;
+	INIT_LIST_HEAD ( &xhci->doorbells );
 
 	/* Fix up PCI device */
 	adjust_pci_device ( pci );
@@ -27,6 +27,13 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Maximum transfer size */
 #define XHCI_MTU 65536
 
+/** Data buffer boundary
+ *
+ * The data buffer described by a single transfer TRB must not cross
+ * a 64kB boundary.
+ */
+#define XHCI_TRB_BOUNDARY 65536
+
 /** xHCI PCI BAR */
 #define XHCI_BAR PCI_BASE_ADDRESS_0
 
@@ -961,9 +968,11 @@ xhci_ring_consumed ( struct xhci_trb_ring *ring ) {
 
 /** Number of TRBs in the event ring
  *
- * This is a policy decision.
+ * This is a policy decision.  The event ring must be large enough to
+ * hold the completions generated by all bulk transfer rings between
+ * successive polls.
  */
-#define XHCI_EVENT_TRBS_LOG2 6
+#define XHCI_EVENT_TRBS_LOG2 8
 
 /** Number of TRBs in a transfer ring
  *
@@ -971,6 +980,13 @@ xhci_ring_consumed ( struct xhci_trb_ring *ring ) {
  */
 #define XHCI_TRANSFER_TRBS_LOG2 6
 
+/** Number of TRBs in a bulk transfer ring
+ *
+ * This is a policy decision.  Bulk endpoints (e.g. for USB network
+ * devices) may have many large transfers in flight concurrently.
+ */
+#define XHCI_BULK_TRBS_LOG2 8
+
 /** Maximum time to wait for BIOS to release ownership
  *
  * This is a policy decision.
@@ -1090,6 +1106,8 @@ struct xhci_device {
 	struct xhci_event_ring event;
 	/** Current command (if any) */
 	union xhci_trb *pending;
+	/** Endpoints with a pending doorbell */
+	struct list_head doorbells;
 
 	/** Device slots, indexed by slot ID */
 	struct xhci_slot **slot;
@@ -1145,6 +1163,8 @@ struct xhci_endpoint {
 	struct xhci_endpoint_context *context;
 	/** Transfer ring */
 	struct xhci_trb_ring ring;
+	/** List of endpoints with a pending doorbell */
+	struct list_head doorbell;
 };
 
 #endif /* _IPXE_XHCI_H */
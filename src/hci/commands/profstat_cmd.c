@@ -24,9 +24,11 @@
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdio.h>
+#include <string.h>
 #include <getopt.h>
 #include <ipxe/command.h>
 #include <ipxe/parseopt.h>
+#include <ipxe/params.h>
 #include <usr/profstat.h>
 
 /** @file
@@ -36,10 +38,20 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 
 /** "profstat" options */
-struct profstat_options {};
+struct profstat_options {
+	/** Parameter list name */
+	char *params;
+	/** Reset statistics */
+	int reset;
+};
 
 /** "profstat" option list */
-static struct option_descriptor profstat_opts[] = {};
+static struct option_descriptor profstat_opts[] = {
+	OPTION_DESC ( "params", 'p', required_argument,
+		      struct profstat_options, params, parse_string ),
+	OPTION_DESC ( "reset", 'r', no_argument,
+		      struct profstat_options, reset, parse_flag ),
+};
 
 /** "profstat" command descriptor */
 static struct command_descriptor profstat_cmd =
@@ -54,13 +66,29 @@ static struct command_descriptor profstat_cmd =
  */
 static int profstat_exec ( int argc, char **argv ) {
 	struct profstat_options opts;
+	struct parameters *params;
 	int rc;
 
 	/* Parse options */
 	if ( ( rc = parse_options ( argc, argv, &profstat_cmd, &opts ) ) != 0 )
 		return rc;
 
-	profstat();
+	/* Export or print statistics, as applicable */
+	if ( opts.params ) {
+		if ( ( rc = parse_parameters ( opts.params, &params ) ) != 0 )
+			return rc;
+		if ( ( rc = profstat_export ( params ) ) != 0 ) {
+			printf ( "Could not export profiling statistics: %s\n",
+				 strerror ( rc ) );
+			return rc;
+		}
+	} else {
+		profstat();
+	}
+
+	/* Reset statistics, if applicable */
+	if ( opts.reset )
+		profstat_reset();
 
 	return 0;
 }
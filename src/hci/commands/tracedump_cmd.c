@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdio.h>
+#include <getopt.h>
+#include <ipxe/command.h>
+#include <ipxe/parseopt.h>
+#include <usr/tracedump.h>
+
+/** @file
+ *
+ * Event tracing commands
+ *
+ */
+
+/** "tracedump" options */
+struct tracedump_options {
+	/** Discard events after dumping */
+	int reset;
+};
+
+/** "tracedump" option list */
+static struct option_descriptor tracedump_opts[] = {
+	OPTION_DESC ( "reset", 'r', no_argument,
+		      struct tracedump_options, reset, parse_flag ),
+};
+
+/** "tracedump" command descriptor */
+static struct command_descriptor tracedump_cmd =
+	COMMAND_DESC ( struct tracedump_options, tracedump_opts, 0, 0, NULL );
+
+/**
+ * The "tracedump" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int tracedump_exec ( int argc, char **argv ) {
+	struct tracedump_options opts;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &tracedump_cmd, &opts ) ) != 0 )
+		return rc;
+
+	/* Dump events */
+	tracedump();
+
+	/* Discard events, if applicable */
+	if ( opts.reset )
+		tracedump_reset();
+
+	return 0;
+}
+
+/** Event tracing commands */
+struct command tracedump_commands[] __command = {
+	{
+		.name = "tracedump",
+		.exec = tracedump_exec,
+	},
+};
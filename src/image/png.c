@@ -352,71 +352,71 @@ static int png_image_data ( struct image *image, struct png_context *png,
 }
 
 /**
- * Unfilter byte using the "None" filter
+ * Unfilter scanline using the "None" filter
  *
- * @v current		Filtered current byte
- * @v left		Unfiltered left byte
- * @v above		Unfiltered above byte
- * @v above_left	Unfiltered above-left byte
- * @ret current		Unfiltered current byte
+ * @v current		Filtered current scanline
+ * @v above		Unfiltered above scanline
+ * @v len		Length of scanline (excluding filter byte)
+ * @v pixel_len		Pixel length
  */
-static unsigned int png_unfilter_none ( unsigned int current,
-					unsigned int left __unused,
-					unsigned int above __unused,
-					unsigned int above_left __unused ) {
+static void png_unfilter_none ( uint8_t *current __unused,
+				const uint8_t *above __unused,
+				size_t len __unused,
+				size_t pixel_len __unused ) {
 
-	return current;
+	/* Nothing to do */
 }
 
 /**
- * Unfilter byte using the "Sub" filter
+ * Unfilter scanline using the "Sub" filter
  *
- * @v current		Filtered current byte
- * @v left		Unfiltered left byte
- * @v above		Unfiltered above byte
- * @v above_left	Unfiltered above-left byte
- * @ret current		Unfiltered current byte
+ * @v current		Filtered current scanline
+ * @v above		Unfiltered above scanline
+ * @v len		Length of scanline (excluding filter byte)
+ * @v pixel_len		Pixel length
  */
-static unsigned int png_unfilter_sub ( unsigned int current,
-				       unsigned int left,
-				       unsigned int above __unused,
-				       unsigned int above_left __unused ) {
+static void png_unfilter_sub ( uint8_t *current,
+			       const uint8_t *above __unused,
+			       size_t len, size_t pixel_len ) {
+	size_t i;
 
-	return ( current + left );
+	for ( i = pixel_len ; i < len ; i++ )
+		current[i] += current[ i - pixel_len ];
 }
 
 /**
- * Unfilter byte using the "Up" filter
+ * Unfilter scanline using the "Up" filter
  *
- * @v current		Filtered current byte
- * @v left		Unfiltered left byte
- * @v above		Unfiltered above byte
- * @v above_left	Unfiltered above-left byte
- * @ret current		Unfiltered current byte
+ * @v current		Filtered current scanline
+ * @v above		Unfiltered above scanline
+ * @v len		Length of scanline (excluding filter byte)
+ * @v pixel_len		Pixel length
  */
-static unsigned int png_unfilter_up ( unsigned int current,
-				      unsigned int left __unused,
-				      unsigned int above,
-				      unsigned int above_left __unused ) {
+static void png_unfilter_up ( uint8_t *current, const uint8_t *above,
+			      size_t len, size_t pixel_len __unused ) {
+	size_t i;
 
-	return ( current + above );
+	for ( i = 0 ; i < len ; i++ )
+		current[i] += above[i];
 }
 
 /**
- * Unfilter byte using the "Average" filter
+ * Unfilter scanline using the "Average" filter
  *
- * @v current		Filtered current byte
- * @v left		Unfiltered left byte
- * @v above		Unfiltered above byte
- * @v above_left	Unfiltered above-left byte
- * @ret current		Unfiltered current byte
+ * @v current		Filtered current scanline
+ * @v above		Unfiltered above scanline
+ * @v len		Length of scanline (excluding filter byte)
+ * @v pixel_len		Pixel length
  */
-static unsigned int png_unfilter_average ( unsigned int current,
-					   unsigned int left,
-					   unsigned int above,
-					   unsigned int above_left __unused ) {
-
-	return ( current + ( ( above + left ) >> 1 ) );
+static void png_unfilter_average ( uint8_t *current, const uint8_t *above,
+				   size_t len, size_t pixel_len ) {
+	size_t i;
+
+	/* Left bytes are taken to be zero for the first pixel */
+	for ( i = 0 ; i < pixel_len ; i++ )
+		current[i] += ( above[i] >> 1 );
+	for ( ; i < len ; i++ )
+		current[i] += ( ( above[i] + current[ i - pixel_len ] ) >> 1 );
 }
 
 /**
@@ -427,18 +427,19 @@ static unsigned int png_unfilter_average ( unsigned int current,
  * @v c			Pixel C
  * @ret predictor	Predictor pixel
  */
-static unsigned int png_paeth_predictor ( unsigned int a, unsigned int b,
-					  unsigned int c ) {
-	unsigned int p;
-	unsigned int pa;
-	unsigned int pb;
-	unsigned int pc;
-
-	/* Algorithm as defined in RFC 2083 section 6.6 */
-	p = ( a + b - c );
-	pa = abs ( p - a );
-	pb = abs ( p - b );
-	pc = abs ( p - c );
+static inline unsigned int png_paeth_predictor ( unsigned int a,
+						 unsigned int b,
+						 unsigned int c ) {
+	int pa;
+	int pb;
+	int pc;
+
+	/* Algorithm as defined in RFC 2083 section 6.6, rearranged
+	 * to avoid calculating the initial estimate p=(a+b-c).
+	 */
+	pa = abs ( ( ( int ) b ) - ( ( int ) c ) );
+	pb = abs ( ( ( int ) a ) - ( ( int ) c ) );
+	pc = abs ( ( ( int ) ( a + b ) ) - ( ( int ) ( 2 * c ) ) );
 	if ( ( pa <= pb ) && ( pa <= pc ) ) {
 		return a;
 	} else if ( pb <= pc ) {
@@ -449,37 +450,42 @@ static unsigned int png_paeth_predictor ( unsigned int a, unsigned int b,
 }
 
 /**
- * Unfilter byte using the "Paeth" filter
+ * Unfilter scanline using the "Paeth" filter
  *
- * @v current		Filtered current byte
- * @v above_left	Unfiltered above-left byte
- * @v above		Unfiltered above byte
- * @v left		Unfiltered left byte
- * @ret current		Unfiltered current byte
+ * @v current		Filtered current scanline
+ * @v above		Unfiltered above scanline
+ * @v len		Length of scanline (excluding filter byte)
+ * @v pixel_len		Pixel length
  */
-static unsigned int png_unfilter_paeth ( unsigned int current,
-					 unsigned int left,
-					 unsigned int above,
-					 unsigned int above_left ) {
+static void png_unfilter_paeth ( uint8_t *current, const uint8_t *above,
+				 size_t len, size_t pixel_len ) {
+	size_t i;
 
-	return ( current + png_paeth_predictor ( left, above, above_left ) );
+	/* Left and above-left bytes are taken to be zero for the
+	 * first pixel, in which case the predictor is always the
+	 * above byte.
+	 */
+	for ( i = 0 ; i < pixel_len ; i++ )
+		current[i] += above[i];
+	for ( ; i < len ; i++ ) {
+		current[i] += png_paeth_predictor ( current[ i - pixel_len ],
+						    above[i],
+						    above[ i - pixel_len ] );
+	}
 }
 
 /** A PNG filter */
 struct png_filter {
 	/**
-	 * Unfilter byte
+	 * Unfilter scanline
 	 *
-	 * @v current		Filtered current byte
-	 * @v left		Unfiltered left byte
-	 * @v above		Unfiltered above byte
-	 * @v above_left	Unfiltered above-left byte
-	 * @ret current		Unfiltered current byte
+	 * @v current		Filtered current scanline
+	 * @v above		Unfiltered above scanline
+	 * @v len		Length of scanline (excluding filter byte)
+	 * @v pixel_len		Pixel length
 	 */
-	unsigned int ( * unfilter ) ( unsigned int current,
-				      unsigned int left,
-				      unsigned int above,
-				      unsigned int above_left );
+	void ( * unfilter ) ( uint8_t *current, const uint8_t *above,
+			      size_t len, size_t pixel_len );
 };
 
 /** PNG filter types */
@@ -506,20 +512,26 @@ static int png_unfilter_pass ( struct image *image, struct png_context *png,
 			       struct png_interlace *interlace ) {
 	size_t offset = png->raw.offset;
 	size_t pixel_len = png_pixel_len ( png );
-	size_t scanline_len = png_scanline_len ( png, interlace );
+	size_t len = ( png_scanline_len ( png, interlace ) - 1 );
 	struct png_filter *filter;
 	unsigned int scanline;
-	unsigned int byte;
 	uint8_t filter_type;
-	uint8_t left;
-	uint8_t above;
-	uint8_t above_left;
-	uint8_t current;
+	uint8_t *buf;
+	uint8_t *current;
+	uint8_t *above;
+	uint8_t *tmp;
+	int rc;
 
-	/* On the first scanline of a pass, above bytes are assumed to
-	 * be zero.
+	/* Allocate current and above scanline buffers.  On the first
+	 * scanline of a pass, above bytes are assumed to be zero.
 	 */
-	above = 0;
+	buf = zalloc ( 2 * len );
+	if ( ! buf ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	above = buf;
+	current = ( buf + len );
 
 	/* Iterate over each scanline in turn */
 	for ( scanline = 0 ; scanline < interlace->height ; scanline++ ) {
@@ -531,54 +543,36 @@ static int png_unfilter_pass ( struct image *image, struct png_context *png,
 				      sizeof ( png_filters[0] ) ) ) {
 			DBGC ( image, "PNG %s unknown filter type %d\n",
 			       image->name, filter_type );
-			return -ENOTSUP;
+			rc = -ENOTSUP;
+			goto err_filter;
 		}
 		filter = &png_filters[filter_type];
 		assert ( filter->unfilter != NULL );
 		DBGC2 ( image, "PNG %s pass %d scanline %d filter type %d\n",
 			image->name, interlace->pass, scanline, filter_type );
 
-		/* At the start of a line, both above-left and left
-		 * bytes are taken to be zero.
-		 */
-		left = 0;
-		above_left = 0;
-
-		/* Iterate over each byte (not pixel) in turn */
-		for ( byte = 0 ; byte < ( scanline_len - 1 ) ; byte++ ) {
-
-			/* Extract predictor bytes, if applicable */
-			if ( byte >= pixel_len ) {
-				copy_from_user ( &left, png->raw.data,
-						 ( offset - pixel_len ),
-						 sizeof ( left ) );
-			}
-			if ( scanline > 0 ) {
-				copy_from_user ( &above, png->raw.data,
-						 ( offset - scanline_len ),
-						 sizeof ( above ) );
-			}
-			if ( ( scanline > 0 ) && ( byte >= pixel_len ) ) {
-				copy_from_user ( &above_left, png->raw.data,
-						 ( offset - scanline_len -
-						   pixel_len ),
-						 sizeof ( above_left ) );
-			}
+		/* Unfilter whole scanline */
+		copy_from_user ( current, png->raw.data, offset, len );
+		filter->unfilter ( current, above, len, pixel_len );
+		copy_to_user ( png->raw.data, offset, current, len );
+		offset += len;
 
-			/* Unfilter current byte */
-			copy_from_user ( &current, png->raw.data,
-					 offset, sizeof ( current ) );
-			current = filter->unfilter ( current, left, above,
-						     above_left );
-			copy_to_user ( png->raw.data, offset++,
-				       &current, sizeof ( current ) );
-		}
+		/* Use this scanline as the above scanline for the next */
+		tmp = above;
+		above = current;
+		current = tmp;
 	}
 
 	/* Update offset */
 	png->raw.offset = offset;
 
-	return 0;
+	/* Success */
+	rc = 0;
+
+ err_filter:
+	free ( buf );
+ err_alloc:
+	return rc;
 }
 
 /**
@@ -637,6 +631,124 @@ static inline unsigned int png_pixel ( unsigned int raw, unsigned int alpha,
 	return ( ( ( ( ( 0xff00 * raw * alpha ) / max ) / max ) + 0x80 ) >> 8 );
 }
 
+/**
+ * Fill one interlace pass of PNG pixels for an 8-bit truecolour image
+ *
+ * @v image		PNG image
+ * @v png		PNG context
+ * @v interlace		Interlace pass
+ * @ret rc		Return status code
+ *
+ * This converts a whole scanline at a time, for the common case of
+ * 8-bit RGB or RGBA images.
+ *
+ * This routine may assume that it is impossible to overrun either the
+ * raw data buffer or the pixel buffer, since the sizes of both are
+ * determined by the image dimensions.
+ */
+static int png_pixels_pass_truecolour ( struct image *image,
+					struct png_context *png,
+					struct png_interlace *interlace ) {
+	size_t raw_offset = png->raw.offset;
+	int has_alpha = ( png->colour_type & PNG_COLOUR_TYPE_ALPHA );
+	size_t raw_len = ( interlace->width * png->channels );
+	size_t pixels_len = ( interlace->width * sizeof ( uint32_t ) );
+	size_t pixbuf_y_offset;
+	size_t pixbuf_offset;
+	size_t pixbuf_x_stride;
+	size_t pixbuf_y_stride;
+	const uint8_t *sample;
+	uint32_t *pixels;
+	uint8_t *raw;
+	unsigned int alpha;
+	unsigned int y;
+	unsigned int x;
+
+	/* Sanity checks */
+	assert ( png->depth == 8 );
+	assert ( png->channels == ( has_alpha ? 4 : 3 ) );
+
+	/* Allocate scanline buffers */
+	pixels = malloc ( pixels_len + raw_len );
+	if ( ! pixels )
+		return -ENOMEM;
+	raw = ( ( ( void * ) pixels ) + pixels_len );
+
+	/* Calculate pixel buffer offset and strides */
+	pixbuf_y_offset = ( ( ( interlace->y_indent * png->pixbuf->width ) +
+			      interlace->x_indent ) * sizeof ( pixels[0] ) );
+	pixbuf_x_stride = ( interlace->x_stride * sizeof ( pixels[0] ) );
+	pixbuf_y_stride = ( interlace->y_stride * png->pixbuf->width *
+			    sizeof ( pixels[0] ) );
+	DBGC2 ( image, "PNG %s pass %d %dx%d at (%d,%d) stride (%d,%d)\n",
+		image->name, interlace->pass, interlace->width,
+		interlace->height, interlace->x_indent, interlace->y_indent,
+		interlace->x_stride, interlace->y_stride );
+
+	/* Iterate over each scanline in turn */
+	for ( y = 0 ; y < interlace->height ; y++ ) {
+
+		/* Skip filter byte and extract scanline */
+		raw_offset++;
+		copy_from_user ( raw, png->raw.data, raw_offset, raw_len );
+		raw_offset += raw_len;
+
+		/* Convert to native pixel format */
+		sample = raw;
+		if ( has_alpha ) {
+			for ( x = 0 ; x < interlace->width ; x++ ) {
+				alpha = sample[3];
+				if ( alpha == 0xff ) {
+					pixels[x] = ( ( sample[0] << 16 ) |
+						      ( sample[1] << 8 ) |
+						      ( sample[2] << 0 ) );
+				} else {
+					pixels[x] =
+					  ( ( png_pixel ( sample[0], alpha,
+							  0xff ) << 16 ) |
+					    ( png_pixel ( sample[1], alpha,
+							  0xff ) << 8 ) |
+					    ( png_pixel ( sample[2], alpha,
+							  0xff ) << 0 ) );
+				}
+				sample += 4;
+			}
+		} else {
+			for ( x = 0 ; x < interlace->width ; x++ ) {
+				pixels[x] = ( ( sample[0] << 16 ) |
+					      ( sample[1] << 8 ) |
+					      ( sample[2] << 0 ) );
+				sample += 3;
+			}
+		}
+
+		/* Store pixels */
+		if ( interlace->x_stride == 1 ) {
+			copy_to_user ( png->pixbuf->data, pixbuf_y_offset,
+				       pixels, pixels_len );
+		} else {
+			pixbuf_offset = pixbuf_y_offset;
+			for ( x = 0 ; x < interlace->width ; x++ ) {
+				copy_to_user ( png->pixbuf->data,
+					       pixbuf_offset, &pixels[x],
+					       sizeof ( pixels[x] ) );
+				pixbuf_offset += pixbuf_x_stride;
+			}
+		}
+
+		/* Move to next output row */
+		pixbuf_y_offset += pixbuf_y_stride;
+	}
+
+	/* Update offset */
+	png->raw.offset = raw_offset;
+
+	/* Free scanline buffers */
+	free ( pixels );
+
+	return 0;
+}
+
 /**
  * Fill one interlace pass of PNG pixels
  *
@@ -673,6 +785,11 @@ static void png_pixels_pass ( struct image *image,
 	uint8_t current = 0;
 	uint32_t pixel;
 
+	/* Use bulk conversion for 8-bit truecolour images, if possible */
+	if ( ( png->depth == 8 ) && is_rgb && ( ! is_indexed ) &&
+	     ( png_pixels_pass_truecolour ( image, png, interlace ) == 0 ) )
+		return;
+
 	/* We only ever use the top byte of 16-bit pixels.  Model this
 	 * as a bit depth of 8 with a stride of more than one.
 	 */
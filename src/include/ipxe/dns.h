@@ -134,6 +134,26 @@ struct dns_rr_cname {
 	struct dns_rr_common common;
 } __attribute__ (( packed ));
 
+/** Type of a DNS "SOA" record */
+#define DNS_TYPE_SOA 6
+
+/** Trailing fields of a DNS "SOA" record
+ *
+ * These follow the variable-length MNAME and RNAME fields.
+ */
+struct dns_soa_tail {
+	/** Serial number */
+	uint32_t serial;
+	/** Refresh interval */
+	uint32_t refresh;
+	/** Retry interval */
+	uint32_t retry;
+	/** Expiry limit */
+	uint32_t expire;
+	/** Minimum TTL (used as negative caching TTL) */
+	uint32_t minimum;
+} __attribute__ (( packed ));
+
 /** A DNS resource record */
 union dns_rr {
 	/** Common fields */
@@ -146,10 +166,41 @@ union dns_rr {
 	struct dns_rr_cname cname;
 };
 
+/** Maximum number of cached DNS results */
+#define DNS_CACHE_MAX 16
+
+/** Maximum time for which to cache a DNS result (in seconds)
+ *
+ * This is a policy decision.
+ */
+#define DNS_CACHE_MAX_TTL ( 24 * 60 * 60 )
+
+/** Maximum time for which to cache a negative DNS result (in seconds)
+ *
+ * RFC 2308 section 5 suggests a limit of between one and three hours.
+ */
+#define DNS_CACHE_MAX_NEGATIVE_TTL ( 3 * 60 * 60 )
+
+/** DNS statistics */
+struct dns_statistics {
+	/** Number of queries transmitted */
+	unsigned int queries;
+	/** Number of cache hits */
+	unsigned int hits;
+	/** Number of cache misses */
+	unsigned int misses;
+};
+
+extern struct dns_statistics dns_stats;
+
 extern int dns_encode ( const char *string, struct dns_name *name );
 extern int dns_decode ( struct dns_name *name, char *data, size_t len );
 extern int dns_compare ( struct dns_name *first, struct dns_name *second );
 extern int dns_copy ( struct dns_name *src, struct dns_name *dst );
 extern int dns_skip ( struct dns_name *name );
+extern int dns_cache_add ( const char *name, sa_family_t family,
+			   struct sockaddr *sa, unsigned long ttl );
+extern unsigned long dns_cache_ttl ( const char *name, sa_family_t family );
+extern void dns_cache_flush ( void );
 
 #endif /* _IPXE_DNS_H */
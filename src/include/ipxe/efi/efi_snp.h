@@ -21,6 +21,12 @@
 /** SNP transmit completion ring size */
 #define EFI_SNP_NUM_TX 32
 
+/** Maximum SNP network device polling rate (in polls per second)
+ *
+ * This is a policy decision.
+ */
+#define EFI_SNP_POLL_RATE 20000
+
 /** An SNP device */
 struct efi_snp_device {
 	/** List of SNP devices */
@@ -47,6 +53,8 @@ struct efi_snp_device {
 	unsigned int tx_cons;
 	/** Receive queue */
 	struct list_head rx;
+	/** Time of last network device poll */
+	unsigned long polled;
 	/** The network interface identifier */
 	EFI_NETWORK_INTERFACE_IDENTIFIER_PROTOCOL nii;
 	/** Component name protocol */
@@ -23,6 +23,12 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Transparent background magic colour (raw colour value) */
 #define FBCON_TRANSPARENT 0xffffffff
 
+/** Number of entries in glyph cache
+ *
+ * Must be a power of two.
+ */
+#define FBCON_GLYPH_CACHE 256
+
 /** A font glyph */
 struct fbcon_font_glyph {
 	/** Row bitmask */
@@ -102,6 +108,21 @@ struct fbcon_text {
 	userptr_t start;
 };
 
+/** A frame buffer glyph cache
+ *
+ * The glyph cache holds pre-rendered pixel data for recently drawn
+ * text cells with an opaque background colour, so that drawing a
+ * cached cell requires only a copy of each pixel row.
+ */
+struct fbcon_glyph_cache {
+	/** Cached text cells, or NULL if glyph cache is unavailable */
+	struct fbcon_text_cell *cells;
+	/** Rendered glyph pixel data */
+	userptr_t start;
+	/** Length of a single rendered glyph */
+	size_t len;
+};
+
 /** A frame buffer background picture */
 struct fbcon_picture {
 	/** Start address */
@@ -142,6 +163,10 @@ struct fbcon {
 	struct fbcon_text text;
 	/** Background picture */
 	struct fbcon_picture picture;
+	/** Glyph cache */
+	struct fbcon_glyph_cache cache;
+	/** Rows requiring redraw (one flag per character row) */
+	uint8_t *dirty;
 	/** Display cursor */
 	int show_cursor;
 };
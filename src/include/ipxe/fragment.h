@@ -17,14 +17,75 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Fragment reassembly timeout */
 #define FRAGMENT_TIMEOUT ( TICKS_PER_SEC / 2 )
 
+/** Maximum number of fragments held before the final fragment
+ *
+ * A maximum-length (64kB) IPv4 datagram is split into 45 fragments
+ * on a standard Ethernet link.
+ */
+#define FRAGMENT_MAX_PENDING 64
+
+/** Maximum total size of I/O buffers held before the final fragment
+ *
+ * This allows for each of the maximum number of fragments to be held
+ * in a 2kB receive buffer.
+ */
+#define FRAGMENT_MAX_PENDING_SIZE ( 128 * 1024 )
+
+/** A hole within a fragment reassembly buffer
+ *
+ * Holes are maintained in order of increasing offset, as described
+ * in RFC 815.
+ */
+struct fragment_hole {
+	/** List of holes */
+	struct list_head list;
+	/** Offset of first missing byte */
+	size_t start;
+	/** Offset of first byte following the hole */
+	size_t end;
+};
+
+/** Hole end offset used before the reassembled length is known */
+#define FRAGMENT_HOLE_INFINITY ( ~( ( size_t ) 0 ) )
+
+/** A fragment awaiting placement in a reassembly buffer */
+struct fragment_pending {
+	/** List of pending fragments */
+	struct list_head list;
+	/** Received fragment */
+	struct io_buffer *iobuf;
+	/** Length of non-fragmentable portion of received fragment */
+	size_t hdrlen;
+	/** Offset of fragment within reassembled payload */
+	size_t offset;
+};
+
 /** A fragment reassembly buffer */
 struct fragment {
 	/* List of fragment reassembly buffers */
 	struct list_head list;
-	/** Reassembled packet */
+	/** Reassembled packet
+	 *
+	 * Until the final fragment has been received (and so the
+	 * length of the reassembled packet is known), this is one of
+	 * the pending fragments: the fragment at offset zero if
+	 * received, otherwise the first fragment to be received.
+	 */
 	struct io_buffer *iobuf;
 	/** Length of non-fragmentable portion of reassembled packet */
 	size_t hdrlen;
+	/** Length of reassembled payload (if final fragment received) */
+	size_t len;
+	/** Final fragment has been received */
+	int final;
+	/** List of holes */
+	struct list_head holes;
+	/** List of fragments awaiting placement */
+	struct list_head pending;
+	/** Number of fragments awaiting placement */
+	unsigned int count;
+	/** Total size of I/O buffers awaiting placement */
+	size_t size;
 	/** Reassembly timer */
 	struct retry_timer timer;
 	/** Fragment reassembler */
@@ -388,6 +388,8 @@ struct http_transaction {
 	size_t len;
 	/** Chunk length remaining */
 	size_t remaining;
+	/** A request has been sent but has not yet completed */
+	int outstanding;
 };
 
 /******************************************************************************
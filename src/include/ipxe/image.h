@@ -129,6 +129,7 @@ struct image_type {
 #define __image_type( probe_order ) __table_entry ( IMAGE_TYPES, probe_order )
 
 extern struct list_head images;
+extern unsigned int images_generation;
 extern struct image *current_image;
 
 /** Iterate over all registered images */
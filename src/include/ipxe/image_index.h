@@ -0,0 +1,16 @@
+#ifndef _IPXE_IMAGE_INDEX_H
+#define _IPXE_IMAGE_INDEX_H
+
+/** @file
+ *
+ * Image name index
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+struct image;
+
+extern struct image * find_image_nocase ( const char *name );
+
+#endif /* _IPXE_IMAGE_INDEX_H */
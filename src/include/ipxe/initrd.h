@@ -1,5 +1,5 @@
-#ifndef _INITRD_H
-#define _INITRD_H
+#ifndef _IPXE_INITRD_H
+#define _IPXE_INITRD_H
 
 /** @file
  *
@@ -24,7 +24,8 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 #define INITRD_MIN_FREE_LEN ( 512 * 1024 )
 
+extern size_t initrd_rearrange ( userptr_t bottom, userptr_t top );
 extern void initrd_reshuffle ( userptr_t bottom );
 extern int initrd_reshuffle_check ( size_t len, userptr_t bottom );
 
-#endif /* _INITRD_H */
+#endif /* _IPXE_INITRD_H */
@@ -152,6 +152,7 @@ extern void intf_poke ( struct interface *intf,
 
 extern struct interface_descriptor null_intf_desc;
 extern struct interface null_intf;
+extern unsigned int intf_generation;
 
 /**
  * Initialise an object interface
@@ -166,6 +167,7 @@ static inline void intf_init ( struct interface *intf,
 	intf->dest = &null_intf;
 	intf->refcnt = refcnt;
 	intf->desc = desc;
+	intf_generation++;
 }
 
 /**
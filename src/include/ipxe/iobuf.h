@@ -46,8 +46,39 @@ struct io_buffer {
 	void *tail;
 	/** End of the buffer */
         void *end;
+
+	/** Checksum offload flags
+	 *
+	 * This is the bitwise-OR of zero or more IOB_CSUM_XXX
+	 * constants.
+	 */
+	unsigned int csum_flags;
+	/** Start of checksummed data (if IOB_CSUM_PARTIAL) */
+	void *csum_start;
+	/** Offset of checksum field from start of checksummed data
+	 * (if IOB_CSUM_PARTIAL)
+	 */
+	size_t csum_offset;
 };
 
+/** Transport-layer checksum has been verified by hardware
+ *
+ * Set by a network device driver on a received packet if the
+ * hardware has verified that the transport-layer checksum is
+ * correct.
+ */
+#define IOB_CSUM_VALID 0x0001
+
+/** Transport-layer checksum must be completed by hardware
+ *
+ * Set on a packet to be transmitted if the transport-layer checksum
+ * field contains only the (uncomplemented) pseudo-header checksum.
+ * The hardware must calculate the checksum over the data starting
+ * at csum_start and place the result at csum_offset bytes beyond
+ * csum_start.
+ */
+#define IOB_CSUM_PARTIAL 0x0002
+
 /**
  * Reserve space at start of I/O buffer
  *
@@ -188,6 +219,21 @@ static inline void iob_populate ( struct io_buffer *iobuf,
 	iobuf->head = iobuf->data = data;
 	iobuf->tail = ( data + len );
 	iobuf->end = ( data + max_len );
+	iobuf->csum_flags = 0;
+}
+
+/**
+ * Mark I/O buffer as requiring transport-layer checksum completion
+ *
+ * @v iobuf	I/O buffer
+ * @v start	Start of checksummed data
+ * @v csum	Checksum field
+ */
+static inline void iob_csum_partial ( struct io_buffer *iobuf, void *start,
+				      void *csum ) {
+	iobuf->csum_flags |= IOB_CSUM_PARTIAL;
+	iobuf->csum_start = start;
+	iobuf->csum_offset = ( csum - start );
 }
 
 /**
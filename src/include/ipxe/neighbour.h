@@ -39,6 +39,8 @@ struct neighbour {
 	struct refcnt refcnt;
 	/** List of neighbour cache entries */
 	struct list_head list;
+	/** List of neighbour cache entries within hash bucket */
+	struct list_head hash;
 
 	/** Network device */
 	struct net_device *netdev;
@@ -55,6 +57,12 @@ struct neighbour {
 	uint8_t net_source[MAX_NET_ADDR_LEN];
 	/** Retransmission timer */
 	struct retry_timer timer;
+	/** Number of consecutive failed discovery attempts */
+	unsigned int failures;
+	/** Time of most recent failed discovery attempt */
+	unsigned long failed;
+	/** Time to wait before reattempting discovery after failure */
+	unsigned long holdoff;
 
 	/** Pending I/O buffers */
 	struct list_head tx_queue;
@@ -68,10 +76,38 @@ struct neighbour {
  */
 static inline __attribute__ (( always_inline )) int
 neighbour_has_ll_dest ( struct neighbour *neighbour ) {
-	return ( ! timer_running ( &neighbour->timer ) );
+	return ( ! ( timer_running ( &neighbour->timer ) ||
+		     neighbour->failures ) );
 }
 
+/**
+ * Test if neighbour cache entry records a failed discovery
+ *
+ * @v neighbour		Neighbour cache entry
+ * @ret has_failed	Neighbour discovery has failed
+ */
+static inline __attribute__ (( always_inline )) int
+neighbour_has_failed ( struct neighbour *neighbour ) {
+	return ( neighbour->failures &&
+		 ( ! timer_running ( &neighbour->timer ) ) );
+}
+
+/** Neighbour cache statistics */
+struct neighbour_statistics {
+	/** Number of cache lookups */
+	unsigned int lookups;
+	/** Number of cache lookups which found an existing entry */
+	unsigned int hits;
+	/** Number of neighbour discovery attempts started */
+	unsigned int discoveries;
+	/** Number of neighbour discovery attempts which failed */
+	unsigned int failures;
+	/** Number of packets dropped due to a failed discovery */
+	unsigned int drops;
+};
+
 extern struct list_head neighbours;
+extern struct neighbour_statistics neighbour_stats;
 
 extern int neighbour_tx ( struct io_buffer *iobuf, struct net_device *netdev,
 			  struct net_protocol *net_protocol,
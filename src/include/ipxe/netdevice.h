@@ -289,6 +289,8 @@ struct net_device_stats {
 	unsigned int good;
 	/** Count of error completions */
 	unsigned int bad;
+	/** Count of packets with checksums offloaded to hardware */
+	unsigned int csum;
 	/** Error breakdowns */
 	struct net_device_error errors[NETDEV_MAX_UNIQUE_ERRORS];
 };
@@ -400,6 +402,12 @@ struct net_device {
 	 * This length includes any link-layer headers.
 	 */
 	size_t max_pkt_len;
+	/** Hardware offload capabilities
+	 *
+	 * This is the bitwise-OR of zero or more NETDEV_OFFLOAD_XXX
+	 * constants.
+	 */
+	unsigned int offloads;
 	/** TX packet queue */
 	struct list_head tx_queue;
 	/** Deferred TX packet queue */
@@ -438,6 +446,20 @@ struct net_device {
  */
 #define NETDEV_IRQ_UNSUPPORTED 0x0008
 
+/** Network device can verify received TCP and UDP checksums
+ *
+ * The driver must set IOB_CSUM_VALID on each received packet for
+ * which the hardware has verified the transport-layer checksum.
+ */
+#define NETDEV_OFFLOAD_RX_CSUM 0x0001
+
+/** Network device can insert transmitted TCP and UDP checksums
+ *
+ * The driver must complete the transport-layer checksum of each
+ * transmitted packet marked with IOB_CSUM_PARTIAL.
+ */
+#define NETDEV_OFFLOAD_TX_CSUM 0x0002
+
 /** Link-layer protocol table */
 #define LL_PROTOCOLS __table ( struct ll_protocol, "ll_protocols" )
 
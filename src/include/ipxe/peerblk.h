@@ -106,6 +106,8 @@ struct peerdist_block {
 	size_t cipher_remaining;
 	/** Remaining digest length (excluding AES padding bytes) */
 	size_t digest_remaining;
+	/** Decryption chunk buffer (if allocated) */
+	void *chunk;
 
 	/** Discovery client */
 	struct peerdisc_client discovery;
@@ -122,6 +124,12 @@ struct peerdist_block {
 	unsigned long started;
 	/** Time at which most recent attempt was started */
 	unsigned long attempted;
+	/** Time at which most recent retrieval protocol attempt was started
+	 *
+	 * This is recorded regardless of whether or not profiling is
+	 * enabled, since it is used to maintain per-peer statistics.
+	 */
+	unsigned long retrieved;
 };
 
 /** Retrieval protocol block fetch response (including transport header)
@@ -15,6 +15,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/tables.h>
 #include <ipxe/retry.h>
 #include <ipxe/socket.h>
+#include <ipxe/in.h>
 #include <ipxe/interface.h>
 #include <ipxe/pccrc.h>
 
@@ -107,10 +108,39 @@ peerdisc_init ( struct peerdisc_client *peerdisc,
 	peerdisc->op = op;
 }
 
+/** PeerDist per-peer statistics */
+struct peerdisc_statistics {
+	/** List of per-peer statistics */
+	struct list_head list;
+	/** Number of blocks successfully retrieved */
+	unsigned int blocks;
+	/** Number of failed retrieval attempts */
+	unsigned int failures;
+	/** Total length of blocks successfully retrieved */
+	size_t bytes;
+	/** Total time taken to retrieve blocks (in ticks) */
+	unsigned long ticks;
+	/** Peer location */
+	char location[0];
+};
+
+/** Maximum number of peers for which statistics are retained */
+#define PEERDISC_MAX_STATISTICS 16
+
+extern struct list_head peerdisc_stats;
+
+/** Iterate over per-peer statistics, in order of most recent use */
+#define for_each_peerdisc_statistics( stats ) \
+	list_for_each_entry ( (stats), &peerdisc_stats, list )
+
 extern unsigned int peerdisc_timeout_secs;
 
 extern int peerdisc_open ( struct peerdisc_client *peerdisc, const void *id,
 			   size_t len );
 extern void peerdisc_close ( struct peerdisc_client *peerdisc );
+extern struct peerdisc_statistics *
+peerdisc_statistics ( const char *location );
+extern void peerdisc_record ( const char *location, size_t len,
+			      unsigned long ticks, int rc );
 
 #endif /* _IPXE_PEERDISC_H */
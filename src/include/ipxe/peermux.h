@@ -17,10 +17,43 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/uri.h>
 #include <ipxe/xferbuf.h>
 #include <ipxe/pccrc.h>
+#include <ipxe/peerdisc.h>
 
 /** Maximum number of concurrent block downloads */
 #define PEERMUX_MAX_BLOCKS 32
 
+/** Initial number of concurrent block downloads */
+#define PEERMUX_INITIAL_BLOCKS 4
+
+/** PeerDist download concurrency controller
+ *
+ * The number of concurrent block downloads is adjusted once per
+ * "round", i.e. each time that a number of block downloads equal to
+ * the current concurrency limit has completed.
+ *
+ * The limit is initially doubled after each round, until the first
+ * decrease in throughput is observed.  The limit then reverts to its
+ * previous value, and thereafter moves by one in each round: in the
+ * same direction as the previous adjustment if throughput did not
+ * decrease, or in the opposite direction if throughput decreased.
+ */
+struct peerdist_concurrency {
+	/** Maximum number of concurrent block downloads */
+	unsigned int limit;
+	/** Limit is still growing exponentially */
+	int slow_start;
+	/** Direction of most recent adjustment (+1 or -1) */
+	int direction;
+	/** Number of block downloads completed during this round */
+	unsigned int completed;
+	/** Number of bytes received during this round */
+	size_t bytes;
+	/** Time at which this round started */
+	unsigned long started;
+	/** Throughput during previous round (in bytes per tick) */
+	unsigned long rate;
+};
+
 /** PeerDist download content information cache */
 struct peerdist_info_cache {
 	/** Content information */
@@ -63,10 +96,23 @@ struct peerdist_multiplexer {
 	struct list_head busy;
 	/** List of idle block downloads */
 	struct list_head idle;
+	/** Number of busy block downloads */
+	unsigned int active;
+	/** Concurrency controller */
+	struct peerdist_concurrency concurrency;
 	/** Block downloads */
 	struct peerdist_multiplexed_block block[PEERMUX_MAX_BLOCKS];
+
+	/** Discovery client for upcoming segment */
+	struct peerdisc_client discovery;
+	/** Index of upcoming segment (if discovery is open) */
+	unsigned int upcoming;
 };
 
+extern void peermux_concurrency_init ( struct peerdist_concurrency *conc,
+				       unsigned long now );
+extern void peermux_concurrency_update ( struct peerdist_concurrency *conc,
+					 unsigned long now );
 extern int peermux_filter ( struct interface *xfer, struct interface *info,
 			    struct uri *uri );
 
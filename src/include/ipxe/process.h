@@ -25,6 +25,16 @@ struct process {
 	 * this field may be NULL.
 	 */
 	struct refcnt *refcnt;
+	/** Process is idle (i.e. waiting to be woken) */
+	int idle;
+	/** Idle process will be woken automatically at its wake time */
+	int sleeping;
+	/** Time at which to wake sleeping process */
+	unsigned long wake;
+	/** Number of steps executed */
+	unsigned long steps;
+	/** Time spent executing steps (in profiling timestamp units) */
+	unsigned long cycles;
 };
 
 /** A process descriptor */
@@ -41,6 +51,8 @@ struct process_descriptor {
 	void ( * step ) ( void *object );
 	/** Automatically reschedule the process */
 	int reschedule;
+	/** Name (for statistics reporting) */
+	const char *name;
 };
 
 /**
@@ -81,6 +93,7 @@ struct process_descriptor {
 		.offset = process_offset ( object_type, process ),	      \
 		.step = PROC_STEP ( object_type, _step ),		      \
 		.reschedule = 1,					      \
+		.name = #_step,					      \
 	}
 
 /**
@@ -95,6 +108,7 @@ struct process_descriptor {
 		.offset = process_offset ( object_type, process ),	      \
 		.step = PROC_STEP ( object_type, _step ),		      \
 		.reschedule = 0,					      \
+		.name = #_step,					      \
 	}
 
 /**
@@ -109,13 +123,19 @@ struct process_descriptor {
 		.offset = 0,						      \
 		.step = PROC_STEP ( struct process, _step ),		      \
 		.reschedule = 1,					      \
+		.name = #_step,					      \
 	}
 
 extern void * __attribute__ (( pure ))
 process_object ( struct process *process );
 extern void process_add ( struct process *process );
 extern void process_del ( struct process *process );
+extern void process_idle ( struct process *process );
+extern void process_sleep ( struct process *process, unsigned long timeout );
+extern void process_wake ( struct process *process );
+extern void process_for_each ( void ( * visit ) ( struct process *process ) );
 extern void step ( void );
+extern void process_nap ( void );
 
 /**
  * Initialise process without adding to process list
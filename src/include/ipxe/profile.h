@@ -18,6 +18,15 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define PROFILING 1
 #endif
 
+/** Number of profiling histogram buckets
+ *
+ * Samples are counted in logarithmically-sized buckets: bucket N
+ * counts samples for which flsl(sample)==N (i.e. samples in the
+ * range [2^(N-1),2^N)).  The final bucket also counts all larger
+ * samples.
+ */
+#define PROFILE_BUCKETS 32
+
 /**
  * A data structure for storing profiling information
  */
@@ -46,6 +55,12 @@ struct profiler {
 	 * (i.e. one less than would be returned by flsll(raw_accvar)).
 	 */
 	unsigned int accvar_msb;
+	/** Minimum sample value */
+	unsigned long min;
+	/** Maximum sample value */
+	unsigned long max;
+	/** Sample histogram */
+	unsigned int buckets[PROFILE_BUCKETS];
 };
 
 /** Profiler table */
@@ -64,6 +79,9 @@ extern void profile_update ( struct profiler *profiler, unsigned long sample );
 extern unsigned long profile_mean ( struct profiler *profiler );
 extern unsigned long profile_variance ( struct profiler *profiler );
 extern unsigned long profile_stddev ( struct profiler *profiler );
+extern unsigned long profile_percentile ( struct profiler *profiler,
+					  unsigned int percent );
+extern void profile_reset ( struct profiler *profiler );
 
 /**
  * Get start time
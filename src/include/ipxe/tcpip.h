@@ -170,6 +170,25 @@ struct tcpip_net_protocol {
 	struct net_device * ( * netdev ) ( struct sockaddr_tcpip *dest );
 };
 
+/** Number of local port hash buckets
+ *
+ * This must be a power of two.
+ */
+#define TCPIP_PORT_HASH_SIZE 64
+
+/**
+ * Calculate local port hash bucket
+ *
+ * @v port		Local port (in host byte order)
+ * @ret bucket		Hash bucket index
+ */
+static inline __attribute__ (( always_inline )) unsigned int
+tcpip_port_hash ( unsigned int port ) {
+
+	return ( ( port ^ ( port >> 6 ) ^ ( port >> 12 ) ) &
+		 ( TCPIP_PORT_HASH_SIZE - 1 ) );
+}
+
 /** TCP/IP transport-layer protocol table */
 #define TCPIP_PROTOCOLS __table ( struct tcpip_protocol, "tcpip_protocols" )
 
@@ -198,6 +217,13 @@ extern size_t tcpip_mtu ( struct sockaddr_tcpip *st_dest );
 extern uint16_t generic_tcpip_continue_chksum ( uint16_t partial,
 						const void *data, size_t len );
 extern uint16_t tcpip_chksum ( const void *data, size_t len );
+extern void tcpip_tx_chksum ( struct io_buffer *iobuf,
+			      struct tcpip_protocol *tcpip_protocol,
+			      struct net_device *netdev,
+			      uint16_t *trans_csum );
+extern uint16_t tcpip_rx_chksum ( struct io_buffer *iobuf,
+				  struct net_device *netdev,
+				  uint16_t pshdr_csum, size_t len );
 extern int tcpip_bind ( struct sockaddr_tcpip *st_local,
 			int ( * available ) ( int port ) );
 
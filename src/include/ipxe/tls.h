@@ -70,6 +70,7 @@ struct tls_header {
 #define TLS_CERTIFICATE_VERIFY 15
 #define TLS_CLIENT_KEY_EXCHANGE 16
 #define TLS_FINISHED 20
+#define TLS_CERTIFICATE_STATUS 22
 
 /* TLS alert levels */
 #define TLS_ALERT_WARNING 1
@@ -105,6 +106,10 @@ struct tls_header {
 #define TLS_MAX_FRAGMENT_LENGTH_2048 3
 #define TLS_MAX_FRAGMENT_LENGTH_4096 4
 
+/* TLS certificate status request extension */
+#define TLS_STATUS_REQUEST 5
+#define TLS_STATUS_REQUEST_OCSP 1
+
 /* TLS signature algorithms extension */
 #define TLS_SIGNATURE_ALGORITHMS 13
 
@@ -274,6 +279,10 @@ struct tls_session {
 
 	/** Server certificate chain */
 	struct x509_chain *chain;
+	/** Stapled OCSP response for server certificate (if any) */
+	void *stapled;
+	/** Length of stapled OCSP response */
+	size_t stapled_len;
 	/** Certificate validator */
 	struct interface validator;
 
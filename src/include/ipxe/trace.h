@@ -0,0 +1,95 @@
+#ifndef _IPXE_TRACE_H
+#define _IPXE_TRACE_H
+
+/** @file
+ *
+ * Event tracing
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <config/trace.h>
+
+/** A trace event */
+struct trace_event {
+	/** Timestamp (in profiling timestamp units) */
+	uint64_t timestamp;
+	/** Object to which the event relates */
+	void *object;
+	/** Event-specific data */
+	unsigned long data;
+	/** Event type */
+	unsigned int type;
+};
+
+/** Network device transmitted packet (data is packet length) */
+#define TRACE_NETDEV_TX 0
+
+/** Network device received packet (data is packet length) */
+#define TRACE_NETDEV_RX 1
+
+/** TCP connection changed state (data is new state) */
+#define TRACE_TCP_STATE 2
+
+/** TCP connection retransmitted (data is sequence number) */
+#define TRACE_TCP_RETRANSMIT 3
+
+/** TLS handshake started */
+#define TRACE_TLS_START 4
+
+/** TLS handshake record received (data is handshake type) */
+#define TRACE_TLS_HANDSHAKE 5
+
+/** TLS handshake completed or abandoned (data is status code) */
+#define TRACE_TLS_READY 6
+
+/** HTTP request sent */
+#define TRACE_HTTP_REQUEST 7
+
+/** HTTP response headers received (data is status code) */
+#define TRACE_HTTP_RESPONSE 8
+
+/** HTTP request completed or abandoned (data is status code) */
+#define TRACE_HTTP_CLOSE 9
+
+/** DNS request started */
+#define TRACE_DNS_START 10
+
+/** DNS request completed (data is status code) */
+#define TRACE_DNS_DONE 11
+
+/** Image download started */
+#define TRACE_IMAGE_START 12
+
+/** Image download completed (data is status code) */
+#define TRACE_IMAGE_DONE 13
+
+/** Number of trace event types */
+#define TRACE_NUM_TYPES 14
+
+extern struct trace_event trace_events[];
+extern unsigned int trace_count;
+
+extern void trace_record ( unsigned int type, void *object,
+			   unsigned long data );
+
+/**
+ * Record trace event
+ *
+ * @v type		Event type
+ * @v object		Object to which the event relates
+ * @v data		Event-specific data
+ */
+static inline __attribute__ (( always_inline )) void
+trace ( unsigned int type, void *object, unsigned long data ) {
+
+	/* Force dead code elimination in non-tracing builds */
+	if ( ! TRACE_EVENTS )
+		return;
+
+	trace_record ( type, object, data );
+}
+
+#endif /* _IPXE_TRACE_H */
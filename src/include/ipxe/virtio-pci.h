@@ -1,6 +1,11 @@
 #ifndef _VIRTIO_PCI_H_
 # define _VIRTIO_PCI_H_
 
+#include <unistd.h>
+#include <byteswap.h>
+#include <ipxe/io.h>
+#include <ipxe/pci.h>
+
 /* A 32-bit r/o bitmask of the features supported by the host */
 #define VIRTIO_PCI_HOST_FEATURES        0
 
@@ -37,6 +42,82 @@
 /* Virtio ABI version, this must match exactly */
 #define VIRTIO_PCI_ABI_VERSION          0
 
+/* PCI capability types: */
+#define VIRTIO_PCI_CAP_COMMON_CFG       1  /* Common configuration */
+#define VIRTIO_PCI_CAP_NOTIFY_CFG       2  /* Notifications */
+#define VIRTIO_PCI_CAP_ISR_CFG          3  /* ISR access */
+#define VIRTIO_PCI_CAP_DEVICE_CFG       4  /* Device specific configuration */
+#define VIRTIO_PCI_CAP_PCI_CFG          5  /* PCI configuration access */
+
+/* Offsets of fields within a virtio PCI capability */
+#define VIRTIO_PCI_CAP_VNDR            0  /* Generic PCI field: PCI_CAP_ID_VNDR */
+#define VIRTIO_PCI_CAP_NEXT            1  /* Generic PCI field: next ptr */
+#define VIRTIO_PCI_CAP_LEN             2  /* Generic PCI field: capability length */
+#define VIRTIO_PCI_CAP_CFG_TYPE        3  /* Identifies the structure */
+#define VIRTIO_PCI_CAP_BAR             4  /* Where to find it */
+#define VIRTIO_PCI_CAP_OFFSET          8  /* Offset within bar */
+#define VIRTIO_PCI_CAP_LENGTH         12  /* Length of the structure, in bytes */
+#define VIRTIO_PCI_NOTIFY_CAP_MULT    16  /* Multiplier for queue_notify_off */
+
+/* Fields in VIRTIO_PCI_CAP_COMMON_CFG: */
+struct virtio_pci_common_cfg {
+   /* About the whole device */
+   u32 device_feature_select; /* read-write */
+   u32 device_feature;        /* read-only */
+   u32 guest_feature_select;  /* read-write */
+   u32 guest_feature;         /* read-write */
+   u16 msix_config;           /* read-write */
+   u16 num_queues;            /* read-only */
+   u8 device_status;          /* read-write */
+   u8 config_generation;      /* read-only */
+
+   /* About a specific virtqueue */
+   u16 queue_select;          /* read-write */
+   u16 queue_size;            /* read-write, power of 2 */
+   u16 queue_msix_vector;     /* read-write */
+   u16 queue_enable;          /* read-write */
+   u16 queue_notify_off;      /* read-only */
+   u32 queue_desc_lo;         /* read-write */
+   u32 queue_desc_hi;         /* read-write */
+   u32 queue_avail_lo;        /* read-write */
+   u32 queue_avail_hi;        /* read-write */
+   u32 queue_used_lo;         /* read-write */
+   u32 queue_used_hi;         /* read-write */
+} __attribute__ (( packed ));
+
+/* Virtio 1.0 PCI region descriptor. We support memory mapped I/O and port
+ * I/O regions. */
+struct virtio_pci_region {
+   void *base;
+   size_t length;
+   u8 bar;
+
+/* How to interpret the base field */
+#define VIRTIO_PCI_REGION_TYPE_MASK  0x00000003
+/* The base field is a memory address */
+#define VIRTIO_PCI_REGION_MEMORY     0x00000001
+/* The base field is a port address */
+#define VIRTIO_PCI_REGION_PORT       0x00000002
+   unsigned flags;
+};
+
+/* Virtio 1.0 device state */
+struct virtio_pci_modern_device {
+   struct pci_device *pci;
+
+   /* Position of the VIRTIO_PCI_CAP_NOTIFY_CFG capability */
+   int notify_cap_pos;
+
+   /* Common configuration region */
+   struct virtio_pci_region common;
+
+   /* Device-specific configuration region */
+   struct virtio_pci_region device;
+
+   /* ISR access region */
+   struct virtio_pci_region isr;
+};
+
 static inline u32 vp_get_features(unsigned int ioaddr)
 {
    return inl(ioaddr + VIRTIO_PCI_HOST_FEATURES);
@@ -96,6 +177,188 @@ static inline void vp_del_vq(unsigned int ioaddr, int queue_index)
    outl(0, ioaddr + VIRTIO_PCI_QUEUE_PFN);
 }
 
+struct vring_virtqueue;
+
+void vp_free_vq(struct vring_virtqueue *vq);
 int vp_find_vq(unsigned int ioaddr, int queue_index,
                struct vring_virtqueue *vq);
+
+
+/* Virtio 1.0 I/O routines abstract away the three possible HW access
+ * mechanisms - memory and port I/O. */
+static inline u8 vpm_ioread8(struct virtio_pci_modern_device *vdev __unused,
+                             struct virtio_pci_region *region, size_t offset)
+{
+   switch (region->flags & VIRTIO_PCI_REGION_TYPE_MASK) {
+   case VIRTIO_PCI_REGION_MEMORY:
+      return readb(region->base + offset);
+   case VIRTIO_PCI_REGION_PORT:
+      return inb(region->base + offset);
+   default:
+      return 0xff;
+   }
+}
+
+static inline u16 vpm_ioread16(struct virtio_pci_modern_device *vdev __unused,
+                               struct virtio_pci_region *region, size_t offset)
+{
+   switch (region->flags & VIRTIO_PCI_REGION_TYPE_MASK) {
+   case VIRTIO_PCI_REGION_MEMORY:
+      return le16_to_cpu(readw(region->base + offset));
+   case VIRTIO_PCI_REGION_PORT:
+      return le16_to_cpu(inw(region->base + offset));
+   default:
+      return 0xffff;
+   }
+}
+
+static inline u32 vpm_ioread32(struct virtio_pci_modern_device *vdev __unused,
+                               struct virtio_pci_region *region, size_t offset)
+{
+   switch (region->flags & VIRTIO_PCI_REGION_TYPE_MASK) {
+   case VIRTIO_PCI_REGION_MEMORY:
+      return le32_to_cpu(readl(region->base + offset));
+   case VIRTIO_PCI_REGION_PORT:
+      return le32_to_cpu(inl(region->base + offset));
+   default:
+      return 0xffffffff;
+   }
+}
+
+static inline void vpm_iowrite8(struct virtio_pci_modern_device *vdev __unused,
+                                struct virtio_pci_region *region,
+                                u8 data, size_t offset)
+{
+   switch (region->flags & VIRTIO_PCI_REGION_TYPE_MASK) {
+   case VIRTIO_PCI_REGION_MEMORY:
+      writeb(data, region->base + offset);
+      break;
+   case VIRTIO_PCI_REGION_PORT:
+      outb(data, region->base + offset);
+      break;
+   }
+}
+
+static inline void vpm_iowrite16(struct virtio_pci_modern_device *vdev __unused,
+                                 struct virtio_pci_region *region,
+                                 u16 data, size_t offset)
+{
+   data = cpu_to_le16(data);
+   switch (region->flags & VIRTIO_PCI_REGION_TYPE_MASK) {
+   case VIRTIO_PCI_REGION_MEMORY:
+      writew(data, region->base + offset);
+      break;
+   case VIRTIO_PCI_REGION_PORT:
+      outw(data, region->base + offset);
+      break;
+   }
+}
+
+static inline void vpm_iowrite32(struct virtio_pci_modern_device *vdev __unused,
+                                 struct virtio_pci_region *region,
+                                 u32 data, size_t offset)
+{
+   data = cpu_to_le32(data);
+   switch (region->flags & VIRTIO_PCI_REGION_TYPE_MASK) {
+   case VIRTIO_PCI_REGION_MEMORY:
+      writel(data, region->base + offset);
+      break;
+   case VIRTIO_PCI_REGION_PORT:
+      outl(data, region->base + offset);
+      break;
+   }
+}
+
+static inline void vpm_iowrite64(struct virtio_pci_modern_device *vdev,
+                                 struct virtio_pci_region *region,
+                                 u64 data, size_t offset_lo, size_t offset_hi)
+{
+   vpm_iowrite32(vdev, region, (u32)data, offset_lo);
+   vpm_iowrite32(vdev, region, data >> 32, offset_hi);
+}
+
+#define COMMON_OFFSET(field) offsetof(struct virtio_pci_common_cfg, field)
+
+/* Virtio 1.0 device manipulation routines */
+static inline void vpm_reset(struct virtio_pci_modern_device *vdev)
+{
+   vpm_iowrite8(vdev, &vdev->common, 0, COMMON_OFFSET(device_status));
+   while (vpm_ioread8(vdev, &vdev->common, COMMON_OFFSET(device_status)))
+      mdelay(1);
+}
+
+static inline u8 vpm_get_status(struct virtio_pci_modern_device *vdev)
+{
+   return vpm_ioread8(vdev, &vdev->common, COMMON_OFFSET(device_status));
+}
+
+static inline void vpm_add_status(struct virtio_pci_modern_device *vdev,
+                                  u8 status)
+{
+   u8 curr_status = vpm_ioread8(vdev, &vdev->common,
+                                COMMON_OFFSET(device_status));
+   vpm_iowrite8(vdev, &vdev->common, curr_status | status,
+                COMMON_OFFSET(device_status));
+}
+
+static inline u64 vpm_get_features(struct virtio_pci_modern_device *vdev)
+{
+   u32 features_lo, features_hi;
+
+   vpm_iowrite32(vdev, &vdev->common, 0,
+                 COMMON_OFFSET(device_feature_select));
+   features_lo = vpm_ioread32(vdev, &vdev->common,
+                              COMMON_OFFSET(device_feature));
+   vpm_iowrite32(vdev, &vdev->common, 1,
+                 COMMON_OFFSET(device_feature_select));
+   features_hi = vpm_ioread32(vdev, &vdev->common,
+                              COMMON_OFFSET(device_feature));
+
+   return ((u64)features_hi << 32) | features_lo;
+}
+
+static inline void vpm_set_features(struct virtio_pci_modern_device *vdev,
+                                    u64 features)
+{
+   u32 features_lo = (u32)features;
+   u32 features_hi = features >> 32;
+
+   vpm_iowrite32(vdev, &vdev->common, 0,
+                 COMMON_OFFSET(guest_feature_select));
+   vpm_iowrite32(vdev, &vdev->common, features_lo,
+                 COMMON_OFFSET(guest_feature));
+   vpm_iowrite32(vdev, &vdev->common, 1,
+                 COMMON_OFFSET(guest_feature_select));
+   vpm_iowrite32(vdev, &vdev->common, features_hi,
+                 COMMON_OFFSET(guest_feature));
+}
+
+static inline void vpm_get(struct virtio_pci_modern_device *vdev,
+                           unsigned offset, void *buf, unsigned len)
+{
+   u8 *ptr = buf;
+   unsigned i;
+
+   for (i = 0; i < len; i++)
+      ptr[i] = vpm_ioread8(vdev, &vdev->device, offset + i);
+}
+
+static inline u8 vpm_get_isr(struct virtio_pci_modern_device *vdev)
+{
+   return vpm_ioread8(vdev, &vdev->isr, 0);
+}
+
+void vpm_notify(struct virtio_pci_modern_device *vdev,
+                struct vring_virtqueue *vq);
+
+int vpm_find_vqs(struct virtio_pci_modern_device *vdev,
+                 unsigned nvqs, struct vring_virtqueue *vqs);
+
+int virtio_pci_find_capability(struct pci_device *pci, uint8_t cfg_type);
+
+int virtio_pci_map_capability(struct pci_device *pci, int cap, size_t minlen,
+                              u32 align, u32 start, u32 size,
+                              struct virtio_pci_region *region);
+
+void virtio_pci_unmap_capability(struct virtio_pci_region *region);
 #endif /* _VIRTIO_PCI_H_ */
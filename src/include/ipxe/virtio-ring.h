@@ -1,6 +1,8 @@
 #ifndef _VIRTIO_RING_H_
 # define _VIRTIO_RING_H_
 
+#include <ipxe/virtio-pci.h>
+
 /* Status byte for guest to report progress, and synchronize features. */
 /* We have seen device and processed generic fields (VIRTIO_CONFIG_F_VIRTIO) */
 #define VIRTIO_CONFIG_S_ACKNOWLEDGE     1
@@ -8,9 +10,23 @@
 #define VIRTIO_CONFIG_S_DRIVER          2
 /* Driver has used its parts of the config, and is happy */
 #define VIRTIO_CONFIG_S_DRIVER_OK       4
+/* Driver has finished configuring features */
+#define VIRTIO_CONFIG_S_FEATURES_OK     8
 /* We've given up on this device. */
 #define VIRTIO_CONFIG_S_FAILED          0x80
 
+/* Virtio feature flags used to negotiate device and driver features. */
+/* Can the device handle any descriptor layout? */
+#define VIRTIO_F_ANY_LAYOUT             27
+/* The Guest publishes the used index for which it expects an interrupt
+ * at the end of the avail ring. Host should ignore the avail->flags field. */
+/* The Host publishes the avail index for which it expects a kick
+ * at the end of the used ring. Guest should ignore the used->flags field. */
+#define VIRTIO_RING_F_EVENT_IDX         29
+/* v1.0 compliant. */
+#define VIRTIO_F_VERSION_1              32
+
+/* Largest queue size that we will request from a virtio 1.0 device */
 #define MAX_QUEUE_NUM      (256)
 
 #define VRING_DESC_F_NEXT  1
@@ -55,22 +71,30 @@ struct vring {
    struct vring_used *used;
 };
 
+/* The avail ring is followed by the used event index, and the used
+ * ring is followed by the avail event index. */
 #define vring_size(num) \
    (((((sizeof(struct vring_desc) * num) + \
-      (sizeof(struct vring_avail) + sizeof(u16) * num)) \
+      (sizeof(struct vring_avail) + sizeof(u16) * (num + 1))) \
          + PAGE_MASK) & ~PAGE_MASK) + \
-         (sizeof(struct vring_used) + sizeof(struct vring_used_elem) * num))
+         (sizeof(struct vring_used) + sizeof(struct vring_used_elem) * num + \
+          sizeof(u16)))
 
-typedef unsigned char virtio_queue_t[PAGE_MASK + vring_size(MAX_QUEUE_NUM)];
+#define vring_used_event(vr) ((vr)->avail->ring[(vr)->num])
+#define vring_avail_event(vr) (*(u16 *)((vr)->used->ring + (vr)->num))
 
 struct vring_virtqueue {
-   virtio_queue_t queue;
+   unsigned char *queue;
+   size_t queue_size;
    struct vring vring;
    u16 free_head;
    u16 last_used_idx;
-   void *vdata[MAX_QUEUE_NUM];
+   void **vdata;
+   /* Event index notification suppression is in use */
+   int event;
    /* PCI */
    int queue_index;
+   struct virtio_pci_region notification;
 };
 
 struct vring_list {
@@ -96,7 +120,7 @@ static inline void vring_init(struct vring *vr,
 
    /* physical address of used must be page aligned */
 
-   pa = virt_to_phys(&vr->avail->ring[num]);
+   pa = virt_to_phys(&vr->avail->ring[num + 1]);
    pa = (pa + PAGE_MASK) & ~PAGE_MASK;
         vr->used = phys_to_virt(pa);
 
@@ -108,11 +132,27 @@ static inline void vring_init(struct vring *vr,
 static inline void vring_enable_cb(struct vring_virtqueue *vq)
 {
    vq->vring.avail->flags &= ~VRING_AVAIL_F_NO_INTERRUPT;
+   if (vq->event)
+           vring_used_event(&vq->vring) = vq->last_used_idx;
 }
 
 static inline void vring_disable_cb(struct vring_virtqueue *vq)
 {
    vq->vring.avail->flags |= VRING_AVAIL_F_NO_INTERRUPT;
+   if (vq->event)
+           vring_used_event(&vq->vring) = vq->last_used_idx - 1;
+}
+
+/*
+ * vring_need_event
+ *
+ * has the index moved past the event index ?
+ *
+ */
+
+static inline int vring_need_event(u16 event_idx, u16 new_idx, u16 old_idx)
+{
+   return (u16)(new_idx - event_idx - 1) < (u16)(new_idx - old_idx);
 }
 
 
@@ -134,6 +174,7 @@ void *vring_get_buf(struct vring_virtqueue *vq, unsigned int *len);
 void vring_add_buf(struct vring_virtqueue *vq, struct vring_list list[],
                    unsigned int out, unsigned int in,
                    void *index, int num_added);
-void vring_kick(unsigned int ioaddr, struct vring_virtqueue *vq, int num_added);
+void vring_kick(struct virtio_pci_modern_device *vdev, unsigned int ioaddr,
+                struct vring_virtqueue *vq, int num_added);
 
 #endif /* _VIRTIO_RING_H_ */
@@ -128,6 +128,8 @@ struct x509_ocsp_responder {
 	struct asn1_cursor uri;
 	/** OCSP status is good */
 	int good;
+	/** Time at which OCSP status ceases to be valid */
+	time_t expiry;
 };
 
 /** X.509 certificate authority information access */
@@ -186,6 +188,10 @@ struct x509_certificate {
 
 	/** Link in certificate store */
 	struct x509_link store;
+	/** Link in certificate store raw certificate index */
+	struct list_head store_raw;
+	/** Link in certificate store subject index */
+	struct list_head store_subject;
 
 	/** Certificate has been validated */
 	int valid;
@@ -338,6 +344,21 @@ struct x509_root {
 	const void *fingerprints;
 };
 
+/** Maximum number of entries in the validated certificate cache */
+#define X509_CACHE_MAX 16
+
+/** X.509 validated certificate cache statistics */
+struct x509_cache_statistics {
+	/** Number of cached entries */
+	unsigned int entries;
+	/** Number of cache hits */
+	unsigned int hits;
+	/** Number of cache misses */
+	unsigned int misses;
+};
+
+extern struct x509_cache_statistics x509_cache_stats;
+
 extern const char * x509_name ( struct x509_certificate *cert );
 extern int x509_parse ( struct x509_certificate *cert,
 			const struct asn1_cursor *raw );
@@ -368,16 +389,7 @@ extern void x509_fingerprint ( struct x509_certificate *cert,
 extern int x509_check_root ( struct x509_certificate *cert,
 			     struct x509_root *root );
 extern int x509_check_time ( struct x509_certificate *cert, time_t time );
-
-/**
- * Invalidate X.509 certificate
- *
- * @v cert		X.509 certificate
- */
-static inline void x509_invalidate ( struct x509_certificate *cert ) {
-	cert->valid = 0;
-	cert->path_remaining = 0;
-}
+extern void x509_invalidate ( struct x509_certificate *cert );
 
 /**
  * Invalidate X.509 certificate chain
@@ -0,0 +1,14 @@
+#ifndef _USR_CERTMGMT_H
+#define _USR_CERTMGMT_H
+
+/** @file
+ *
+ * Certificate management
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+extern void certstat ( void );
+
+#endif /* _USR_CERTMGMT_H */
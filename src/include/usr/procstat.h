@@ -0,0 +1,14 @@
+#ifndef _USR_PROCSTAT_H
+#define _USR_PROCSTAT_H
+
+/** @file
+ *
+ * Process statistics
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+extern void procstat ( void );
+
+#endif /* _USR_PROCSTAT_H */
@@ -9,6 +9,10 @@
 
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
+struct parameters;
+
 extern void profstat ( void );
+extern void profstat_reset ( void );
+extern int profstat_export ( struct parameters *params );
 
 #endif /* _USR_PROFSTAT_H */
@@ -0,0 +1,15 @@
+#ifndef _USR_TRACEDUMP_H
+#define _USR_TRACEDUMP_H
+
+/** @file
+ *
+ * Event tracing
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+extern void tracedump ( void );
+extern void tracedump_reset ( void );
+
+#endif /* _USR_TRACEDUMP_H */
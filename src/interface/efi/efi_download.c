@@ -25,6 +25,8 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/process.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/xfer.h>
+#include <ipxe/list.h>
+#include <ipxe/timer.h>
 #include <ipxe/efi/efi.h>
 #include <ipxe/efi/efi_snp.h>
 #include <ipxe/efi/efi_download.h>
@@ -33,13 +35,29 @@ FILE_LICENCE ( GPL2_OR_LATER );
 static EFI_GUID ipxe_download_protocol_guid
 	= IPXE_DOWNLOAD_PROTOCOL_GUID;
 
+/** Maximum length of data to coalesce into a single data callback
+ *
+ * This is a policy decision.
+ */
+#define EFI_DOWNLOAD_BATCH_LEN ( 64 * 1024 )
+
+/** Maximum time to spend processing pending work within a single poll
+ *
+ * This is a policy decision.
+ */
+#define EFI_DOWNLOAD_POLL_MAX_TICKS ( TICKS_PER_SEC / 50 )
+
 /** A single in-progress file */
 struct efi_download_file {
+	/** List of in-progress files */
+	struct list_head list;
 	/** Data transfer interface that provides downloaded data */
 	struct interface xfer;
 
-	/** Current file position */
+	/** Current file position (including any coalesced data) */
 	size_t pos;
+	/** Coalesced data not yet passed to the data callback, if any */
+	struct io_buffer *batch;
 
 	/** Data callback */
 	IPXE_DOWNLOAD_DATA_CALLBACK data_callback;
@@ -51,6 +69,71 @@ struct efi_download_file {
 	void *context;
 };
 
+/** List of in-progress files */
+static LIST_HEAD ( efi_download_files );
+
+/** Number of data callbacks invoked */
+static unsigned int efi_download_callbacks;
+
+/**
+ * Pass data to the data callback
+ *
+ * @v file		Data transfer file
+ * @v data		Data
+ * @v len		Length of data
+ * @v pos		File position
+ * @ret rc		Return status code
+ */
+static int efi_download_callback ( struct efi_download_file *file,
+				   void *data, size_t len, size_t pos ) {
+	EFI_STATUS efirc;
+
+	/* Call out to the data handler */
+	efi_download_callbacks++;
+	if ( ( efirc = file->data_callback ( file->context, data,
+					     len, pos ) ) != 0 )
+		return -EEFI ( efirc );
+
+	return 0;
+}
+
+/**
+ * Pass any coalesced data to the data callback
+ *
+ * @v file		Data transfer file
+ * @ret rc		Return status code
+ */
+static int efi_download_flush ( struct efi_download_file *file ) {
+	struct io_buffer *batch = file->batch;
+	size_t len;
+
+	/* Do nothing unless there is coalesced data */
+	if ( ! batch )
+		return 0;
+	len = iob_len ( batch );
+	if ( ! len )
+		return 0;
+	iob_empty ( batch );
+
+	return efi_download_callback ( file, batch->data, len,
+				       ( file->pos - len ) );
+}
+
+/**
+ * Find in-progress file with coalesced data
+ *
+ * @ret file		Data transfer file, or NULL
+ */
+static struct efi_download_file * efi_download_pending ( void ) {
+	struct efi_download_file *file;
+
+	list_for_each_entry ( file, &efi_download_files, list ) {
+		if ( file->batch && iob_len ( file->batch ) )
+			return file;
+	}
+	return NULL;
+}
+
 /* xfer interface */
 
 /**
@@ -61,6 +144,15 @@ struct efi_download_file {
  */
 static void efi_download_close ( struct efi_download_file *file, int rc ) {
 
+	/* Pass any remaining coalesced data to the data callback,
+	 * unless the transfer has failed.
+	 */
+	if ( rc == 0 )
+		rc = efi_download_flush ( file );
+	free_iob ( file->batch );
+	file->batch = NULL;
+	list_del ( &file->list );
+
 	file->finish_callback ( file->context, EFIRC ( rc ) );
 
 	intf_shutdown ( &file->xfer, rc );
@@ -75,24 +167,48 @@ static void efi_download_close ( struct efi_download_file *file, int rc ) {
  * @v iobuf		I/O buffer
  * @v meta		Data transfer metadata
  * @ret rc		Return status code
+ *
+ * Contiguous data is coalesced into batches of up to
+ * EFI_DOWNLOAD_BATCH_LEN bytes, to reduce the number of data
+ * callbacks.  Data is passed to the data callback when a batch is
+ * full, when the file position changes, when the download finishes,
+ * or at the end of the next call to efi_download_poll().
  */
 static int efi_download_deliver_iob ( struct efi_download_file *file,
 				      struct io_buffer *iobuf,
 				      struct xfer_metadata *meta ) {
-	EFI_STATUS efirc;
+	struct io_buffer *batch;
 	size_t len = iob_len ( iobuf );
 	int rc;
 
+	/* Pass coalesced data to the data callback if the new data
+	 * is not contiguous, or would not fit.
+	 */
+	if ( ( meta->flags & XFER_FL_ABS_OFFSET ) || meta->offset ||
+	     ( file->batch && ( len > iob_tailroom ( file->batch ) ) ) ) {
+		if ( ( rc = efi_download_flush ( file ) ) != 0 )
+			goto err_flush;
+	}
+
 	/* Calculate new buffer position */
 	if ( meta->flags & XFER_FL_ABS_OFFSET )
 		file->pos = 0;
 	file->pos += meta->offset;
 
-	/* Call out to the data handler */
-	if ( ( efirc = file->data_callback ( file->context, iobuf->data,
-					     len, file->pos ) ) != 0 ) {
-		rc = -EEFI ( efirc );
-		goto err_callback;
+	/* Allocate batch buffer, if applicable */
+	if ( ( ! file->batch ) && ( len < EFI_DOWNLOAD_BATCH_LEN ) )
+		file->batch = alloc_iob ( EFI_DOWNLOAD_BATCH_LEN );
+
+	/* Coalesce data if possible, otherwise pass it directly to
+	 * the data callback.
+	 */
+	batch = file->batch;
+	if ( batch && ( len <= iob_tailroom ( batch ) ) ) {
+		memcpy ( iob_put ( batch, len ), iobuf->data, len );
+	} else {
+		if ( ( rc = efi_download_callback ( file, iobuf->data, len,
+						    file->pos ) ) != 0 )
+			goto err_callback;
 	}
 
 	/* Update current buffer position */
@@ -102,6 +218,7 @@ static int efi_download_deliver_iob ( struct efi_download_file *file,
 	rc = 0;
 
  err_callback:
+ err_flush:
 	free_iob ( iobuf );
 	return rc;
 }
@@ -151,7 +268,9 @@ efi_download_start ( IPXE_DOWNLOAD_PROTOCOL *This __unused,
 	}
 
 	efi_snp_claim();
+	list_add_tail ( &file->list, &efi_download_files );
 	file->pos = 0;
+	file->batch = NULL;
 	file->data_callback = DataCallback;
 	file->finish_callback = FinishCallback;
 	file->context = Context;
@@ -185,10 +304,34 @@ efi_download_abort ( IPXE_DOWNLOAD_PROTOCOL *This __unused,
  *
  * @v This		iPXE Download Protocol instance
  * @ret Status		EFI status code
+ *
+ * Pending work is processed until a data callback has been invoked,
+ * or until EFI_DOWNLOAD_POLL_MAX_TICKS have elapsed.  Any remaining
+ * coalesced data is then passed to the data callback.
  */
 static EFI_STATUS EFIAPI
 efi_download_poll ( IPXE_DOWNLOAD_PROTOCOL *This __unused ) {
-	step();
+	struct efi_download_file *file;
+	unsigned int callbacks = efi_download_callbacks;
+	unsigned long start = currticks();
+	int rc;
+
+	/* Process pending work until a batch of data is delivered */
+	do {
+		step();
+	} while ( ( efi_download_callbacks == callbacks ) &&
+		  ( ! list_empty ( &efi_download_files ) ) &&
+		  ( ( currticks() - start ) < EFI_DOWNLOAD_POLL_MAX_TICKS ) );
+
+	/* Pass any remaining coalesced data to the data callbacks.
+	 * A data callback may abort any in-progress download, so
+	 * search the list afresh after each callback.
+	 */
+	while ( ( file = efi_download_pending() ) ) {
+		if ( ( rc = efi_download_flush ( file ) ) != 0 )
+			efi_download_close ( file, rc );
+	}
+
 	return EFI_SUCCESS;
 }
 
@@ -38,6 +38,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <errno.h>
 #include <wchar.h>
 #include <ipxe/image.h>
+#include <ipxe/image_index.h>
 #include <ipxe/efi/efi.h>
 #include <ipxe/efi/Protocol/SimpleFileSystem.h>
 #include <ipxe/efi/Protocol/BlockIo.h>
@@ -81,17 +82,10 @@ static const char * efi_file_name ( struct efi_file *file ) {
  */
 static struct image * efi_file_find ( const CHAR16 *wname ) {
 	char name[ wcslen ( wname ) + 1 /* NUL */ ];
-	struct image *image;
 
 	/* Find image */
 	snprintf ( name, sizeof ( name ), "%ls", wname );
-	list_for_each_entry ( image, &images, list ) {
-		if ( strcasecmp ( image->name, name ) == 0 )
-			return image;
-	}
-
-	return NULL;
-
+	return find_image_nocase ( name );
 }
 
 /**
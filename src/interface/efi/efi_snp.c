@@ -29,6 +29,8 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/in.h>
 #include <ipxe/version.h>
 #include <ipxe/console.h>
+#include <ipxe/timer.h>
+#include <ipxe/profile.h>
 #include <ipxe/efi/efi.h>
 #include <ipxe/efi/efi_driver.h>
 #include <ipxe/efi/efi_strings.h>
@@ -44,6 +46,18 @@ static LIST_HEAD ( efi_snp_devices );
 /** Network devices are currently claimed for use by iPXE */
 static int efi_snp_claimed;
 
+/** Network device poll profiler */
+static struct profiler efi_snp_poll_profiler __profiler =
+	{ .name = "snpdev.poll" };
+
+/** Transmit profiler */
+static struct profiler efi_snp_tx_profiler __profiler =
+	{ .name = "snpdev.tx" };
+
+/** Receive profiler */
+static struct profiler efi_snp_rx_profiler __profiler =
+	{ .name = "snpdev.rx" };
+
 /* Downgrade user experience if configured to do so
  *
  * The default UEFI user experience for network boot is somewhat
@@ -157,19 +171,33 @@ static void efi_snp_flush ( struct efi_snp_device *snpdev ) {
  * Poll net device and count received packets
  *
  * @v snpdev		SNP device
+ *
+ * The network device is polled no more often than EFI_SNP_POLL_RATE
+ * times per second.  Callers typically invoke the SNP receive and
+ * status methods in a tight loop, and polling the underlying hardware
+ * on every call would dominate the cost of each call.
  */
 static void efi_snp_poll ( struct efi_snp_device *snpdev ) {
 	EFI_BOOT_SERVICES *bs = efi_systab->BootServices;
 	struct io_buffer *iobuf;
+	unsigned long now;
+
+	/* Do nothing if the network device was polled too recently */
+	now = currticks();
+	if ( ( now - snpdev->polled ) < ( TICKS_PER_SEC / EFI_SNP_POLL_RATE ) )
+		return;
+	snpdev->polled = now;
 
 	/* Poll network device */
+	profile_start ( &efi_snp_poll_profiler );
 	netdev_poll ( snpdev->netdev );
+	profile_stop ( &efi_snp_poll_profiler );
 
 	/* Retrieve any received packets */
 	while ( ( iobuf = netdev_rx_dequeue ( snpdev->netdev ) ) ) {
 		list_add_tail ( &iobuf->list, &snpdev->rx );
 		snpdev->interrupts |= EFI_SIMPLE_NETWORK_RECEIVE_INTERRUPT;
-		bs->SignalEvent ( &snpdev->snp.WaitForPacket );
+		bs->SignalEvent ( snpdev->snp.WaitForPacket );
 	}
 }
 
@@ -591,6 +619,9 @@ efi_snp_transmit ( EFI_SIMPLE_NETWORK_PROTOCOL *snp,
 	if ( efi_snp_claimed )
 		return EFI_NOT_READY;
 
+	/* Profile transmissions */
+	profile_start ( &efi_snp_tx_profiler );
+
 	/* Sanity checks */
 	if ( ll_header_len ) {
 		if ( ll_header_len != ll_protocol->ll_header_len ) {
@@ -673,6 +704,7 @@ efi_snp_transmit ( EFI_SIMPLE_NETWORK_PROTOCOL *snp,
 	snpdev->tx[ snpdev->tx_prod++ % EFI_SNP_NUM_TX ] = data;
 	snpdev->interrupts |= EFI_SIMPLE_NETWORK_TRANSMIT_INTERRUPT;
 
+	profile_stop ( &efi_snp_tx_profiler );
 	return 0;
 
  err_ring_full:
@@ -681,6 +713,7 @@ efi_snp_transmit ( EFI_SIMPLE_NETWORK_PROTOCOL *snp,
 	free_iob ( iobuf );
  err_alloc_iob:
  err_sanity:
+	profile_stop ( &efi_snp_tx_profiler );
 	return EFIRC ( rc );
 }
 
@@ -718,8 +751,12 @@ efi_snp_receive ( EFI_SIMPLE_NETWORK_PROTOCOL *snp,
 	if ( efi_snp_claimed )
 		return EFI_NOT_READY;
 
-	/* Poll the network device */
-	efi_snp_poll ( snpdev );
+	/* Profile receptions */
+	profile_start ( &efi_snp_rx_profiler );
+
+	/* Poll the network device, if no packets are already queued */
+	if ( list_empty ( &snpdev->rx ) )
+		efi_snp_poll ( snpdev );
 
 	/* Dequeue a packet, if one is available */
 	iobuf = list_first_entry ( &snpdev->rx, struct io_buffer, list );
@@ -759,6 +796,7 @@ efi_snp_receive ( EFI_SIMPLE_NETWORK_PROTOCOL *snp,
  out_bad_ll_header:
 	free_iob ( iobuf );
  out_no_packet:
+	profile_stop ( &efi_snp_rx_profiler );
 	return EFIRC ( rc );
 }
 
@@ -770,6 +808,7 @@ efi_snp_receive ( EFI_SIMPLE_NETWORK_PROTOCOL *snp,
  */
 static VOID EFIAPI efi_snp_wait_for_packet ( EFI_EVENT event __unused,
 					     VOID *context ) {
+	EFI_BOOT_SERVICES *bs = efi_systab->BootServices;
 	struct efi_snp_device *snpdev = context;
 
 	DBGCP ( snpdev, "SNPDEV %p WAIT_FOR_PACKET\n", snpdev );
@@ -784,6 +823,10 @@ static VOID EFIAPI efi_snp_wait_for_packet ( EFI_EVENT event __unused,
 
 	/* Poll the network device */
 	efi_snp_poll ( snpdev );
+
+	/* Remain signalled while received packets are still queued */
+	if ( ! list_empty ( &snpdev->rx ) )
+		bs->SignalEvent ( snpdev->snp.WaitForPacket );
 }
 
 /** SNP interface */
@@ -26,6 +26,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <ipxe/netdevice.h>
 #include <ipxe/retry.h>
 #include <ipxe/timer.h>
 #include <ipxe/ipstat.h>
@@ -35,8 +38,60 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  * Fragment reassembly
  *
+ * Fragments may arrive in any order, and may overlap.  Missing
+ * portions of the reassembled payload are tracked using a list of
+ * holes, as described in RFC 815.
+ *
+ * The length of the reassembled payload is not known until the final
+ * fragment has been received.  Fragments received before this point
+ * are held as-is, without copying.  Once the final fragment has been
+ * received, a reassembly buffer of the correct size is allocated (or
+ * the fragment at offset zero is extended in place, if it has
+ * sufficient tailroom) and each fragment is copied directly into its
+ * final position.  Each fragment is therefore copied at most once.
+ *
+ * The number and total size of fragments held before the final
+ * fragment is received are limited; a datagram exceeding these limits
+ * is discarded.  Duplicate fragments (which fill no holes) are
+ * silently ignored rather than being counted as reassembly failures.
  */
 
+/**
+ * Free fragment reassembly buffer
+ *
+ * @v fragment		Fragment reassembly buffer
+ */
+static void fragment_free ( struct fragment *fragment ) {
+	struct fragment_hole *hole;
+	struct fragment_hole *tmp_hole;
+	struct fragment_pending *pending;
+	struct fragment_pending *tmp_pending;
+
+	/* Stop reassembly timer and remove from list of buffers */
+	stop_timer ( &fragment->timer );
+	list_del ( &fragment->list );
+
+	/* Free holes */
+	list_for_each_entry_safe ( hole, tmp_hole, &fragment->holes, list ) {
+		list_del ( &hole->list );
+		free ( hole );
+	}
+
+	/* Free pending fragments */
+	list_for_each_entry_safe ( pending, tmp_pending, &fragment->pending,
+				   list ) {
+		list_del ( &pending->list );
+		free_iob ( pending->iobuf );
+		free ( pending );
+	}
+
+	/* Free reassembled packet (if not one of the pending fragments) */
+	if ( fragment->final )
+		free_iob ( fragment->iobuf );
+
+	free ( fragment );
+}
+
 /**
  * Expire fragment reassembly buffer
  *
@@ -48,10 +103,8 @@ static void fragment_expired ( struct retry_timer *timer, int fail __unused ) {
 		container_of ( timer, struct fragment, timer );
 
 	DBGC ( fragment, "FRAG %p expired\n", fragment );
-	free_iob ( fragment->iobuf );
-	list_del ( &fragment->list );
 	fragment->fragments->stats->reasm_fails++;
-	free ( fragment );
+	fragment_free ( fragment );
 }
 
 /**
@@ -74,6 +127,182 @@ static struct fragment * fragment_find ( struct fragment_reassembler *fragments,
 	return NULL;
 }
 
+/**
+ * Fill holes covered by fragment
+ *
+ * @v fragment		Fragment reassembly buffer
+ * @v start		Offset of first byte of fragment
+ * @v end		Offset of first byte following fragment
+ * @ret filled		Number of holes (partially) filled, or negative error
+ */
+static int fragment_fill ( struct fragment *fragment, size_t start,
+			   size_t end ) {
+	struct fragment_hole *hole;
+	struct fragment_hole *tmp;
+	struct fragment_hole *split;
+	int filled = 0;
+
+	list_for_each_entry_safe ( hole, tmp, &fragment->holes, list ) {
+
+		/* Skip holes not covered by this fragment */
+		if ( ( end <= hole->start ) || ( start >= hole->end ) )
+			continue;
+		filled++;
+
+		/* Shrink, split, or remove hole as applicable.  Note
+		 * that a hole can be split only if the fragment lies
+		 * entirely within it, in which case no other holes
+		 * will have been modified.
+		 */
+		if ( start > hole->start ) {
+			if ( end < hole->end ) {
+				split = malloc ( sizeof ( *split ) );
+				if ( ! split )
+					return -ENOMEM;
+				split->start = end;
+				split->end = hole->end;
+				list_add ( &split->list, &hole->list );
+			}
+			hole->end = start;
+		} else if ( end < hole->end ) {
+			hole->start = end;
+		} else {
+			list_del ( &hole->list );
+			free ( hole );
+		}
+	}
+
+	return filled;
+}
+
+/**
+ * Copy fragment into reassembly buffer
+ *
+ * @v fragment		Fragment reassembly buffer
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ * @v offset		Offset of fragment within reassembled payload
+ * @ret rc		Return status code
+ */
+static int fragment_place ( struct fragment *fragment, struct io_buffer *iobuf,
+			    size_t hdrlen, size_t offset ) {
+	struct io_buffer *reasm = fragment->iobuf;
+
+	/* Take non-fragmentable portion from the fragment at offset
+	 * zero, leaving the reassembled payload in place.
+	 */
+	if ( offset == 0 ) {
+		if ( hdrlen > ( iob_headroom ( reasm ) + fragment->hdrlen ) ) {
+			DBGC ( fragment, "FRAG %p no room for %zd-byte "
+			       "header\n", fragment, hdrlen );
+			return -ENOBUFS;
+		}
+		iob_pull ( reasm, fragment->hdrlen );
+		memcpy ( iob_push ( reasm, hdrlen ), iobuf->data, hdrlen );
+		fragment->hdrlen = hdrlen;
+	}
+
+	/* Copy payload */
+	memcpy ( ( reasm->data + fragment->hdrlen + offset ),
+		 ( iobuf->data + hdrlen ), ( iob_len ( iobuf ) - hdrlen ) );
+
+	return 0;
+}
+
+/**
+ * Allocate reassembly buffer
+ *
+ * @v fragment		Fragment reassembly buffer
+ * @ret rc		Return status code
+ *
+ * The length of the reassembled payload must already be known.  All
+ * pending fragments will be copied into the reassembly buffer.
+ */
+static int fragment_alloc ( struct fragment *fragment ) {
+	struct io_buffer *iobuf = fragment->iobuf;
+	struct fragment_pending *pending;
+	struct fragment_pending *tmp;
+	size_t headroom;
+	size_t len;
+	int rc;
+
+	/* Find pending fragment used to identify this buffer */
+	list_for_each_entry ( pending, &fragment->pending, list ) {
+		if ( pending->iobuf == iobuf )
+			break;
+	}
+	assert ( &pending->list != &fragment->pending );
+
+	/* Extend the fragment at offset zero in place if possible,
+	 * otherwise allocate a new buffer.  Preserve I/O buffer
+	 * headroom to allow for code which modifies and resends the
+	 * buffer (e.g. ICMP echo responses), and allow for the
+	 * fragment at offset zero to have a longer header.
+	 */
+	len = ( iob_len ( iobuf ) - fragment->hdrlen );
+	if ( ( pending->offset == 0 ) &&
+	     ( iob_tailroom ( iobuf ) >= ( fragment->len - len ) ) ) {
+		iob_put ( iobuf, ( fragment->len - len ) );
+		iobuf->csum_flags = 0;
+		list_del ( &pending->list );
+		free ( pending );
+	} else {
+		headroom = ( iob_headroom ( iobuf ) + MAX_NET_HEADER_LEN );
+		iobuf = alloc_iob ( headroom + fragment->hdrlen +
+				    fragment->len );
+		if ( ! iobuf ) {
+			DBGC ( fragment, "FRAG %p could not allocate %zd-byte "
+			       "reassembly buffer\n", fragment, fragment->len );
+			return -ENOMEM;
+		}
+		iob_reserve ( iobuf, headroom );
+		memcpy ( iob_put ( iobuf, fragment->hdrlen ),
+			 fragment->iobuf->data, fragment->hdrlen );
+		iob_put ( iobuf, fragment->len );
+	}
+	fragment->iobuf = iobuf;
+	fragment->final = 1;
+
+	/* Copy pending fragments into reassembly buffer */
+	list_for_each_entry_safe ( pending, tmp, &fragment->pending, list ) {
+		if ( ( rc = fragment_place ( fragment, pending->iobuf,
+					     pending->hdrlen,
+					     pending->offset ) ) != 0 )
+			return rc;
+		list_del ( &pending->list );
+		free_iob ( pending->iobuf );
+		free ( pending );
+	}
+
+	return 0;
+}
+
+/**
+ * Record length of reassembled payload
+ *
+ * @v fragment		Fragment reassembly buffer
+ * @v len		Length of reassembled payload
+ * @ret rc		Return status code
+ */
+static int fragment_final ( struct fragment *fragment, size_t len ) {
+	struct fragment_hole *hole;
+	struct fragment_hole *tmp;
+
+	/* Discard any holes beyond the end of the payload */
+	fragment->len = len;
+	list_for_each_entry_safe ( hole, tmp, &fragment->holes, list ) {
+		if ( hole->start >= len ) {
+			list_del ( &hole->list );
+			free ( hole );
+		} else if ( hole->end > len ) {
+			hole->end = len;
+		}
+	}
+
+	/* Allocate reassembly buffer */
+	return fragment_alloc ( fragment );
+}
+
 /**
  * Reassemble packet
  *
@@ -89,89 +318,160 @@ struct io_buffer * fragment_reassemble ( struct fragment_reassembler *fragments,
 					 struct io_buffer *iobuf,
 					 size_t *hdrlen ) {
 	struct fragment *fragment;
-	struct io_buffer *new_iobuf;
-	size_t new_len;
+	struct fragment_hole *hole;
+	struct fragment_pending *pending;
 	size_t offset;
-	size_t expected_offset;
+	size_t end;
+	size_t size;
 	int more_frags;
+	int filled;
+	int rc;
 
 	/* Update statistics */
 	fragments->stats->reasm_reqds++;
 
+	/* Parse fragment */
+	offset = fragments->fragment_offset ( iobuf, *hdrlen );
+	end = ( offset + iob_len ( iobuf ) - *hdrlen );
+	more_frags = fragments->more_fragments ( iobuf, *hdrlen );
+
 	/* Find matching fragment reassembly buffer, if any */
 	fragment = fragment_find ( fragments, iobuf, *hdrlen );
 
-	/* Drop out-of-order fragments */
-	offset = fragments->fragment_offset ( iobuf, *hdrlen );
-	expected_offset = ( fragment ? ( iob_len ( fragment->iobuf ) -
-					 fragment->hdrlen ) : 0 );
-	if ( offset != expected_offset ) {
-		DBGC ( fragment, "FRAG %p dropping out-of-sequence fragment "
-		       "[%zd,%zd), expected [%zd,...)\n", fragment, offset,
-		       ( offset + iob_len ( iobuf ) - *hdrlen ),
-		       expected_offset );
-		goto drop;
-	}
-
-	/* Create or extend fragment reassembly buffer as applicable */
+	/* Create fragment reassembly buffer if applicable */
 	if ( ! fragment ) {
 
-		/* Create new fragment reassembly buffer */
+		/* Return a lone complete fragment immediately */
+		if ( ( offset == 0 ) && ( ! more_frags ) ) {
+			fragments->stats->reasm_oks++;
+			return iobuf;
+		}
+
+		/* Create new fragment reassembly buffer, with a single
+		 * hole covering the whole (as yet unknown) payload.
+		 */
 		fragment = zalloc ( sizeof ( *fragment ) );
 		if ( ! fragment )
 			goto drop;
+		INIT_LIST_HEAD ( &fragment->holes );
+		INIT_LIST_HEAD ( &fragment->pending );
+		hole = malloc ( sizeof ( *hole ) );
+		if ( ! hole ) {
+			free ( fragment );
+			fragment = NULL;
+			goto drop;
+		}
+		hole->start = 0;
+		hole->end = FRAGMENT_HOLE_INFINITY;
+		list_add ( &hole->list, &fragment->holes );
 		list_add ( &fragment->list, &fragments->list );
 		fragment->iobuf = iobuf;
 		fragment->hdrlen = *hdrlen;
 		timer_init ( &fragment->timer, fragment_expired, NULL );
 		fragment->fragments = fragments;
-		DBGC ( fragment, "FRAG %p [0,%zd)\n", fragment,
-		       ( iob_len ( iobuf ) - *hdrlen ) );
+	}
+	DBGC ( fragment, "FRAG %p [%zd,%zd)%s\n", fragment, offset, end,
+	       ( more_frags ? "" : " final" ) );
+
+	if ( fragment->final ) {
+
+		/* Check fragment lies within reassembled payload */
+		if ( ( end > fragment->len ) ||
+		     ( ( ! more_frags ) && ( end != fragment->len ) ) ) {
+			DBGC ( fragment, "FRAG %p fragment [%zd,%zd) "
+			       "inconsistent with length %zd\n", fragment,
+			       offset, end, fragment->len );
+			goto drop;
+		}
+
+		/* Copy directly into reassembly buffer */
+		if ( ( rc = fragment_place ( fragment, iobuf, *hdrlen,
+					     offset ) ) != 0 )
+			goto drop;
+		filled = fragment_fill ( fragment, offset, end );
+		if ( filled < 0 )
+			goto drop;
+		if ( filled == 0 )
+			goto duplicate;
+		free_iob ( iobuf );
 
 	} else {
 
-		/* Check if this is the final fragment */
-		more_frags = fragments->more_fragments ( iobuf, *hdrlen );
-		DBGC ( fragment, "FRAG %p [%zd,%zd)%s\n", fragment,
-		       offset, ( offset + iob_len ( iobuf ) - *hdrlen ),
-		       ( more_frags ? "" : " complete" ) );
+		/* Check final fragment does not truncate payload.  The
+		 * last hole always starts at the end of the
+		 * furthest fragment received so far.
+		 */
+		hole = list_last_entry ( &fragment->holes, struct fragment_hole,
+					 list );
+		if ( ( ! more_frags ) && ( hole->start > end ) ) {
+			DBGC ( fragment, "FRAG %p final fragment [%zd,%zd) "
+			       "truncates [%zd,...)\n", fragment, offset, end,
+			       hole->start );
+			goto drop;
+		}
 
-		/* Extend fragment reassembly buffer.  Preserve I/O
-		 * buffer headroom to allow for code which modifies
-		 * and resends the buffer (e.g. ICMP echo responses).
+		/* Hold fragment until reassembly buffer is allocated,
+		 * ignoring duplicate fragments.
 		 */
-		iob_pull ( iobuf, *hdrlen );
-		new_len = ( iob_headroom ( fragment->iobuf ) +
-			    iob_len ( fragment->iobuf ) + iob_len ( iobuf ) );
-		new_iobuf = alloc_iob ( new_len );
-		if ( ! new_iobuf ) {
-			DBGC ( fragment, "FRAG %p could not extend reassembly "
-			       "buffer to %zd bytes\n", fragment, new_len );
+		pending = malloc ( sizeof ( *pending ) );
+		if ( ! pending )
+			goto drop;
+		filled = fragment_fill ( fragment, offset, end );
+		if ( filled < 0 ) {
+			free ( pending );
 			goto drop;
 		}
-		iob_reserve ( new_iobuf, iob_headroom ( fragment->iobuf ) );
-		memcpy ( iob_put ( new_iobuf, iob_len ( fragment->iobuf ) ),
-			 fragment->iobuf->data, iob_len ( fragment->iobuf ) );
-		memcpy ( iob_put ( new_iobuf, iob_len ( iobuf ) ),
-			 iobuf->data, iob_len ( iobuf ) );
-		free_iob ( fragment->iobuf );
-		fragment->iobuf = new_iobuf;
-		free_iob ( iobuf );
+		if ( ( filled == 0 ) && more_frags ) {
+			free ( pending );
+			goto duplicate;
+		}
 
-		/* Stop fragment reassembly timer */
-		stop_timer ( &fragment->timer );
+		/* Discard whole datagram if too much is being held */
+		size = ( iobuf->end - iobuf->head );
+		if ( ( fragment->count >= FRAGMENT_MAX_PENDING ) ||
+		     ( ( fragment->size + size ) >
+		       FRAGMENT_MAX_PENDING_SIZE ) ) {
+			DBGC ( fragment, "FRAG %p too many fragments pending "
+			       "(%u, %zd bytes)\n", fragment,
+			       fragment->count, fragment->size );
+			fragments->stats->reasm_fails++;
+			free ( pending );
+			free_iob ( iobuf );
+			fragment_free ( fragment );
+			return NULL;
+		}
+		pending->iobuf = iobuf;
+		pending->hdrlen = *hdrlen;
+		pending->offset = offset;
+		list_add_tail ( &pending->list, &fragment->pending );
+		fragment->count++;
+		fragment->size += size;
+		if ( offset == 0 ) {
+			fragment->iobuf = iobuf;
+			fragment->hdrlen = *hdrlen;
+		}
 
-		/* If this is the final fragment, return it */
-		if ( ! more_frags ) {
-			iobuf = fragment->iobuf;
-			*hdrlen = fragment->hdrlen;
-			list_del ( &fragment->list );
-			free ( fragment );
-			fragments->stats->reasm_oks++;
-			return iobuf;
+		/* Allocate reassembly buffer if length is now known */
+		if ( ( ! more_frags ) &&
+		     ( ( rc = fragment_final ( fragment, end ) ) != 0 ) ) {
+			fragments->stats->reasm_fails++;
+			fragment_free ( fragment );
+			return NULL;
 		}
 	}
 
+	/* If reassembly is complete, return the reassembled packet */
+	if ( fragment->final && list_empty ( &fragment->holes ) ) {
+		DBGC ( fragment, "FRAG %p complete\n", fragment );
+		iobuf = fragment->iobuf;
+		*hdrlen = fragment->hdrlen;
+		stop_timer ( &fragment->timer );
+		list_del ( &fragment->list );
+		free ( fragment );
+		fragments->stats->reasm_oks++;
+		return iobuf;
+	}
+
 	/* (Re)start fragment reassembly timer */
 	start_timer_fixed ( &fragment->timer, FRAGMENT_TIMEOUT );
 
@@ -179,6 +479,12 @@ struct io_buffer * fragment_reassemble ( struct fragment_reassembler *fragments,
 
  drop:
 	fragments->stats->reasm_fails++;
+ duplicate:
 	free_iob ( iobuf );
+	/* Discard a newly-created buffer which still refers to this fragment */
+	if ( fragment && ( ! fragment->final ) &&
+	     list_empty ( &fragment->pending ) ) {
+		fragment_free ( fragment );
+	}
 	return NULL;
 }
@@ -360,8 +360,7 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 	/* Fix up checksums */
 	if ( trans_csum ) {
 		*trans_csum = ipv4_pshdr_chksum ( iobuf, *trans_csum );
-		if ( ! *trans_csum )
-			*trans_csum = tcpip_protocol->zero_csum;
+		tcpip_tx_chksum ( iobuf, tcpip_protocol, netdev, trans_csum );
 	}
 	iphdr->chksum = tcpip_chksum ( iphdr, sizeof ( *iphdr ) );
 
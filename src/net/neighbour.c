@@ -31,6 +31,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/retry.h>
 #include <ipxe/timer.h>
 #include <ipxe/malloc.h>
+#include <ipxe/init.h>
 #include <ipxe/neighbour.h>
 
 /** @file
@@ -48,11 +49,55 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Neighbour discovery maximum timeout */
 #define NEIGHBOUR_MAX_TIMEOUT ( TICKS_PER_SEC * 3 )
 
-/** The neighbour cache */
+/** Minimum holdoff time after a failed neighbour discovery */
+#define NEIGHBOUR_MIN_HOLDOFF ( TICKS_PER_SEC * 1 )
+
+/** Maximum holdoff time after a failed neighbour discovery */
+#define NEIGHBOUR_MAX_HOLDOFF ( TICKS_PER_SEC * 32 )
+
+/** Number of neighbour cache hash buckets
+ *
+ * This must be a power of two.
+ */
+#define NEIGHBOUR_HASH_SIZE 32
+
+/** The neighbour cache (in order of most recent use) */
 struct list_head neighbours = LIST_HEAD_INIT ( neighbours );
 
+/** Neighbour cache hash buckets */
+static struct list_head neighbour_hash[NEIGHBOUR_HASH_SIZE];
+
+/** Neighbour cache statistics */
+struct neighbour_statistics neighbour_stats;
+
 static void neighbour_expired ( struct retry_timer *timer, int over );
 
+/**
+ * Find neighbour cache hash bucket
+ *
+ * @v netdev		Network device
+ * @v net_protocol	Network-layer protocol
+ * @v net_dest		Destination network-layer address
+ * @ret bucket		Hash bucket
+ *
+ * The network device index forms part of the hash key, so that each
+ * network device effectively has its own partition of the hash table.
+ */
+static struct list_head * neighbour_bucket ( struct net_device *netdev,
+					     struct net_protocol *net_protocol,
+					     const void *net_dest ) {
+	const uint8_t *bytes = net_dest;
+	unsigned int hash;
+	unsigned int i;
+
+	hash = ( ( netdev->index << 4 ) ^ net_protocol->net_proto );
+	for ( i = 0 ; i < net_protocol->net_addr_len ; i++ )
+		hash = ( ( hash * 31 ) + bytes[i] );
+	hash ^= ( hash >> 16 );
+	hash ^= ( hash >> 8 );
+	return &neighbour_hash[ hash & ( NEIGHBOUR_HASH_SIZE - 1 ) ];
+}
+
 /**
  * Free neighbour cache entry
  *
@@ -101,6 +146,8 @@ static struct neighbour * neighbour_create ( struct net_device *netdev,
 
 	/* Transfer ownership to cache */
 	list_add ( &neighbour->list, &neighbours );
+	list_add ( &neighbour->hash,
+		   neighbour_bucket ( netdev, net_protocol, net_dest ) );
 
 	DBGC ( neighbour, "NEIGHBOUR %s %s %s created\n", netdev->name,
 	       net_protocol->name, net_protocol->ntoa ( net_dest ) );
@@ -118,9 +165,12 @@ static struct neighbour * neighbour_create ( struct net_device *netdev,
 static struct neighbour * neighbour_find ( struct net_device *netdev,
 					   struct net_protocol *net_protocol,
 					   const void *net_dest ) {
+	struct list_head *bucket;
 	struct neighbour *neighbour;
 
-	list_for_each_entry ( neighbour, &neighbours, list ) {
+	neighbour_stats.lookups++;
+	bucket = neighbour_bucket ( netdev, net_protocol, net_dest );
+	list_for_each_entry ( neighbour, bucket, hash ) {
 		if ( ( neighbour->netdev == netdev ) &&
 		     ( neighbour->net_protocol == net_protocol ) &&
 		     ( memcmp ( neighbour->net_dest, net_dest,
@@ -130,6 +180,7 @@ static struct neighbour * neighbour_find ( struct net_device *netdev,
 			list_del ( &neighbour->list );
 			list_add ( &neighbour->list, &neighbours );
 
+			neighbour_stats.hits++;
 			return neighbour;
 		}
 	}
@@ -154,8 +205,12 @@ static void neighbour_discover ( struct neighbour *neighbour,
 	memcpy ( neighbour->net_source, net_source,
 		 net_protocol->net_addr_len );
 
-	/* Start timer to trigger neighbour discovery */
+	/* Start timer to trigger neighbour discovery, discarding any
+	 * timeout backoff left over from a previous failed attempt.
+	 */
+	neighbour->timer.timeout = 0;
 	start_timer_nodelay ( &neighbour->timer );
+	neighbour_stats.discoveries++;
 
 	DBGC ( neighbour, "NEIGHBOUR %s %s %s discovering via %s\n",
 	       netdev->name, net_protocol->name,
@@ -183,8 +238,9 @@ static void neighbour_discovered ( struct neighbour *neighbour,
 	       net_protocol->name, net_protocol->ntoa ( neighbour->net_dest ),
 	       ll_protocol->name, ll_protocol->ntoa ( neighbour->ll_dest ) );
 
-	/* Stop retransmission timer */
+	/* Stop retransmission timer and clear any record of failure */
 	stop_timer ( &neighbour->timer );
+	neighbour->failures = 0;
 
 	/* Transmit any packets in queue.  Take out a temporary
 	 * reference on the entry to prevent it from going out of
@@ -211,23 +267,16 @@ static void neighbour_discovered ( struct neighbour *neighbour,
 }
 
 /**
- * Destroy neighbour cache entry
+ * Discard deferred packets
  *
  * @v neighbour		Neighbour cache entry
- * @v rc		Reason for destruction
+ * @v rc		Reason for discard
  */
-static void neighbour_destroy ( struct neighbour *neighbour, int rc ) {
+static void neighbour_flush_queue ( struct neighbour *neighbour, int rc ) {
 	struct net_device *netdev = neighbour->netdev;
 	struct net_protocol *net_protocol = neighbour->net_protocol;
 	struct io_buffer *iobuf;
 
-	/* Take ownership from cache */
-	list_del ( &neighbour->list );
-
-	/* Stop timer */
-	stop_timer ( &neighbour->timer );
-
-	/* Discard any outstanding I/O buffers */
 	while ( ( iobuf = list_first_entry ( &neighbour->tx_queue,
 					     struct io_buffer, list )) != NULL){
 		DBGC2 ( neighbour, "NEIGHBOUR %s %s %s discarding deferred "
@@ -237,6 +286,62 @@ static void neighbour_destroy ( struct neighbour *neighbour, int rc ) {
 		list_del ( &iobuf->list );
 		netdev_tx_err ( neighbour->netdev, iobuf, rc );
 	}
+}
+
+/**
+ * Record failed neighbour discovery
+ *
+ * @v neighbour		Neighbour cache entry
+ * @v rc		Reason for failure
+ *
+ * The cache entry is retained as a negative entry.  Packets for this
+ * neighbour will be dropped without reattempting discovery until the
+ * holdoff time has elapsed.  The holdoff time is doubled for each
+ * consecutive failure.
+ */
+static void neighbour_failed ( struct neighbour *neighbour, int rc ) {
+	struct net_device *netdev = neighbour->netdev;
+	struct net_protocol *net_protocol = neighbour->net_protocol;
+
+	/* Discard any outstanding I/O buffers */
+	neighbour_flush_queue ( neighbour, rc );
+
+	/* Calculate holdoff time */
+	if ( neighbour->failures++ ) {
+		neighbour->holdoff <<= 1;
+		if ( neighbour->holdoff > NEIGHBOUR_MAX_HOLDOFF )
+			neighbour->holdoff = NEIGHBOUR_MAX_HOLDOFF;
+	} else {
+		neighbour->holdoff = NEIGHBOUR_MIN_HOLDOFF;
+	}
+	neighbour->failed = currticks();
+	neighbour_stats.failures++;
+
+	DBGC ( neighbour, "NEIGHBOUR %s %s %s failed (attempt %d, holdoff "
+	       "%ld ticks): %s\n", netdev->name, net_protocol->name,
+	       net_protocol->ntoa ( neighbour->net_dest ), neighbour->failures,
+	       neighbour->holdoff, strerror ( rc ) );
+}
+
+/**
+ * Destroy neighbour cache entry
+ *
+ * @v neighbour		Neighbour cache entry
+ * @v rc		Reason for destruction
+ */
+static void neighbour_destroy ( struct neighbour *neighbour, int rc ) {
+	struct net_device *netdev = neighbour->netdev;
+	struct net_protocol *net_protocol = neighbour->net_protocol;
+
+	/* Take ownership from cache */
+	list_del ( &neighbour->list );
+	list_del ( &neighbour->hash );
+
+	/* Stop timer */
+	stop_timer ( &neighbour->timer );
+
+	/* Discard any outstanding I/O buffers */
+	neighbour_flush_queue ( neighbour, rc );
 
 	DBGC ( neighbour, "NEIGHBOUR %s %s %s destroyed: %s\n", netdev->name,
 	       net_protocol->name, net_protocol->ntoa ( neighbour->net_dest ),
@@ -263,9 +368,9 @@ static void neighbour_expired ( struct retry_timer *timer, int fail ) {
 	const void *net_source = neighbour->net_source;
 	int rc;
 
-	/* If we have failed, destroy the cache entry */
+	/* If we have failed, record the failure */
 	if ( fail ) {
-		neighbour_destroy ( neighbour, -ETIMEDOUT );
+		neighbour_failed ( neighbour, -ETIMEDOUT );
 		return;
 	}
 
@@ -311,6 +416,21 @@ int neighbour_tx ( struct io_buffer *iobuf, struct net_device *netdev,
 		neighbour_discover ( neighbour, discovery, net_source );
 	}
 
+	/* If discovery has previously failed, then drop the packet
+	 * unless the holdoff time has elapsed.
+	 */
+	if ( neighbour_has_failed ( neighbour ) ) {
+		if ( ( currticks() - neighbour->failed ) < neighbour->holdoff ){
+			DBGC2 ( neighbour, "NEIGHBOUR %s %s %s dropping "
+				"packet\n", netdev->name, net_protocol->name,
+				net_protocol->ntoa ( net_dest ) );
+			neighbour_stats.drops++;
+			netdev_tx_err ( netdev, iobuf, -EHOSTUNREACH );
+			return -EHOSTUNREACH;
+		}
+		neighbour_discover ( neighbour, discovery, net_source );
+	}
+
 	/* If a link-layer address is available then transmit
 	 * immediately, otherwise queue for later transmission.
 	 */
@@ -395,6 +515,22 @@ static void neighbour_flush ( struct net_device *netdev ) {
 	}
 }
 
+/**
+ * Initialise neighbour cache
+ *
+ */
+static void neighbour_init ( void ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < NEIGHBOUR_HASH_SIZE ; i++ )
+		INIT_LIST_HEAD ( &neighbour_hash[i] );
+}
+
+/** Neighbour cache initialisation function */
+struct init_fn neighbour_init_fn __init_fn ( INIT_NORMAL ) = {
+	.initialise = neighbour_init,
+};
+
 /** Neighbour driver (for net device notifications) */
 struct net_driver neighbour_net_driver __net_driver = {
 	.name = "Neighbour",
@@ -40,6 +40,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/errortab.h>
 #include <ipxe/profile.h>
 #include <ipxe/fault.h>
+#include <ipxe/trace.h>
 #include <ipxe/vlan.h>
 #include <ipxe/netdevice.h>
 
@@ -58,6 +59,11 @@ static struct list_head open_net_devices = LIST_HEAD_INIT ( open_net_devices );
 /** Network device index */
 static unsigned int netdev_index = 0;
 
+static void net_step ( struct process *process );
+
+/** Networking stack process */
+PERMANENT_PROCESS ( net_process, net_step );
+
 /** Network polling profiler */
 static struct profiler net_poll_profiler __profiler = { .name = "net.poll" };
 
@@ -292,6 +298,7 @@ int netdev_tx ( struct net_device *netdev, struct io_buffer *iobuf ) {
 
 	DBGC2 ( netdev, "NETDEV %s transmitting %p (%p+%zx)\n",
 		netdev->name, iobuf, iobuf->data, iob_len ( iobuf ) );
+	trace ( TRACE_NETDEV_TX, netdev, iob_len ( iobuf ) );
 	profile_start ( &net_tx_profiler );
 
 	/* Enqueue packet */
@@ -459,6 +466,7 @@ void netdev_rx ( struct net_device *netdev, struct io_buffer *iobuf ) {
 
 	DBGC2 ( netdev, "NETDEV %s received %p (%p+%zx)\n",
 		netdev->name, iobuf, iobuf->data, iob_len ( iobuf ) );
+	trace ( TRACE_NETDEV_RX, netdev, iob_len ( iobuf ) );
 
 	/* Discard packet (for test purposes) if applicable */
 	if ( ( rc = inject_fault ( NETDEV_DISCARD_RATE ) ) != 0 ) {
@@ -754,6 +762,9 @@ int netdev_open ( struct net_device *netdev ) {
 	/* Add to head of open devices list */
 	list_add ( &netdev->open_list, &open_net_devices );
 
+	/* Wake networking stack process, if idle */
+	process_wake ( &net_process );
+
 	/* Notify drivers of device state change */
 	netdev_notify ( netdev );
 
@@ -1085,8 +1096,19 @@ void net_poll ( void ) {
  *
  * @v process		Network stack process
  */
-static void net_step ( struct process *process __unused ) {
+static void net_step ( struct process *process ) {
+
+	/* Poll the network stack */
 	net_poll();
+
+	/* Sleep until a device is opened, if no devices are open.
+	 * Open devices must be polled to discover received packets,
+	 * and so the process remains runnable (which also prevents
+	 * process_nap() from halting the CPU) while any device is
+	 * open.
+	 */
+	if ( list_empty ( &open_net_devices ) )
+		process_idle ( process );
 }
 
 /**
@@ -1111,9 +1133,6 @@ __weak struct net_device * vlan_find ( struct net_device *trunk __unused,
 	return NULL;
 }
 
-/** Networking stack process */
-PERMANENT_PROCESS ( net_process, net_step );
-
 /**
  * Discard some cached network device data
  *
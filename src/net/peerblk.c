@@ -48,6 +48,18 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 #define PEERBLK_DECRYPT_CHUNKSIZE 2048
 
+/** PeerDist decryption batch size
+ *
+ * This is the maximum number of bytes to be decrypted and added to
+ * the block digest within a single invocation of the decryption
+ * process.  Larger batches amortise the per-step overhead; smaller
+ * batches leave more time for the network stack to continue
+ * receiving data for other concurrently downloading blocks.
+ *
+ * This is a policy decision.
+ */
+#define PEERBLK_DECRYPT_BATCH ( 8 * PEERBLK_DECRYPT_CHUNKSIZE )
+
 /** PeerDist raw block download attempt initial progress timeout
  *
  * This is a policy decision.
@@ -133,6 +145,7 @@ static void peerblk_free ( struct refcnt *refcnt ) {
 
 	uri_put ( peerblk->uri );
 	free ( peerblk->cipherctx );
+	free ( peerblk->chunk );
 	free ( peerblk );
 }
 
@@ -164,6 +177,10 @@ static void peerblk_reset ( struct peerdist_block *peerblk, int rc ) {
 	peerblk->cipherctx = NULL;
 	peerblk->cipher = NULL;
 
+	/* Free decryption chunk buffer */
+	free ( peerblk->chunk );
+	peerblk->chunk = NULL;
+
 	/* Reset trim thresholds */
 	peerblk->start = ( peerblk->trim.start - peerblk->range.start );
 	peerblk->end = ( peerblk->trim.end - peerblk->range.start );
@@ -262,6 +279,28 @@ static int peerblk_deliver ( struct peerdist_block *peerblk,
 	return 0;
 }
 
+/**
+ * Record outcome of PeerDist retrieval protocol download attempt
+ *
+ * @v peerblk		PeerDist block download
+ * @v rc		Attempt status code
+ */
+static void peerblk_record ( struct peerdist_block *peerblk, int rc ) {
+	struct peerdisc_segment *segment = peerblk->discovery.segment;
+	struct peerdisc_peer *peer = peerblk->peer;
+
+	/* Do nothing unless current attempt is a retrieval protocol
+	 * attempt (rather than a raw download attempt).
+	 */
+	if ( ( peer == NULL ) || ( &peer->list == &segment->peers ) )
+		return;
+
+	/* Update per-peer statistics */
+	peerdisc_record ( peer->location,
+			  ( peerblk->range.end - peerblk->range.start ),
+			  ( currticks() - peerblk->retrieved ), rc );
+}
+
 /**
  * Finish PeerDist block download attempt
  *
@@ -295,6 +334,7 @@ static void peerblk_done ( struct peerdist_block *peerblk, int rc ) {
 	/* Profile successful attempt */
 	profile_custom ( &peerblk_attempt_success_profiler,
 			 ( now - peerblk->attempted ) );
+	peerblk_record ( peerblk, 0 );
 
 	/* Close download */
 	peerblk_close ( peerblk, 0 );
@@ -304,6 +344,7 @@ static void peerblk_done ( struct peerdist_block *peerblk, int rc ) {
 	/* Record failure reason and schedule a retry attempt */
 	profile_custom ( &peerblk_attempt_failure_profiler,
 			 ( now - peerblk->attempted ) );
+	peerblk_record ( peerblk, rc );
 	peerblk_reset ( peerblk, rc );
 	peerblk->rc = rc;
 	start_timer_nodelay ( &peerblk->timer );
@@ -507,6 +548,9 @@ static int peerblk_retrieval_open ( struct peerdist_block *peerblk,
 		goto err_open;
 	}
 
+	/* Record attempt start time */
+	peerblk->retrieved = currticks();
+
 	/* Annul HTTP connection (for testing) if applicable.  Do not
 	 * report as an immediate error, in order to test our ability
 	 * to recover from a totally unresponsive HTTP server.
@@ -968,30 +1012,17 @@ static int peerblk_decrypt_write ( struct peerdist_block *peerblk,
  * Decrypt one chunk of PeerDist retrieval protocol data
  *
  * @v peerblk		PeerDist block download
+ * @v data		Chunk buffer
+ * @ret rc		Return status code
  */
-static void peerblk_decrypt ( struct peerdist_block *peerblk ) {
+static int peerblk_decrypt_chunk ( struct peerdist_block *peerblk,
+				   void *data ) {
 	struct cipher_algorithm *cipher = peerblk->cipher;
 	struct digest_algorithm *digest = peerblk->digest;
-	struct xfer_buffer *xferbuf;
 	size_t cipher_len;
 	size_t digest_len;
-	void *data;
 	int rc;
 
-	/* Sanity check */
-	assert ( ( PEERBLK_DECRYPT_CHUNKSIZE % cipher->blocksize ) == 0 );
-
-	/* Get the underlying data transfer buffer */
-	xferbuf = xfer_buffer ( &peerblk->xfer );
-	if ( ! xferbuf ) {
-		DBGC ( peerblk, "PEERBLK %p %d.%d has no underlying data "
-		       "transfer buffer\n", peerblk, peerblk->segment,
-		       peerblk->block );
-		rc = -ENOTSUP;
-		goto err_xfer_buffer;
-	}
-	peerblk->decrypt[PEERBLK_DURING].xferbuf = xferbuf;
-
 	/* Calculate cipher and digest lengths */
 	cipher_len = PEERBLK_DECRYPT_CHUNKSIZE;
 	if ( cipher_len > peerblk->cipher_remaining )
@@ -1001,19 +1032,12 @@ static void peerblk_decrypt ( struct peerdist_block *peerblk ) {
 		digest_len = peerblk->digest_remaining;
 	assert ( ( cipher_len & ( cipher->blocksize - 1 ) ) == 0 );
 
-	/* Allocate temporary data buffer */
-	data = malloc ( cipher_len );
-	if ( ! data ) {
-		rc = -ENOMEM;
-		goto err_alloc_data;
-	}
-
 	/* Read ciphertext */
 	if ( ( rc = peerblk_decrypt_read ( peerblk, data, cipher_len ) ) != 0 ){
 		DBGC ( peerblk, "PEERBLK %p %d.%d could not read ciphertext: "
 		       "%s\n", peerblk, peerblk->segment, peerblk->block,
 		       strerror ( rc ) );
-		goto err_read;
+		return rc;
 	}
 
 	/* Decrypt data */
@@ -1027,15 +1051,60 @@ static void peerblk_decrypt ( struct peerdist_block *peerblk ) {
 		DBGC ( peerblk, "PEERBLK %p %d.%d could not write plaintext: "
 		       "%s\n", peerblk, peerblk->segment, peerblk->block,
 		       strerror ( rc ) );
-		goto err_write;
+		return rc;
 	}
 
 	/* Consume input */
 	peerblk->cipher_remaining -= cipher_len;
 	peerblk->digest_remaining -= digest_len;
 
-	/* Free temporary data buffer */
-	free ( data );
+	return 0;
+}
+
+/**
+ * Decrypt a batch of PeerDist retrieval protocol data
+ *
+ * @v peerblk		PeerDist block download
+ */
+static void peerblk_decrypt ( struct peerdist_block *peerblk ) {
+	struct cipher_algorithm *cipher = peerblk->cipher;
+	struct xfer_buffer *xferbuf;
+	size_t batch;
+	int rc;
+
+	/* Sanity check */
+	assert ( ( PEERBLK_DECRYPT_CHUNKSIZE % cipher->blocksize ) == 0 );
+
+	/* Get the underlying data transfer buffer */
+	xferbuf = xfer_buffer ( &peerblk->xfer );
+	if ( ! xferbuf ) {
+		DBGC ( peerblk, "PEERBLK %p %d.%d has no underlying data "
+		       "transfer buffer\n", peerblk, peerblk->segment,
+		       peerblk->block );
+		rc = -ENOTSUP;
+		goto err;
+	}
+	peerblk->decrypt[PEERBLK_DURING].xferbuf = xferbuf;
+
+	/* Allocate chunk buffer, if not already allocated.  The
+	 * buffer is reused for all chunks within this attempt.
+	 */
+	if ( ! peerblk->chunk ) {
+		peerblk->chunk = malloc ( PEERBLK_DECRYPT_CHUNKSIZE );
+		if ( ! peerblk->chunk ) {
+			rc = -ENOMEM;
+			goto err;
+		}
+	}
+
+	/* Decrypt chunks until the batch size has been reached */
+	for ( batch = 0 ; ( peerblk->cipher_remaining &&
+			    ( batch < PEERBLK_DECRYPT_BATCH ) ) ;
+	      batch += PEERBLK_DECRYPT_CHUNKSIZE ) {
+		if ( ( rc = peerblk_decrypt_chunk ( peerblk,
+						    peerblk->chunk ) ) != 0 )
+			goto err;
+	}
 
 	/* Continue processing until all input is consumed */
 	if ( peerblk->cipher_remaining )
@@ -1045,11 +1114,7 @@ static void peerblk_decrypt ( struct peerdist_block *peerblk ) {
 	peerblk_done ( peerblk, 0 );
 	return;
 
- err_write:
- err_read:
-	free ( data );
- err_alloc_data:
- err_xfer_buffer:
+ err:
 	peerblk_done ( peerblk, rc );
 }
 
@@ -1155,6 +1220,7 @@ static void peerblk_expired ( struct retry_timer *timer, int over __unused ) {
 		DBGC ( peerblk, "PEERBLK %p %d.%d timed out after %ld ticks\n",
 		       peerblk, peerblk->segment, peerblk->block,
 		       timer->timeout );
+		peerblk_record ( peerblk, -ETIMEDOUT );
 	}
 
 	/* Abort any current download attempt */
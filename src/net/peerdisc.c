@@ -549,3 +549,88 @@ void peerdisc_close ( struct peerdisc_client *peerdisc ) {
 	if ( list_empty ( &peerdisc_segments ) )
 		peerdisc_socket_close ( 0 );
 }
+
+/******************************************************************************
+ *
+ * Per-peer statistics
+ *
+ ******************************************************************************
+ */
+
+/** Per-peer statistics, in order of most recent use */
+LIST_HEAD ( peerdisc_stats );
+
+/** Number of peers for which statistics are retained */
+static unsigned int peerdisc_stats_count;
+
+/**
+ * Find PeerDist per-peer statistics
+ *
+ * @v location		Peer location
+ * @ret stats		Per-peer statistics, or NULL if not found
+ */
+struct peerdisc_statistics * peerdisc_statistics ( const char *location ) {
+	struct peerdisc_statistics *stats;
+
+	/* Look for matching statistics */
+	list_for_each_entry ( stats, &peerdisc_stats, list ) {
+		if ( strcmp ( location, stats->location ) == 0 )
+			return stats;
+	}
+
+	return NULL;
+}
+
+/**
+ * Record PeerDist retrieval attempt
+ *
+ * @v location		Peer location
+ * @v len		Length of block retrieved
+ * @v ticks		Time taken to retrieve block
+ * @v rc		Retrieval attempt status code
+ */
+void peerdisc_record ( const char *location, size_t len, unsigned long ticks,
+		       int rc ) {
+	struct peerdisc_statistics *stats;
+
+	/* Find or create statistics */
+	stats = peerdisc_statistics ( location );
+	if ( stats ) {
+
+		/* Mark as most recently used */
+		list_del ( &stats->list );
+
+	} else {
+
+		/* Discard least recently used statistics, if applicable */
+		if ( peerdisc_stats_count >= PEERDISC_MAX_STATISTICS ) {
+			stats = list_last_entry ( &peerdisc_stats,
+						  struct peerdisc_statistics,
+						  list );
+			list_del ( &stats->list );
+			free ( stats );
+			peerdisc_stats_count--;
+		}
+
+		/* Allocate and initialise structure */
+		stats = zalloc ( sizeof ( *stats ) + strlen ( location ) +
+				 1 /* NUL */ );
+		if ( ! stats )
+			return;
+		strcpy ( stats->location, location );
+		peerdisc_stats_count++;
+	}
+	list_add ( &stats->list, &peerdisc_stats );
+
+	/* Update statistics */
+	if ( rc == 0 ) {
+		stats->blocks++;
+		stats->bytes += len;
+		stats->ticks += ticks;
+	} else {
+		stats->failures++;
+	}
+	DBGC2 ( stats, "PEERDISC %s retrieved %u blocks (%zu bytes) in %lu "
+		"ticks, %u failures\n", stats->location, stats->blocks,
+		stats->bytes, stats->ticks, stats->failures );
+}
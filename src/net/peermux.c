@@ -24,7 +24,9 @@
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
+#include <ipxe/timer.h>
 #include <ipxe/uri.h>
 #include <ipxe/xferbuf.h>
 #include <ipxe/peerblk.h>
@@ -36,6 +38,97 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+/******************************************************************************
+ *
+ * Concurrency control
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Initialise PeerDist download concurrency controller
+ *
+ * @v conc		Concurrency controller
+ * @v now		Current time
+ */
+void peermux_concurrency_init ( struct peerdist_concurrency *conc,
+				unsigned long now ) {
+
+	memset ( conc, 0, sizeof ( *conc ) );
+	conc->limit = PEERMUX_INITIAL_BLOCKS;
+	conc->slow_start = 1;
+	conc->direction = +1;
+	conc->started = now;
+}
+
+/**
+ * Update PeerDist download concurrency controller on block completion
+ *
+ * @v conc		Concurrency controller
+ * @v now		Current time
+ *
+ * The number of bytes received must already have been added to the
+ * controller's running total.
+ */
+void peermux_concurrency_update ( struct peerdist_concurrency *conc,
+				  unsigned long now ) {
+	unsigned long elapsed;
+	unsigned long rate;
+	int limit = conc->limit;
+
+	/* Do nothing until the current round has completed */
+	if ( ++conc->completed < conc->limit )
+		return;
+
+	/* Calculate throughput during this round */
+	elapsed = ( now - conc->started );
+	if ( ! elapsed )
+		elapsed = 1;
+	rate = ( conc->bytes / elapsed );
+
+	/* Adjust concurrency limit */
+	if ( rate >= conc->rate ) {
+		/* Throughput did not decrease: continue adjusting in
+		 * the same direction.
+		 */
+		limit = ( conc->slow_start ?
+			  ( limit * 2 ) : ( limit + conc->direction ) );
+	} else if ( conc->slow_start ) {
+		/* Throughput decreased during slow start: revert to
+		 * the previous limit and start probing downwards.
+		 */
+		conc->slow_start = 0;
+		conc->direction = -1;
+		limit /= 2;
+	} else {
+		/* Throughput decreased: reverse direction */
+		conc->direction = -conc->direction;
+		limit += conc->direction;
+	}
+	if ( limit > PEERMUX_MAX_BLOCKS )
+		limit = PEERMUX_MAX_BLOCKS;
+	if ( limit < 1 )
+		limit = 1;
+	if ( limit != ( int ) conc->limit ) {
+		DBGC2 ( conc, "PEERMUX %p concurrency %d (%ld bytes/tick)\n",
+			conc, limit, rate );
+	}
+	conc->limit = limit;
+
+	/* Start new round */
+	conc->completed = 0;
+	conc->bytes = 0;
+	conc->started = now;
+	conc->rate = rate;
+}
+
+/******************************************************************************
+ *
+ * Multiplexer
+ *
+ ******************************************************************************
+ */
+
 /**
  * Free PeerDist download multiplexer
  *
@@ -62,6 +155,9 @@ static void peermux_close ( struct peerdist_multiplexer *peermux, int rc ) {
 	/* Stop block download initiation process */
 	process_del ( &peermux->process );
 
+	/* Close upcoming segment discovery */
+	peerdisc_close ( &peermux->discovery );
+
 	/* Shut down all block downloads */
 	for ( i = 0 ; i < PEERMUX_MAX_BLOCKS ; i++ )
 		intf_shutdown ( &peermux->block[i].xfer, rc );
@@ -138,6 +234,7 @@ static void peermux_info_close ( struct peerdist_multiplexer *peermux, int rc ){
 	xfer_seek ( &peermux->xfer, 0 );
 
 	/* Start block download process */
+	peermux_concurrency_init ( &peermux->concurrency, currticks() );
 	process_add ( &peermux->process );
 
 	return;
@@ -146,6 +243,51 @@ static void peermux_info_close ( struct peerdist_multiplexer *peermux, int rc ){
 	peermux_close ( peermux, rc );
 }
 
+/**
+ * Start discovery for upcoming segment
+ *
+ * @v peermux		PeerDist download multiplexer
+ * @v index		Segment index
+ *
+ * Discovering peers for the next segment while the current segment
+ * is downloading allows the first block downloads for the next
+ * segment to start immediately, rather than each waiting for the
+ * discovery timeout.
+ */
+static void peermux_discover ( struct peerdist_multiplexer *peermux,
+			       unsigned int index ) {
+	struct peerdist_info *info = &peermux->cache.info;
+	struct peerdist_info_segment segment;
+	int rc;
+
+	/* Close any existing upcoming segment discovery */
+	peerdisc_close ( &peermux->discovery );
+	peermux->upcoming = index;
+
+	/* Do nothing if there is no upcoming segment */
+	if ( index >= info->segments )
+		return;
+
+	/* Get content information segment */
+	if ( ( rc = peerdist_info_segment ( info, &segment, index ) ) != 0 ) {
+		DBGC ( peermux, "PEERMUX %p could not get segment %d "
+		       "information: %s\n", peermux, index, strerror ( rc ) );
+		/* Non-fatal: blocks will perform their own discovery */
+		return;
+	}
+
+	/* Open discovery */
+	if ( ( rc = peerdisc_open ( &peermux->discovery, segment.id,
+				    info->digestsize ) ) != 0 ) {
+		DBGC ( peermux, "PEERMUX %p could not discover segment %d: "
+		       "%s\n", peermux, index, strerror ( rc ) );
+		/* Non-fatal: blocks will perform their own discovery */
+		return;
+	}
+	DBGC2 ( peermux, "PEERMUX %p discovering segment %d\n",
+		peermux, index );
+}
+
 /**
  * Initiate multiplexed block download
  *
@@ -160,10 +302,13 @@ static void peermux_step ( struct peerdist_multiplexer *peermux ) {
 	unsigned int next_block;
 	int rc;
 
-	/* Stop initiation process if all block downloads are busy */
+	/* Stop initiation process if all permitted block downloads
+	 * are busy.
+	 */
 	peermblk = list_first_entry ( &peermux->idle,
 				      struct peerdist_multiplexed_block, list );
-	if ( ! peermblk ) {
+	if ( ( ! peermblk ) ||
+	     ( peermux->active >= peermux->concurrency.limit ) ) {
 		process_del ( &peermux->process );
 		return;
 	}
@@ -227,6 +372,16 @@ static void peermux_step ( struct peerdist_multiplexer *peermux ) {
 	/* Move to list of busy block downloads */
 	list_del ( &peermblk->list );
 	list_add_tail ( &peermblk->list, &peermux->busy );
+	peermux->active++;
+
+	/* Start discovery for the next segment, if not already
+	 * started.  This is deferred until after the first block
+	 * download for the current segment has been opened, so that
+	 * any peers already discovered for the current segment are
+	 * retained.
+	 */
+	if ( peermux->upcoming <= segment->index )
+		peermux_discover ( peermux, ( segment->index + 1 ) );
 
 	return;
 
@@ -252,6 +407,9 @@ static int peermux_block_deliver ( struct peerdist_multiplexed_block *peermblk,
 	 */
 	assert ( meta->flags & XFER_FL_ABS_OFFSET );
 
+	/* Record received data for concurrency control */
+	peermux->concurrency.bytes += iob_len ( iobuf );
+
 	/* We can't use a simple passthrough interface descriptor,
 	 * since there are multiple block download interfaces.
 	 */
@@ -287,6 +445,7 @@ static void peermux_block_close ( struct peerdist_multiplexed_block *peermblk,
 	/* Move to list of idle downloads */
 	list_del ( &peermblk->list );
 	list_add_tail ( &peermblk->list, &peermux->idle );
+	peermux->active--;
 
 	/* If any error occurred, terminate the whole multiplexer */
 	if ( rc != 0 ) {
@@ -294,6 +453,9 @@ static void peermux_block_close ( struct peerdist_multiplexed_block *peermblk,
 		return;
 	}
 
+	/* Update concurrency limit */
+	peermux_concurrency_update ( &peermux->concurrency, currticks() );
+
 	/* Restart data transfer interface */
 	intf_restart ( &peermblk->xfer, rc );
 
@@ -343,6 +505,23 @@ static struct interface_descriptor peermux_block_desc =
 static struct process_descriptor peermux_process_desc =
 	PROC_DESC ( struct peerdist_multiplexer, process, peermux_step );
 
+/**
+ * Handle upcoming segment peer discovery
+ *
+ * @v discovery		PeerDist discovery client
+ */
+static void peermux_discovered ( struct peerdisc_client *discovery __unused ) {
+
+	/* Nothing to do: discovered peers will be used by the block
+	 * downloads for this segment once they are opened.
+	 */
+}
+
+/** Upcoming segment discovery operations */
+static struct peerdisc_client_operations peermux_discovery_operations = {
+	.discovered = peermux_discovered,
+};
+
 /**
  * Add PeerDist content-encoding filter
  *
@@ -371,6 +550,8 @@ int peermux_filter ( struct interface *xfer, struct interface *info,
 			       &peermux->refcnt );
 	INIT_LIST_HEAD ( &peermux->busy );
 	INIT_LIST_HEAD ( &peermux->idle );
+	peermux_concurrency_init ( &peermux->concurrency, 0 );
+	peerdisc_init ( &peermux->discovery, &peermux_discovery_operations );
 	for ( i = 0 ; i < PEERMUX_MAX_BLOCKS ; i++ ) {
 		peermblk = &peermux->block[i];
 		peermblk->peermux = peermux;
@@ -39,7 +39,10 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  * This implementation of the timer is designed to satisfy RFC 2988
  * and therefore be usable as a TCP retransmission timer.
- * 
+ *
+ * Running timers are held in a timer wheel, indexed by expiry time.
+ * Each poll needs to inspect only the buckets for the time that has
+ * elapsed since the previous poll, rather than every running timer.
  */
 
 /* The theoretical minimum that the algorithm in stop_timer() can
@@ -48,8 +51,96 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 #define MIN_TIMEOUT 7
 
-/** List of running timers */
-static LIST_HEAD ( timers );
+/** Number of timer wheel buckets
+ *
+ * Must be a power of two.
+ */
+#define RETRY_WHEEL_SIZE 256
+
+/** Approximate timer wheel bucket granularity (in milliseconds)
+ *
+ * Each bucket covers a power-of-two number of ticks, chosen to be
+ * close to (but not more than) this interval, so that the wheel
+ * covers roughly the same span of time on every platform regardless
+ * of the timer tick rate.  A bucket never covers less than a single
+ * tick.  This is a policy decision.
+ */
+#define RETRY_WHEEL_GRANULARITY_MS 1
+
+/** Timer wheel
+ *
+ * Each running timer is held in the bucket corresponding to its
+ * expiry time (modulo the time covered by the wheel).
+ */
+static struct list_head retry_wheel[RETRY_WHEEL_SIZE];
+
+/** Timer wheel bucket granularity (as log2 of ticks per bucket)
+ *
+ * A negative value indicates that the granularity has not yet been
+ * calculated.
+ */
+static int retry_shift = -1;
+
+/** Time up to which the timer wheel has been processed */
+static unsigned long retry_ticks;
+
+/** Number of running timers */
+static unsigned int retry_running;
+
+static void retry_step ( struct process *process );
+
+/** Retry timer process */
+PERMANENT_PROCESS ( retry_process, retry_step );
+
+/**
+ * Get timer wheel bucket granularity
+ *
+ * @ret shift		Log2 of number of ticks per bucket
+ */
+static unsigned int retry_wheel_shift ( void ) {
+	unsigned long ticks;
+
+	/* Calculate granularity, if not already calculated */
+	if ( retry_shift < 0 ) {
+		ticks = ( ( TICKS_PER_SEC * RETRY_WHEEL_GRANULARITY_MS ) /
+			  1000 );
+		retry_shift = 0;
+		while ( ( 2UL << retry_shift ) <= ticks )
+			retry_shift++;
+	}
+
+	return retry_shift;
+}
+
+/**
+ * Get timer wheel slot
+ *
+ * @v ticks		Time, in ticks
+ * @ret slot		Timer wheel slot
+ */
+static inline unsigned long retry_slot ( unsigned long ticks ) {
+
+	return ( ticks >> retry_wheel_shift() );
+}
+
+/**
+ * Get timer wheel bucket
+ *
+ * @v slot		Timer wheel slot
+ * @ret bucket		Timer wheel bucket
+ */
+static struct list_head * retry_bucket ( unsigned long slot ) {
+	struct list_head *bucket;
+
+	/* Identify bucket */
+	bucket = &retry_wheel[ slot & ( RETRY_WHEEL_SIZE - 1 ) ];
+
+	/* Initialise bucket, if not already initialised */
+	if ( ! bucket->next )
+		INIT_LIST_HEAD ( bucket );
+
+	return bucket;
+}
 
 /**
  * Start timer with a specified timeout
@@ -63,19 +154,31 @@ static LIST_HEAD ( timers );
  */
 void start_timer_fixed ( struct retry_timer *timer, unsigned long timeout ) {
 
-	/* Add to list of running timers (if applicable) */
-	if ( ! timer->running ) {
-		list_add ( &timer->list, &timers );
+	/* Remove from timer wheel (if already running) */
+	if ( timer->running ) {
+		list_del ( &timer->list );
+	} else {
 		ref_get ( timer->refcnt );
 		timer->running = 1;
+		retry_running++;
 	}
 
+	/* Wake retry timer process, since it may be sleeping until a
+	 * later expiry time.
+	 */
+	process_wake ( &retry_process );
+
 	/* Record start time */
 	timer->start = currticks();
 
 	/* Record timeout */
 	timer->timeout = timeout;
 
+	/* Add to timer wheel */
+	list_add_tail ( &timer->list,
+			retry_bucket ( retry_slot ( timer->start +
+						    timer->timeout ) ) );
+
 	DBGC2 ( timer, "Timer %p started at time %ld (expires at %ld)\n",
 		timer, timer->start, ( timer->start + timer->timeout ) );
 }
@@ -126,6 +229,7 @@ void stop_timer ( struct retry_timer *timer ) {
 	list_del ( &timer->list );
 	runtime = ( now - timer->start );
 	timer->running = 0;
+	retry_running--;
 	DBGC2 ( timer, "Timer %p stopped at time %ld (ran for %ld)\n",
 		timer, now, runtime );
 
@@ -174,6 +278,7 @@ static void timer_expired ( struct retry_timer *timer ) {
 	assert ( timer->running );
 	list_del ( &timer->list );
 	timer->running = 0;
+	retry_running--;
 	timer->count++;
 
 	/* Back off the timeout value */
@@ -195,22 +300,67 @@ static void timer_expired ( struct retry_timer *timer ) {
  *
  */
 void retry_poll ( void ) {
+	LIST_HEAD ( expired );
 	struct retry_timer *timer;
+	struct retry_timer *tmp;
+	struct list_head *bucket;
 	unsigned long now = currticks();
-	unsigned long used;
+	unsigned long now_slot = retry_slot ( now );
+	unsigned long elapsed;
+	unsigned long slot;
 
-	/* Process at most one timer expiry.  We cannot process
-	 * multiple expiries in one pass, because one timer expiring
-	 * may end up triggering another timer's deletion from the
-	 * list.
+	/* Collect expired timers from the bucket for each slot that
+	 * has elapsed since the previous poll.  The bucket for the
+	 * current slot is always examined again, since further
+	 * timers may have been added to it since the previous poll,
+	 * and timers within it may not yet have expired.
 	 */
-	list_for_each_entry ( timer, &timers, list ) {
-		used = ( now - timer->start );
-		if ( used >= timer->timeout ) {
-			timer_expired ( timer );
-			break;
+	elapsed = ( now_slot - retry_slot ( retry_ticks ) );
+	if ( elapsed >= RETRY_WHEEL_SIZE )
+		elapsed = ( RETRY_WHEEL_SIZE - 1 );
+	for ( slot = ( now_slot - elapsed ) ; slot != ( now_slot + 1 ) ;
+	      slot++ ) {
+		bucket = retry_bucket ( slot );
+		list_for_each_entry_safe ( timer, tmp, bucket, list ) {
+			if ( ( now - timer->start ) >= timer->timeout ) {
+				list_del ( &timer->list );
+				list_add_tail ( &timer->list, &expired );
+			}
 		}
 	}
+	retry_ticks = now;
+
+	/* Process each expired timer.  An expiry callback may stop
+	 * or restart any other timer (including timers that are
+	 * still on the list of expired timers), so we must take the
+	 * first remaining expired timer afresh each time.  Timers
+	 * restarted by a callback are returned to the timer wheel,
+	 * and so cannot expire again within this poll.
+	 */
+	while ( ( timer = list_first_entry ( &expired, struct retry_timer,
+					     list ) ) != NULL ) {
+		timer_expired ( timer );
+	}
+}
+
+/**
+ * Calculate time until next possible timer expiry
+ *
+ * @ret timeout		Time until next possible expiry, in ticks
+ *
+ * A timer wheel bucket may contain timers due to expire on later
+ * revolutions of the wheel, so the returned time may be earlier than
+ * the true next expiry time.
+ */
+static unsigned long retry_next ( void ) {
+	unsigned long slot = retry_slot ( retry_ticks );
+	unsigned int i;
+
+	for ( i = 1 ; i < RETRY_WHEEL_SIZE ; i++ ) {
+		if ( ! list_empty ( retry_bucket ( slot + i ) ) )
+			break;
+	}
+	return ( ( ( slot + i ) << retry_wheel_shift() ) - retry_ticks );
 }
 
 /**
@@ -218,9 +368,17 @@ void retry_poll ( void ) {
  *
  * @v process		Retry timer process
  */
-static void retry_step ( struct process *process __unused ) {
+static void retry_step ( struct process *process ) {
+
+	/* Poll timers */
 	retry_poll();
-}
 
-/** Retry timer process */
-PERMANENT_PROCESS ( retry_process, retry_step );
+	/* Sleep until a timer is started, if no timers are running,
+	 * otherwise sleep until the next timer may expire.
+	 */
+	if ( ! retry_running ) {
+		process_idle ( process );
+	} else {
+		process_sleep ( process, retry_next() );
+	}
+}
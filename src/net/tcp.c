@@ -18,6 +18,7 @@
 #include <ipxe/profile.h>
 #include <ipxe/process.h>
 #include <ipxe/tcpip.h>
+#include <ipxe/trace.h>
 #include <ipxe/tcp.h>
 
 /** @file
@@ -34,6 +35,8 @@ struct tcp_connection {
 	struct refcnt refcnt;
 	/** List of TCP connections */
 	struct list_head list;
+	/** List of TCP connections within local port hash bucket */
+	struct list_head hash;
 
 	/** Flags */
 	unsigned int flags;
@@ -164,6 +167,11 @@ struct tcp_rx_queued_header {
  */
 static LIST_HEAD ( tcp_conns );
 
+/**
+ * TCP connections hashed by local port
+ */
+static struct list_head tcp_hash[TCPIP_PORT_HASH_SIZE];
+
 /** Transmit profiler */
 static struct profiler tcp_tx_profiler __profiler = { .name = "tcp.tx" };
 
@@ -217,6 +225,7 @@ tcp_dump_state ( struct tcp_connection *tcp ) {
 		DBGC ( tcp, "TCP %p transitioned from %s to %s\n", tcp,
 		       tcp_state ( tcp->prev_tcp_state ),
 		       tcp_state ( tcp->tcp_state ) );
+		trace ( TRACE_TCP_STATE, tcp, tcp->tcp_state );
 	}
 	tcp->prev_tcp_state = tcp->tcp_state;
 }
@@ -325,6 +334,7 @@ static int tcp_open ( struct interface *xfer, struct sockaddr *peer,
 	 */
 	intf_plug_plug ( &tcp->xfer, xfer );
 	list_add ( &tcp->list, &tcp_conns );
+	list_add ( &tcp->hash, &tcp_hash[ tcpip_port_hash ( port ) ] );
 	return 0;
 
  err:
@@ -382,6 +392,7 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
 		stop_timer ( &tcp->timer );
 		stop_timer ( &tcp->wait );
 		list_del ( &tcp->list );
+		list_del ( &tcp->hash );
 		ref_put ( &tcp->refcnt );
 		DBGC ( tcp, "TCP %p connection deleted\n", tcp );
 		return;
@@ -727,7 +738,8 @@ static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
 	tcphdr->hlen = ( ( payload - iobuf->data ) << 2 );
 	tcphdr->flags = flags;
 	tcphdr->win = htons ( tcp->rcv_win >> tcp->rcv_win_scale );
-	tcphdr->csum = tcpip_chksum ( iobuf->data, iob_len ( iobuf ) );
+	tcphdr->csum = TCPIP_EMPTY_CSUM;
+	iob_csum_partial ( iobuf, tcphdr, &tcphdr->csum );
 
 	/* Dump header */
 	DBGC2 ( tcp, "TCP %p TX %d->%d %08x..%08x           %08x %4zd",
@@ -797,6 +809,7 @@ static void tcp_expired ( struct retry_timer *timer, int over ) {
 		tcp_close ( tcp, -ETIMEDOUT );
 	} else {
 		/* Otherwise, retransmit the packet */
+		trace ( TRACE_TCP_RETRANSMIT, tcp, tcp->snd_seq );
 		tcp_xmit ( tcp );
 	}
 }
@@ -855,7 +868,8 @@ static int tcp_xmit_reset ( struct tcp_connection *tcp,
 	tcphdr->hlen = ( ( sizeof ( *tcphdr ) / 4 ) << 4 );
 	tcphdr->flags = ( TCP_RST | TCP_ACK );
 	tcphdr->win = htons ( 0 );
-	tcphdr->csum = tcpip_chksum ( iobuf->data, iob_len ( iobuf ) );
+	tcphdr->csum = TCPIP_EMPTY_CSUM;
+	iob_csum_partial ( iobuf, tcphdr, &tcphdr->csum );
 
 	/* Dump header */
 	DBGC2 ( tcp, "TCP %p TX %d->%d %08x..%08x           %08x %4d",
@@ -892,9 +906,10 @@ static int tcp_xmit_reset ( struct tcp_connection *tcp,
  * @ret tcp		TCP connection, or NULL
  */
 static struct tcp_connection * tcp_demux ( unsigned int local_port ) {
+	struct list_head *bucket = &tcp_hash[ tcpip_port_hash ( local_port ) ];
 	struct tcp_connection *tcp;
 
-	list_for_each_entry ( tcp, &tcp_conns, list ) {
+	list_for_each_entry ( tcp, bucket, hash ) {
 		if ( tcp->local_port == local_port )
 			return tcp;
 	}
@@ -1312,7 +1327,7 @@ static void tcp_process_rx_queue ( struct tcp_connection *tcp ) {
  * @ret rc		Return status code
   */
 static int tcp_rx ( struct io_buffer *iobuf,
-		    struct net_device *netdev __unused,
+		    struct net_device *netdev,
 		    struct sockaddr_tcpip *st_src,
 		    struct sockaddr_tcpip *st_dest __unused,
 		    uint16_t pshdr_csum ) {
@@ -1354,8 +1369,7 @@ static int tcp_rx ( struct io_buffer *iobuf,
 		rc = -EINVAL;
 		goto discard;
 	}
-	csum = tcpip_continue_chksum ( pshdr_csum, iobuf->data,
-				       iob_len ( iobuf ) );
+	csum = tcpip_rx_chksum ( iobuf, netdev, pshdr_csum, iob_len ( iobuf ) );
 	if ( csum != 0 ) {
 		DBG ( "TCP checksum incorrect (is %04x including checksum "
 		      "field, should be 0000)\n", csum );
@@ -1572,6 +1586,24 @@ static void tcp_shutdown ( int booting __unused ) {
 	}
 }
 
+/**
+ * Initialise TCP connection hash table
+ *
+ */
+static void tcp_init ( void ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < ( sizeof ( tcp_hash ) /
+			    sizeof ( tcp_hash[0] ) ) ; i++ ) {
+		INIT_LIST_HEAD ( &tcp_hash[i] );
+	}
+}
+
+/** TCP initialisation function */
+struct init_fn tcp_init_fn __init_fn ( INIT_NORMAL ) = {
+	.initialise = tcp_init,
+};
+
 /** TCP shutdown function */
 struct startup_fn tcp_startup_fn __startup_fn ( STARTUP_LATE ) = {
 	.shutdown = tcp_shutdown,
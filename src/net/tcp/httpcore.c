@@ -54,6 +54,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/version.h>
 #include <ipxe/params.h>
 #include <ipxe/profile.h>
+#include <ipxe/trace.h>
 #include <ipxe/vsprintf.h>
 #include <ipxe/http.h>
 
@@ -261,6 +262,26 @@ static void http_free ( struct refcnt *refcnt ) {
 	free ( http );
 }
 
+/**
+ * Record completion of outstanding HTTP request, if any
+ *
+ * @v http		HTTP transaction
+ * @v rc		Request status code
+ *
+ * Each request may be retried (e.g. after a stale connection or an
+ * authentication challenge) or redirected, so that a transaction may
+ * involve several requests.  Every request that is sent must be
+ * recorded as completed exactly once, in order to allow trace event
+ * beginnings and ends to be paired.
+ */
+static void http_request_done ( struct http_transaction *http, int rc ) {
+
+	if ( http->outstanding ) {
+		trace ( TRACE_HTTP_CLOSE, http, rc );
+		http->outstanding = 0;
+	}
+}
+
 /**
  * Close HTTP transaction
  *
@@ -269,6 +290,9 @@ static void http_free ( struct refcnt *refcnt ) {
  */
 static void http_close ( struct http_transaction *http, int rc ) {
 
+	/* Record end of any outstanding request */
+	http_request_done ( http, rc );
+
 	/* Stop process */
 	process_del ( &http->process );
 
@@ -306,6 +330,9 @@ static void http_close_error ( struct http_transaction *http, int rc ) {
 static void http_reopen ( struct http_transaction *http ) {
 	int rc;
 
+	/* Abandon any outstanding request */
+	http_request_done ( http, -ECANCELED );
+
 	/* Close existing connection */
 	intf_restart ( &http->conn, -ECANCELED );
 
@@ -740,6 +767,9 @@ static int http_transfer_complete ( struct http_transaction *http ) {
 	const char *location;
 	int rc;
 
+	/* Record end of request */
+	http_request_done ( http, http->response.rc );
+
 	/* Keep connection alive if applicable */
 	if ( http->response.flags & HTTP_RESPONSE_KEEPALIVE )
 		pool_recycle ( &http->conn );
@@ -1082,6 +1112,8 @@ static int http_tx_request ( struct http_transaction *http ) {
 		       http, strerror ( rc ) );
 		goto err_deliver;
 	}
+	trace ( TRACE_HTTP_REQUEST, http, 0 );
+	http->outstanding = 1;
 
 	/* Clear any previous response */
 	empty_line_buffer ( &http->response.headers );
@@ -1472,6 +1504,7 @@ static int http_rx_headers ( struct http_transaction *http,
 	/* Process headers */
 	if ( ( rc = http_parse_headers ( http ) ) != 0 )
 		return rc;
+	trace ( TRACE_HTTP_RESPONSE, http, http->response.status );
 
 	/* Initialise content encoding, if applicable */
 	if ( ( content = http->response.content.encoding ) &&
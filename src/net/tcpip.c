@@ -205,6 +205,77 @@ uint16_t tcpip_chksum ( const void *data, size_t len ) {
 	return tcpip_continue_chksum ( TCPIP_EMPTY_CSUM, data, len );
 }
 
+/**
+ * Complete transport-layer checksum of transmitted packet
+ *
+ * @v iobuf		I/O buffer
+ * @v tcpip_protocol	Transport-layer protocol
+ * @v netdev		Transmitting network device
+ * @v trans_csum	Transport-layer checksum
+ *
+ * The transport-layer checksum must already include the
+ * pseudo-header checksum.  If the I/O buffer is marked with
+ * IOB_CSUM_PARTIAL, then the remainder of the checksum will be left
+ * for the hardware to complete (if the network device supports
+ * transmit checksum offload) or will be calculated in software.
+ */
+void tcpip_tx_chksum ( struct io_buffer *iobuf,
+		       struct tcpip_protocol *tcpip_protocol,
+		       struct net_device *netdev, uint16_t *trans_csum ) {
+	uint16_t partial;
+
+	/* Complete partial checksum, if applicable */
+	if ( iobuf->csum_flags & IOB_CSUM_PARTIAL ) {
+
+		/* Leave for hardware to complete, if possible.  The
+		 * hardware expects the checksum field to hold the
+		 * uncomplemented pseudo-header checksum.
+		 */
+		if ( netdev->offloads & NETDEV_OFFLOAD_TX_CSUM ) {
+			*trans_csum = ~( *trans_csum );
+			netdev->tx_stats.csum++;
+			return;
+		}
+
+		/* Otherwise, complete checksum in software */
+		partial = *trans_csum;
+		*trans_csum = 0;
+		*trans_csum = tcpip_continue_chksum ( partial,
+						      iobuf->csum_start,
+						      ( iobuf->tail -
+							iobuf->csum_start ) );
+		iobuf->csum_flags &= ~IOB_CSUM_PARTIAL;
+	}
+
+	/* Use preferred zero checksum value */
+	if ( ! *trans_csum )
+		*trans_csum = tcpip_protocol->zero_csum;
+}
+
+/**
+ * Verify transport-layer checksum of received packet
+ *
+ * @v iobuf		I/O buffer
+ * @v netdev		Network device
+ * @v pshdr_csum	Pseudo-header checksum
+ * @v len		Length of transport-layer data
+ * @ret csum		Checksum (zero if correct)
+ *
+ * Packets for which the hardware has already verified the checksum
+ * will not be checksummed again in software.
+ */
+uint16_t tcpip_rx_chksum ( struct io_buffer *iobuf, struct net_device *netdev,
+			   uint16_t pshdr_csum, size_t len ) {
+
+	/* Skip verification if already verified by hardware */
+	if ( iobuf->csum_flags & IOB_CSUM_VALID ) {
+		netdev->rx_stats.csum++;
+		return 0;
+	}
+
+	return tcpip_continue_chksum ( pshdr_csum, iobuf->data, len );
+}
+
 /**
  * Bind to local TCP/IP port
  *
@@ -47,6 +47,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/certstore.h>
 #include <ipxe/rbg.h>
 #include <ipxe/validator.h>
+#include <ipxe/trace.h>
 #include <ipxe/tls.h>
 
 /* Disambiguate the various error causes */
@@ -102,6 +103,10 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define EINFO_EINVAL_MAC						\
 	__einfo_uniqify ( EINFO_EINVAL, 0x0d,				\
 			  "Invalid MAC" )
+#define EINVAL_CERT_STATUS __einfo_error ( EINFO_EINVAL_CERT_STATUS )
+#define EINFO_EINVAL_CERT_STATUS					\
+	__einfo_uniqify ( EINFO_EINVAL, 0x0e,				\
+			  "Invalid Certificate Status" )
 #define EIO_ALERT __einfo_error ( EINFO_EIO_ALERT )
 #define EINFO_EIO_ALERT							\
 	__einfo_uniqify ( EINFO_EINVAL, 0x01,				\
@@ -134,6 +139,10 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define EINFO_ENOMEM_RX_CONCAT						\
 	__einfo_uniqify ( EINFO_ENOMEM, 0x08,				\
 			  "Not enough space to concatenate received data" )
+#define ENOMEM_STAPLED __einfo_error ( EINFO_ENOMEM_STAPLED )
+#define EINFO_ENOMEM_STAPLED						\
+	__einfo_uniqify ( EINFO_ENOMEM, 0x09,				\
+			  "Not enough space for stapled OCSP response" )
 #define ENOTSUP_CIPHER __einfo_error ( EINFO_ENOTSUP_CIPHER )
 #define EINFO_ENOTSUP_CIPHER						\
 	__einfo_uniqify ( EINFO_ENOTSUP, 0x01,				\
@@ -321,6 +330,7 @@ static void free_tls ( struct refcnt *refcnt ) {
 	}
 	x509_put ( tls->cert );
 	x509_chain_put ( tls->chain );
+	free ( tls->stapled );
 
 	/* Free TLS structure itself */
 	free ( tls );	
@@ -334,6 +344,10 @@ static void free_tls ( struct refcnt *refcnt ) {
  */
 static void tls_close ( struct tls_session *tls, int rc ) {
 
+	/* Record end of handshake, if still in progress */
+	if ( is_pending ( &tls->server_negotiation ) )
+		trace ( TRACE_TLS_READY, tls, rc );
+
 	/* Remove pending operations, if applicable */
 	pending_put ( &tls->client_negotiation );
 	pending_put ( &tls->server_negotiation );
@@ -954,6 +968,13 @@ static int tls_send_client_hello ( struct tls_session *tls ) {
 				struct tls_signature_hash_id
 					code[TLS_NUM_SIG_HASH_ALGORITHMS];
 			} __attribute__ (( packed )) signature_algorithms;
+			uint16_t status_request_type;
+			uint16_t status_request_len;
+			struct {
+				uint8_t type;
+				uint16_t responder_id_list_len;
+				uint16_t request_extensions_len;
+			} __attribute__ (( packed )) status_request;
 		} __attribute__ (( packed )) extensions;
 	} __attribute__ (( packed )) hello;
 	struct tls_cipher_suite *suite;
@@ -995,6 +1016,10 @@ static int tls_send_client_hello ( struct tls_session *tls ) {
 		= htons ( sizeof ( hello.extensions.signature_algorithms.code));
 	i = 0 ; for_each_table_entry ( sighash, TLS_SIG_HASH_ALGORITHMS )
 		hello.extensions.signature_algorithms.code[i++] = sighash->code;
+	hello.extensions.status_request_type = htons ( TLS_STATUS_REQUEST );
+	hello.extensions.status_request_len
+		= htons ( sizeof ( hello.extensions.status_request ) );
+	hello.extensions.status_request.type = TLS_STATUS_REQUEST_OCSP;
 
 	return tls_send_handshake ( tls, &hello, sizeof ( hello ) );
 }
@@ -1475,6 +1500,61 @@ static int tls_new_certificate ( struct tls_session *tls,
 	return 0;
 }
 
+/**
+ * Receive new Certificate Status handshake record
+ *
+ * @v tls		TLS session
+ * @v data		Plaintext handshake record
+ * @v len		Length of plaintext handshake record
+ * @ret rc		Return status code
+ */
+static int tls_new_certificate_status ( struct tls_session *tls,
+					const void *data, size_t len ) {
+	const struct {
+		uint8_t type;
+		tls24_t length;
+		uint8_t response[0];
+	} __attribute__ (( packed )) *status = data;
+	size_t response_len;
+	const void *end;
+
+	/* Sanity check */
+	if ( len < sizeof ( *status ) ) {
+		DBGC ( tls, "TLS %p received underlength Certificate Status\n",
+		       tls );
+		DBGC_HD ( tls, data, len );
+		return -EINVAL_CERT_STATUS;
+	}
+	response_len = tls_uint24 ( &status->length );
+	end = ( status->response + response_len );
+	if ( ( response_len == 0 ) || ( end != ( data + len ) ) ) {
+		DBGC ( tls, "TLS %p received malformed Certificate Status\n",
+		       tls );
+		DBGC_HD ( tls, data, len );
+		return -EINVAL_CERT_STATUS;
+	}
+
+	/* Ignore unknown status types */
+	if ( status->type != TLS_STATUS_REQUEST_OCSP ) {
+		DBGC ( tls, "TLS %p ignoring certificate status type %d\n",
+		       tls, status->type );
+		return 0;
+	}
+
+	/* Record stapled OCSP response for use by the validator */
+	free ( tls->stapled );
+	tls->stapled_len = 0;
+	tls->stapled = malloc ( response_len );
+	if ( ! tls->stapled )
+		return -ENOMEM_STAPLED;
+	memcpy ( tls->stapled, status->response, response_len );
+	tls->stapled_len = response_len;
+	DBGC ( tls, "TLS %p received %zd-byte stapled OCSP response\n",
+	       tls, response_len );
+
+	return 0;
+}
+
 /**
  * Receive new Certificate Request handshake record
  *
@@ -1533,7 +1613,9 @@ static int tls_new_server_hello_done ( struct tls_session *tls,
 	}
 
 	/* Begin certificate validation */
-	if ( ( rc = create_validator ( &tls->validator, tls->chain ) ) != 0 ) {
+	if ( ( rc = create_validator ( &tls->validator, tls->chain,
+				       tls->stapled,
+				       tls->stapled_len ) ) != 0 ) {
 		DBGC ( tls, "TLS %p could not start certificate validation: "
 		       "%s\n", tls, strerror ( rc ) );
 		return rc;
@@ -1581,6 +1663,7 @@ static int tls_new_finished ( struct tls_session *tls,
 
 	/* Mark server as finished */
 	pending_put ( &tls->server_negotiation );
+	trace ( TRACE_TLS_READY, tls, 0 );
 
 	/* Send notification of a window change */
 	xfer_window_changed ( &tls->plainstream );
@@ -1619,6 +1702,7 @@ static int tls_new_handshake ( struct tls_session *tls,
 			return -EINVAL_HANDSHAKE;
 		}
 
+		trace ( TRACE_TLS_HANDSHAKE, tls, handshake->type );
 		switch ( handshake->type ) {
 		case TLS_SERVER_HELLO:
 			rc = tls_new_server_hello ( tls, payload, payload_len );
@@ -1626,6 +1710,10 @@ static int tls_new_handshake ( struct tls_session *tls,
 		case TLS_CERTIFICATE:
 			rc = tls_new_certificate ( tls, payload, payload_len );
 			break;
+		case TLS_CERTIFICATE_STATUS:
+			rc = tls_new_certificate_status ( tls, payload,
+							  payload_len );
+			break;
 		case TLS_CERTIFICATE_REQUEST:
 			rc = tls_new_certificate_request ( tls, payload,
 							   payload_len );
@@ -2595,6 +2683,7 @@ int add_tls ( struct interface *xfer, const char *name,
 	/* Add pending operations for server and client Finished messages */
 	pending_get ( &tls->client_negotiation );
 	pending_get ( &tls->server_negotiation );
+	trace ( TRACE_TLS_START, tls, 0 );
 
 	/* Attach to parent interface, mortalise self, and return */
 	intf_plug_plug ( &tls->plainstream, xfer );
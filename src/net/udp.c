@@ -5,6 +5,7 @@
 #include <byteswap.h>
 #include <errno.h>
 #include <ipxe/tcpip.h>
+#include <ipxe/init.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/xfer.h>
 #include <ipxe/open.h>
@@ -26,7 +27,12 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 struct udp_connection {
 	/** Reference counter */
 	struct refcnt refcnt;
-	/** List of UDP connections */
+	/** List of UDP connections
+	 *
+	 * Connections bound to a local port are held in the hash
+	 * bucket for that port; connections accepting any local port
+	 * are held in the wildcard list.
+	 */
 	struct list_head list;
 
 	/** Data transfer interface */
@@ -39,9 +45,14 @@ struct udp_connection {
 };
 
 /**
- * List of registered UDP connections
+ * UDP connections hashed by local port
+ */
+static struct list_head udp_hash[TCPIP_PORT_HASH_SIZE];
+
+/**
+ * List of UDP connections accepting any local port
  */
-static LIST_HEAD ( udp_conns );
+static LIST_HEAD ( udp_wildcard );
 
 /* Forward declatations */
 static struct interface_descriptor udp_xfer_desc;
@@ -54,9 +65,10 @@ struct tcpip_protocol udp_protocol __tcpip_protocol;
  * @ret port		Local port number, or negative error
  */
 static int udp_port_available ( int port ) {
+	struct list_head *bucket = &udp_hash[ tcpip_port_hash ( port ) ];
 	struct udp_connection *udp;
 
-	list_for_each_entry ( udp, &udp_conns, list ) {
+	list_for_each_entry ( udp, bucket, list ) {
 		if ( udp->local.st_port == htons ( port ) )
 			return -EADDRINUSE;
 	}
@@ -111,7 +123,12 @@ static int udp_open_common ( struct interface *xfer,
 	 * list and return
 	 */
 	intf_plug_plug ( &udp->xfer, xfer );
-	list_add ( &udp->list, &udp_conns );
+	if ( udp->local.st_port ) {
+		list_add ( &udp->list, &udp_hash[ tcpip_port_hash (
+					ntohs ( udp->local.st_port ) ) ] );
+	} else {
+		list_add ( &udp->list, &udp_wildcard );
+	}
 	return 0;
 
  err:
@@ -219,16 +236,18 @@ static int udp_tx ( struct udp_connection *udp, struct io_buffer *iobuf,
 }
 
 /**
- * Identify UDP connection by local address
+ * Identify UDP connection by local address within a list
  *
+ * @v list		List of UDP connections
  * @v local		Local address
  * @ret udp		UDP connection, or NULL
  */
-static struct udp_connection * udp_demux ( struct sockaddr_tcpip *local ) {
+static struct udp_connection *
+udp_demux_list ( struct list_head *list, struct sockaddr_tcpip *local ) {
 	static const struct sockaddr_tcpip empty_sockaddr = { .pad = { 0, } };
 	struct udp_connection *udp;
 
-	list_for_each_entry ( udp, &udp_conns, list ) {
+	list_for_each_entry ( udp, list, list ) {
 		if ( ( ( udp->local.st_family == local->st_family ) ||
 		       ( udp->local.st_family == 0 ) ) &&
 		     ( ( udp->local.st_port == local->st_port ) ||
@@ -243,6 +262,29 @@ static struct udp_connection * udp_demux ( struct sockaddr_tcpip *local ) {
 	return NULL;
 }
 
+/**
+ * Identify UDP connection by local address
+ *
+ * @v local		Local address
+ * @ret udp		UDP connection, or NULL
+ *
+ * Connections bound to a specific local port take precedence over
+ * connections accepting any local port (i.e. promiscuous connections
+ * used by the PXE API).
+ */
+static struct udp_connection * udp_demux ( struct sockaddr_tcpip *local ) {
+	struct list_head *bucket;
+	struct udp_connection *udp;
+
+	/* Check for a connection bound to this local port */
+	bucket = &udp_hash[ tcpip_port_hash ( ntohs ( local->st_port ) ) ];
+	if ( ( udp = udp_demux_list ( bucket, local ) ) != NULL )
+		return udp;
+
+	/* Check for a connection accepting any local port */
+	return udp_demux_list ( &udp_wildcard, local );
+}
+
 /**
  * Process a received packet
  *
@@ -254,7 +296,7 @@ static struct udp_connection * udp_demux ( struct sockaddr_tcpip *local ) {
  * @ret rc		Return status code
  */
 static int udp_rx ( struct io_buffer *iobuf,
-		    struct net_device *netdev __unused,
+		    struct net_device *netdev,
 		    struct sockaddr_tcpip *st_src,
 		    struct sockaddr_tcpip *st_dest, uint16_t pshdr_csum ) {
 	struct udp_header *udphdr = iobuf->data;
@@ -286,7 +328,7 @@ static int udp_rx ( struct io_buffer *iobuf,
 		goto done;
 	}
 	if ( udphdr->chksum ) {
-		csum = tcpip_continue_chksum ( pshdr_csum, iobuf->data, ulen );
+		csum = tcpip_rx_chksum ( iobuf, netdev, pshdr_csum, ulen );
 		if ( csum != 0 ) {
 			DBG ( "UDP checksum incorrect (is %04x including "
 			      "checksum field, should be 0000)\n", csum );
@@ -332,6 +374,24 @@ struct tcpip_protocol udp_protocol __tcpip_protocol = {
 	.tcpip_proto = IP_UDP,
 };
 
+/**
+ * Initialise UDP connection hash table
+ *
+ */
+static void udp_init ( void ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < ( sizeof ( udp_hash ) /
+			    sizeof ( udp_hash[0] ) ) ; i++ ) {
+		INIT_LIST_HEAD ( &udp_hash[i] );
+	}
+}
+
+/** UDP initialisation function */
+struct init_fn udp_init_fn __init_fn ( INIT_NORMAL ) = {
+	.initialise = udp_init,
+};
+
 /***************************************************************************
  *
  * Data transfer interface
@@ -29,11 +29,15 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
 #include <ctype.h>
 #include <errno.h>
 #include <byteswap.h>
 #include <ipxe/refcnt.h>
+#include <ipxe/malloc.h>
+#include <ipxe/timer.h>
+#include <ipxe/process.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/xfer.h>
 #include <ipxe/open.h>
@@ -44,6 +48,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/features.h>
 #include <ipxe/dhcp.h>
 #include <ipxe/dhcpv6.h>
+#include <ipxe/trace.h>
 #include <ipxe/dns.h>
 
 /** @file
@@ -435,6 +440,254 @@ static const char * dns_type ( uint16_t type ) {
 	}
 }
 
+/** A cached DNS result */
+struct dns_cache_entry {
+	/** List of cached results */
+	struct list_head list;
+	/** Address family */
+	sa_family_t family;
+	/** Resolved address (if successful) */
+	union {
+		struct sockaddr sa;
+		struct sockaddr_in sin;
+		struct sockaddr_in6 sin6;
+	} address;
+	/** Status code */
+	int rc;
+	/** Time at which result was cached */
+	unsigned long created;
+	/** Time for which result remains valid (in ticks) */
+	unsigned long ttl;
+	/** Name
+	 *
+	 * Must be at end of structure
+	 */
+	char name[0];
+};
+
+/** DNS cache
+ *
+ * Entries are kept in order of most recent use.
+ */
+static LIST_HEAD ( dns_cache );
+
+/** Number of entries in DNS cache */
+static unsigned int dns_cache_count;
+
+/** DNS statistics */
+struct dns_statistics dns_stats;
+
+/**
+ * Remove entry from DNS cache
+ *
+ * @v entry		Cached result
+ */
+static void dns_cache_del ( struct dns_cache_entry *entry ) {
+
+	DBGC2 ( &dns_cache, "DNS cache discarding \"%s\"\n", entry->name );
+	list_del ( &entry->list );
+	dns_cache_count--;
+	free ( entry );
+}
+
+/**
+ * Find entry in DNS cache
+ *
+ * @v name		Name
+ * @v family		Address family
+ * @ret entry		Cached result, or NULL if not found
+ */
+static struct dns_cache_entry * dns_cache_find ( const char *name,
+						 sa_family_t family ) {
+	struct dns_cache_entry *entry;
+	struct dns_cache_entry *tmp;
+	unsigned long now = currticks();
+
+	list_for_each_entry_safe ( entry, tmp, &dns_cache, list ) {
+
+		/* Discard any expired entries */
+		if ( ( now - entry->created ) >= entry->ttl ) {
+			dns_cache_del ( entry );
+			continue;
+		}
+
+		/* Move matching entry to head of list */
+		if ( ( entry->family == family ) &&
+		     ( strcasecmp ( entry->name, name ) == 0 ) ) {
+			list_del ( &entry->list );
+			list_add ( &entry->list, &dns_cache );
+			dns_stats.hits++;
+			return entry;
+		}
+	}
+
+	dns_stats.misses++;
+	return NULL;
+}
+
+/**
+ * Add result to DNS cache
+ *
+ * @v name		Name
+ * @v family		Address family
+ * @v sa		Resolved address, or NULL for a negative result
+ * @v ttl		Time to live (in seconds)
+ * @ret rc		Return status code
+ *
+ * Results with a zero time to live are not cached.  Any existing
+ * result for the same name and address family is replaced.
+ */
+int dns_cache_add ( const char *name, sa_family_t family,
+		    struct sockaddr *sa, unsigned long ttl ) {
+	struct dns_cache_entry *entry;
+	unsigned long max_ttl;
+
+	/* Limit time to live */
+	max_ttl = ( sa ? DNS_CACHE_MAX_TTL : DNS_CACHE_MAX_NEGATIVE_TTL );
+	if ( ttl > max_ttl )
+		ttl = max_ttl;
+	if ( ! ttl )
+		return 0;
+
+	/* Remove any existing entry for this name */
+	list_for_each_entry ( entry, &dns_cache, list ) {
+		if ( ( entry->family == family ) &&
+		     ( strcasecmp ( entry->name, name ) == 0 ) ) {
+			dns_cache_del ( entry );
+			break;
+		}
+	}
+
+	/* Discard least recently used entry, if cache is full */
+	if ( dns_cache_count >= DNS_CACHE_MAX ) {
+		dns_cache_del ( list_last_entry ( &dns_cache,
+						  struct dns_cache_entry,
+						  list ) );
+	}
+
+	/* Allocate and populate entry */
+	entry = zalloc ( sizeof ( *entry ) + strlen ( name ) + 1 /* NUL */ );
+	if ( ! entry )
+		return -ENOMEM;
+	strcpy ( entry->name, name );
+	entry->family = family;
+	if ( sa ) {
+		memcpy ( &entry->address.sa, sa, sizeof ( entry->address ) );
+	} else {
+		entry->rc = -ENXIO_NO_RECORD;
+	}
+	entry->created = currticks();
+	entry->ttl = ( ttl * TICKS_PER_SEC );
+
+	/* Add to cache */
+	list_add ( &entry->list, &dns_cache );
+	dns_cache_count++;
+	DBGC ( &dns_cache, "DNS cache caching \"%s\" as %s for %lus\n", name,
+	       ( sa ? sock_ntoa ( sa ) : strerror ( entry->rc ) ), ttl );
+
+	return 0;
+}
+
+/**
+ * Get time to live of cached DNS result
+ *
+ * @v name		Name
+ * @v family		Address family
+ * @ret ttl		Time to live (in seconds), or zero if not cached
+ *
+ * The time to live is that with which the result was cached, not the
+ * remaining lifetime.  The cache statistics are not updated.
+ */
+unsigned long dns_cache_ttl ( const char *name, sa_family_t family ) {
+	struct dns_cache_entry *entry;
+
+	list_for_each_entry ( entry, &dns_cache, list ) {
+		if ( ( entry->family == family ) &&
+		     ( strcasecmp ( entry->name, name ) == 0 ) ) {
+			return ( entry->ttl / TICKS_PER_SEC );
+		}
+	}
+	return 0;
+}
+
+/**
+ * Flush DNS cache
+ *
+ */
+void dns_cache_flush ( void ) {
+	struct dns_cache_entry *entry;
+	struct dns_cache_entry *tmp;
+
+	list_for_each_entry_safe ( entry, tmp, &dns_cache, list )
+		dns_cache_del ( entry );
+}
+
+/**
+ * Discard some cached DNS results
+ *
+ * @ret discarded	Number of cached items discarded
+ */
+static unsigned int dns_cache_discard ( void ) {
+	struct dns_cache_entry *entry;
+
+	/* Drop least recently used entry, if any */
+	entry = list_last_entry ( &dns_cache, struct dns_cache_entry, list );
+	if ( entry ) {
+		dns_cache_del ( entry );
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+/**
+ * DNS cache discarder
+ *
+ * Cached DNS results are deemed to have a low replacement cost,
+ * since recreating a result requires only a single query.
+ */
+struct cache_discarder dns_discarder __cache_discarder ( CACHE_CHEAP ) = {
+	.discard = dns_cache_discard,
+};
+
+/**
+ * Calculate negative caching time from DNS "SOA" record
+ *
+ * @v buf		DNS response
+ * @v offset		Offset of resource record
+ * @ret ttl		Negative caching time (in seconds), or zero
+ */
+static unsigned long dns_soa_ttl ( struct dns_name *buf, size_t offset ) {
+	union dns_rr *rr = ( buf->data + offset );
+	struct dns_soa_tail *tail;
+	struct dns_name soa;
+	unsigned long ttl;
+	unsigned long minimum;
+	int tail_offset;
+
+	/* Skip MNAME and RNAME fields */
+	soa.data = buf->data;
+	soa.offset = ( offset + sizeof ( rr->common ) );
+	soa.len = ( soa.offset + ntohs ( rr->common.rdlength ) );
+	tail_offset = dns_skip ( &soa );
+	if ( tail_offset < 0 )
+		return 0;
+	soa.offset = tail_offset;
+	tail_offset = dns_skip ( &soa );
+	if ( tail_offset < 0 )
+		return 0;
+	if ( ( tail_offset + sizeof ( *tail ) ) > soa.len )
+		return 0;
+	tail = ( buf->data + tail_offset );
+
+	/* Use the lower of the SOA record's own TTL and its minimum
+	 * field, as per RFC 2308 section 5.
+	 */
+	ttl = ntohl ( rr->common.ttl );
+	minimum = ntohl ( tail->minimum );
+	return ( ( ttl < minimum ) ? ttl : minimum );
+}
+
 /** A DNS request */
 struct dns_request {
 	/** Reference counter */
@@ -445,13 +698,19 @@ struct dns_request {
 	struct interface socket;
 	/** Retry timer */
 	struct retry_timer timer;
+	/** Cached result delivery process */
+	struct process process;
 
+	/** Name being resolved */
+	char *hostname;
 	/** Socket address to fill in with resolved address */
 	union {
 		struct sockaddr sa;
 		struct sockaddr_in sin;
 		struct sockaddr_in6 sin6;
 	} address;
+	/** Address family */
+	sa_family_t family;
 	/** Initial query type */
 	uint16_t qtype;
 	/** Buffer for current query */
@@ -475,6 +734,12 @@ struct dns_request {
 	struct dns_name search;
 	/** Recursion counter */
 	unsigned int recursion;
+	/** Time to live of positive result (in seconds) */
+	unsigned long ttl;
+	/** Time to live of negative result (in seconds) */
+	unsigned long negative_ttl;
+	/** Cached status code */
+	int rc;
 };
 
 /**
@@ -485,8 +750,12 @@ struct dns_request {
  */
 static void dns_done ( struct dns_request *dns, int rc ) {
 
-	/* Stop the retry timer */
+	/* Record end of request */
+	trace ( TRACE_DNS_DONE, dns, rc );
+
+	/* Stop the retry timer and cached result delivery process */
 	stop_timer ( &dns->timer );
+	process_del ( &dns->process );
 
 	/* Shut down interfaces */
 	intf_shutdown ( &dns->socket, rc );
@@ -504,6 +773,10 @@ static void dns_resolved ( struct dns_request *dns ) {
 	DBGC ( dns, "DNS %p found address %s\n",
 	       dns, sock_ntoa ( &dns->address.sa ) );
 
+	/* Cache resolved address */
+	dns_cache_add ( dns->hostname, dns->address.sa.sa_family,
+			&dns->address.sa, dns->ttl );
+
 	/* Return resolved address */
 	resolv_done ( &dns->resolv, &dns->address.sa );
 
@@ -574,6 +847,7 @@ static int dns_send_packet ( struct dns_request *dns ) {
 
 	/* Generate query identifier */
 	query->id = random();
+	dns_stats.queries++;
 
 	/* Send query */
 	DBGC ( dns, "DNS %p sending query ID %#04x for %s type %s\n", dns,
@@ -622,6 +896,8 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 	size_t next_offset;
 	size_t rdlength;
 	size_t name_len;
+	unsigned long soa_ttl = 0;
+	unsigned long ttl;
 	int rc;
 
 	/* Sanity check */
@@ -698,6 +974,10 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 			goto done;
 		}
 
+		/* Record negative caching time from any SOA record */
+		if ( rr->common.type == htons ( DNS_TYPE_SOA ) )
+			soa_ttl = dns_soa_ttl ( &buf, offset );
+
 		/* Skip non-matching names */
 		if ( dns_compare ( &buf, &dns->name ) != 0 ) {
 			DBGC2 ( dns, "DNS %p ignoring response for %s type "
@@ -706,6 +986,21 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 			continue;
 		}
 
+		/* Skip address records for the other address family */
+		if ( ( ( rr->common.type == htons ( DNS_TYPE_A ) ) &&
+		       ( dns->family != AF_INET ) ) ||
+		     ( ( rr->common.type == htons ( DNS_TYPE_AAAA ) ) &&
+		       ( dns->family != AF_INET6 ) ) ) {
+			DBGC2 ( dns, "DNS %p ignoring %s record\n",
+				dns, dns_type ( rr->common.type ) );
+			continue;
+		}
+
+		/* Limit cached lifetime to that of each matching record */
+		ttl = ntohl ( rr->common.ttl );
+		if ( ttl < dns->ttl )
+			dns->ttl = ttl;
+
 		/* Handle answer */
 		switch ( rr->common.type ) {
 
@@ -781,26 +1076,26 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 	 */
 	stop_timer ( &dns->timer );
 
+	/* Limit negative caching time to that specified by the SOA
+	 * record.  Negative responses without an SOA record must not
+	 * be cached (RFC 2308 section 5).
+	 */
+	if ( soa_ttl < dns->negative_ttl )
+		dns->negative_ttl = soa_ttl;
+
 	/* Determine what to do next based on the type of query we
 	 * issued and the response we received
 	 */
 	switch ( qtype ) {
 
 	case htons ( DNS_TYPE_AAAA ):
-		/* We asked for an AAAA record and got nothing; try
-		 * the A.
-		 */
-		DBGC ( dns, "DNS %p found no AAAA record; trying A\n", dns );
-		dns->question->qtype = htons ( DNS_TYPE_A );
-		dns_send_packet ( dns );
-		rc = 0;
-		goto done;
-
 	case htons ( DNS_TYPE_A ):
-		/* We asked for an A record and got nothing;
-		 * try the CNAME.
+		/* We asked for an address record and got nothing;
+		 * try the CNAME.  (The other address family, if
+		 * required, is queried by a separate request.)
 		 */
-		DBGC ( dns, "DNS %p found no A record; trying CNAME\n", dns );
+		DBGC ( dns, "DNS %p found no %s record; trying CNAME\n",
+		       dns, dns_type ( qtype ) );
 		dns->question->qtype = htons ( DNS_TYPE_CNAME );
 		dns_send_packet ( dns );
 		rc = 0;
@@ -822,6 +1117,8 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 		 */
 		if ( dns->search.offset == dns->search.len ) {
 			DBGC ( dns, "DNS %p found no CNAME record\n", dns );
+			dns_cache_add ( dns->hostname, dns->family, NULL,
+					dns->negative_ttl );
 			rc = -ENXIO_NO_RECORD;
 			dns_done ( dns, rc );
 			goto done;
@@ -887,49 +1184,78 @@ static struct interface_descriptor dns_resolv_desc =
 	INTF_DESC ( struct dns_request, resolv, dns_resolv_op );
 
 /**
- * Resolve name using DNS
+ * Deliver cached DNS result
  *
- * @v resolv		Name resolution interface
- * @v name		Name to resolve
- * @v sa		Socket address to fill in
- * @ret rc		Return status code
+ * @v dns		DNS request
  */
-static int dns_resolv ( struct interface *resolv,
-			const char *name, struct sockaddr *sa ) {
-	struct dns_request *dns;
-	struct dns_header *query;
-	size_t search_len;
-	int name_len;
-	int rc;
+static void dns_cached ( struct dns_request *dns ) {
 
-	/* Fail immediately if no DNS servers */
-	if ( ! nameserver.sa.sa_family ) {
-		DBG ( "DNS not attempting to resolve \"%s\": "
-		      "no DNS servers\n", name );
-		rc = -ENXIO_NO_NAMESERVER;
-		goto err_no_nameserver;
+	if ( dns->rc == 0 ) {
+		DBGC ( dns, "DNS %p found cached address %s\n",
+		       dns, sock_ntoa ( &dns->address.sa ) );
+		resolv_done ( &dns->resolv, &dns->address.sa );
+	} else {
+		DBGC ( dns, "DNS %p found cached failure: %s\n",
+		       dns, strerror ( dns->rc ) );
 	}
 
-	/* Determine whether or not to use search list */
-	search_len = ( strchr ( name, '.' ) ? 0 : dns_search.len );
+	/* Mark operation as complete */
+	dns_done ( dns, dns->rc );
+}
 
-	/* Allocate DNS structure */
-	dns = zalloc ( sizeof ( *dns ) + search_len );
-	if ( ! dns ) {
-		rc = -ENOMEM;
-		goto err_alloc_dns;
+/** DNS cached result delivery process descriptor */
+static struct process_descriptor dns_process_desc =
+	PROC_DESC_ONCE ( struct dns_request, process, dns_cached );
+
+/**
+ * Use cached DNS result
+ *
+ * @v dns		DNS request
+ * @v entry		Cached result
+ */
+static void dns_use_cache ( struct dns_request *dns,
+			    struct dns_cache_entry *entry ) {
+
+	/* Fill in resolved address, preserving any other fields
+	 * (such as the port number) from the original socket address
+	 */
+	switch ( entry->address.sa.sa_family ) {
+	case AF_INET:
+		dns->address.sin.sin_family = AF_INET;
+		dns->address.sin.sin_addr = entry->address.sin.sin_addr;
+		break;
+	case AF_INET6:
+		dns->address.sin6.sin6_family = AF_INET6;
+		memcpy ( &dns->address.sin6.sin6_addr,
+			 &entry->address.sin6.sin6_addr,
+			 sizeof ( dns->address.sin6.sin6_addr ) );
+		break;
+	default:
+		/* Negative result */
+		break;
 	}
-	ref_init ( &dns->refcnt, NULL );
-	intf_init ( &dns->resolv, &dns_resolv_desc, &dns->refcnt );
-	intf_init ( &dns->socket, &dns_socket_desc, &dns->refcnt );
-	timer_init ( &dns->timer, dns_timer_expired, &dns->refcnt );
-	memcpy ( &dns->address.sa, sa, sizeof ( dns->address.sa ) );
-	dns->search.data = ( ( ( void * ) dns ) + sizeof ( *dns ) );
-	dns->search.len = search_len;
-	memcpy ( dns->search.data, dns_search.data, search_len );
+	dns->rc = entry->rc;
+
+	/* Deliver result via process, since the caller's interface
+	 * is not yet attached.
+	 */
+	process_add ( &dns->process );
+}
+
+/**
+ * Start DNS query
+ *
+ * @v dns		DNS request
+ * @v name		Name to resolve
+ * @ret rc		Return status code
+ */
+static int dns_query ( struct dns_request *dns, const char *name ) {
+	struct dns_header *query;
+	int name_len;
+	int rc;
 
 	/* Determine initial query type */
-	switch ( nameserver.sa.sa_family ) {
+	switch ( dns->family ) {
 	case AF_INET:
 		dns->qtype = htons ( DNS_TYPE_A );
 		break;
@@ -937,8 +1263,7 @@ static int dns_resolv ( struct interface *resolv,
 		dns->qtype = htons ( DNS_TYPE_AAAA );
 		break;
 	default:
-		rc = -ENOTSUP;
-		goto err_type;
+		return -ENOTSUP;
 	}
 
 	/* Construct query */
@@ -949,38 +1274,322 @@ static int dns_resolv ( struct interface *resolv,
 	dns->name.offset = offsetof ( typeof ( dns->buf ), name );
 	dns->name.len = offsetof ( typeof ( dns->buf ), padding );
 	name_len = dns_encode ( name, &dns->name );
-	if ( name_len < 0 ) {
-		rc = name_len;
-		goto err_encode;
-	}
+	if ( name_len < 0 )
+		return name_len;
 	dns->offset = ( offsetof ( typeof ( dns->buf ), name ) +
 			name_len - 1 /* Strip root label */ );
 	if ( ( rc = dns_question ( dns ) ) != 0 )
-		goto err_question;
+		return rc;
 
 	/* Open UDP connection */
 	if ( ( rc = xfer_open_socket ( &dns->socket, SOCK_DGRAM,
 				       &nameserver.sa, NULL ) ) != 0 ) {
 		DBGC ( dns, "DNS %p could not open socket: %s\n",
 		       dns, strerror ( rc ) );
-		goto err_open_socket;
+		return rc;
 	}
 
 	/* Start timer to trigger first packet */
 	start_timer_nodelay ( &dns->timer );
 
+	return 0;
+}
+
+/**
+ * Start DNS request for a single address family
+ *
+ * @v resolv		Name resolution interface
+ * @v name		Name to resolve
+ * @v sa		Socket address to fill in
+ * @v family		Address family
+ * @ret rc		Return status code
+ */
+static int dns_start ( struct interface *resolv, const char *name,
+		       struct sockaddr *sa, sa_family_t family ) {
+	struct dns_cache_entry *cached;
+	struct dns_request *dns;
+	size_t search_len;
+	size_t hostname_len;
+	int rc;
+
+	/* Do not look up addresses that we would be unable to use */
+	if ( ! tcpip_net_protocol ( family ) ) {
+		rc = -EAFNOSUPPORT;
+		goto err_family;
+	}
+
+	/* Check for a cached result */
+	cached = dns_cache_find ( name, family );
+
+	/* Fail immediately if no DNS servers */
+	if ( ( ! cached ) && ( ! nameserver.sa.sa_family ) ) {
+		DBG ( "DNS not attempting to resolve \"%s\": "
+		      "no DNS servers\n", name );
+		rc = -ENXIO_NO_NAMESERVER;
+		goto err_no_nameserver;
+	}
+
+	/* Determine whether or not to use search list */
+	search_len = ( strchr ( name, '.' ) ? 0 : dns_search.len );
+	hostname_len = ( strlen ( name ) + 1 /* NUL */ );
+
+	/* Allocate DNS structure */
+	dns = zalloc ( sizeof ( *dns ) + search_len + hostname_len );
+	if ( ! dns ) {
+		rc = -ENOMEM;
+		goto err_alloc_dns;
+	}
+	ref_init ( &dns->refcnt, NULL );
+	intf_init ( &dns->resolv, &dns_resolv_desc, &dns->refcnt );
+	intf_init ( &dns->socket, &dns_socket_desc, &dns->refcnt );
+	timer_init ( &dns->timer, dns_timer_expired, &dns->refcnt );
+	process_init_stopped ( &dns->process, &dns_process_desc,
+			       &dns->refcnt );
+	memcpy ( &dns->address.sa, sa, sizeof ( dns->address.sa ) );
+	dns->family = family;
+	dns->search.data = ( ( ( void * ) dns ) + sizeof ( *dns ) );
+	dns->search.len = search_len;
+	memcpy ( dns->search.data, dns_search.data, search_len );
+	dns->hostname = ( dns->search.data + search_len );
+	memcpy ( dns->hostname, name, hostname_len );
+	dns->ttl = DNS_CACHE_MAX_TTL;
+	dns->negative_ttl = DNS_CACHE_MAX_NEGATIVE_TTL;
+
+	/* Record start of request */
+	trace ( TRACE_DNS_START, dns, 0 );
+
+	/* Use cached result, if available, otherwise start query */
+	if ( cached ) {
+		dns_use_cache ( dns, cached );
+	} else if ( ( rc = dns_query ( dns, name ) ) != 0 ) {
+		goto err_query;
+	}
+
 	/* Attach parent interface, mortalise self, and return */
 	intf_plug_plug ( &dns->resolv, resolv );
 	ref_put ( &dns->refcnt );
 	return 0;	
 
- err_open_socket:
- err_question:
- err_encode:
- err_type:
+ err_query:
+	trace ( TRACE_DNS_DONE, dns, rc );
 	ref_put ( &dns->refcnt );
  err_alloc_dns:
  err_no_nameserver:
+ err_family:
+	return rc;
+}
+
+/** A DNS name resolution
+ *
+ * If the caller does not specify an address family, then each
+ * address family is tried in turn, starting with the family of the
+ * nameserver.  The first address for which a route exists is passed
+ * to the caller; if no address is routable, then the first address
+ * found is passed to the caller.  The result is therefore a single
+ * address, chosen deterministically.
+ */
+struct dns_resolution {
+	/** Reference counter */
+	struct refcnt refcnt;
+	/** Name resolution interface */
+	struct interface resolv;
+	/** DNS request interface */
+	struct interface request;
+	/** Socket address to fill in */
+	struct sockaddr sa;
+	/** Address families to try */
+	sa_family_t families[2];
+	/** Number of address families tried */
+	unsigned int tried;
+	/** First unroutable address found, if any */
+	struct sockaddr unroutable;
+	/** A routable address has been found */
+	int found;
+	/** Most recent request failure status code */
+	int rc;
+	/** Name to resolve
+	 *
+	 * Must be at end of structure
+	 */
+	char name[0];
+};
+
+/**
+ * Close DNS name resolution
+ *
+ * @v res		DNS name resolution
+ * @v rc		Reason for close
+ */
+static void dns_resolution_close ( struct dns_resolution *res, int rc ) {
+
+	/* Shut down interfaces */
+	intf_shutdown ( &res->request, rc );
+	intf_shutdown ( &res->resolv, rc );
+}
+
+/**
+ * Start DNS request for next address family
+ *
+ * @v res		DNS name resolution
+ * @ret rc		Return status code
+ */
+static int dns_resolution_next ( struct dns_resolution *res ) {
+	sa_family_t family;
+	int rc;
+
+	/* Try each remaining address family in turn */
+	while ( res->tried < ( sizeof ( res->families ) /
+			       sizeof ( res->families[0] ) ) ) {
+		family = res->families[ res->tried++ ];
+		if ( ( rc = dns_start ( &res->request, res->name, &res->sa,
+					family ) ) == 0 )
+			return 0;
+		res->rc = rc;
+	}
+
+	return res->rc;
+}
+
+/**
+ * Handle address found by DNS request
+ *
+ * @v res		DNS name resolution
+ * @v sa		Resolved socket address
+ */
+static void dns_resolution_done ( struct dns_resolution *res,
+				  struct sockaddr *sa ) {
+
+	/* Record first unroutable address, in case no other family
+	 * produces a routable address.
+	 */
+	if ( ! tcpip_netdev ( ( struct sockaddr_tcpip * ) sa ) ) {
+		DBGC ( res, "DNS %p found unroutable %s\n",
+		       res, sock_ntoa ( sa ) );
+		if ( ! res->unroutable.sa_family )
+			memcpy ( &res->unroutable, sa,
+				 sizeof ( res->unroutable ) );
+		return;
+	}
+
+	/* Pass address to caller */
+	res->found = 1;
+	resolv_done ( &res->resolv, sa );
+}
+
+/**
+ * Handle completion of DNS request
+ *
+ * @v res		DNS name resolution
+ * @v rc		Reason for completion
+ */
+static void dns_resolution_request_close ( struct dns_resolution *res,
+					   int rc ) {
+
+	/* Restart interface */
+	intf_restart ( &res->request, rc );
+	if ( rc != 0 )
+		res->rc = rc;
+
+	/* Finish if a routable address has been found */
+	if ( res->found ) {
+		rc = 0;
+		goto finished;
+	}
+
+	/* Try next address family, if any */
+	if ( dns_resolution_next ( res ) == 0 )
+		return;
+
+	/* Fall back to any unroutable address */
+	if ( res->unroutable.sa_family ) {
+		resolv_done ( &res->resolv, &res->unroutable );
+		rc = 0;
+		goto finished;
+	}
+	rc = res->rc;
+
+ finished:
+	dns_resolution_close ( res, rc );
+}
+
+/** DNS name resolution request interface operations */
+static struct interface_operation dns_resolution_request_op[] = {
+	INTF_OP ( resolv_done, struct dns_resolution *, dns_resolution_done ),
+	INTF_OP ( intf_close, struct dns_resolution *,
+		  dns_resolution_request_close ),
+};
+
+/** DNS name resolution request interface descriptor */
+static struct interface_descriptor dns_resolution_request_desc =
+	INTF_DESC ( struct dns_resolution, request,
+		    dns_resolution_request_op );
+
+/** DNS name resolution interface operations */
+static struct interface_operation dns_resolution_resolv_op[] = {
+	INTF_OP ( intf_close, struct dns_resolution *, dns_resolution_close ),
+};
+
+/** DNS name resolution interface descriptor */
+static struct interface_descriptor dns_resolution_resolv_desc =
+	INTF_DESC ( struct dns_resolution, resolv, dns_resolution_resolv_op );
+
+/**
+ * Resolve name using DNS
+ *
+ * @v resolv		Name resolution interface
+ * @v name		Name to resolve
+ * @v sa		Socket address to fill in
+ * @ret rc		Return status code
+ *
+ * If the socket address specifies an address family, then only that
+ * address family will be resolved.
+ */
+static int dns_resolv ( struct interface *resolv,
+			const char *name, struct sockaddr *sa ) {
+	struct dns_resolution *res;
+	size_t name_len = ( strlen ( name ) + 1 /* NUL */ );
+	int rc;
+
+	/* Resolve only the specified address family, if any */
+	if ( sa->sa_family )
+		return dns_start ( resolv, name, sa, sa->sa_family );
+
+	/* Allocate and initialise structure */
+	res = zalloc ( sizeof ( *res ) + name_len );
+	if ( ! res ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	ref_init ( &res->refcnt, NULL );
+	intf_init ( &res->resolv, &dns_resolution_resolv_desc,
+		    &res->refcnt );
+	intf_init ( &res->request, &dns_resolution_request_desc,
+		    &res->refcnt );
+	memcpy ( &res->sa, sa, sizeof ( res->sa ) );
+	memcpy ( res->name, name, name_len );
+	res->rc = -ENXIO_NO_RECORD;
+
+	/* Try the nameserver's address family first */
+	if ( nameserver.sa.sa_family == AF_INET6 ) {
+		res->families[0] = AF_INET6;
+		res->families[1] = AF_INET;
+	} else {
+		res->families[0] = AF_INET;
+		res->families[1] = AF_INET6;
+	}
+
+	/* Start first request */
+	if ( ( rc = dns_resolution_next ( res ) ) != 0 )
+		goto err_start;
+
+	/* Attach parent interface, mortalise self, and return */
+	intf_plug_plug ( &res->resolv, resolv );
+	ref_put ( &res->refcnt );
+	return 0;
+
+ err_start:
+	ref_put ( &res->refcnt );
+ err_alloc:
 	return rc;
 }
 
@@ -1114,6 +1723,13 @@ static void apply_dns_search ( void ) {
  * @ret rc		Return status code
  */
 static int apply_dns_settings ( void ) {
+	typeof ( nameserver ) old_nameserver;
+	struct dns_name old_search;
+
+	/* Record existing configuration */
+	memcpy ( &old_nameserver, &nameserver, sizeof ( old_nameserver ) );
+	memcpy ( &old_search, &dns_search, sizeof ( old_search ) );
+	memset ( &dns_search, 0, sizeof ( dns_search ) );
 
 	/* Fetch DNS server address */
 	nameserver.sa.sa_family = 0;
@@ -1147,6 +1763,16 @@ static int apply_dns_settings ( void ) {
 		DBG ( "\n" );
 	}
 
+	/* Flush DNS cache if configuration has changed */
+	if ( ( memcmp ( &old_nameserver, &nameserver,
+			sizeof ( old_nameserver ) ) != 0 ) ||
+	     ( old_search.len != dns_search.len ) ||
+	     ( memcmp ( old_search.data, dns_search.data,
+			dns_search.len ) != 0 ) ) {
+		dns_cache_flush();
+	}
+	free ( old_search.data );
+
 	return 0;
 }
 
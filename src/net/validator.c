@@ -64,6 +64,10 @@ struct validator {
 	struct x509_chain *chain;
 	/** OCSP check */
 	struct ocsp_check *ocsp;
+	/** Stapled OCSP response for first certificate in chain (if any) */
+	void *stapled;
+	/** Length of stapled OCSP response */
+	size_t stapled_len;
 	/** Data buffer */
 	struct xfer_buffer buffer;
 	/** Action to take upon completed transfer */
@@ -83,6 +87,7 @@ static void validator_free ( struct refcnt *refcnt ) {
 	DBGC2 ( validator, "VALIDATOR %p freed\n", validator );
 	x509_chain_put ( validator->chain );
 	ocsp_put ( validator->ocsp );
+	free ( validator->stapled );
 	xferbuf_free ( &validator->buffer );
 	free ( validator );
 }
@@ -321,6 +326,47 @@ static int validator_ocsp_validate ( struct validator *validator,
 	return 0;
 }
 
+/**
+ * Use stapled OCSP response
+ *
+ * @v validator		Certificate validator
+ * @v cert		Certificate to check
+ * @v issuer		Issuing certificate
+ * @ret rc		Return status code
+ *
+ * The stapled response is used only once: if it cannot be validated,
+ * then the caller may fall back to performing an OCSP check.
+ */
+static int validator_stapled_ocsp ( struct validator *validator,
+				    struct x509_certificate *cert,
+				    struct x509_certificate *issuer ) {
+	int rc;
+
+	/* Create OCSP check */
+	assert ( validator->ocsp == NULL );
+	if ( ( rc = ocsp_check ( cert, issuer, &validator->ocsp ) ) != 0 ) {
+		DBGC ( validator, "VALIDATOR %p could not create OCSP check: "
+		       "%s\n", validator, strerror ( rc ) );
+		goto err_check;
+	}
+
+	/* Validate stapled response */
+	DBGC ( validator, "VALIDATOR %p using stapled OCSP response\n",
+	       validator );
+	if ( ( rc = validator_ocsp_validate ( validator, validator->stapled,
+					      validator->stapled_len ) ) != 0 )
+		goto err_validate;
+
+ err_validate:
+	ocsp_put ( validator->ocsp );
+	validator->ocsp = NULL;
+ err_check:
+	free ( validator->stapled );
+	validator->stapled = NULL;
+	validator->stapled_len = 0;
+	return rc;
+}
+
 /**
  * Start OCSP check
  *
@@ -480,10 +526,19 @@ static void validator_step ( struct validator *validator ) {
 		if ( ! issuer->valid )
 			continue;
 		/* The issuer is valid, but this certificate is not
-		 * yet valid.  If OCSP is applicable, start it.
+		 * yet valid.  If OCSP is applicable, use the stapled
+		 * response if available, otherwise start OCSP.
 		 */
 		if ( cert->extensions.auth_info.ocsp.uri.len &&
 		     ( ! cert->extensions.auth_info.ocsp.good ) ) {
+			/* Use stapled response, if applicable */
+			if ( validator->stapled &&
+			     ( cert == x509_first ( validator->chain ) ) &&
+			     ( validator_stapled_ocsp ( validator, cert,
+							issuer ) == 0 ) ) {
+				process_add ( &validator->process );
+				return;
+			}
 			/* Start OCSP */
 			if ( ( rc = validator_start_ocsp ( validator, cert,
 							   issuer ) ) != 0 ) {
@@ -531,9 +586,12 @@ static struct process_descriptor validator_process_desc =
  *
  * @v job		Job control interface
  * @v chain		X.509 certificate chain
+ * @v stapled		Stapled OCSP response for first certificate, or NULL
+ * @v stapled_len	Length of stapled OCSP response
  * @ret rc		Return status code
  */
-int create_validator ( struct interface *job, struct x509_chain *chain ) {
+int create_validator ( struct interface *job, struct x509_chain *chain,
+		       const void *stapled, size_t stapled_len ) {
 	struct validator *validator;
 	int rc;
 
@@ -559,6 +617,17 @@ int create_validator ( struct interface *job, struct x509_chain *chain ) {
 	validator->chain = x509_chain_get ( chain );
 	xferbuf_malloc_init ( &validator->buffer );
 
+	/* Record stapled OCSP response, if any */
+	if ( stapled ) {
+		validator->stapled = malloc ( stapled_len );
+		if ( ! validator->stapled ) {
+			rc = -ENOMEM;
+			goto err_stapled;
+		}
+		memcpy ( validator->stapled, stapled, stapled_len );
+		validator->stapled_len = stapled_len;
+	}
+
 	/* Attach parent interface, mortalise self, and return */
 	intf_plug_plug ( &validator->job, job );
 	ref_put ( &validator->refcnt );
@@ -566,6 +635,7 @@ int create_validator ( struct interface *job, struct x509_chain *chain ) {
 		validator, validator->chain );
 	return 0;
 
+ err_stapled:
 	validator_finished ( validator, rc );
 	ref_put ( &validator->refcnt );
  err_alloc:
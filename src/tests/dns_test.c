@@ -32,14 +32,35 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /* Forcibly enable assertions */
 #undef NDEBUG
 
+#include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
+#include <strings.h>
+#include <errno.h>
 #include <assert.h>
+#include <byteswap.h>
+#include <ipxe/in.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/xfer.h>
+#include <ipxe/open.h>
+#include <ipxe/interface.h>
+#include <ipxe/process.h>
+#include <ipxe/settings.h>
+#include <ipxe/resolv.h>
 #include <ipxe/dns.h>
 #include <ipxe/test.h>
 
 /** Define inline data */
 #define DATA(...) { __VA_ARGS__ }
 
+/** Define inline 32-bit big-endian value */
+#define U32( value ) ( ( (value) >> 24 ) & 0xff ),			\
+		     ( ( (value) >> 16 ) & 0xff ),			\
+		     ( ( (value) >> 8 ) & 0xff ), ( (value) & 0xff )
+
+/** Test nameserver address (192.0.2.53) */
+#define DNS_TEST_NAMESERVER 0xc0000235UL
+
 /** A DNS encoding test */
 struct dns_encode_test {
 	/** String */
@@ -420,6 +441,620 @@ static void dns_list_okx ( struct dns_list_test *test, const char *file,
 }
 #define dns_list_ok( test ) dns_list_okx ( test, __FILE__, __LINE__ )
 
+/** A DNS cache test resolution */
+struct dns_cache_test {
+	/** Name resolution interface */
+	struct interface resolv;
+	/** Resolved IPv4 address */
+	struct sockaddr_in sin;
+	/** Resolved IPv6 address */
+	struct sockaddr_in6 sin6;
+	/** Number of addresses resolved */
+	unsigned int resolved;
+	/** Resolution is complete */
+	int done;
+	/** Completion status code */
+	int rc;
+};
+
+/**
+ * Handle resolved name
+ *
+ * @v test		DNS cache test resolution
+ * @v sa		Resolved socket address
+ */
+static void dns_cache_test_resolv_done ( struct dns_cache_test *test,
+					 struct sockaddr *sa ) {
+
+	if ( sa->sa_family == AF_INET6 ) {
+		memcpy ( &test->sin6, sa, sizeof ( test->sin6 ) );
+	} else {
+		memcpy ( &test->sin, sa, sizeof ( test->sin ) );
+	}
+	test->resolved++;
+}
+
+/**
+ * Handle completed name resolution
+ *
+ * @v test		DNS cache test resolution
+ * @v rc		Reason for close
+ */
+static void dns_cache_test_close ( struct dns_cache_test *test, int rc ) {
+
+	intf_restart ( &test->resolv, rc );
+	test->rc = rc;
+	test->done = 1;
+}
+
+/** DNS cache test resolution interface operations */
+static struct interface_operation dns_cache_test_operations[] = {
+	INTF_OP ( resolv_done, struct dns_cache_test *,
+		  dns_cache_test_resolv_done ),
+	INTF_OP ( intf_close, struct dns_cache_test *, dns_cache_test_close ),
+};
+
+/** DNS cache test resolution interface descriptor */
+static struct interface_descriptor dns_cache_test_desc =
+	INTF_DESC ( struct dns_cache_test, resolv, dns_cache_test_operations );
+
+/**
+ * Resolve name and report DNS cache test result
+ *
+ * @v name		Name to resolve
+ * @v family		Address family to resolve, or zero
+ * @v sin6		Expected IPv6 address, or NULL
+ * @v sin		Expected IPv4 address, or NULL
+ * @v hits		Expected number of cache hits
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void dns_cache_okx ( const char *name, sa_family_t family,
+			    struct sockaddr_in6 *sin6,
+			    struct sockaddr_in *sin, unsigned int hits,
+			    const char *file, unsigned int line ) {
+	struct dns_cache_test test;
+	struct sockaddr_in sa;
+	unsigned int queries = dns_stats.queries;
+	unsigned int old_hits = dns_stats.hits;
+	unsigned int i;
+
+	/* Resolve name */
+	memset ( &test, 0, sizeof ( test ) );
+	intf_init ( &test.resolv, &dns_cache_test_desc, NULL );
+	memset ( &sa, 0, sizeof ( sa ) );
+	sa.sin_family = family;
+	sa.sin_port = htons ( 80 );
+	okx ( resolv ( &test.resolv, name, ( struct sockaddr * ) &sa ) == 0,
+	      file, line );
+	for ( i = 0 ; ( ( ! test.done ) && ( i < 16 ) ) ; i++ )
+		step();
+	okx ( test.done, file, line );
+
+	/* Check that no queries were transmitted */
+	okx ( dns_stats.queries == queries, file, line );
+	okx ( dns_stats.hits == ( old_hits + hits ), file, line );
+
+	/* Check result */
+	okx ( test.resolved == ( ( sin6 ? 1U : 0U ) + ( sin ? 1U : 0U ) ),
+	      file, line );
+	okx ( ( test.rc == 0 ) == ( test.resolved != 0 ), file, line );
+	if ( sin6 ) {
+		okx ( test.sin6.sin6_family == AF_INET6, file, line );
+		okx ( test.sin6.sin6_port == htons ( 80 ), file, line );
+		okx ( memcmp ( &test.sin6.sin6_addr, &sin6->sin6_addr,
+			       sizeof ( test.sin6.sin6_addr ) ) == 0,
+		      file, line );
+	}
+	if ( sin ) {
+		okx ( test.sin.sin_family == AF_INET, file, line );
+		okx ( test.sin.sin_port == htons ( 80 ), file, line );
+		okx ( test.sin.sin_addr.s_addr == sin->sin_addr.s_addr,
+		      file, line );
+	}
+}
+#define dns_cache_ok( name, sin6, sin, hits ) \
+	dns_cache_okx ( name, 0, sin6, sin, hits, __FILE__, __LINE__ )
+#define dns_cache_family_ok( name, family, sin6, sin, hits ) \
+	dns_cache_okx ( name, family, sin6, sin, hits, __FILE__, __LINE__ )
+
+/**
+ * Perform DNS cache self-tests
+ *
+ */
+static void dns_cache_test_exec ( void ) {
+	struct sockaddr_in sin;
+	struct sockaddr_in sin_new;
+	struct sockaddr_in6 sin6;
+	char name[32];
+	unsigned int i;
+
+	/* Construct test addresses */
+	memset ( &sin, 0, sizeof ( sin ) );
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl ( 0x0a000001 );
+	memset ( &sin_new, 0, sizeof ( sin_new ) );
+	sin_new.sin_family = AF_INET;
+	sin_new.sin_addr.s_addr = htonl ( 0x0a000002 );
+	memset ( &sin6, 0, sizeof ( sin6 ) );
+	sin6.sin6_family = AF_INET6;
+	sin6.sin6_addr.s6_addr[0] = 0xfe;
+	sin6.sin6_addr.s6_addr[1] = 0x80;
+	sin6.sin6_addr.s6_addr[15] = 0x01;
+
+	/* Start with an empty cache */
+	dns_cache_flush();
+	dns_cache_ok ( "boot.ipxe.test", NULL, NULL, 0 );
+
+	/* Positive results */
+	ok ( dns_cache_add ( "boot.ipxe.test", AF_INET,
+			     ( struct sockaddr * ) &sin, 60 ) == 0 );
+	ok ( dns_cache_add ( "boot6.ipxe.test", AF_INET6,
+			     ( struct sockaddr * ) &sin6, 60 ) == 0 );
+	dns_cache_ok ( "boot.ipxe.test", NULL, &sin, 1 );
+	dns_cache_ok ( "BOOT.iPXE.test", NULL, &sin, 1 );
+	dns_cache_ok ( "boot6.ipxe.test", &sin6, NULL, 1 );
+
+	/* Results for both address families.  With no routes and no
+	 * nameserver, an unspecified family resolves deterministically
+	 * to the first family tried (IPv4).
+	 */
+	ok ( dns_cache_add ( "dual.ipxe.test", AF_INET,
+			     ( struct sockaddr * ) &sin, 60 ) == 0 );
+	ok ( dns_cache_add ( "dual.ipxe.test", AF_INET6,
+			     ( struct sockaddr * ) &sin6, 60 ) == 0 );
+	dns_cache_ok ( "dual.ipxe.test", NULL, &sin, 2 );
+	dns_cache_family_ok ( "dual.ipxe.test", AF_INET, NULL, &sin, 1 );
+	dns_cache_family_ok ( "dual.ipxe.test", AF_INET6, &sin6, NULL, 1 );
+
+	/* Specified address family is never substituted */
+	dns_cache_family_ok ( "boot6.ipxe.test", AF_INET, NULL, NULL, 0 );
+
+	/* Replaced result */
+	ok ( dns_cache_add ( "boot.ipxe.test", AF_INET,
+			     ( struct sockaddr * ) &sin_new, 60 ) == 0 );
+	dns_cache_ok ( "boot.ipxe.test", NULL, &sin_new, 1 );
+
+	/* Negative results */
+	ok ( dns_cache_add ( "missing.ipxe.test", AF_INET, NULL, 60 ) == 0 );
+	dns_cache_ok ( "missing.ipxe.test", NULL, NULL, 1 );
+	ok ( dns_cache_add ( "dual.ipxe.test", AF_INET6, NULL, 60 ) == 0 );
+	dns_cache_ok ( "dual.ipxe.test", NULL, &sin, 2 );
+
+	/* Zero TTL results are not cached */
+	ok ( dns_cache_add ( "volatile.ipxe.test", AF_INET,
+			     ( struct sockaddr * ) &sin, 0 ) == 0 );
+	dns_cache_ok ( "volatile.ipxe.test", NULL, NULL, 0 );
+
+	/* Cache size is bounded, discarding least recently used */
+	dns_cache_flush();
+	ok ( dns_cache_add ( "boot.ipxe.test", AF_INET,
+			     ( struct sockaddr * ) &sin, 60 ) == 0 );
+	for ( i = 0 ; i < DNS_CACHE_MAX ; i++ ) {
+		snprintf ( name, sizeof ( name ), "host%d.ipxe.test", i );
+		ok ( dns_cache_add ( name, AF_INET, ( struct sockaddr * ) &sin,
+				     60 ) == 0 );
+	}
+	dns_cache_ok ( "boot.ipxe.test", NULL, NULL, 0 );
+	dns_cache_ok ( "host0.ipxe.test", NULL, &sin, 1 );
+	snprintf ( name, sizeof ( name ), "host%d.ipxe.test",
+		   ( DNS_CACHE_MAX - 1 ) );
+	dns_cache_ok ( name, NULL, &sin, 1 );
+
+	/* Flushing cache discards all results */
+	dns_cache_flush();
+	dns_cache_ok ( "host0.ipxe.test", NULL, NULL, 0 );
+}
+
+/** A DNS response test */
+struct dns_response_test {
+	/** Name to resolve */
+	const char *name;
+	/** Answer records for "A" queries */
+	const void *a;
+	/** Length of answer records for "A" queries */
+	size_t a_len;
+	/** Answer records for "CNAME" queries */
+	const void *cname;
+	/** Length of answer records for "CNAME" queries */
+	size_t cname_len;
+	/** Expected IPv4 address (in host byte order), or zero */
+	uint32_t address;
+	/** Expected cached IPv4 time to live (in seconds), or zero */
+	unsigned long ttl;
+};
+
+/**
+ * Define a DNS response test
+ *
+ * @v _name		Test name
+ * @v _string		Name to resolve
+ * @v _a		Answer records for "A" queries
+ * @v _cname		Answer records for "CNAME" queries
+ * @v _address		Expected IPv4 address, or zero
+ * @v _ttl		Expected cached time to live, or zero
+ * @ret test		DNS response test
+ *
+ * Answer records are appended to a copy of the query, and so may use
+ * a compression pointer to the question name at offset 12.  Test
+ * names are all of the form "xxxx.ipxe.test", and so may also use a
+ * compression pointer to "ipxe.test" at offset 17.  The first answer
+ * record always starts at offset 32.
+ */
+#define DNS_RESPONSE( _name, _string, _a, _cname, _address, _ttl )	\
+	static const uint8_t _name ## __a[] = _a;			\
+	static const uint8_t _name ## __cname[] = _cname;		\
+	static struct dns_response_test _name = {			\
+		.name = _string,					\
+		.a = _name ## __a,					\
+		.a_len = sizeof ( _name ## __a ),			\
+		.cname = _name ## __cname,				\
+		.cname_len = sizeof ( _name ## __cname ),		\
+		.address = _address,					\
+		.ttl = _ttl,						\
+	}
+
+/** Current DNS response test */
+static struct dns_response_test *dns_response_test;
+
+/** A DNS test nameserver connection */
+struct dns_test_server {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Response delivery process */
+	struct process process;
+	/** Pending responses */
+	struct list_head responses;
+};
+
+/**
+ * Close DNS test nameserver connection
+ *
+ * @v server		DNS test nameserver connection
+ * @v rc		Reason for close
+ */
+static void dns_test_server_close ( struct dns_test_server *server, int rc ) {
+	struct io_buffer *iobuf;
+	struct io_buffer *tmp;
+
+	/* Discard any pending responses */
+	list_for_each_entry_safe ( iobuf, tmp, &server->responses, list ) {
+		list_del ( &iobuf->list );
+		free_iob ( iobuf );
+	}
+
+	/* Stop process and shut down interface */
+	process_del ( &server->process );
+	intf_shutdown ( &server->xfer, rc );
+}
+
+/**
+ * Receive DNS query at test nameserver
+ *
+ * @v server		DNS test nameserver connection
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int dns_test_server_deliver ( struct dns_test_server *server,
+				     struct io_buffer *iobuf,
+				     struct xfer_metadata *meta __unused ) {
+	struct dns_response_test *test = dns_response_test;
+	struct dns_question *question;
+	struct io_buffer *response;
+	struct dns_name qname;
+	char name[64];
+	const void *answer = NULL;
+	size_t answer_len = 0;
+	int offset;
+	int len;
+	int rc;
+
+	/* Parse question */
+	qname.data = iobuf->data;
+	qname.offset = sizeof ( struct dns_header );
+	qname.len = iob_len ( iobuf );
+	len = dns_decode ( &qname, name, sizeof ( name ) );
+	offset = dns_skip ( &qname );
+	if ( ( len < 0 ) || ( offset < 0 ) ||
+	     ( ( offset + sizeof ( *question ) ) > iob_len ( iobuf ) ) ) {
+		rc = -EINVAL;
+		goto done;
+	}
+	question = ( iobuf->data + offset );
+
+	/* Select answer records */
+	if ( test && ( strcasecmp ( name, test->name ) == 0 ) ) {
+		if ( question->qtype == htons ( DNS_TYPE_A ) ) {
+			answer = test->a;
+			answer_len = test->a_len;
+		} else if ( question->qtype == htons ( DNS_TYPE_CNAME ) ) {
+			answer = test->cname;
+			answer_len = test->cname_len;
+		}
+	}
+
+	/* Construct response.  The parser ignores the header flags
+	 * and record counts, so these are left as in the query.
+	 */
+	response = alloc_iob ( offset + sizeof ( *question ) + answer_len );
+	if ( ! response ) {
+		rc = -ENOMEM;
+		goto done;
+	}
+	memcpy ( iob_put ( response, ( offset + sizeof ( *question ) ) ),
+		 iobuf->data, ( offset + sizeof ( *question ) ) );
+	memcpy ( iob_put ( response, answer_len ), answer, answer_len );
+
+	/* Deliver response via process, as for a received packet */
+	list_add_tail ( &response->list, &server->responses );
+	process_add ( &server->process );
+	rc = 0;
+
+ done:
+	free_iob ( iobuf );
+	return rc;
+}
+
+/**
+ * Deliver pending DNS test nameserver response
+ *
+ * @v server		DNS test nameserver connection
+ */
+static void dns_test_server_step ( struct dns_test_server *server ) {
+	struct io_buffer *iobuf;
+
+	/* Deliver first pending response, if any */
+	iobuf = list_first_entry ( &server->responses, struct io_buffer,
+				   list );
+	if ( iobuf ) {
+		list_del ( &iobuf->list );
+		xfer_deliver_iob ( &server->xfer, iobuf );
+	}
+
+	/* Stop when no responses remain */
+	if ( list_empty ( &server->responses ) )
+		process_del ( &server->process );
+}
+
+/** DNS test nameserver interface operations */
+static struct interface_operation dns_test_server_operations[] = {
+	INTF_OP ( xfer_deliver, struct dns_test_server *,
+		  dns_test_server_deliver ),
+	INTF_OP ( intf_close, struct dns_test_server *,
+		  dns_test_server_close ),
+};
+
+/** DNS test nameserver interface descriptor */
+static struct interface_descriptor dns_test_server_desc =
+	INTF_DESC ( struct dns_test_server, xfer, dns_test_server_operations );
+
+/** DNS test nameserver process descriptor */
+static struct process_descriptor dns_test_server_process_desc =
+	PROC_DESC ( struct dns_test_server, process, dns_test_server_step );
+
+/**
+ * Open socket to DNS test nameserver
+ *
+ * @v xfer		Data transfer interface
+ * @v peer		Peer socket address
+ * @v local		Local socket address, or NULL
+ * @ret rc		Return status code
+ *
+ * Sockets to any address other than the test nameserver are passed
+ * through to the normal UDP socket opener.
+ */
+static int dns_test_server_open ( struct interface *xfer,
+				  struct sockaddr *peer,
+				  struct sockaddr *local ) {
+	struct sockaddr_in *sin = ( ( struct sockaddr_in * ) peer );
+	struct dns_test_server *server;
+	struct socket_opener *opener;
+
+	/* Pass through sockets to any other address */
+	if ( sin->sin_addr.s_addr != htonl ( DNS_TEST_NAMESERVER ) ) {
+		for_each_table_entry ( opener, SOCKET_OPENERS ) {
+			if ( ( opener->open != dns_test_server_open ) &&
+			     ( opener->semantics == UDP_SOCK_DGRAM ) &&
+			     ( opener->family == AF_INET ) ) {
+				return opener->open ( xfer, peer, local );
+			}
+		}
+		return -ENOTSUP;
+	}
+
+	/* Allocate and initialise connection */
+	server = zalloc ( sizeof ( *server ) );
+	if ( ! server )
+		return -ENOMEM;
+	ref_init ( &server->refcnt, NULL );
+	intf_init ( &server->xfer, &dns_test_server_desc, &server->refcnt );
+	process_init_stopped ( &server->process, &dns_test_server_process_desc,
+			       &server->refcnt );
+	INIT_LIST_HEAD ( &server->responses );
+
+	/* Attach parent interface, mortalise self, and return */
+	intf_plug_plug ( &server->xfer, xfer );
+	ref_put ( &server->refcnt );
+	return 0;
+}
+
+/** DNS test nameserver socket opener
+ *
+ * This takes precedence over the normal UDP socket opener.
+ */
+struct socket_opener dns_test_socket_opener
+	__table_entry ( SOCKET_OPENERS, 00 ) = {
+	.semantics	= UDP_SOCK_DGRAM,
+	.family		= AF_INET,
+	.open		= dns_test_server_open,
+};
+
+/**
+ * Report DNS response test result
+ *
+ * @v test		DNS response test
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void dns_response_okx ( struct dns_response_test *test,
+			       const char *file, unsigned int line ) {
+	struct dns_cache_test res;
+	struct sockaddr_in sa;
+	unsigned int queries = dns_stats.queries;
+	unsigned int i;
+
+	/* Resolve name */
+	dns_response_test = test;
+	memset ( &res, 0, sizeof ( res ) );
+	intf_init ( &res.resolv, &dns_cache_test_desc, NULL );
+	memset ( &sa, 0, sizeof ( sa ) );
+	okx ( resolv ( &res.resolv, test->name,
+		       ( struct sockaddr * ) &sa ) == 0, file, line );
+	for ( i = 0 ; ( ( ! res.done ) && ( i < 64 ) ) ; i++ )
+		step();
+	okx ( res.done, file, line );
+	dns_response_test = NULL;
+
+	/* Check that queries were sent to the nameserver */
+	okx ( dns_stats.queries > queries, file, line );
+
+	/* Check result */
+	if ( test->address ) {
+		okx ( res.rc == 0, file, line );
+		okx ( res.sin.sin_family == AF_INET, file, line );
+		okx ( res.sin.sin_addr.s_addr == htonl ( test->address ),
+		      file, line );
+	} else {
+		okx ( res.rc != 0, file, line );
+		okx ( res.resolved == 0, file, line );
+	}
+
+	/* Check cached time to live.  No IPv6 result is cached,
+	 * since the test nameserver returns no SOA record in
+	 * response to "AAAA" queries.
+	 */
+	okx ( dns_cache_ttl ( test->name, AF_INET ) == test->ttl, file, line );
+	okx ( dns_cache_ttl ( test->name, AF_INET6 ) == 0, file, line );
+}
+#define dns_response_ok( test ) dns_response_okx ( test, __FILE__, __LINE__ )
+
+/* Minimum TTL across matching CNAME and A records, ignoring others */
+DNS_RESPONSE ( response_min_a, "boot.ipxe.test",
+	DATA ( /* x.ipxe.test A 10.0.0.99 TTL 5 (ignored) */
+	       1, 'x', 0xc0, 17, 0, DNS_TYPE_A, 0, DNS_CLASS_IN, U32 ( 5 ),
+	       0, 4, 10, 0, 0, 99,
+	       /* boot.ipxe.test CNAME www.ipxe.test TTL 300 */
+	       0xc0, 12, 0, DNS_TYPE_CNAME, 0, DNS_CLASS_IN, U32 ( 300 ),
+	       0, 6, 3, 'w', 'w', 'w', 0xc0, 17,
+	       /* www.ipxe.test A 10.0.0.1 TTL 60 */
+	       0xc0, 62, 0, DNS_TYPE_A, 0, DNS_CLASS_IN, U32 ( 60 ),
+	       0, 4, 10, 0, 0, 1 ),
+	DATA(), 0x0a000001UL, 60 );
+
+/* Minimum TTL taken from CNAME record */
+DNS_RESPONSE ( response_min_cname, "cnam.ipxe.test",
+	DATA ( /* cnam.ipxe.test CNAME www.ipxe.test TTL 45 */
+	       0xc0, 12, 0, DNS_TYPE_CNAME, 0, DNS_CLASS_IN, U32 ( 45 ),
+	       0, 6, 3, 'w', 'w', 'w', 0xc0, 17,
+	       /* www.ipxe.test A 10.0.0.2 TTL 600 */
+	       0xc0, 44, 0, DNS_TYPE_A, 0, DNS_CLASS_IN, U32 ( 600 ),
+	       0, 4, 10, 0, 0, 2 ),
+	DATA(), 0x0a000002UL, 45 );
+
+/* Address records for the other family are ignored */
+DNS_RESPONSE ( response_other_family, "mixd.ipxe.test",
+	DATA ( /* mixd.ipxe.test AAAA fe80::1 TTL 5 (ignored) */
+	       0xc0, 12, 0, DNS_TYPE_AAAA, 0, DNS_CLASS_IN, U32 ( 5 ),
+	       0, 16, 0xfe, 0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
+	       /* mixd.ipxe.test A 10.0.0.5 TTL 60 */
+	       0xc0, 12, 0, DNS_TYPE_A, 0, DNS_CLASS_IN, U32 ( 60 ),
+	       0, 4, 10, 0, 0, 5 ),
+	DATA(), 0x0a000005UL, 60 );
+
+/* Excessive TTL is capped */
+DNS_RESPONSE ( response_max, "huge.ipxe.test",
+	DATA ( /* huge.ipxe.test A 10.0.0.3 TTL 0xffffffff */
+	       0xc0, 12, 0, DNS_TYPE_A, 0, DNS_CLASS_IN, U32 ( 0xffffffffUL ),
+	       0, 4, 10, 0, 0, 3 ),
+	DATA(), 0x0a000003UL, DNS_CACHE_MAX_TTL );
+
+/* Zero TTL is not cached */
+DNS_RESPONSE ( response_zero, "zero.ipxe.test",
+	DATA ( /* zero.ipxe.test A 10.0.0.4 TTL 0 */
+	       0xc0, 12, 0, DNS_TYPE_A, 0, DNS_CLASS_IN, U32 ( 0 ),
+	       0, 4, 10, 0, 0, 4 ),
+	DATA(), 0x0a000004UL, 0 );
+
+/** An "ipxe.test" SOA record */
+#define SOA( ttl, minimum )						\
+	0xc0, 17, 0, DNS_TYPE_SOA, 0, DNS_CLASS_IN, U32 ( ttl ),	\
+	0, 30, 2, 'n', 's', 0xc0, 17, 2, 'h', 'm', 0xc0, 17,		\
+	U32 ( 1 ), U32 ( 3600 ), U32 ( 900 ), U32 ( 604800 ),		\
+	U32 ( minimum )
+
+/* Negative result cached using SOA minimum field */
+DNS_RESPONSE ( response_soa_minimum, "none.ipxe.test",
+	DATA ( SOA ( 900, 300 ) ), DATA ( SOA ( 900, 300 ) ), 0, 300 );
+
+/* Negative result cached using SOA record TTL */
+DNS_RESPONSE ( response_soa_ttl, "tiny.ipxe.test",
+	DATA ( SOA ( 120, 3600 ) ), DATA ( SOA ( 120, 3600 ) ), 0, 120 );
+
+/* Excessive negative TTL is capped */
+DNS_RESPONSE ( response_soa_max, "long.ipxe.test",
+	DATA ( SOA ( 86400, 86400 ) ), DATA ( SOA ( 86400, 86400 ) ), 0,
+	DNS_CACHE_MAX_NEGATIVE_TTL );
+
+/* Negative result is cached only if every response has an SOA record */
+DNS_RESPONSE ( response_soa_partial, "part.ipxe.test",
+	DATA ( SOA ( 900, 300 ) ), DATA(), 0, 0 );
+
+/* Negative result without SOA record is not cached */
+DNS_RESPONSE ( response_nxdomain, "gone.ipxe.test", DATA(), DATA(), 0, 0 );
+
+/* Negative result with truncated SOA record is not cached */
+DNS_RESPONSE ( response_soa_truncated, "trim.ipxe.test",
+	DATA ( 0xc0, 17, 0, DNS_TYPE_SOA, 0, DNS_CLASS_IN, U32 ( 900 ),
+	       0, 10, 2, 'n', 's', 0xc0, 17, 2, 'h', 'm', 0xc0, 17 ),
+	DATA ( 0xc0, 17, 0, DNS_TYPE_SOA, 0, DNS_CLASS_IN, U32 ( 900 ),
+	       0, 10, 2, 'n', 's', 0xc0, 17, 2, 'h', 'm', 0xc0, 17 ),
+	0, 0 );
+
+/**
+ * Perform DNS response self-tests
+ *
+ */
+static void dns_response_test_exec ( void ) {
+	struct in_addr nameserver;
+
+	/* Use test nameserver (which also flushes the cache) */
+	nameserver.s_addr = htonl ( DNS_TEST_NAMESERVER );
+	ok ( store_setting ( NULL, &dns_setting, &nameserver,
+			     sizeof ( nameserver ) ) == 0 );
+
+	/* Positive responses */
+	dns_response_ok ( &response_min_a );
+	dns_response_ok ( &response_min_cname );
+	dns_response_ok ( &response_other_family );
+	dns_response_ok ( &response_max );
+	dns_response_ok ( &response_zero );
+
+	/* Negative responses */
+	dns_response_ok ( &response_soa_minimum );
+	dns_response_ok ( &response_soa_ttl );
+	dns_response_ok ( &response_soa_max );
+	dns_response_ok ( &response_soa_partial );
+	dns_response_ok ( &response_nxdomain );
+	dns_response_ok ( &response_soa_truncated );
+
+	/* Remove test nameserver (which also flushes the cache) */
+	delete_setting ( NULL, &dns_setting );
+	dns_cache_ok ( "boot.ipxe.test", NULL, NULL, 0 );
+}
+
 /* Simple encoding test */
 DNS_ENCODE ( encode_simple, "ipxe.org",
 	     DATA ( 4, 'i', 'p', 'x', 'e', 3, 'o', 'r', 'g', 0 ) );
@@ -600,6 +1235,12 @@ static void dns_test_exec ( void ) {
 
 	/* Search list tets */
 	dns_list_ok ( &search );
+
+	/* Cache tests */
+	dns_cache_test_exec();
+
+	/* Response tests */
+	dns_response_test_exec();
 }
 
 /** DNS self-test */
@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Frame buffer console self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <ipxe/umalloc.h>
+#include <ipxe/pixbuf.h>
+#include <ipxe/console.h>
+#include <ipxe/profile.h>
+#include <ipxe/fbcon.h>
+#include <ipxe/test.h>
+
+/** Font height used for tests */
+#define FBCON_TEST_FONT_HEIGHT 16
+
+/** A frame buffer console test */
+struct fbcon_test {
+	/** Width (in pixels) */
+	unsigned int width;
+	/** Height (in pixels) */
+	unsigned int height;
+	/** Number of lines to print */
+	unsigned int lines;
+	/** Use background picture */
+	int picture;
+};
+
+/** Define a frame buffer console test */
+#define FBCON_TEST( name, WIDTH, HEIGHT, LINES, PICTURE )		\
+	static struct fbcon_test name = {				\
+		.width = WIDTH,						\
+		.height = HEIGHT,					\
+		.lines = LINES,						\
+		.picture = PICTURE,					\
+	}
+
+/** Many lines on a large console */
+FBCON_TEST ( large, 1024, 768, 2048, 0 );
+
+/** Many lines on a small console */
+FBCON_TEST ( small, 320, 200, 2048, 0 );
+
+/** Lines on a small console with a background picture */
+FBCON_TEST ( small_picture, 320, 200, 256, 1 );
+
+/** Colour mapping (32-bit xRGB) */
+static struct fbcon_colour_map fbcon_test_map = {
+	.red_scale = 0,
+	.green_scale = 0,
+	.blue_scale = 0,
+	.red_lsb = 16,
+	.green_lsb = 8,
+	.blue_lsb = 0,
+};
+
+/**
+ * Get character glyph
+ *
+ * @v character		Character
+ * @v glyph		Character glyph to fill in
+ */
+static void fbcon_test_glyph ( unsigned int character, uint8_t *glyph ) {
+	unsigned int i;
+
+	/* Generate an arbitrary (but blank for spaces) pattern */
+	for ( i = 0 ; i < FBCON_TEST_FONT_HEIGHT ; i++ ) {
+		glyph[i] = ( ( character == ' ' ) ?
+			     0 : ( ( character * ( i + 1 ) ) ^ ( i << 4 ) ) );
+	}
+}
+
+/** Font definition */
+static struct fbcon_font fbcon_test_font = {
+	.height = FBCON_TEST_FONT_HEIGHT,
+	.glyph = fbcon_test_glyph,
+};
+
+/**
+ * Print line to frame buffer console
+ *
+ * @v fbcon		Frame buffer console
+ * @v index		Line index
+ */
+static void fbcon_test_line ( struct fbcon *fbcon, unsigned int index ) {
+	char buf[64];
+	unsigned int i;
+
+	/* Construct line with a varying colour and length, leaving
+	 * some lines blank.
+	 */
+	if ( index % 7 ) {
+		snprintf ( buf, sizeof ( buf ),
+			   "\033[%dm\033[%dmLine %d%.*s\033[0m\n",
+			   ( 30 + ( index % 8 ) ),
+			   ( ( index % 5 ) ? 49 : ( 40 + ( index % 3 ) ) ),
+			   index, ( index % 23 ), "........................" );
+	} else {
+		snprintf ( buf, sizeof ( buf ), "\n" );
+	}
+
+	/* Print line */
+	for ( i = 0 ; buf[i] ; i++ )
+		fbcon_putchar ( fbcon, buf[i] );
+}
+
+/**
+ * Report frame buffer console test result
+ *
+ * @v test		Frame buffer console test
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void fbcon_okx ( struct fbcon_test *test, const char *file,
+			unsigned int line ) {
+	struct fbcon_geometry pixel = {
+		.width = test->width,
+		.height = test->height,
+		.len = sizeof ( uint32_t ),
+		.stride = ( test->width * sizeof ( uint32_t ) ),
+	};
+	struct console_configuration config = {
+		.width = test->width,
+		.height = test->height,
+		.depth = 32,
+	};
+	unsigned int saved_width = console_width;
+	unsigned int saved_height = console_height;
+	struct pixel_buffer *pixbuf = NULL;
+	struct profiler profiler;
+	struct fbcon scrolled;
+	struct fbcon fresh;
+	userptr_t scrolled_start;
+	userptr_t fresh_start;
+	size_t len = ( pixel.height * pixel.stride );
+	uint32_t *data;
+	unsigned int first;
+	unsigned int i;
+
+	/* Allocate frame buffers */
+	scrolled_start = umalloc ( len );
+	okx ( scrolled_start != UNULL, file, line );
+	fresh_start = umalloc ( len );
+	okx ( fresh_start != UNULL, file, line );
+	if ( ( ! scrolled_start ) || ( ! fresh_start ) )
+		goto err_umalloc;
+
+	/* Construct background picture, if applicable */
+	if ( test->picture ) {
+		pixbuf = alloc_pixbuf ( test->width, test->height );
+		okx ( pixbuf != NULL, file, line );
+		if ( ! pixbuf )
+			goto err_pixbuf;
+		data = user_to_virt ( pixbuf->data, 0 );
+		for ( i = 0 ; i < ( test->width * test->height ) ; i++ )
+			data[i] = ( i * 0x010203 );
+		config.pixbuf = pixbuf;
+	}
+
+	/* Print all lines (with scrolling) */
+	okx ( fbcon_init ( &scrolled, scrolled_start, &pixel, &fbcon_test_map,
+			   &fbcon_test_font, &config ) == 0, file, line );
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < test->lines ; i++ ) {
+		profile_start ( &profiler );
+		fbcon_test_line ( &scrolled, i );
+		profile_stop ( &profiler );
+	}
+	DBG ( "FBCON printed %d lines on %dx%d console%s in %ld +/- %ld "
+	      "ticks per line\n", test->lines, test->width, test->height,
+	      ( test->picture ? " with picture" : "" ),
+	      profile_mean ( &profiler ), profile_stddev ( &profiler ) );
+
+	/* Print only the lines remaining on screen (without scrolling) */
+	okx ( fbcon_init ( &fresh, fresh_start, &pixel, &fbcon_test_map,
+			   &fbcon_test_font, &config ) == 0, file, line );
+	assert ( test->lines >= fresh.character.height );
+	first = ( test->lines - ( fresh.character.height - 1 ) );
+	for ( i = first ; i < test->lines ; i++ )
+		fbcon_test_line ( &fresh, i );
+
+	/* Verify that both frame buffers are identical */
+	okx ( memcmp ( user_to_virt ( scrolled_start, 0 ),
+		       user_to_virt ( fresh_start, 0 ), len ) == 0,
+	      file, line );
+
+	fbcon_fini ( &fresh );
+	fbcon_fini ( &scrolled );
+	if ( pixbuf )
+		pixbuf_put ( pixbuf );
+ err_pixbuf:
+ err_umalloc:
+	ufree ( fresh_start );
+	ufree ( scrolled_start );
+	console_set_size ( saved_width, saved_height );
+}
+#define fbcon_ok( test ) fbcon_okx ( test, __FILE__, __LINE__ )
+
+/**
+ * Perform frame buffer console self-tests
+ *
+ */
+static void fbcon_test_exec ( void ) {
+
+	fbcon_ok ( &large );
+	fbcon_ok ( &small );
+	fbcon_ok ( &small_picture );
+}
+
+/** Frame buffer console self-test */
+struct self_test fbcon_test __self_test = {
+	.name = "fbcon",
+	.exec = fbcon_test_exec,
+};
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Image name index self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdio.h>
+#include <ipxe/image.h>
+#include <ipxe/image_index.h>
+#include <ipxe/test.h>
+
+/** Number of images used for the large index test */
+#define IMAGE_INDEX_TEST_MANY 300
+
+/**
+ * Create and register test image
+ *
+ * @v name		Image name
+ * @ret image		Image
+ */
+static struct image * image_index_test_register ( const char *name ) {
+	struct image *image;
+
+	image = alloc_image ( NULL );
+	ok ( image != NULL );
+	if ( ! image )
+		return NULL;
+	ok ( image_set_name ( image, name ) == 0 );
+	ok ( register_image ( image ) == 0 );
+	image_put ( image );
+	return image;
+}
+
+/**
+ * Perform image name index self-tests
+ *
+ */
+static void image_index_test_exec ( void ) {
+	static struct image *many[IMAGE_INDEX_TEST_MANY];
+	struct image *first;
+	struct image *second;
+	struct image *other;
+	char name[32];
+	unsigned int i;
+	int found;
+
+	/* Register test images */
+	first = image_index_test_register ( "idxtest.efi" );
+	second = image_index_test_register ( "IDXTEST.EFI" );
+	other = image_index_test_register ( "idxother" );
+	if ( ! ( first && second && other ) )
+		return;
+
+	/* Check lookups, case-insensitivity and first-match order */
+	ok ( find_image_nocase ( "idxtest.efi" ) == first );
+	ok ( find_image_nocase ( "IdxTest.Efi" ) == first );
+	ok ( find_image_nocase ( "IDXOTHER" ) == other );
+	ok ( find_image_nocase ( "idxmissing" ) == NULL );
+	ok ( find_image_nocase ( "idxtest" ) == NULL );
+
+	/* Check that renaming invalidates the index */
+	ok ( image_set_name ( first, "idxrenamed" ) == 0 );
+	ok ( find_image_nocase ( "idxtest.efi" ) == second );
+	ok ( find_image_nocase ( "IDXRENAMED" ) == first );
+
+	/* Check that unregistration invalidates the index */
+	unregister_image ( second );
+	ok ( find_image_nocase ( "idxtest.efi" ) == NULL );
+	unregister_image ( first );
+	ok ( find_image_nocase ( "idxrenamed" ) == NULL );
+	ok ( find_image_nocase ( "idxother" ) == other );
+
+	/* Check that the index grows to accommodate many images */
+	for ( i = 0 ; i < IMAGE_INDEX_TEST_MANY ; i++ ) {
+		snprintf ( name, sizeof ( name ), "idxmany%d", i );
+		many[i] = image_index_test_register ( name );
+	}
+	found = 1;
+	for ( i = 0 ; i < IMAGE_INDEX_TEST_MANY ; i++ ) {
+		snprintf ( name, sizeof ( name ), "IDXMANY%d", i );
+		if ( find_image_nocase ( name ) != many[i] )
+			found = 0;
+	}
+	ok ( found );
+	ok ( find_image_nocase ( "idxother" ) == other );
+	ok ( find_image_nocase ( "idxmany" ) == NULL );
+
+	/* Unregister remaining images */
+	for ( i = 0 ; i < IMAGE_INDEX_TEST_MANY ; i++ ) {
+		if ( many[i] )
+			unregister_image ( many[i] );
+	}
+	unregister_image ( other );
+	ok ( find_image_nocase ( "idxmany0" ) == NULL );
+	ok ( find_image_nocase ( "idxother" ) == NULL );
+}
+
+/** Image name index self-test */
+struct self_test image_index_test __self_test = {
+	.name = "image_index",
+	.exec = image_index_test_exec,
+};
@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * initrd reshuffling self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <ipxe/initrd.h>
+#include <ipxe/image.h>
+#include <ipxe/umalloc.h>
+#include <ipxe/uaccess.h>
+#include <ipxe/test.h>
+
+/** Maximum number of initrds in a test */
+#define INITRD_TEST_MAX 16
+
+/** An initrd reshuffling test */
+struct initrd_test {
+	/** Random seed */
+	unsigned int seed;
+	/** Number of initrds */
+	unsigned int count;
+	/** Maximum length of each initrd */
+	size_t max_len;
+	/** Length of memory region */
+	size_t region_len;
+	/** Free space is insufficient to evacuate all initrds */
+	int tight;
+};
+
+/** Define an initrd reshuffling test */
+#define INITRD_TEST( name, SEED, COUNT, MAX_LEN, REGION_LEN, TIGHT )	\
+	static struct initrd_test name = {				\
+		.seed = SEED,						\
+		.count = COUNT,						\
+		.max_len = MAX_LEN,					\
+		.region_len = REGION_LEN,				\
+		.tight = TIGHT,						\
+	}
+
+/** Single initrd */
+INITRD_TEST ( single, 0x1234, 1, 65536, ( 256 * 1024 ), 0 );
+
+/** A few initrds with plentiful free space */
+INITRD_TEST ( few_roomy, 0x2718, 4, 65536, ( 1024 * 1024 ), 0 );
+
+/** Many initrds with plentiful free space */
+INITRD_TEST ( many_roomy, 0x3141, 12, 65536, ( 2048 * 1024 ), 0 );
+
+/** Many small initrds with plentiful free space */
+INITRD_TEST ( many_small, 0x1618, 16, 4096, ( 256 * 1024 ), 0 );
+
+/** Many initrds with restricted free space
+ *
+ * The initrds total 440kB, leaving only 64kB of free space.
+ */
+INITRD_TEST ( many_tight, 0x5772, 12, 65536, ( 504 * 1024 ), 1 );
+
+/**
+ * Generate initrd content byte
+ *
+ * @v index		initrd index
+ * @v offset		Offset within initrd
+ * @ret byte		Content byte
+ */
+static inline uint8_t initrd_test_byte ( unsigned int index, size_t offset ) {
+	return ( ( index << 4 ) ^ offset ^ ( offset >> 8 ) );
+}
+
+/**
+ * Report initrd reshuffling test result
+ *
+ * @v test		initrd reshuffling test
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void initrd_okx ( struct initrd_test *test, const char *file,
+			 unsigned int line ) {
+	struct image *images[INITRD_TEST_MAX];
+	unsigned int order[INITRD_TEST_MAX];
+	struct image *image;
+	userptr_t region;
+	userptr_t current;
+	uint8_t *data;
+	size_t total = 0;
+	size_t offset;
+	size_t moved;
+	size_t len;
+	unsigned int tmp;
+	unsigned int i;
+	unsigned int j;
+	int correct;
+
+	/* Sanity check */
+	assert ( test->count <= INITRD_TEST_MAX );
+
+	/* Allocate memory region */
+	region = umalloc ( test->region_len );
+	okx ( region != UNULL, file, line );
+	if ( ! region )
+		return;
+
+	/* Create initrds */
+	srandom ( test->seed );
+	for ( i = 0 ; i < test->count ; i++ ) {
+		image = alloc_image ( NULL );
+		okx ( image != NULL, file, line );
+		assert ( image != NULL );
+		image->len = ( ( random() % test->max_len ) + 1 );
+		total += ( ( image->len + INITRD_ALIGN - 1 ) &
+			   ~( INITRD_ALIGN - 1 ) );
+		images[i] = image;
+		order[i] = i;
+	}
+	assert ( total <= test->region_len );
+
+	/* Verify that free space is restricted, if applicable */
+	if ( test->tight )
+		okx ( ( 2 * total ) > test->region_len, file, line );
+
+	/* Place initrds at the bottom of the region in random order */
+	for ( i = ( test->count - 1 ) ; i > 0 ; i-- ) {
+		j = ( random() % ( i + 1 ) );
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+	offset = 0;
+	for ( i = 0 ; i < test->count ; i++ ) {
+		image = images[ order[i] ];
+		image->data = userptr_add ( region, offset );
+		data = user_to_virt ( image->data, 0 );
+		for ( j = 0 ; j < image->len ; j++ )
+			data[j] = initrd_test_byte ( order[i], j );
+		offset += ( ( image->len + INITRD_ALIGN - 1 ) &
+			    ~( INITRD_ALIGN - 1 ) );
+	}
+
+	/* Register initrds in desired order */
+	for ( i = 0 ; i < test->count ; i++ )
+		okx ( register_image ( images[i] ) == 0, file, line );
+
+	/* Reshuffle initrds */
+	moved = initrd_rearrange ( region,
+				   userptr_add ( region, test->region_len ) );
+	DBG ( "INITRD reshuffled %d initrds (%#zx bytes) within %#zx bytes "
+	      "by moving %#zx bytes\n", test->count, total, test->region_len,
+	      moved );
+
+	/* Verify that each initrd is in its final location */
+	current = userptr_add ( region, ( test->region_len - total ) );
+	for ( i = 0 ; i < test->count ; i++ ) {
+		image = images[i];
+		okx ( image->data == current, file, line );
+		data = user_to_virt ( image->data, 0 );
+		correct = 1;
+		for ( j = 0 ; j < image->len ; j++ ) {
+			if ( data[j] != initrd_test_byte ( i, j ) )
+				correct = 0;
+		}
+		okx ( correct, file, line );
+		len = ( ( image->len + INITRD_ALIGN - 1 ) &
+			~( INITRD_ALIGN - 1 ) );
+		current = userptr_add ( current, len );
+	}
+
+	/* Verify that no initrd was moved more than three times
+	 * (i.e. squashed, evacuated and placed), if there was
+	 * sufficient free space to allow this.
+	 */
+	if ( ( 2 * total ) <= test->region_len )
+		okx ( moved <= ( 3 * total ), file, line );
+
+	/* Unregister initrds */
+	for ( i = 0 ; i < test->count ; i++ ) {
+		image = images[i];
+		image->data = UNULL;
+		image->len = 0;
+		unregister_image ( image );
+		image_put ( image );
+	}
+
+	/* Free memory region */
+	ufree ( region );
+}
+#define initrd_ok( test ) initrd_okx ( test, __FILE__, __LINE__ )
+
+/**
+ * Perform initrd reshuffling self-tests
+ *
+ */
+static void initrd_test_exec ( void ) {
+
+	initrd_ok ( &single );
+	initrd_ok ( &few_roomy );
+	initrd_ok ( &many_roomy );
+	initrd_ok ( &many_small );
+	initrd_ok ( &many_tight );
+}
+
+/** initrd reshuffling self-test */
+struct self_test initrd_test __self_test = {
+	.name = "initrd",
+	.exec = initrd_test_exec,
+};
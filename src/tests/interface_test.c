@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Object interface self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <ipxe/test.h>
+#include <ipxe/profile.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/interface.h>
+#include <ipxe/xfer.h>
+
+/** Number of pass-through filters in test chain */
+#define INTF_TEST_FILTERS 3
+
+/** Number of sample iterations for profiling */
+#define PROFILE_COUNT 1024
+
+/** Flow control window reported by test sink */
+#define INTF_TEST_WINDOW 4096
+
+/** A test data source */
+struct intf_test_source {
+	/** Data transfer interface */
+	struct interface xfer;
+};
+
+/** A test pass-through filter
+ *
+ * This models a protocol layer (such as TLS or a content decoder)
+ * which does not itself handle data transfer operations, and so
+ * passes them through to the underlying interface.
+ */
+struct intf_test_filter {
+	/** Upper data transfer interface */
+	struct interface up;
+	/** Lower data transfer interface */
+	struct interface down;
+	/** Number of window change notifications received */
+	unsigned int changed;
+};
+
+/** A test data sink */
+struct intf_test_sink {
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Number of datagrams received */
+	unsigned int rx;
+};
+
+/** Test data source */
+static struct intf_test_source intf_test_source;
+
+/** Test pass-through filters */
+static struct intf_test_filter intf_test_filters[INTF_TEST_FILTERS];
+
+/** Test data sinks */
+static struct intf_test_sink intf_test_sinks[2];
+
+/** Data delivery profiler */
+static struct profiler intf_test_deliver_profiler __profiler =
+	{ .name = "intf.deliver" };
+
+/**
+ * Receive window change notification
+ *
+ * @v filter		Test filter
+ */
+static void intf_test_filter_changed ( struct intf_test_filter *filter ) {
+
+	filter->changed++;
+}
+
+/** Test filter upper interface operations */
+static struct interface_operation intf_test_filter_up_op[] = {
+	INTF_OP ( xfer_window_changed, struct intf_test_filter *,
+		  intf_test_filter_changed ),
+};
+
+/** Test filter upper interface descriptor */
+static struct interface_descriptor intf_test_filter_up_desc =
+	INTF_DESC_PASSTHRU ( struct intf_test_filter, up,
+			     intf_test_filter_up_op, down );
+
+/** Test filter lower interface operations */
+static struct interface_operation intf_test_filter_down_op[] = {
+	INTF_OP ( xfer_window_changed, struct intf_test_filter *,
+		  intf_test_filter_changed ),
+};
+
+/** Test filter lower interface descriptor */
+static struct interface_descriptor intf_test_filter_down_desc =
+	INTF_DESC_PASSTHRU ( struct intf_test_filter, down,
+			     intf_test_filter_down_op, up );
+
+/**
+ * Receive datagram
+ *
+ * @v sink		Test sink
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int intf_test_sink_deliver ( struct intf_test_sink *sink,
+				    struct io_buffer *iobuf __unused,
+				    struct xfer_metadata *meta __unused ) {
+
+	/* Retain I/O buffer for reuse by the caller */
+	sink->rx++;
+	return 0;
+}
+
+/**
+ * Check flow control window
+ *
+ * @v sink		Test sink
+ * @ret len		Length of window
+ */
+static size_t intf_test_sink_window ( struct intf_test_sink *sink __unused ) {
+
+	return INTF_TEST_WINDOW;
+}
+
+/** Test sink interface operations */
+static struct interface_operation intf_test_sink_op[] = {
+	INTF_OP ( xfer_deliver, struct intf_test_sink *,
+		  intf_test_sink_deliver ),
+	INTF_OP ( xfer_window, struct intf_test_sink *,
+		  intf_test_sink_window ),
+};
+
+/** Test sink interface descriptor */
+static struct interface_descriptor intf_test_sink_desc =
+	INTF_DESC ( struct intf_test_sink, xfer, intf_test_sink_op );
+
+/**
+ * Construct test chain
+ *
+ * @v sink		Test sink
+ */
+static void intf_test_plug ( struct intf_test_sink *sink ) {
+	struct interface *up = &intf_test_source.xfer;
+	struct intf_test_filter *filter;
+	unsigned int i;
+
+	for ( i = 0 ; i < INTF_TEST_FILTERS ; i++ ) {
+		filter = &intf_test_filters[i];
+		intf_plug_plug ( up, &filter->up );
+		up = &filter->down;
+	}
+	intf_plug_plug ( up, &sink->xfer );
+}
+
+/**
+ * Perform object interface self-tests
+ *
+ */
+static void intf_test_exec ( void ) {
+	struct intf_test_filter *filter;
+	struct intf_test_sink *sink;
+	struct io_buffer *iobuf;
+	unsigned int i;
+	int rc;
+
+	/* Initialise test objects */
+	intf_init ( &intf_test_source.xfer, &null_intf_desc, NULL );
+	for ( i = 0 ; i < INTF_TEST_FILTERS ; i++ ) {
+		filter = &intf_test_filters[i];
+		memset ( filter, 0, sizeof ( *filter ) );
+		intf_init ( &filter->up, &intf_test_filter_up_desc, NULL );
+		intf_init ( &filter->down, &intf_test_filter_down_desc, NULL );
+	}
+	for ( i = 0 ; i < ( sizeof ( intf_test_sinks ) /
+			    sizeof ( intf_test_sinks[0] ) ) ; i++ ) {
+		sink = &intf_test_sinks[i];
+		memset ( sink, 0, sizeof ( *sink ) );
+		intf_init ( &sink->xfer, &intf_test_sink_desc, NULL );
+	}
+	iobuf = alloc_iob ( 0 );
+	ok ( iobuf != NULL );
+	if ( ! iobuf )
+		return;
+
+	/* Deliver datagrams through the chain */
+	intf_test_plug ( &intf_test_sinks[0] );
+	rc = 0;
+	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
+		profile_start ( &intf_test_deliver_profiler );
+		rc |= xfer_deliver_iob ( &intf_test_source.xfer, iobuf );
+		profile_stop ( &intf_test_deliver_profiler );
+	}
+	ok ( rc == 0 );
+	ok ( intf_test_sinks[0].rx == PROFILE_COUNT );
+	DBG ( "INTF delivered through %d pass-through filters in %ld +/- %ld "
+	      "ticks\n", INTF_TEST_FILTERS,
+	      profile_mean ( &intf_test_deliver_profiler ),
+	      profile_stddev ( &intf_test_deliver_profiler ) );
+
+	/* Check operations handled within and beyond the chain */
+	ok ( xfer_window ( &intf_test_source.xfer ) == INTF_TEST_WINDOW );
+	xfer_window_changed ( &intf_test_source.xfer );
+	ok ( intf_test_filters[0].changed == 1 );
+	xfer_window_changed ( &intf_test_sinks[0].xfer );
+	ok ( intf_test_filters[ INTF_TEST_FILTERS - 1 ].changed == 1 );
+
+	/* Verify that replugging redirects subsequent deliveries */
+	intf_test_plug ( &intf_test_sinks[1] );
+	ok ( xfer_deliver_iob ( &intf_test_source.xfer, iobuf ) == 0 );
+	ok ( intf_test_sinks[0].rx == PROFILE_COUNT );
+	ok ( intf_test_sinks[1].rx == 1 );
+
+	/* Verify that a nullified destination receives nothing */
+	intf_nullify ( &intf_test_sinks[1].xfer );
+	ok ( xfer_window ( &intf_test_source.xfer ) != INTF_TEST_WINDOW );
+	ok ( xfer_deliver_iob ( &intf_test_source.xfer, iobuf ) != 0 );
+	ok ( intf_test_sinks[1].rx == 1 );
+
+	/* Verify that a restored destination receives data again */
+	intf_test_sinks[1].xfer.desc = &intf_test_sink_desc;
+	intf_test_plug ( &intf_test_sinks[1] );
+	iobuf = alloc_iob ( 0 );
+	ok ( iobuf != NULL );
+	if ( ! iobuf )
+		return;
+	ok ( xfer_deliver_iob ( &intf_test_source.xfer, iobuf ) == 0 );
+	ok ( intf_test_sinks[1].rx == 2 );
+
+	/* Verify that unplugging stops deliveries */
+	intf_unplug ( &intf_test_filters[0].down );
+	ok ( xfer_window ( &intf_test_source.xfer ) != INTF_TEST_WINDOW );
+	intf_plug ( &intf_test_filters[0].down, &intf_test_filters[1].up );
+	ok ( xfer_window ( &intf_test_source.xfer ) == INTF_TEST_WINDOW );
+
+	/* Dismantle chain */
+	intf_unplug ( &intf_test_source.xfer );
+	for ( i = 0 ; i < INTF_TEST_FILTERS ; i++ ) {
+		filter = &intf_test_filters[i];
+		intf_unplug ( &filter->up );
+		intf_unplug ( &filter->down );
+	}
+	intf_unplug ( &intf_test_sinks[0].xfer );
+	intf_unplug ( &intf_test_sinks[1].xfer );
+	free_iob ( iobuf );
+}
+
+/** Object interface self-test */
+struct self_test interface_test __self_test = {
+	.name = "interface",
+	.exec = intf_test_exec,
+};
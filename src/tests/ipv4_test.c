@@ -33,9 +33,15 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #undef NDEBUG
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <assert.h>
 #include <byteswap.h>
 #include <ipxe/in.h>
+#include <ipxe/ip.h>
+#include <ipxe/ipstat.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/fragment.h>
 #include <ipxe/test.h>
 
 /** Define inline IPv4 address */
@@ -104,6 +110,349 @@ static void inet_aton_fail_okx ( const char *text, const char *file,
 #define inet_aton_fail_ok( text ) \
 	inet_aton_fail_okx ( text, __FILE__, __LINE__ )
 
+/** An IPv4 fragment */
+struct ipv4_fragment {
+	/** Offset within payload */
+	size_t offset;
+	/** Length */
+	size_t len;
+};
+
+/** An IPv4 fragment reassembly test */
+struct ipv4_fragment_test {
+	/** Length of reassembled payload */
+	size_t len;
+	/** Fragments, in order of arrival (or NULL to generate) */
+	struct ipv4_fragment *frags;
+	/** Number of fragments */
+	unsigned int count;
+	/** Length of each generated fragment */
+	size_t frag_len;
+	/** Random seed used to shuffle generated fragments */
+	unsigned int seed;
+	/** Allocate fragments with room for the whole payload */
+	int inplace;
+};
+
+/** Maximum number of fragments in a test */
+#define IPV4_FRAGMENT_TEST_MAX 64
+
+/** Reassembled payload length used for fragments which are never final */
+#define IPV4_FRAGMENT_TEST_INFINITY 0xffff
+
+/** Define inline fragment */
+#define FRAG( offset, len ) { offset, len }
+
+/** Define an IPv4 fragment reassembly test using explicit fragments */
+#define IPV4_FRAGMENT_TEST( name, LEN, ... )				\
+	static struct ipv4_fragment name ## _frags[] = { __VA_ARGS__ };	\
+	static struct ipv4_fragment_test name = {			\
+		.len = LEN,						\
+		.frags = name ## _frags,				\
+		.count = ( sizeof ( name ## _frags ) /			\
+			   sizeof ( name ## _frags[0] ) ),		\
+	}
+
+/** Define an IPv4 fragment reassembly test using fragments which may
+ * be extended in place
+ */
+#define IPV4_FRAGMENT_INPLACE_TEST( name, LEN, ... )			\
+	static struct ipv4_fragment name ## _frags[] = { __VA_ARGS__ };	\
+	static struct ipv4_fragment_test name = {			\
+		.len = LEN,						\
+		.frags = name ## _frags,				\
+		.count = ( sizeof ( name ## _frags ) /			\
+			   sizeof ( name ## _frags[0] ) ),		\
+		.inplace = 1,						\
+	}
+
+/** Define an IPv4 fragment reassembly test using shuffled fragments */
+#define IPV4_FRAGMENT_SHUFFLE_TEST( name, LEN, FRAG_LEN, SEED )	\
+	static struct ipv4_fragment_test name = {			\
+		.len = LEN,						\
+		.count = ( ( (LEN) + (FRAG_LEN) - 1 ) / (FRAG_LEN) ),	\
+		.frag_len = FRAG_LEN,					\
+		.seed = SEED,						\
+	}
+
+/** Fragments in order */
+IPV4_FRAGMENT_TEST ( frag_in_order, 3000,
+		     FRAG ( 0, 1480 ), FRAG ( 1480, 1480 ), FRAG ( 2960, 40 ) );
+
+/** Fragments in reverse order */
+IPV4_FRAGMENT_TEST ( frag_reversed, 3000,
+		     FRAG ( 2960, 40 ), FRAG ( 1480, 1480 ), FRAG ( 0, 1480 ) );
+
+/** Fragments with first fragment last */
+IPV4_FRAGMENT_TEST ( frag_first_last, 4000,
+		     FRAG ( 1000, 1000 ), FRAG ( 3000, 1000 ),
+		     FRAG ( 2000, 1000 ), FRAG ( 0, 1000 ) );
+
+/** Overlapping and duplicated fragments */
+IPV4_FRAGMENT_TEST ( frag_overlap, 4000,
+		     FRAG ( 800, 1600 ), FRAG ( 0, 1000 ), FRAG ( 800, 1600 ),
+		     FRAG ( 3200, 800 ), FRAG ( 2000, 800 ),
+		     FRAG ( 2400, 1200 ) );
+
+/** Overlapping fragments arriving after the final fragment */
+IPV4_FRAGMENT_TEST ( frag_overlap_final, 2048,
+		     FRAG ( 1024, 1024 ), FRAG ( 512, 1024 ), FRAG ( 8, 8 ),
+		     FRAG ( 0, 1024 ) );
+
+/** Fragments in order, with first fragment extended in place */
+IPV4_FRAGMENT_INPLACE_TEST ( frag_inplace, 3000,
+			     FRAG ( 0, 1480 ), FRAG ( 1480, 1480 ),
+			     FRAG ( 2960, 40 ) );
+
+/** Large datagram (e.g. TFTP with a 64kB block size) in random order */
+IPV4_FRAGMENT_SHUFFLE_TEST ( frag_large, 65468, 1480, 0x1f4a );
+
+/**
+ * Generate IPv4 fragment test payload byte
+ *
+ * @v offset		Offset within payload
+ * @ret byte		Payload byte
+ */
+static inline uint8_t ipv4_fragment_test_byte ( size_t offset ) {
+	return ( offset ^ ( offset >> 8 ) ^ 0x5a );
+}
+
+/**
+ * Construct IPv4 test fragment
+ *
+ * @v offset		Offset within payload
+ * @v len		Length of fragment
+ * @v total		Length of reassembled payload
+ * @v tailroom		Additional tailroom
+ * @ret iobuf		I/O buffer, or NULL on allocation failure
+ *
+ * The fragment is marked as having a hardware-verified checksum.
+ */
+static struct io_buffer * ipv4_fragment_iob ( size_t offset, size_t len,
+					      size_t total, size_t tailroom ) {
+	struct io_buffer *iobuf;
+	struct iphdr *iphdr;
+	uint8_t *data;
+	size_t end;
+	size_t i;
+
+	iobuf = alloc_iob ( MAX_LL_HEADER_LEN + sizeof ( *iphdr ) + len +
+			    tailroom );
+	if ( ! iobuf )
+		return NULL;
+	iob_reserve ( iobuf, MAX_LL_HEADER_LEN );
+	iphdr = iob_put ( iobuf, sizeof ( *iphdr ) );
+	memset ( iphdr, 0, sizeof ( *iphdr ) );
+	iphdr->verhdrlen = ( IP_VER | ( sizeof ( *iphdr ) / 4 ) );
+	iphdr->ident = htons ( 0x1234 );
+	end = ( offset + len );
+	iphdr->frags = htons ( ( offset >> 3 ) |
+			       ( ( end < total ) ? IP_MASK_MOREFRAGS : 0 ) );
+	iphdr->src.s_addr = htonl ( 0xc0a80001 );
+	data = iob_put ( iobuf, len );
+	for ( i = 0 ; i < len ; i++ )
+		data[i] = ipv4_fragment_test_byte ( offset + i );
+	iobuf->csum_flags = IOB_CSUM_VALID;
+
+	return iobuf;
+}
+
+/**
+ * Check if IPv4 test fragment matches fragment reassembly buffer
+ *
+ * @v fragment		Fragment reassembly buffer
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ * @ret is_fragment	Fragment matches this reassembly buffer
+ */
+static int ipv4_test_is_fragment ( struct fragment *fragment,
+				   struct io_buffer *iobuf,
+				   size_t hdrlen __unused ) {
+	struct iphdr *frag_iphdr = fragment->iobuf->data;
+	struct iphdr *iphdr = iobuf->data;
+
+	return ( ( iphdr->src.s_addr == frag_iphdr->src.s_addr ) &&
+		 ( iphdr->ident == frag_iphdr->ident ) );
+}
+
+/**
+ * Get IPv4 test fragment offset
+ *
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ * @ret offset		Offset
+ */
+static size_t ipv4_test_fragment_offset ( struct io_buffer *iobuf,
+					  size_t hdrlen __unused ) {
+	struct iphdr *iphdr = iobuf->data;
+
+	return ( ( ntohs ( iphdr->frags ) & IP_MASK_OFFSET ) << 3 );
+}
+
+/**
+ * Check if more IPv4 test fragments exist
+ *
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ * @ret more_frags	More fragments exist
+ */
+static int ipv4_test_more_fragments ( struct io_buffer *iobuf,
+				      size_t hdrlen __unused ) {
+	struct iphdr *iphdr = iobuf->data;
+
+	return ( iphdr->frags & htons ( IP_MASK_MOREFRAGS ) );
+}
+
+/** IPv4 test fragment reassembly statistics */
+static struct ip_statistics ipv4_test_stats;
+
+/** IPv4 test fragment reassembler */
+static struct fragment_reassembler ipv4_test_reassembler = {
+	.list = LIST_HEAD_INIT ( ipv4_test_reassembler.list ),
+	.is_fragment = ipv4_test_is_fragment,
+	.fragment_offset = ipv4_test_fragment_offset,
+	.more_fragments = ipv4_test_more_fragments,
+	.stats = &ipv4_test_stats,
+};
+
+/**
+ * Report an IPv4 fragment reassembly test result
+ *
+ * @v test		Fragment reassembly test
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void ipv4_fragment_okx ( struct ipv4_fragment_test *test,
+				const char *file, unsigned int line ) {
+	struct ipv4_fragment frags[IPV4_FRAGMENT_TEST_MAX];
+	struct ipv4_fragment tmp;
+	struct io_buffer *iobuf;
+	struct io_buffer *reassembled = NULL;
+	struct iphdr *iphdr;
+	uint8_t *data;
+	size_t hdrlen;
+	size_t tailroom;
+	unsigned int i;
+	unsigned int j;
+	int correct;
+
+	/* Construct list of fragments */
+	assert ( test->count <= IPV4_FRAGMENT_TEST_MAX );
+	if ( test->frags ) {
+		memcpy ( frags, test->frags, ( test->count *
+					       sizeof ( frags[0] ) ) );
+	} else {
+		for ( i = 0 ; i < test->count ; i++ ) {
+			frags[i].offset = ( i * test->frag_len );
+			frags[i].len = ( test->len - frags[i].offset );
+			if ( frags[i].len > test->frag_len )
+				frags[i].len = test->frag_len;
+		}
+		srandom ( test->seed );
+		for ( i = ( test->count - 1 ) ; i > 0 ; i-- ) {
+			j = ( random() % ( i + 1 ) );
+			memcpy ( &tmp, &frags[i], sizeof ( tmp ) );
+			memcpy ( &frags[i], &frags[j], sizeof ( frags[i] ) );
+			memcpy ( &frags[j], &tmp, sizeof ( frags[j] ) );
+		}
+	}
+	memset ( &ipv4_test_stats, 0, sizeof ( ipv4_test_stats ) );
+
+	/* Deliver each fragment in turn */
+	for ( i = 0 ; i < test->count ; i++ ) {
+
+		/* Construct fragment */
+		tailroom = ( test->inplace ? test->len : 0 );
+		iobuf = ipv4_fragment_iob ( frags[i].offset, frags[i].len,
+					    test->len, tailroom );
+		okx ( iobuf != NULL, file, line );
+		if ( ! iobuf )
+			break;
+
+		/* Reassemble */
+		hdrlen = sizeof ( *iphdr );
+		okx ( reassembled == NULL, file, line );
+		reassembled = fragment_reassemble ( &ipv4_test_reassembler,
+						    iobuf, &hdrlen );
+	}
+
+	/* Check reassembled packet */
+	okx ( reassembled != NULL, file, line );
+	if ( ! reassembled )
+		return;
+	okx ( hdrlen == sizeof ( *iphdr ), file, line );
+	okx ( iob_len ( reassembled ) == ( hdrlen + test->len ), file, line );
+	iphdr = reassembled->data;
+	okx ( ! ( iphdr->frags & htons ( IP_MASK_OFFSET ) ), file, line );
+	data = ( reassembled->data + hdrlen );
+	correct = 1;
+	for ( j = 0 ; j < test->len ; j++ ) {
+		if ( data[j] != ipv4_fragment_test_byte ( j ) )
+			correct = 0;
+	}
+	okx ( correct, file, line );
+	okx ( iob_headroom ( reassembled ) >= MAX_LL_HEADER_LEN, file, line );
+	okx ( ipv4_test_stats.reasm_reqds == test->count, file, line );
+	okx ( ipv4_test_stats.reasm_oks == 1, file, line );
+	okx ( ipv4_test_stats.reasm_fails == 0, file, line );
+	okx ( reassembled->csum_flags == 0, file, line );
+	okx ( list_empty ( &ipv4_test_reassembler.list ), file, line );
+	free_iob ( reassembled );
+}
+#define ipv4_fragment_ok( test ) \
+	ipv4_fragment_okx ( test, __FILE__, __LINE__ )
+
+/**
+ * Report an IPv4 fragment reassembly limit test result
+ *
+ * @v tailroom		Additional tailroom in each fragment
+ * @v file		Test code file
+ * @v line		Test code line
+ *
+ * Deliver small non-final fragments until the reassembly buffer is
+ * discarded, and check that this happens at the expected point.
+ */
+static void ipv4_fragment_limit_okx ( size_t tailroom, const char *file,
+				      unsigned int line ) {
+	struct io_buffer *iobuf;
+	struct io_buffer *reassembled;
+	size_t total = 0;
+	size_t hdrlen;
+	size_t size;
+	unsigned int count;
+
+	memset ( &ipv4_test_stats, 0, sizeof ( ipv4_test_stats ) );
+	for ( count = 0 ; count <= FRAGMENT_MAX_PENDING ; count++ ) {
+
+		/* Construct next in-order non-final fragment */
+		iobuf = ipv4_fragment_iob ( ( count * 8 ), 8,
+					    IPV4_FRAGMENT_TEST_INFINITY,
+					    tailroom );
+		okx ( iobuf != NULL, file, line );
+		if ( ! iobuf )
+			break;
+		size = ( iobuf->end - iobuf->head );
+
+		/* Check for discard once either limit is exceeded */
+		hdrlen = sizeof ( struct iphdr );
+		reassembled = fragment_reassemble ( &ipv4_test_reassembler,
+						    iobuf, &hdrlen );
+		okx ( reassembled == NULL, file, line );
+		total += size;
+		if ( ( count == FRAGMENT_MAX_PENDING ) ||
+		     ( total > FRAGMENT_MAX_PENDING_SIZE ) )
+			break;
+		okx ( ! list_empty ( &ipv4_test_reassembler.list ),
+		      file, line );
+		okx ( ipv4_test_stats.reasm_fails == 0, file, line );
+	}
+	okx ( list_empty ( &ipv4_test_reassembler.list ), file, line );
+	okx ( ipv4_test_stats.reasm_fails == 1, file, line );
+	okx ( ipv4_test_stats.reasm_oks == 0, file, line );
+}
+#define ipv4_fragment_limit_ok( tailroom ) \
+	ipv4_fragment_limit_okx ( tailroom, __FILE__, __LINE__ )
+
 /**
  * Perform IPv4 self-tests
  *
@@ -145,6 +494,17 @@ static void ipv4_test_exec ( void ) {
 	inet_aton_fail_ok ( "127.0.0" ); /* Too short */
 	inet_aton_fail_ok ( "1.2.3.a" ); /* Invalid characters */
 	inet_aton_fail_ok ( "127.0..1" ); /* Missing bytes */
+
+	/* Fragment reassembly tests */
+	ipv4_fragment_ok ( &frag_in_order );
+	ipv4_fragment_ok ( &frag_reversed );
+	ipv4_fragment_ok ( &frag_first_last );
+	ipv4_fragment_ok ( &frag_overlap );
+	ipv4_fragment_ok ( &frag_overlap_final );
+	ipv4_fragment_ok ( &frag_large );
+	ipv4_fragment_ok ( &frag_inplace );
+	ipv4_fragment_limit_ok ( 0 );
+	ipv4_fragment_limit_ok ( 4096 );
 }
 
 /** IPv4 self-test */
@@ -1789,6 +1789,20 @@ static time_t test_vultr = 1416697736ULL; /* Sat 22 Nov 23:08:56 2014 */
 	ok ( ocsp_validate ( (test)->ocsp, time ) != 0 );		\
 	} while ( 0 )
 
+/**
+ * Report OCSP status expiry test result
+ *
+ * @v test		OCSP test
+ * @v time		Time at which OCSP response is stale
+ */
+#define ocsp_stale_ok( test, time ) do {				\
+	struct x509_certificate *cert = (test)->cert->cert;		\
+	struct x509_certificate *issuer = (test)->issuer->cert;		\
+	ok ( cert->extensions.auth_info.ocsp.good );			\
+	ok ( x509_validate ( cert, issuer, time, NULL ) != 0 );		\
+	ok ( ! cert->extensions.auth_info.ocsp.good );			\
+	} while ( 0 )
+
 /**
  * Perform OCSP self-tests
  *
@@ -1815,6 +1829,7 @@ static void ocsp_test_exec ( void ) {
 	ocsp_request_ok ( &barclays_ocsp );
 	ocsp_response_ok ( &barclays_ocsp );
 	ocsp_validate_ok ( &barclays_ocsp, test_time );
+	ocsp_stale_ok ( &barclays_ocsp, test_stale );
 	ocsp_validate_fail_ok ( &barclays_ocsp, test_stale );
 
 	/* "google" test */
@@ -33,6 +33,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #undef NDEBUG
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <ipxe/uaccess.h>
@@ -40,8 +41,19 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/sha256.h>
 #include <ipxe/sha512.h>
 #include <ipxe/hmac.h>
+#include <ipxe/profile.h>
 #include <ipxe/test.h>
 
+/** Number of sample iterations for profiling */
+#define PROFILE_COUNT 16
+
+/** Length of data used for block hashing throughput measurements
+ *
+ * This matches the fixed block size used by version 1 content
+ * information.
+ */
+#define PEERDIST_TEST_BLKSIZE 65536
+
 /** Define inline raw data */
 #define DATA(...) { __VA_ARGS__ }
 
@@ -493,6 +505,71 @@ peerdist_info_passphrase_okx ( struct peerdist_info_segment_test *test,
 	peerdist_info_passphrase_okx ( test, info, pass, pass_len,	\
 				       __FILE__, __LINE__ )
 
+/**
+ * Calculate block hashing cost
+ *
+ * @v info		Content information
+ * @ret cost		Cost (in cycles per byte)
+ */
+static unsigned long
+peerdist_info_block_cost ( const struct peerdist_info *info ) {
+	static uint8_t random[PEERDIST_TEST_BLKSIZE]; /* Too large for stack */
+	struct digest_algorithm *digest = info->digest;
+	uint8_t ctx[digest->ctxsize];
+	uint8_t out[digest->digestsize];
+	struct profiler profiler;
+	unsigned long cost;
+	unsigned int i;
+
+	/* Fill buffer with pseudo-random data */
+	srand ( 0x1234568 );
+	for ( i = 0 ; i < sizeof ( random ) ; i++ )
+		random[i] = rand();
+
+	/* Profile block hash calculation */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		digest_init ( digest, ctx );
+		digest_update ( digest, ctx, random, sizeof ( random ) );
+		digest_final ( digest, ctx, out );
+		profile_stop ( &profiler );
+	}
+
+	/* Round to nearest whole number of cycles per byte */
+	cost = ( ( profile_mean ( &profiler ) + ( sizeof ( random ) / 2 ) ) /
+		 sizeof ( random ) );
+
+	return cost;
+}
+
+/**
+ * Calculate segment hash cost
+ *
+ * @v info		Content information
+ * @v index		Segment index
+ * @ret cost		Cost (in cycles)
+ */
+static unsigned long
+peerdist_info_segment_cost ( const struct peerdist_info *info,
+			     unsigned int index ) {
+	struct peerdist_info_segment segment;
+	struct profiler profiler;
+	unsigned int i;
+
+	/* Profile segment parsing (including segment secret and
+	 * segment identifier calculation)
+	 */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		peerdist_info_segment ( info, &segment, index );
+		profile_stop ( &profiler );
+	}
+
+	return profile_mean ( &profiler );
+}
+
 /**
  * Perform content information self-tests
  *
@@ -509,6 +586,9 @@ static void peerdist_info_test_exec ( void ) {
 	peerdist_info_segment_ok ( &iis_85_png_v1_s0, &info, &segment );
 	peerdist_info_block_ok ( &iis_85_png_v1_s0_b0, &segment, &block );
 	peerdist_info_block_ok ( &iis_85_png_v1_s0_b1, &segment, &block );
+	DBG ( "PCCRC v1 block hash cost %ld cycles per byte, segment hash "
+	      "cost %ld cycles\n", peerdist_info_block_cost ( &info ),
+	      peerdist_info_segment_cost ( &info, 0 ) );
 
 	/* IIS logo (iis-85.png) content information version 2 */
 	peerdist_info_ok ( &iis_85_png_v2, &info );
@@ -520,6 +600,9 @@ static void peerdist_info_test_exec ( void ) {
 				      passphrase, sizeof ( passphrase ) );
 	peerdist_info_segment_ok ( &iis_85_png_v2_s1, &info, &segment );
 	peerdist_info_block_ok ( &iis_85_png_v2_s1_b0, &segment, &block );
+	DBG ( "PCCRC v2 block hash cost %ld cycles per byte, segment hash "
+	      "cost %ld cycles\n", peerdist_info_block_cost ( &info ),
+	      peerdist_info_segment_cost ( &info, 1 ) );
 }
 
 /** Content information self-test */
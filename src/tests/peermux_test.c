@@ -0,0 +1,1011 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * PeerDist multiplexer self-tests
+ *
+ * The concurrency controller is exercised against a set of stand-in
+ * peers, each of which can serve a limited number of concurrent
+ * block downloads at a fixed rate.  Requesting more concurrent block
+ * downloads than the peers can serve causes the aggregate throughput
+ * to fall, as would happen with a congested real network.
+ *
+ * The multiplexer itself is exercised by downloading generated
+ * content from a test origin server.  No peers are ever discovered,
+ * so each block is fetched from the origin server using an HTTP
+ * range request.
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <byteswap.h>
+#include <ipxe/in.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/if_ether.h>
+#include <ipxe/ethernet.h>
+#include <ipxe/settings.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/xfer.h>
+#include <ipxe/xferbuf.h>
+#include <ipxe/open.h>
+#include <ipxe/socket.h>
+#include <ipxe/interface.h>
+#include <ipxe/process.h>
+#include <ipxe/uri.h>
+#include <ipxe/crypto.h>
+#include <ipxe/sha256.h>
+#include <ipxe/pccrc.h>
+#include <ipxe/peerdisc.h>
+#include <ipxe/peermux.h>
+#include <ipxe/test.h>
+
+/** Length of each stand-in block download */
+#define PEERMUX_TEST_BLOCK_LEN 65536
+
+/** Maximum number of stand-in peers */
+#define PEERMUX_TEST_MAX_PEERS 8
+
+/** Test origin server address (192.0.2.80) */
+#define PEERMUX_TEST_SERVER 0xc0000250UL
+
+/** Test network device address (192.0.2.1) */
+#define PEERMUX_TEST_ADDRESS 0xc0000201UL
+
+/** Test origin server URI */
+#define PEERMUX_TEST_URI "http://192.0.2.80/peermux.bin"
+
+/** Block size of generated content */
+#define PEERMUX_TEST_BLKSIZE 4096
+
+/** Number of blocks per segment of generated content */
+#define PEERMUX_TEST_SEGMENT_BLOCKS 4
+
+/** Length of each segment of generated content */
+#define PEERMUX_TEST_SEGLEN \
+	( PEERMUX_TEST_SEGMENT_BLOCKS * PEERMUX_TEST_BLKSIZE )
+
+/** Number of scheduler steps for which test origin server delays responses
+ *
+ * This allows several block downloads to be outstanding
+ * concurrently, as would happen with a real network.
+ */
+#define PEERMUX_TEST_LATENCY 8
+
+/** A stand-in peer */
+struct peermux_test_peer {
+	/** Location */
+	const char *location;
+	/** Number of concurrent block downloads that can be served */
+	unsigned int slots;
+	/** Throughput per concurrent block download (in bytes per tick) */
+	unsigned long rate;
+};
+
+/** A set of stand-in peers */
+struct peermux_test_peers {
+	/** Stand-in peers */
+	struct peermux_test_peer *peers;
+	/** Number of stand-in peers */
+	unsigned int count;
+};
+
+/** Define a set of stand-in peers */
+#define PEERS( name, ... )						\
+	static struct peermux_test_peer name ## _peers[] =		\
+		{ __VA_ARGS__ };					\
+	static struct peermux_test_peers name = {			\
+		.peers = name ## _peers,				\
+		.count = ( sizeof ( name ## _peers ) /			\
+			   sizeof ( name ## _peers[0] ) ),		\
+	}
+
+/** Three equal peers */
+PEERS ( three_peers,
+	{ "192.168.0.1", 4, 1000 },
+	{ "192.168.0.2", 4, 1000 },
+	{ "192.168.0.3", 4, 1000 } );
+
+/** Two of the three equal peers */
+PEERS ( two_peers,
+	{ "192.168.0.1", 4, 1000 },
+	{ "192.168.0.2", 4, 1000 } );
+
+/** A single peer */
+PEERS ( one_peer,
+	{ "192.168.0.4", 2, 2000 } );
+
+/** Many high-capacity peers */
+PEERS ( many_peers,
+	{ "192.168.1.1", 16, 1000 },
+	{ "192.168.1.2", 16, 1000 },
+	{ "192.168.1.3", 16, 1000 },
+	{ "192.168.1.4", 16, 1000 } );
+
+/**
+ * Calculate total capacity of stand-in peers
+ *
+ * @v peers		Stand-in peers
+ * @ret capacity	Total number of concurrent block downloads
+ */
+static unsigned int peermux_test_capacity ( struct peermux_test_peers *peers ) {
+	unsigned int capacity = 0;
+	unsigned int i;
+
+	for ( i = 0 ; i < peers->count ; i++ )
+		capacity += peers->peers[i].slots;
+	return capacity;
+}
+
+/**
+ * Run concurrency controller against stand-in peers
+ *
+ * @v conc		Concurrency controller
+ * @v peers		Stand-in peers
+ * @v rounds		Number of rounds
+ * @v now		Current time (updated)
+ *
+ * Each peer serves a share of the block downloads in proportion to
+ * its capacity, and per-peer statistics are recorded for each block
+ * download.
+ */
+static void peermux_test_run ( struct peerdist_concurrency *conc,
+			       struct peermux_test_peers *peers,
+			       unsigned int rounds, unsigned long *now ) {
+	struct peermux_test_peer *peer;
+	unsigned int capacity = peermux_test_capacity ( peers );
+	unsigned long throughput;
+	unsigned long elapsed;
+	unsigned int limit;
+	unsigned int slot;
+	unsigned int i;
+	unsigned int j;
+
+	for ( i = 0 ; i < rounds ; i++ ) {
+
+		/* Calculate aggregate throughput for this round,
+		 * penalising any excess concurrency.
+		 */
+		limit = conc->limit;
+		throughput = ( peers->peers[0].rate *
+			       ( ( limit <= capacity ) ? limit : capacity ) );
+		if ( limit > capacity )
+			throughput = ( ( throughput * capacity ) / limit );
+		elapsed = ( ( limit * PEERMUX_TEST_BLOCK_LEN ) / throughput );
+
+		/* Complete all block downloads for this round */
+		for ( j = 0 ; j < limit ; j++ ) {
+
+			/* Identify serving peer */
+			slot = ( j % capacity );
+			for ( peer = peers->peers ; slot >= peer->slots ;
+			      peer++ ) {
+				slot -= peer->slots;
+			}
+			peerdisc_record ( peer->location,
+					  PEERMUX_TEST_BLOCK_LEN,
+					  ( ( elapsed * peer->rate ) /
+					    peers->peers[0].rate ), 0 );
+
+			/* Complete block download */
+			conc->bytes += PEERMUX_TEST_BLOCK_LEN;
+			if ( j == ( limit - 1 ) )
+				*now += elapsed;
+			peermux_concurrency_update ( conc, *now );
+		}
+	}
+}
+
+/**
+ * Report concurrency convergence test result
+ *
+ * @v conc		Concurrency controller
+ * @v peers		Stand-in peers
+ * @v rounds		Number of rounds
+ * @v now		Current time (updated)
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void peermux_converge_okx ( struct peerdist_concurrency *conc,
+				   struct peermux_test_peers *peers,
+				   unsigned int rounds, unsigned long *now,
+				   const char *file, unsigned int line ) {
+	unsigned int capacity = peermux_test_capacity ( peers );
+	unsigned int expected;
+	unsigned int i;
+
+	/* Run controller until it should have converged */
+	peermux_test_run ( conc, peers, rounds, now );
+
+	/* Check that limit remains close to the peers' capacity */
+	expected = ( ( capacity < PEERMUX_MAX_BLOCKS ) ?
+		     capacity : PEERMUX_MAX_BLOCKS );
+	for ( i = 0 ; i < 8 ; i++ ) {
+		peermux_test_run ( conc, peers, 1, now );
+		DBG ( "PEERMUX concurrency %d for capacity %d\n",
+		      conc->limit, capacity );
+		okx ( ( conc->limit + 1 ) >= expected, file, line );
+		okx ( conc->limit <= ( expected + 1 ), file, line );
+	}
+}
+#define peermux_converge_ok( conc, peers, rounds, now ) \
+	peermux_converge_okx ( conc, peers, rounds, now, __FILE__, __LINE__ )
+
+/** A PeerDist multiplexer download test */
+struct peermux_download_test {
+	/** Length of content */
+	size_t len;
+	/** Serve a corrupted copy of this block (or -1 for none) */
+	int corrupt;
+	/** Download is expected to succeed */
+	int success;
+};
+
+/** Define a PeerDist multiplexer download test */
+#define DOWNLOAD( name, LEN, CORRUPT, SUCCESS )				\
+	static struct peermux_download_test name = {			\
+		.len = LEN,						\
+		.corrupt = CORRUPT,					\
+		.success = SUCCESS,					\
+	}
+
+/** Three segments, ending with a partial block */
+DOWNLOAD ( three_segments,
+	   ( ( 3 * PEERMUX_TEST_SEGLEN ) - ( PEERMUX_TEST_BLKSIZE / 2 ) ),
+	   -1, 1 );
+
+/** A single partial segment */
+DOWNLOAD ( one_segment, ( PEERMUX_TEST_SEGLEN - PEERMUX_TEST_BLKSIZE ),
+	   -1, 1 );
+
+/** Many segments, exceeding the maximum concurrency */
+DOWNLOAD ( many_segments, ( 12 * PEERMUX_TEST_SEGLEN ), -1, 1 );
+
+/** Three segments, with a block that always fails verification */
+DOWNLOAD ( corrupt_block, ( 3 * PEERMUX_TEST_SEGLEN ), 5, 0 );
+
+/** Current download test */
+static struct peermux_download_test *peermux_download_test;
+
+/** Generated content */
+static uint8_t *peermux_test_content;
+
+/** Test origin server statistics */
+static struct {
+	/** Number of range requests received */
+	unsigned int requests;
+	/** Number of currently open connections */
+	unsigned int open;
+	/** Maximum number of concurrently open connections */
+	unsigned int max_open;
+} peermux_test_server_stats;
+
+/** A test origin server connection */
+struct peermux_test_server {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Response delivery process */
+	struct process process;
+	/** Received request */
+	char request[512];
+	/** Length of received request */
+	size_t len;
+	/** Requested range start */
+	size_t start;
+	/** Requested range end */
+	size_t end;
+	/** Connection is established */
+	int connected;
+	/** Request is complete */
+	int complete;
+	/** Remaining response delay (in scheduler steps) */
+	unsigned int delay;
+};
+
+/**
+ * Close test origin server connection
+ *
+ * @v server		Test origin server connection
+ * @v rc		Reason for close
+ */
+static void peermux_test_server_close ( struct peermux_test_server *server,
+					int rc ) {
+
+	/* Update statistics, if still open */
+	if ( process_running ( &server->process ) )
+		peermux_test_server_stats.open--;
+
+	/* Stop process and shut down interface */
+	process_del ( &server->process );
+	intf_shutdown ( &server->xfer, rc );
+}
+
+/**
+ * Check test origin server flow control window
+ *
+ * @v server		Test origin server connection
+ * @ret len		Length of window
+ */
+static size_t peermux_test_server_window ( struct peermux_test_server *server ){
+
+	return ( ( server->connected && ! server->complete ) ?
+		 sizeof ( server->request ) : 0 );
+}
+
+/**
+ * Receive request at test origin server
+ *
+ * @v server		Test origin server connection
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int peermux_test_server_deliver ( struct peermux_test_server *server,
+					 struct io_buffer *iobuf,
+					 struct xfer_metadata *meta __unused ){
+	size_t len = iob_len ( iobuf );
+	char *range;
+	char *sep;
+	int rc;
+
+	/* Append to request */
+	if ( ( server->complete ) ||
+	     ( ( server->len + len ) >= sizeof ( server->request ) ) ) {
+		rc = -ENOBUFS;
+		goto done;
+	}
+	memcpy ( ( server->request + server->len ), iobuf->data, len );
+	server->len += len;
+
+	/* Wait for end of request headers */
+	if ( ! strstr ( server->request, "\r\n\r\n" ) ) {
+		rc = 0;
+		goto done;
+	}
+	server->complete = 1;
+	peermux_test_server_stats.requests++;
+
+	/* Parse requested range */
+	range = strstr ( server->request, "\r\nRange: bytes=" );
+	if ( ! range ) {
+		rc = -EINVAL;
+		goto done;
+	}
+	range += strlen ( "\r\nRange: bytes=" );
+	server->start = strtoul ( range, &sep, 10 );
+	if ( *sep != '-' ) {
+		rc = -EINVAL;
+		goto done;
+	}
+	server->end = ( strtoul ( ( sep + 1 ), &sep, 10 ) + 1 );
+	if ( ( *sep != '\r' ) || ( server->start >= server->end ) ||
+	     ( server->end > peermux_download_test->len ) ) {
+		rc = -EINVAL;
+		goto done;
+	}
+	rc = 0;
+
+ done:
+	free_iob ( iobuf );
+	if ( rc != 0 )
+		peermux_test_server_close ( server, rc );
+	return rc;
+}
+
+/**
+ * Deliver test origin server response
+ *
+ * @v server		Test origin server connection
+ */
+static void peermux_test_server_step ( struct peermux_test_server *server ) {
+	struct peermux_download_test *test = peermux_download_test;
+	size_t len = ( server->end - server->start );
+	struct io_buffer *iobuf;
+	int rc;
+
+	/* Report connection as established */
+	if ( ! server->connected ) {
+		server->connected = 1;
+		xfer_window_changed ( &server->xfer );
+		return;
+	}
+
+	/* Wait for complete request, then simulate network latency */
+	if ( ! server->complete )
+		return;
+	if ( server->delay ) {
+		server->delay--;
+		return;
+	}
+
+	/* Construct response */
+	iobuf = xfer_alloc_iob ( &server->xfer, ( 128 + len ) );
+	if ( ! iobuf ) {
+		rc = -ENOMEM;
+		goto done;
+	}
+	iob_put ( iobuf, snprintf ( iobuf->data, iob_tailroom ( iobuf ),
+				    "HTTP/1.0 206 Partial Content\r\n"
+				    "Content-Length: %zd\r\n\r\n", len ) );
+	memcpy ( iob_put ( iobuf, len ),
+		 ( peermux_test_content + server->start ), len );
+	if ( ( test->corrupt >= 0 ) &&
+	     ( server->start == ( ( size_t ) test->corrupt *
+				  PEERMUX_TEST_BLKSIZE ) ) ) {
+		*( ( uint8_t * ) iobuf->tail - 1 ) ^= 0x01;
+	}
+
+	/* Deliver response and close connection */
+	rc = xfer_deliver_iob ( &server->xfer, iobuf );
+
+ done:
+	peermux_test_server_close ( server, rc );
+}
+
+/** Test origin server interface operations */
+static struct interface_operation peermux_test_server_operations[] = {
+	INTF_OP ( xfer_deliver, struct peermux_test_server *,
+		  peermux_test_server_deliver ),
+	INTF_OP ( xfer_window, struct peermux_test_server *,
+		  peermux_test_server_window ),
+	INTF_OP ( intf_close, struct peermux_test_server *,
+		  peermux_test_server_close ),
+};
+
+/** Test origin server interface descriptor */
+static struct interface_descriptor peermux_test_server_desc =
+	INTF_DESC ( struct peermux_test_server, xfer,
+		    peermux_test_server_operations );
+
+/** Test origin server process descriptor */
+static struct process_descriptor peermux_test_server_process_desc =
+	PROC_DESC ( struct peermux_test_server, process,
+		    peermux_test_server_step );
+
+/**
+ * Open connection to test origin server
+ *
+ * @v xfer		Data transfer interface
+ * @v peer		Peer socket address
+ * @v local		Local socket address, or NULL
+ * @ret rc		Return status code
+ *
+ * Connections to any address other than the test origin server are
+ * passed through to the normal TCP socket opener.
+ */
+static int peermux_test_server_open ( struct interface *xfer,
+				      struct sockaddr *peer,
+				      struct sockaddr *local ) {
+	struct sockaddr_in *sin = ( ( struct sockaddr_in * ) peer );
+	struct peermux_test_server *server;
+	struct socket_opener *opener;
+
+	/* Pass through connections to any other address */
+	if ( ( ! peermux_download_test ) ||
+	     ( sin->sin_addr.s_addr != htonl ( PEERMUX_TEST_SERVER ) ) ) {
+		for_each_table_entry ( opener, SOCKET_OPENERS ) {
+			if ( ( opener->open != peermux_test_server_open ) &&
+			     ( opener->semantics == TCP_SOCK_STREAM ) &&
+			     ( opener->family == AF_INET ) ) {
+				return opener->open ( xfer, peer, local );
+			}
+		}
+		return -ENOTSUP;
+	}
+
+	/* Allocate and initialise connection */
+	server = zalloc ( sizeof ( *server ) );
+	if ( ! server )
+		return -ENOMEM;
+	ref_init ( &server->refcnt, NULL );
+	intf_init ( &server->xfer, &peermux_test_server_desc,
+		    &server->refcnt );
+	process_init ( &server->process, &peermux_test_server_process_desc,
+		       &server->refcnt );
+	server->delay = PEERMUX_TEST_LATENCY;
+
+	/* Update statistics */
+	peermux_test_server_stats.open++;
+	if ( peermux_test_server_stats.max_open <
+	     peermux_test_server_stats.open ) {
+		peermux_test_server_stats.max_open =
+			peermux_test_server_stats.open;
+	}
+
+	/* Attach parent interface, mortalise self, and return */
+	intf_plug_plug ( &server->xfer, xfer );
+	ref_put ( &server->refcnt );
+	return 0;
+}
+
+/** Test origin server socket opener
+ *
+ * This takes precedence over the normal TCP socket opener.
+ */
+struct socket_opener peermux_test_socket_opener
+	__table_entry ( SOCKET_OPENERS, 00 ) = {
+	.semantics	= TCP_SOCK_STREAM,
+	.family		= AF_INET,
+	.open		= peermux_test_server_open,
+};
+
+/**
+ * Open test network device
+ *
+ * @v netdev		Network device
+ * @ret rc		Return status code
+ */
+static int peermux_test_netdev_open ( struct net_device *netdev __unused ) {
+
+	return 0;
+}
+
+/**
+ * Close test network device
+ *
+ * @v netdev		Network device
+ */
+static void peermux_test_netdev_close ( struct net_device *netdev __unused ) {
+
+	/* Nothing to do */
+}
+
+/**
+ * Transmit packet via test network device
+ *
+ * @v netdev		Network device
+ * @v iobuf		I/O buffer
+ * @ret rc		Return status code
+ *
+ * All packets (e.g. peer discovery requests) are silently discarded.
+ */
+static int peermux_test_netdev_transmit ( struct net_device *netdev,
+					  struct io_buffer *iobuf ) {
+
+	netdev_tx_complete ( netdev, iobuf );
+	return 0;
+}
+
+/**
+ * Poll test network device
+ *
+ * @v netdev		Network device
+ */
+static void peermux_test_netdev_poll ( struct net_device *netdev __unused ) {
+
+	/* Nothing to do */
+}
+
+/** Test network device operations */
+static struct net_device_operations peermux_test_netdev_operations = {
+	.open		= peermux_test_netdev_open,
+	.close		= peermux_test_netdev_close,
+	.transmit	= peermux_test_netdev_transmit,
+	.poll		= peermux_test_netdev_poll,
+};
+
+/**
+ * Create test network device
+ *
+ * @ret netdev		Network device, or NULL on error
+ *
+ * The test origin server is reachable only via a configured route,
+ * since unroutable addresses are never attempted.
+ */
+static struct net_device * peermux_test_netdev_create ( void ) {
+	struct in_addr address = { htonl ( PEERMUX_TEST_ADDRESS ) };
+	struct net_device *netdev;
+	int rc;
+
+	/* Allocate and initialise network device */
+	netdev = alloc_etherdev ( 0 );
+	if ( ! netdev )
+		goto err_alloc;
+	netdev_init ( netdev, &peermux_test_netdev_operations );
+	memset ( netdev->hw_addr, 0x02, ETH_ALEN );
+
+	/* Register and open network device */
+	if ( ( rc = register_netdev ( netdev ) ) != 0 )
+		goto err_register;
+	if ( ( rc = netdev_open ( netdev ) ) != 0 )
+		goto err_open;
+
+	/* Configure IPv4 address */
+	if ( ( rc = store_setting ( netdev_settings ( netdev ), &ip_setting,
+				    &address, sizeof ( address ) ) ) != 0 )
+		goto err_store;
+
+	return netdev;
+
+ err_store:
+ err_open:
+	unregister_netdev ( netdev );
+ err_register:
+	netdev_nullify ( netdev );
+	netdev_put ( netdev );
+ err_alloc:
+	return NULL;
+}
+
+/**
+ * Destroy test network device
+ *
+ * @v netdev		Network device
+ */
+static void peermux_test_netdev_destroy ( struct net_device *netdev ) {
+
+	unregister_netdev ( netdev );
+	netdev_nullify ( netdev );
+	netdev_put ( netdev );
+}
+
+/**
+ * Construct content information for generated content
+ *
+ * @v len		Length of content
+ * @v info_len		Length of content information to fill in
+ * @ret info		Content information, or NULL on error
+ */
+static void * peermux_test_info ( size_t len, size_t *info_len ) {
+	struct digest_algorithm *digest = &sha256_algorithm;
+	struct peerdist_info_v1 *header;
+	peerdist_info_v1_segment_t ( SHA256_DIGEST_SIZE ) *segment;
+	struct peerdist_info_v1_block *block;
+	uint8_t ctx[SHA256_CTX_SIZE];
+	unsigned int segments;
+	unsigned int blocks;
+	unsigned int i;
+	unsigned int j;
+	size_t offset;
+	size_t frag_len;
+	uint8_t *hash;
+	void *info;
+
+	/* Calculate length of content information */
+	segments = ( ( len + PEERMUX_TEST_SEGLEN - 1 ) / PEERMUX_TEST_SEGLEN );
+	blocks = ( ( len + PEERMUX_TEST_BLKSIZE - 1 ) / PEERMUX_TEST_BLKSIZE );
+	*info_len = ( sizeof ( *header ) + ( segments * sizeof ( *segment ) ) +
+		      ( segments * sizeof ( *block ) ) +
+		      ( blocks * SHA256_DIGEST_SIZE ) );
+
+	/* Allocate content information */
+	info = zalloc ( *info_len );
+	if ( ! info )
+		return NULL;
+
+	/* Construct header */
+	header = info;
+	header->version.raw = cpu_to_le16 ( PEERDIST_INFO_V1 );
+	header->hash = cpu_to_le32 ( PEERDIST_INFO_V1_HASH_SHA256 );
+	header->segments = cpu_to_le32 ( segments );
+
+	/* Construct segment descriptions.  The segment hashes serve
+	 * only as identifiers, since no peers will be discovered.
+	 */
+	segment = ( info + sizeof ( *header ) );
+	for ( i = 0 ; i < segments ; i++ ) {
+		offset = ( i * PEERMUX_TEST_SEGLEN );
+		frag_len = ( len - offset );
+		if ( frag_len > PEERMUX_TEST_SEGLEN )
+			frag_len = PEERMUX_TEST_SEGLEN;
+		segment[i].segment.offset = cpu_to_le64 ( offset );
+		segment[i].segment.len = cpu_to_le32 ( frag_len );
+		segment[i].segment.blksize =
+			cpu_to_le32 ( PEERMUX_TEST_BLKSIZE );
+		memset ( segment[i].hash, ( i + 1 ),
+			 sizeof ( segment[i].hash ) );
+		memset ( segment[i].secret, ( 0x80 | i ),
+			 sizeof ( segment[i].secret ) );
+	}
+
+	/* Construct block descriptions */
+	block = ( ( void * ) &segment[segments] );
+	for ( i = 0 ; i < segments ; i++ ) {
+		offset = ( i * PEERMUX_TEST_SEGLEN );
+		hash = ( ( ( void * ) block ) + sizeof ( *block ) );
+		for ( j = 0 ; ( ( j < PEERMUX_TEST_SEGMENT_BLOCKS ) &&
+				( offset < len ) ) ; j++ ) {
+			frag_len = ( len - offset );
+			if ( frag_len > PEERMUX_TEST_BLKSIZE )
+				frag_len = PEERMUX_TEST_BLKSIZE;
+			digest_init ( digest, ctx );
+			digest_update ( digest, ctx,
+					( peermux_test_content + offset ),
+					frag_len );
+			digest_final ( digest, ctx, hash );
+			hash += SHA256_DIGEST_SIZE;
+			offset += frag_len;
+		}
+		block->blocks = cpu_to_le32 ( j );
+		block = ( ( void * ) hash );
+	}
+	assert ( ( ( void * ) block ) == ( info + *info_len ) );
+
+	return info;
+}
+
+/** A PeerDist multiplexer test download */
+struct peermux_test_download {
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Content information interface */
+	struct interface info;
+	/** Data transfer buffer */
+	struct xfer_buffer buffer;
+	/** Download has completed */
+	int done;
+	/** Download status code */
+	int rc;
+};
+
+/**
+ * Handle test download completion
+ *
+ * @v download		Test download
+ * @v rc		Reason for close
+ */
+static void peermux_test_download_close ( struct peermux_test_download
+					  *download, int rc ) {
+
+	intf_restart ( &download->xfer, rc );
+	intf_restart ( &download->info, rc );
+	download->rc = rc;
+	download->done = 1;
+}
+
+/**
+ * Receive test download data
+ *
+ * @v download		Test download
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int peermux_test_download_deliver ( struct peermux_test_download
+					   *download, struct io_buffer *iobuf,
+					   struct xfer_metadata *meta ) {
+
+	return xferbuf_deliver ( &download->buffer, iobuf, meta );
+}
+
+/**
+ * Get test download underlying data transfer buffer
+ *
+ * @v download		Test download
+ * @ret xferbuf		Data transfer buffer
+ */
+static struct xfer_buffer *
+peermux_test_download_buffer ( struct peermux_test_download *download ) {
+
+	return &download->buffer;
+}
+
+/** Test download data transfer interface operations */
+static struct interface_operation peermux_test_download_operations[] = {
+	INTF_OP ( xfer_deliver, struct peermux_test_download *,
+		  peermux_test_download_deliver ),
+	INTF_OP ( xfer_buffer, struct peermux_test_download *,
+		  peermux_test_download_buffer ),
+	INTF_OP ( intf_close, struct peermux_test_download *,
+		  peermux_test_download_close ),
+};
+
+/** Test download data transfer interface descriptor */
+static struct interface_descriptor peermux_test_download_desc =
+	INTF_DESC ( struct peermux_test_download, xfer,
+		    peermux_test_download_operations );
+
+/** Test download content information interface operations */
+static struct interface_operation peermux_test_info_operations[] = {
+	INTF_OP ( intf_close, struct peermux_test_download *,
+		  peermux_test_download_close ),
+};
+
+/** Test download content information interface descriptor */
+static struct interface_descriptor peermux_test_info_desc =
+	INTF_DESC ( struct peermux_test_download, info,
+		    peermux_test_info_operations );
+
+/**
+ * Report PeerDist multiplexer download test result
+ *
+ * @v test		Download test
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void peermux_download_okx ( struct peermux_download_test *test,
+				   const char *file, unsigned int line ) {
+	struct peermux_test_download download;
+	unsigned int timeout = peerdisc_timeout_secs;
+	unsigned int blocks;
+	struct uri *uri;
+	void *info;
+	size_t info_len;
+	size_t i;
+
+	/* Generate content */
+	peermux_test_content = malloc ( test->len );
+	okx ( peermux_test_content != NULL, file, line );
+	if ( ! peermux_test_content )
+		goto err_content;
+	for ( i = 0 ; i < test->len ; i++ )
+		peermux_test_content[i] = ( ( i * 7 ) + ( i >> 12 ) );
+
+	/* Construct content information */
+	info = peermux_test_info ( test->len, &info_len );
+	okx ( info != NULL, file, line );
+	if ( ! info )
+		goto err_info;
+
+	/* Parse URI */
+	uri = parse_uri ( PEERMUX_TEST_URI );
+	okx ( uri != NULL, file, line );
+	if ( ! uri )
+		goto err_uri;
+
+	/* Create multiplexer.  There are no peers to be discovered,
+	 * so disable the discovery timeout.
+	 */
+	peerdisc_timeout_secs = 0;
+	peermux_download_test = test;
+	memset ( &peermux_test_server_stats, 0,
+		 sizeof ( peermux_test_server_stats ) );
+	memset ( &download, 0, sizeof ( download ) );
+	intf_init ( &download.xfer, &peermux_test_download_desc, NULL );
+	intf_init ( &download.info, &peermux_test_info_desc, NULL );
+	xferbuf_malloc_init ( &download.buffer );
+	okx ( peermux_filter ( &download.xfer, &download.info, uri ) == 0,
+	      file, line );
+
+	/* Deliver content information */
+	okx ( xfer_deliver_raw ( &download.info, info, info_len ) == 0,
+	      file, line );
+	intf_restart ( &download.info, 0 );
+
+	/* Wait for download to complete */
+	for ( i = 0 ; ( ( ! download.done ) && ( i < 4096 ) ) ; i++ )
+		step();
+	okx ( download.done, file, line );
+	DBG ( "PEERMUX downloaded %zd bytes with up to %d concurrent "
+	      "requests\n", test->len, peermux_test_server_stats.max_open );
+
+	/* Check result */
+	blocks = ( ( test->len + PEERMUX_TEST_BLKSIZE - 1 ) /
+		   PEERMUX_TEST_BLKSIZE );
+	if ( test->success ) {
+		okx ( download.rc == 0, file, line );
+		okx ( download.buffer.len == test->len, file, line );
+		okx ( memcmp ( download.buffer.data, peermux_test_content,
+			       test->len ) == 0, file, line );
+		okx ( peermux_test_server_stats.requests == blocks,
+		      file, line );
+	} else {
+		okx ( download.rc != 0, file, line );
+	}
+
+	/* Check that concurrency limit was used and respected */
+	okx ( peermux_test_server_stats.max_open <= PEERMUX_MAX_BLOCKS,
+	      file, line );
+	okx ( peermux_test_server_stats.max_open >=
+	      ( ( blocks < PEERMUX_INITIAL_BLOCKS ) ?
+		blocks : PEERMUX_INITIAL_BLOCKS ), file, line );
+
+	/* Allow any remaining connections to close */
+	for ( i = 0 ; ( ( peermux_test_server_stats.open ) && ( i < 64 ) ) ;
+	      i++ ) {
+		step();
+	}
+	okx ( peermux_test_server_stats.open == 0, file, line );
+
+	peermux_download_test = NULL;
+	peerdisc_timeout_secs = timeout;
+	xferbuf_free ( &download.buffer );
+	uri_put ( uri );
+ err_uri:
+	free ( info );
+ err_info:
+	free ( peermux_test_content );
+	peermux_test_content = NULL;
+ err_content:
+	return;
+}
+#define peermux_download_ok( test ) \
+	peermux_download_okx ( test, __FILE__, __LINE__ )
+
+/**
+ * Perform PeerDist multiplexer self-tests
+ *
+ */
+static void peermux_test_exec ( void ) {
+	struct peerdist_concurrency conc;
+	struct net_device *netdev;
+	struct peerdisc_statistics *stats;
+	unsigned long now = 0;
+	char location[16];
+	unsigned int i;
+
+	/* Check initial state */
+	peermux_concurrency_init ( &conc, now );
+	ok ( conc.limit == PEERMUX_INITIAL_BLOCKS );
+
+	/* Check convergence to capacity of stand-in peers */
+	peermux_converge_ok ( &conc, &three_peers, 32, &now );
+
+	/* Check convergence after loss of a peer */
+	peermux_converge_ok ( &conc, &two_peers, 32, &now );
+
+	/* Check convergence to a single peer */
+	peermux_converge_ok ( &conc, &one_peer, 32, &now );
+
+	/* Check growth to maximum concurrency */
+	peermux_converge_ok ( &conc, &many_peers, 64, &now );
+
+	/* Check per-peer statistics */
+	stats = peerdisc_statistics ( "192.168.0.1" );
+	ok ( stats != NULL );
+	if ( stats ) {
+		ok ( stats->blocks > 0 );
+		ok ( stats->bytes == ( stats->blocks *
+				       PEERMUX_TEST_BLOCK_LEN ) );
+		ok ( stats->failures == 0 );
+		peerdisc_record ( "192.168.0.1", 0, 0, -ETIMEDOUT );
+		ok ( stats->failures == 1 );
+	}
+	ok ( peerdisc_statistics ( "192.168.0.5" ) == NULL );
+
+	/* Check that per-peer statistics are bounded */
+	for ( i = 0 ; i < PEERDISC_MAX_STATISTICS ; i++ ) {
+		snprintf ( location, sizeof ( location ), "10.0.0.%d", i );
+		peerdisc_record ( location, PEERMUX_TEST_BLOCK_LEN, 1, 0 );
+	}
+	ok ( peerdisc_statistics ( "10.0.0.0" ) != NULL );
+	ok ( peerdisc_statistics ( "192.168.0.1" ) == NULL );
+
+	/* Check multiplexed downloads */
+	netdev = peermux_test_netdev_create();
+	ok ( netdev != NULL );
+	if ( netdev ) {
+		peermux_download_ok ( &three_segments );
+		peermux_download_ok ( &one_segment );
+		peermux_download_ok ( &many_segments );
+		peermux_download_ok ( &corrupt_block );
+		peermux_test_netdev_destroy ( netdev );
+	}
+}
+
+/** PeerDist multiplexer self-test */
+struct self_test peermux_test __self_test = {
+	.name = "peermux",
+	.exec = peermux_test_exec,
+};
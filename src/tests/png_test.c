@@ -32,13 +32,24 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /* Forcibly enable assertions */
 #undef NDEBUG
 
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <byteswap.h>
+#include <ipxe/umalloc.h>
+#include <ipxe/image.h>
 #include <ipxe/pixbuf.h>
+#include <ipxe/profile.h>
 #include <ipxe/png.h>
 #include <ipxe/test.h>
 #include "pixbuf_test.h"
 
+/** Number of sample iterations for profiling */
+#define PROFILE_COUNT 4
+
+/** Maximum length of a stored DEFLATE block */
+#define PNG_TEST_STORED_MAX 0xffff
+
 /** Define inline pixel data */
 #define DATA(...) { __VA_ARGS__ }
 
@@ -1939,6 +1950,159 @@ PIX ( original, &png_image_type,
 	     0x5fa7ff, 0x4e9ffe, 0x4596f4, 0x4fa7ff, 0x62beff, 0x59b8ff,
 	     0x2e8de9, 0x4faeff, 0x4aa9ff, 0x4a9ff7, 0x77bbff, 0x78b7fe ) );
 
+/**
+ * Append PNG chunk to generated image
+ *
+ * @v data		Image data
+ * @v offset		Offset within image data
+ * @v type		Chunk type
+ * @v chunk		Chunk data (or NULL to leave in place)
+ * @v len		Length of chunk data
+ * @ret offset		Updated offset within image data
+ *
+ * The chunk CRC is left as zero, since it is not checked.
+ */
+static size_t png_test_chunk ( uint8_t *data, size_t offset, uint32_t type,
+			       const void *chunk, size_t len ) {
+	struct png_chunk_header header;
+	struct png_chunk_footer footer;
+
+	header.len = htonl ( len );
+	header.type = htonl ( type );
+	memcpy ( ( data + offset ), &header, sizeof ( header ) );
+	offset += sizeof ( header );
+	if ( chunk )
+		memcpy ( ( data + offset ), chunk, len );
+	offset += len;
+	memset ( &footer, 0, sizeof ( footer ) );
+	memcpy ( ( data + offset ), &footer, sizeof ( footer ) );
+	offset += sizeof ( footer );
+
+	return offset;
+}
+
+/**
+ * Profile PNG decoding
+ *
+ * @v width		Image width
+ * @v height		Image height
+ * @v colour_type	Colour type
+ * @v channels		Number of channels
+ * @v file		Test code file
+ * @v line		Test code line
+ *
+ * Generate an uncompressed (stored) 8-bit image using each basic
+ * filter type in turn, and measure the time taken to decode it.
+ */
+static void png_profile_okx ( unsigned int width, unsigned int height,
+			      unsigned int colour_type, unsigned int channels,
+			      const char *file, unsigned int line ) {
+	static struct png_signature signature = PNG_SIGNATURE;
+	struct png_image_header ihdr;
+	struct pixel_buffer *pixbuf;
+	struct profiler profiler;
+	struct image *image;
+	uint8_t *data;
+	uint8_t *raw;
+	size_t scanline_len = ( 1 + ( width * channels ) );
+	size_t raw_len = ( height * scanline_len );
+	size_t blocks = ( ( raw_len + PNG_TEST_STORED_MAX - 1 ) /
+			  PNG_TEST_STORED_MAX );
+	size_t zlib_len = ( 2 /* Header */ + ( 5 * blocks ) + raw_len +
+			    4 /* Adler-32 (unchecked) */ );
+	size_t len = ( sizeof ( signature ) +
+		       ( 3 * ( sizeof ( struct png_chunk_header ) +
+			       sizeof ( struct png_chunk_footer ) ) ) +
+		       sizeof ( ihdr ) + zlib_len );
+	size_t offset;
+	size_t remaining;
+	size_t frag_len;
+	unsigned int y;
+	unsigned int i;
+	int rc;
+
+	/* Allocate image */
+	image = alloc_image ( NULL );
+	okx ( image != NULL, file, line );
+	if ( ! image )
+		goto err_alloc_image;
+	image->data = umalloc ( len );
+	okx ( image->data != UNULL, file, line );
+	if ( ! image->data )
+		goto err_umalloc;
+	image->len = len;
+	data = user_to_virt ( image->data, 0 );
+
+	/* Construct signature and image header */
+	memcpy ( data, &signature, sizeof ( signature ) );
+	offset = sizeof ( signature );
+	memset ( &ihdr, 0, sizeof ( ihdr ) );
+	ihdr.width = htonl ( width );
+	ihdr.height = htonl ( height );
+	ihdr.depth = 8;
+	ihdr.colour_type = colour_type;
+	offset = png_test_chunk ( data, offset, PNG_TYPE_IHDR, &ihdr,
+				  sizeof ( ihdr ) );
+
+	/* Construct image data as stored DEFLATE blocks */
+	offset = png_test_chunk ( data, offset, PNG_TYPE_IDAT, NULL,
+				  zlib_len );
+	raw = ( data + offset - sizeof ( struct png_chunk_footer ) - zlib_len );
+	*(raw++) = 0x78;
+	*(raw++) = 0x01;
+	srand ( 0x1234 );
+	for ( remaining = raw_len, y = 0 ; remaining ; remaining -= frag_len ) {
+		frag_len = remaining;
+		if ( frag_len > PNG_TEST_STORED_MAX )
+			frag_len = PNG_TEST_STORED_MAX;
+		*(raw++) = ( ( frag_len == remaining ) ? 0x01 : 0x00 );
+		*(raw++) = ( frag_len & 0xff );
+		*(raw++) = ( frag_len >> 8 );
+		*(raw++) = ( ~frag_len & 0xff );
+		*(raw++) = ( ~frag_len >> 8 );
+		for ( i = 0 ; i < frag_len ; i++ ) {
+			if ( ( ( raw_len - remaining + i ) %
+			       scanline_len ) == 0 ) {
+				*(raw++) = ( y++ % 5 );
+			} else {
+				*(raw++) = rand();
+			}
+		}
+	}
+	offset = png_test_chunk ( data, offset, PNG_TYPE_IEND, NULL, 0 );
+	assert ( offset == len );
+
+	/* Register image */
+	okx ( register_image ( image ) == 0, file, line );
+	okx ( image->type == &png_image_type, file, line );
+
+	/* Profile decoding */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		rc = image_pixbuf ( image, &pixbuf );
+		profile_stop ( &profiler );
+		okx ( rc == 0, file, line );
+		if ( rc != 0 )
+			break;
+		okx ( pixbuf->width == width, file, line );
+		okx ( pixbuf->height == height, file, line );
+		pixbuf_put ( pixbuf );
+	}
+	DBG ( "PNG decoded %dx%d colour type %d in %ld +/- %ld ticks\n",
+	      width, height, colour_type, profile_mean ( &profiler ),
+	      profile_stddev ( &profiler ) );
+
+	unregister_image ( image );
+ err_umalloc:
+	image_put ( image );
+ err_alloc_image:
+	return;
+}
+#define png_profile_ok( width, height, colour_type, channels )		\
+	png_profile_okx ( width, height, colour_type, channels,		\
+			  __FILE__, __LINE__ )
+
 /**
  * Perform PNG self-test
  *
@@ -1988,6 +2152,11 @@ static void png_test_exec ( void ) {
 
 	/* Alpha channel */
 	pixbuf_ok ( &alpha );
+
+	/* Decoding speed */
+	png_profile_ok ( 1024, 768, PNG_COLOUR_TYPE_RGB, 3 );
+	png_profile_ok ( 1024, 768,
+			 ( PNG_COLOUR_TYPE_RGB | PNG_COLOUR_TYPE_ALPHA ), 4 );
 }
 
 /** PNG self-test */
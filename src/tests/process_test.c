@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Process self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <ipxe/timer.h>
+#include <ipxe/process.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/ethernet.h>
+#include <ipxe/if_ether.h>
+#include <ipxe/test.h>
+
+/** Number of steps sufficient to reach every runnable process */
+#define PROCESS_TEST_STEPS 64
+
+/** Sleep duration used to test sleeping processes (in ms) */
+#define PROCESS_TEST_SLEEP_MS 2
+
+/** Period without network activity used to test polling (in ms) */
+#define PROCESS_TEST_IDLE_MS 250
+
+/** Number of polling rounds checked after a period of inactivity */
+#define PROCESS_TEST_ROUNDS 16
+
+/** A process test process */
+struct process_test_process {
+	/** Process */
+	struct process process;
+	/** Number of steps executed */
+	unsigned int steps;
+	/** Time of most recent step */
+	unsigned long last;
+	/** Process has been visited */
+	int visited;
+};
+
+/** Process test process */
+static struct process_test_process process_test_process;
+
+/** Number of times the test network device has been polled */
+static unsigned int process_test_polls;
+
+/**
+ * Execute test process step
+ *
+ * @v test		Test process
+ */
+static void process_test_step ( struct process_test_process *test ) {
+
+	test->steps++;
+	test->last = currticks();
+}
+
+/** Test process descriptor */
+static struct process_descriptor process_test_desc =
+	PROC_DESC ( struct process_test_process, process, process_test_step );
+
+/**
+ * Visit test process
+ *
+ * @v process		Process
+ */
+static void process_test_visit ( struct process *process ) {
+	struct process_test_process *test = &process_test_process;
+
+	if ( process == &test->process )
+		test->visited++;
+}
+
+/**
+ * Count steps executed by test process
+ *
+ * @v count		Number of scheduler steps to execute
+ * @ret steps		Number of test process steps executed
+ */
+static unsigned int process_test_run ( unsigned int count ) {
+	struct process_test_process *test = &process_test_process;
+	unsigned int steps = test->steps;
+
+	while ( count-- )
+		step();
+	return ( test->steps - steps );
+}
+
+/**
+ * Open test network device
+ *
+ * @v netdev		Network device
+ * @ret rc		Return status code
+ */
+static int process_test_netdev_open ( struct net_device *netdev __unused ) {
+
+	return 0;
+}
+
+/**
+ * Close test network device
+ *
+ * @v netdev		Network device
+ */
+static void process_test_netdev_close ( struct net_device *netdev __unused ) {
+
+	/* Nothing to do */
+}
+
+/**
+ * Transmit packet via test network device
+ *
+ * @v netdev		Network device
+ * @v iobuf		I/O buffer
+ * @ret rc		Return status code
+ */
+static int process_test_netdev_transmit ( struct net_device *netdev,
+					  struct io_buffer *iobuf ) {
+
+	netdev_tx_complete ( netdev, iobuf );
+	return 0;
+}
+
+/**
+ * Poll test network device
+ *
+ * @v netdev		Network device
+ */
+static void process_test_netdev_poll ( struct net_device *netdev __unused ) {
+
+	process_test_polls++;
+}
+
+/** Test network device operations */
+static struct net_device_operations process_test_netdev_operations = {
+	.open		= process_test_netdev_open,
+	.close		= process_test_netdev_close,
+	.transmit	= process_test_netdev_transmit,
+	.poll		= process_test_netdev_poll,
+};
+
+/**
+ * Check that an open network device is polled on every scheduler pass
+ *
+ * @v file		Test code file
+ * @v line		Test code line
+ *
+ * Received packets can be discovered only by polling, so an open
+ * network device must continue to be polled promptly even after a
+ * period without any network activity.
+ */
+static void process_test_netdev_okx ( const char *file, unsigned int line ) {
+	struct net_device *netdev;
+	unsigned long start;
+	unsigned int polls;
+	unsigned int missed;
+	unsigned int i;
+
+	/* Create and open network device */
+	netdev = alloc_etherdev ( 0 );
+	okx ( netdev != NULL, file, line );
+	if ( ! netdev )
+		return;
+	netdev_init ( netdev, &process_test_netdev_operations );
+	memset ( netdev->hw_addr, 0x02, ETH_ALEN );
+	okx ( register_netdev ( netdev ) == 0, file, line );
+	okx ( netdev_open ( netdev ) == 0, file, line );
+
+	/* Run without any network activity for a while */
+	start = currticks();
+	while ( ( currticks() - start ) <
+		( ( PROCESS_TEST_IDLE_MS * TICKS_PER_SEC ) / 1000 ) ) {
+		step();
+	}
+
+	/* Verify that the device is still polled on every pass
+	 * through the runnable processes.
+	 */
+	missed = 0;
+	for ( i = 0 ; i < PROCESS_TEST_ROUNDS ; i++ ) {
+		polls = process_test_polls;
+		process_test_run ( PROCESS_TEST_STEPS );
+		if ( process_test_polls == polls )
+			missed++;
+	}
+	okx ( missed == 0, file, line );
+
+	/* Verify that the device is no longer polled once closed */
+	netdev_close ( netdev );
+	process_test_run ( PROCESS_TEST_STEPS );
+	polls = process_test_polls;
+	process_test_run ( PROCESS_TEST_STEPS );
+	okx ( process_test_polls == polls, file, line );
+
+	/* Destroy network device */
+	unregister_netdev ( netdev );
+	netdev_nullify ( netdev );
+	netdev_put ( netdev );
+}
+#define process_test_netdev_ok() \
+	process_test_netdev_okx ( __FILE__, __LINE__ )
+
+/**
+ * Perform process self-tests
+ *
+ */
+static void process_test_exec ( void ) {
+	struct process_test_process *test = &process_test_process;
+	unsigned long start;
+	unsigned long elapsed;
+
+	/* Start test process */
+	memset ( test, 0, sizeof ( *test ) );
+	process_init ( &test->process, &process_test_desc, NULL );
+	ok ( process_running ( &test->process ) );
+	ok ( process_test_run ( PROCESS_TEST_STEPS ) > 0 );
+	process_for_each ( process_test_visit );
+	ok ( test->visited == 1 );
+
+	/* Verify that an idle process is not scheduled */
+	process_idle ( &test->process );
+	ok ( process_running ( &test->process ) );
+	ok ( test->process.idle );
+	ok ( process_test_run ( PROCESS_TEST_STEPS ) == 0 );
+	process_for_each ( process_test_visit );
+	ok ( test->visited == 2 );
+
+	/* Verify that a woken process is scheduled */
+	process_wake ( &test->process );
+	ok ( ! test->process.idle );
+	ok ( process_test_run ( PROCESS_TEST_STEPS ) > 0 );
+
+	/* Verify that waking a runnable process has no effect */
+	process_wake ( &test->process );
+	ok ( process_running ( &test->process ) );
+	ok ( process_test_run ( PROCESS_TEST_STEPS ) > 0 );
+
+	/* Verify that a sleeping process is woken at its wake time */
+	process_sleep ( &test->process,
+			( ( PROCESS_TEST_SLEEP_MS * TICKS_PER_SEC ) / 1000 ) );
+	start = currticks();
+	ok ( test->process.idle );
+	ok ( test->process.sleeping );
+	do {
+		elapsed = ( currticks() - start );
+		if ( process_test_run ( 1 ) )
+			break;
+	} while ( elapsed < TICKS_PER_SEC );
+	ok ( ! test->process.idle );
+	ok ( ! test->process.sleeping );
+	ok ( ( test->last - start ) >= 1 );
+	ok ( elapsed < ( TICKS_PER_SEC / 10 ) );
+
+	/* Verify that a sleeping process may be woken early */
+	process_sleep ( &test->process, ( 10 * TICKS_PER_SEC ) );
+	ok ( process_test_run ( PROCESS_TEST_STEPS ) == 0 );
+	process_wake ( &test->process );
+	ok ( ! test->process.sleeping );
+	ok ( process_test_run ( PROCESS_TEST_STEPS ) > 0 );
+
+	/* Verify that a sleeping process is woken before napping */
+	process_sleep ( &test->process, 0 );
+	process_nap();
+	ok ( ! test->process.idle );
+
+	/* Verify that an idle process may be stopped */
+	process_sleep ( &test->process, ( 10 * TICKS_PER_SEC ) );
+	process_del ( &test->process );
+	ok ( ! process_running ( &test->process ) );
+	ok ( ! test->process.idle );
+	ok ( ! test->process.sleeping );
+	ok ( process_test_run ( PROCESS_TEST_STEPS ) == 0 );
+	test->visited = 0;
+	process_for_each ( process_test_visit );
+	ok ( test->visited == 0 );
+
+	/* Verify that a stopped process cannot become idle */
+	process_idle ( &test->process );
+	ok ( ! process_running ( &test->process ) );
+	ok ( ! test->process.idle );
+
+	/* Verify that an open network device is polled promptly */
+	process_test_netdev_ok();
+}
+
+/** Process self-test */
+struct self_test process_test __self_test = {
+	.name = "process",
+	.exec = process_test_exec,
+};
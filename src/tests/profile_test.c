@@ -47,13 +47,32 @@ struct profile_test {
 	unsigned long mean;
 	/** Expected standard deviation */
 	unsigned long stddev;
+	/** Expected minimum sample value */
+	unsigned long min;
+	/** Expected maximum sample value */
+	unsigned long max;
+	/** Expected median sample value */
+	unsigned long p50;
+	/** Expected 99th percentile sample value */
+	unsigned long p99;
 };
 
+/** Maximum permitted error in an approximate percentile
+ *
+ * @v value		Expected percentile sample value
+ * @ret error		Maximum permitted error
+ *
+ * Percentiles are calculated from a histogram, and so can be only
+ * approximate.  Allow a one percent error, with a small absolute
+ * error to allow for rounding of small values.
+ */
+#define PROFILE_PERCENTILE_ERROR( value ) ( ( (value) / 100 ) + 2 )
+
 /** Define inline data */
 #define DATA(...) { __VA_ARGS__ }
 
 /** Define a profiling test */
-#define PROFILE_TEST( name, MEAN, STDDEV, SAMPLES )			\
+#define PROFILE_TEST( name, MEAN, STDDEV, MIN, MAX, P50, P99, SAMPLES )	\
 	static const unsigned long name ## _samples[] = SAMPLES;	\
 	static struct profile_test name = {				\
 		.samples = name ## _samples,				\
@@ -61,36 +80,65 @@ struct profile_test {
 			   sizeof ( name ## _samples [0] ) ),		\
 		.mean = MEAN,						\
 		.stddev = STDDEV,					\
+		.min = MIN,						\
+		.max = MAX,						\
+		.p50 = P50,						\
+		.p99 = P99,						\
 	}
 
 /** Empty data set */
-PROFILE_TEST ( empty, 0, 0, DATA() );
+PROFILE_TEST ( empty, 0, 0, 0, 0, 0, 0, DATA() );
 
 /** Single-element data set (zero) */
-PROFILE_TEST ( zero, 0, 0, DATA ( 0 ) );
+PROFILE_TEST ( zero, 0, 0, 0, 0, 0, 0, DATA ( 0 ) );
 
 /** Single-element data set (non-zero) */
-PROFILE_TEST ( single, 42, 0, DATA ( 42 ) );
+PROFILE_TEST ( single, 42, 0, 42, 42, 42, 42, DATA ( 42 ) );
 
 /** Multiple identical element data set */
-PROFILE_TEST ( identical, 69, 0, DATA ( 69, 69, 69, 69, 69, 69, 69 ) );
+PROFILE_TEST ( identical, 69, 0, 69, 69, 69, 69,
+	       DATA ( 69, 69, 69, 69, 69, 69, 69 ) );
 
 /** Small element data set */
-PROFILE_TEST ( small, 5, 2, DATA ( 3, 5, 9, 4, 3, 2, 5, 7 ) );
+PROFILE_TEST ( small, 5, 2, 2, 9, 4, 9, DATA ( 3, 5, 9, 4, 3, 2, 5, 7 ) );
 
 /** Random data set */
-PROFILE_TEST ( random, 70198, 394,
+PROFILE_TEST ( random, 70198, 394, 69600, 71078, 70101, 71078,
 	       DATA ( 69772, 70068, 70769, 69653, 70663, 71078, 70101, 70341,
 		      70215, 69600, 70020, 70456, 70421, 69972, 70267, 69999,
 		      69972 ) );
 
 /** Large-valued random data set */
-PROFILE_TEST ( large, 93533894UL, 25538UL,
+PROFILE_TEST ( large, 93533894UL, 25538UL, 93492361UL, 93586731UL,
+	       93537152UL, 93586731UL,
 	       DATA ( 93510333UL, 93561169UL, 93492361UL, 93528647UL,
 		      93557566UL, 93503465UL, 93540126UL, 93549020UL,
 		      93502307UL, 93527320UL, 93537152UL, 93540125UL,
 		      93550773UL, 93586731UL, 93521312UL ) );
 
+/** Long-tailed data set */
+PROFILE_TEST ( tail, 210, 987, 10, 5000, 10, 5000,
+	       DATA ( 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+		      10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 5000, 10, 10,
+		      10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+		      10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 5000 ) );
+
+/**
+ * Check approximate percentile
+ *
+ * @v value		Calculated percentile sample value
+ * @v expected		Expected percentile sample value
+ * @ret ok		Calculated value is close to expected value
+ */
+static int profile_percentile_ok ( unsigned long value,
+				   unsigned long expected ) {
+	unsigned long error;
+
+	error = ( ( value > expected ) ?
+		  ( value - expected ) : ( expected - value ) );
+	return ( error <= PROFILE_PERCENTILE_ERROR ( expected ) );
+}
+
 /**
  * Report a profiling test result
  *
@@ -103,6 +151,8 @@ static void profile_okx ( struct profile_test *test, const char *file,
 	struct profiler profiler;
 	unsigned long mean;
 	unsigned long stddev;
+	unsigned long p50;
+	unsigned long p99;
 	unsigned int i;
 
 	/* Initialise profiler */
@@ -118,6 +168,20 @@ static void profile_okx ( struct profile_test *test, const char *file,
 	DBGC ( test, "PROFILE calculated mean %ld stddev %ld\n", mean, stddev );
 	okx ( mean == test->mean, file, line );
 	okx ( stddev == test->stddev, file, line );
+	okx ( profiler.min == test->min, file, line );
+	okx ( profiler.max == test->max, file, line );
+	p50 = profile_percentile ( &profiler, 50 );
+	p99 = profile_percentile ( &profiler, 99 );
+	DBGC ( test, "PROFILE calculated p50 %ld p99 %ld\n", p50, p99 );
+	okx ( profile_percentile_ok ( p50, test->p50 ), file, line );
+	okx ( profile_percentile_ok ( p99, test->p99 ), file, line );
+
+	/* Check that reset discards all samples */
+	profile_reset ( &profiler );
+	okx ( profiler.count == 0, file, line );
+	okx ( profile_mean ( &profiler ) == 0, file, line );
+	okx ( profile_stddev ( &profiler ) == 0, file, line );
+	okx ( profile_percentile ( &profiler, 99 ) == 0, file, line );
 }
 #define profile_ok( test ) profile_okx ( test, __FILE__, __LINE__ )
 
@@ -126,6 +190,9 @@ static void profile_okx ( struct profile_test *test, const char *file,
  *
  */
 static void profile_test_exec ( void ) {
+	struct profiler profiler;
+	unsigned int percent;
+	unsigned int i;
 
 	/* Perform profiling tests */
 	profile_ok ( &empty );
@@ -135,6 +202,19 @@ static void profile_test_exec ( void ) {
 	profile_ok ( &small );
 	profile_ok ( &random );
 	profile_ok ( &large );
+	profile_ok ( &tail );
+
+	/* Check percentiles of evenly spaced samples 1-1000 (spanning
+	 * many histogram buckets), recorded in a shuffled order.
+	 */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < 1000 ; i++ )
+		profile_update ( &profiler, ( ( ( i * 7919 ) % 1000 ) + 1 ) );
+	for ( percent = 1 ; percent <= 100 ; percent++ ) {
+		ok ( profile_percentile_ok ( profile_percentile ( &profiler,
+								  percent ),
+					     ( percent * 10 ) ) );
+	}
 }
 
 /** Profiling self-test */
@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Retry timer self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <ipxe/timer.h>
+#include <ipxe/retry.h>
+#include <ipxe/process.h>
+#include <ipxe/profile.h>
+#include <ipxe/test.h>
+
+/** Number of long-running test timers */
+#define RETRY_TEST_TIMERS 4096
+
+/** Number of sample iterations for profiling */
+#define PROFILE_COUNT 256
+
+/** A retry timer test timer */
+struct retry_test_timer {
+	/** Retry timer */
+	struct retry_timer timer;
+	/** Number of expiries */
+	unsigned int expired;
+	/** Timer to stop upon expiry (if any) */
+	struct retry_timer *victim;
+	/** Restart upon expiry */
+	int restart;
+};
+
+/** Long-running test timers */
+static struct retry_test_timer retry_test_timers[RETRY_TEST_TIMERS];
+
+/** Retry timer polling profiler */
+static struct profiler retry_test_poll_profiler __profiler =
+	{ .name = "retry.poll" };
+
+/**
+ * Handle test timer expiry
+ *
+ * @v timer		Retry timer
+ * @v fail		Failure indicator
+ */
+static void retry_test_expired ( struct retry_timer *timer,
+				 int fail __unused ) {
+	struct retry_test_timer *test =
+		container_of ( timer, struct retry_test_timer, timer );
+
+	test->expired++;
+	if ( test->victim )
+		stop_timer ( test->victim );
+	if ( test->restart )
+		start_timer_nodelay ( timer );
+}
+
+/**
+ * Initialise test timer
+ *
+ * @v test		Test timer
+ */
+static void retry_test_init ( struct retry_test_timer *test ) {
+
+	memset ( test, 0, sizeof ( *test ) );
+	timer_init ( &test->timer, retry_test_expired, NULL );
+}
+
+/**
+ * Perform retry timer self-tests
+ *
+ */
+static void retry_test_exec ( void ) {
+	struct retry_test_timer immediate[16];
+	struct retry_test_timer killer;
+	struct retry_test_timer victim;
+	struct retry_test_timer repeat;
+	struct retry_test_timer prompt;
+	unsigned long timeout;
+	unsigned long start;
+	unsigned long elapsed;
+	unsigned int expired;
+	unsigned int i;
+
+	/* Start many long-running timers */
+	for ( i = 0 ; i < RETRY_TEST_TIMERS ; i++ ) {
+		retry_test_init ( &retry_test_timers[i] );
+		start_timer_fixed ( &retry_test_timers[i].timer,
+				    ( ( 1000 + i ) * TICKS_PER_SEC ) );
+	}
+
+	/* Profile polling with many running timers */
+	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
+		profile_start ( &retry_test_poll_profiler );
+		retry_poll();
+		profile_stop ( &retry_test_poll_profiler );
+	}
+	DBG ( "RETRY polled %d running timers in %ld +/- %ld ticks\n",
+	      RETRY_TEST_TIMERS, profile_mean ( &retry_test_poll_profiler ),
+	      profile_stddev ( &retry_test_poll_profiler ) );
+
+	/* Verify that multiple expired timers all expire in one poll */
+	for ( i = 0 ; i < ( sizeof ( immediate ) /
+			    sizeof ( immediate[0] ) ) ; i++ ) {
+		retry_test_init ( &immediate[i] );
+		start_timer_nodelay ( &immediate[i].timer );
+	}
+	retry_poll();
+	for ( i = 0 ; i < ( sizeof ( immediate ) /
+			    sizeof ( immediate[0] ) ) ; i++ ) {
+		ok ( immediate[i].expired == 1 );
+		ok ( ! timer_running ( &immediate[i].timer ) );
+	}
+
+	/* Verify that an expiry callback may stop an expired timer */
+	retry_test_init ( &killer );
+	retry_test_init ( &victim );
+	killer.victim = &victim.timer;
+	start_timer_nodelay ( &killer.timer );
+	start_timer_nodelay ( &victim.timer );
+	retry_poll();
+	ok ( killer.expired == 1 );
+	ok ( victim.expired == 0 );
+	ok ( ! timer_running ( &victim.timer ) );
+
+	/* Verify that a restarted timer expires only once per poll */
+	retry_test_init ( &repeat );
+	repeat.restart = 1;
+	start_timer_nodelay ( &repeat.timer );
+	retry_poll();
+	ok ( repeat.expired == 1 );
+	ok ( timer_running ( &repeat.timer ) );
+	retry_poll();
+	ok ( repeat.expired == 2 );
+	repeat.restart = 0;
+	stop_timer ( &repeat.timer );
+	ok ( ! timer_running ( &repeat.timer ) );
+
+	/* Stop long-running timers and verify timeout adaptation */
+	expired = 0;
+	for ( i = 0 ; i < RETRY_TEST_TIMERS ; i++ ) {
+		timeout = retry_test_timers[i].timer.timeout;
+		stop_timer ( &retry_test_timers[i].timer );
+		expired += retry_test_timers[i].expired;
+		if ( i == 0 ) {
+			ok ( retry_test_timers[i].timer.timeout <=
+			     ( timeout - ( timeout >> 3 ) + TICKS_PER_SEC ) );
+		}
+	}
+	ok ( expired == 0 );
+
+	/* Verify that stopped timers do not expire */
+	retry_poll();
+	expired = 0;
+	for ( i = 0 ; i < RETRY_TEST_TIMERS ; i++ )
+		expired += retry_test_timers[i].expired;
+	ok ( expired == 0 );
+
+	/* Verify that a timer expires promptly when driven by the
+	 * (possibly sleeping) retry timer process, even when restarted
+	 * with an earlier expiry time.  This must take place while no
+	 * long-running timers remain, since these would otherwise
+	 * prevent the retry timer process from sleeping.
+	 */
+	retry_test_init ( &prompt );
+	start_timer_fixed ( &prompt.timer, 200 );
+	for ( i = 0 ; i < 64 ; i++ )
+		step();
+	ok ( prompt.expired == 0 );
+	start = currticks();
+	start_timer_fixed ( &prompt.timer, 2 );
+	do {
+		step();
+		elapsed = ( currticks() - start );
+	} while ( ( ! prompt.expired ) && ( elapsed < 400 ) );
+	ok ( prompt.expired == 1 );
+	ok ( elapsed >= 2 );
+	ok ( elapsed < 100 );
+}
+
+/** Retry timer self-test */
+struct self_test retry_test __self_test = {
+	.name = "retry",
+	.exec = retry_test_exec,
+};
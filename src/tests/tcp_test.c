@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * TCP self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <byteswap.h>
+#include <ipxe/test.h>
+#include <ipxe/profile.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/xfer.h>
+#include <ipxe/open.h>
+#include <ipxe/socket.h>
+#include <ipxe/in.h>
+#include <ipxe/ip.h>
+#include <ipxe/ipstat.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/if_ether.h>
+#include <ipxe/ethernet.h>
+#include <ipxe/settings.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/tcp.h>
+
+/** Number of test connections */
+#define TCP_TEST_CONNS 512
+
+/** Base local port for test connections */
+#define TCP_TEST_BASE_PORT 30000
+
+/** Local IPv4 address */
+#define TCP_TEST_LOCAL 0xc6336401UL
+
+/** Peer IPv4 address */
+#define TCP_TEST_PEER 0xc6336402UL
+
+/** Peer port */
+#define TCP_TEST_PEER_PORT 80
+
+/** Number of sample iterations for profiling */
+#define PROFILE_COUNT 16
+
+/** A TCP test connection */
+struct tcp_test_conn {
+	/** Data transfer interface */
+	struct interface xfer;
+};
+
+/** TCP test connections */
+static struct tcp_test_conn tcp_test_conns[TCP_TEST_CONNS];
+
+/** TCP demultiplexing profiler */
+static struct profiler tcp_test_demux_profiler __profiler =
+	{ .name = "tcp.demux" };
+
+/** TCP test connection interface operations */
+static struct interface_operation tcp_test_operations[] = {};
+
+/** TCP test connection interface descriptor */
+static struct interface_descriptor tcp_test_desc =
+	INTF_DESC ( struct tcp_test_conn, xfer, tcp_test_operations );
+
+/**
+ * Open test network device
+ *
+ * @v netdev		Network device
+ * @ret rc		Return status code
+ */
+static int tcp_test_netdev_open ( struct net_device *netdev __unused ) {
+
+	return 0;
+}
+
+/**
+ * Close test network device
+ *
+ * @v netdev		Network device
+ */
+static void tcp_test_netdev_close ( struct net_device *netdev __unused ) {
+
+	/* Nothing to do */
+}
+
+/**
+ * Transmit packet via test network device
+ *
+ * @v netdev		Network device
+ * @v iobuf		I/O buffer
+ * @ret rc		Return status code
+ *
+ * All packets are silently discarded.
+ */
+static int tcp_test_netdev_transmit ( struct net_device *netdev,
+				      struct io_buffer *iobuf ) {
+
+	netdev_tx_complete ( netdev, iobuf );
+	return 0;
+}
+
+/**
+ * Poll test network device
+ *
+ * @v netdev		Network device
+ */
+static void tcp_test_netdev_poll ( struct net_device *netdev __unused ) {
+
+	/* Nothing to do */
+}
+
+/** Test network device operations */
+static struct net_device_operations tcp_test_netdev_operations = {
+	.open		= tcp_test_netdev_open,
+	.close		= tcp_test_netdev_close,
+	.transmit	= tcp_test_netdev_transmit,
+	.poll		= tcp_test_netdev_poll,
+};
+
+/**
+ * Inject received segment
+ *
+ * @v port		Destination port
+ * @ret rc		Return status code
+ *
+ * The segment carries no flags and no data, and so has no effect
+ * upon any connection to which it is delivered.
+ */
+static int tcp_test_rx ( unsigned int port ) {
+	struct ip_statistics stats;
+	struct sockaddr_in src;
+	struct sockaddr_in dest;
+	struct tcp_header *tcphdr;
+	struct io_buffer *iobuf;
+	int rc;
+
+	/* Construct segment */
+	iobuf = alloc_iob ( sizeof ( *tcphdr ) );
+	assert ( iobuf != NULL );
+	tcphdr = iob_put ( iobuf, sizeof ( *tcphdr ) );
+	memset ( tcphdr, 0, sizeof ( *tcphdr ) );
+	tcphdr->src = htons ( TCP_TEST_PEER_PORT );
+	tcphdr->dest = htons ( port );
+	tcphdr->hlen = ( ( sizeof ( *tcphdr ) / 4 ) << 4 );
+	tcphdr->csum = tcpip_chksum ( tcphdr, sizeof ( *tcphdr ) );
+
+	/* Construct partially-filled addresses */
+	memset ( &src, 0, sizeof ( src ) );
+	src.sin_family = AF_INET;
+	src.sin_addr.s_addr = htonl ( TCP_TEST_PEER );
+	memset ( &dest, 0, sizeof ( dest ) );
+	dest.sin_family = AF_INET;
+	dest.sin_addr.s_addr = htonl ( TCP_TEST_LOCAL );
+	memset ( &stats, 0, sizeof ( stats ) );
+
+	/* Hand off to TCP */
+	profile_start ( &tcp_test_demux_profiler );
+	rc = tcpip_rx ( iobuf, NULL, IP_TCP, ( struct sockaddr_tcpip * ) &src,
+			( struct sockaddr_tcpip * ) &dest, TCPIP_EMPTY_CSUM,
+			&stats );
+	profile_stop ( &tcp_test_demux_profiler );
+
+	return rc;
+}
+
+/**
+ * Perform TCP self-tests
+ *
+ */
+static void tcp_test_exec ( void ) {
+	struct in_addr address = { htonl ( TCP_TEST_LOCAL ) };
+	struct tcp_test_conn *conn;
+	struct net_device *netdev;
+	struct sockaddr_in peer;
+	struct sockaddr_in local;
+	unsigned int i;
+	unsigned int j;
+	int found;
+
+	/* Create network device providing a route to the peer */
+	netdev = alloc_etherdev ( 0 );
+	ok ( netdev != NULL );
+	if ( ! netdev )
+		return;
+	netdev_init ( netdev, &tcp_test_netdev_operations );
+	memset ( netdev->hw_addr, 0x02, ETH_ALEN );
+	ok ( register_netdev ( netdev ) == 0 );
+	ok ( netdev_open ( netdev ) == 0 );
+	ok ( store_setting ( netdev_settings ( netdev ), &ip_setting,
+			     &address, sizeof ( address ) ) == 0 );
+
+	/* Open test connections */
+	memset ( &peer, 0, sizeof ( peer ) );
+	peer.sin_family = AF_INET;
+	peer.sin_addr.s_addr = htonl ( TCP_TEST_PEER );
+	peer.sin_port = htons ( TCP_TEST_PEER_PORT );
+	for ( i = 0 ; i < TCP_TEST_CONNS ; i++ ) {
+		conn = &tcp_test_conns[i];
+		intf_init ( &conn->xfer, &tcp_test_desc, NULL );
+		memset ( &local, 0, sizeof ( local ) );
+		local.sin_port = htons ( TCP_TEST_BASE_PORT + i );
+		ok ( xfer_open_socket ( &conn->xfer, SOCK_STREAM,
+					( struct sockaddr * ) &peer,
+					( struct sockaddr * ) &local ) == 0 );
+	}
+
+	/* Verify that each local port is now in use */
+	conn = &tcp_test_conns[0];
+	memset ( &local, 0, sizeof ( local ) );
+	local.sin_port = htons ( TCP_TEST_BASE_PORT );
+	ok ( xfer_open_socket ( &conn->xfer, SOCK_STREAM,
+				( struct sockaddr * ) &peer,
+				( struct sockaddr * ) &local ) != 0 );
+
+	/* Deliver segments to each connection */
+	found = 1;
+	for ( j = 0 ; j < PROFILE_COUNT ; j++ ) {
+		for ( i = 0 ; i < TCP_TEST_CONNS ; i++ ) {
+			if ( tcp_test_rx ( TCP_TEST_BASE_PORT + i ) != 0 )
+				found = 0;
+		}
+	}
+	ok ( found );
+	DBG ( "TCP demultiplexed across %d connections in %ld +/- %ld "
+	      "ticks\n", TCP_TEST_CONNS,
+	      profile_mean ( &tcp_test_demux_profiler ),
+	      profile_stddev ( &tcp_test_demux_profiler ) );
+
+	/* Verify that segments to unbound ports are rejected */
+	ok ( tcp_test_rx ( TCP_TEST_BASE_PORT - 1 ) != 0 );
+	ok ( tcp_test_rx ( TCP_TEST_BASE_PORT + TCP_TEST_CONNS ) != 0 );
+
+	/* Close test connections */
+	for ( i = 0 ; i < TCP_TEST_CONNS ; i++ )
+		intf_shutdown ( &tcp_test_conns[i].xfer, 0 );
+
+	/* Verify that segments are no longer accepted, and that the
+	 * local ports are available for reuse.
+	 */
+	ok ( tcp_test_rx ( TCP_TEST_BASE_PORT ) != 0 );
+	ok ( tcp_test_rx ( TCP_TEST_BASE_PORT + TCP_TEST_CONNS - 1 ) != 0 );
+	intf_init ( &conn->xfer, &tcp_test_desc, NULL );
+	ok ( xfer_open_socket ( &conn->xfer, SOCK_STREAM,
+				( struct sockaddr * ) &peer,
+				( struct sockaddr * ) &local ) == 0 );
+	intf_shutdown ( &conn->xfer, 0 );
+
+	/* Destroy network device */
+	unregister_netdev ( netdev );
+	netdev_nullify ( netdev );
+	netdev_put ( netdev );
+}
+
+/** TCP self-test */
+struct self_test tcp_test __self_test = {
+	.name = "tcp",
+	.exec = tcp_test_exec,
+};
@@ -38,6 +38,8 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <assert.h>
 #include <ipxe/test.h>
 #include <ipxe/profile.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/netdevice.h>
 #include <ipxe/tcpip.h>
 
 /** Number of sample iterations for profiling */
@@ -81,6 +83,24 @@ struct tcpip_random_test {
 		.offset = OFFSET,					\
 	}
 
+/** A TCP/IP checksum offload test */
+struct tcpip_offload_test {
+	/** Seed */
+	unsigned int seed;
+	/** Length of data */
+	size_t len;
+	/** Offset of checksum field within data */
+	size_t offset;
+};
+
+/** Define a TCP/IP checksum offload test */
+#define TCPIP_OFFLOAD_TEST( name, SEED, LEN, OFFSET )			\
+	static struct tcpip_offload_test name = {			\
+		.seed = SEED,						\
+		.len = LEN,						\
+		.offset = OFFSET,					\
+	}
+
 /** Buffer for pseudorandom-data tests */
 static uint8_t __attribute__ (( aligned ( 16 ) ))
 	tcpip_data[ 4096 + 7 /* offset */ ];
@@ -123,6 +143,18 @@ TCPIP_RANDOM_TEST ( random_aligned_truncated, 0x12345678UL, 4095, 0 );
 /** Random data (unaligned start and finish) */
 TCPIP_RANDOM_TEST ( partial, 0xcafebabe, 121, 5 );
 
+/** Checksum offload of TCP-like segment */
+TCPIP_OFFLOAD_TEST ( offload_tcp, 0x4f666c64UL, 1460, 16 );
+
+/** Checksum offload of UDP-like datagram */
+TCPIP_OFFLOAD_TEST ( offload_udp, 0x75647020UL, 517, 6 );
+
+/** Dummy transport-layer protocol for checksum offload tests */
+static struct tcpip_protocol tcpip_offload_protocol = {
+	.name = "OFFLOAD",
+	.zero_csum = TCPIP_NEGATIVE_ZERO_CSUM,
+};
+
 /**
  * Calculate TCP/IP checksum
  *
@@ -233,6 +265,92 @@ static void tcpip_random_okx ( struct tcpip_random_test *test,
 }
 #define tcpip_random_ok( test ) tcpip_random_okx ( test, __FILE__, __LINE__ )
 
+/**
+ * Report TCP/IP checksum offload test result
+ *
+ * @v test		TCP/IP checksum offload test
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void tcpip_offload_okx ( struct tcpip_offload_test *test,
+				const char *file, unsigned int line ) {
+	struct net_device *netdev;
+	struct io_buffer *iobuf;
+	uint16_t pshdr_csum;
+	uint16_t expected;
+	uint16_t *csum;
+	uint8_t *data;
+	unsigned int i;
+
+	/* Allocate network device and I/O buffer */
+	netdev = alloc_netdev ( 0 );
+	okx ( netdev != NULL, file, line );
+	if ( ! netdev )
+		goto err_alloc_netdev;
+	iobuf = alloc_iob ( test->len );
+	okx ( iobuf != NULL, file, line );
+	if ( ! iobuf )
+		goto err_alloc_iob;
+
+	/* Generate random data and pseudo-header checksum */
+	srandom ( test->seed );
+	data = iob_put ( iobuf, test->len );
+	for ( i = 0 ; i < test->len ; i++ )
+		data[i] = random();
+	pshdr_csum = random();
+	csum = ( ( void * ) ( data + test->offset ) );
+
+	/* Calculate expected checksum */
+	*csum = 0;
+	expected = tcpip_continue_chksum ( pshdr_csum, data, test->len );
+	if ( ! expected )
+		expected = tcpip_offload_protocol.zero_csum;
+
+	/* Verify software completion of partial checksum */
+	*csum = pshdr_csum;
+	iob_csum_partial ( iobuf, data, csum );
+	tcpip_tx_chksum ( iobuf, &tcpip_offload_protocol, netdev, csum );
+	okx ( *csum == expected, file, line );
+	okx ( ! ( iobuf->csum_flags & IOB_CSUM_PARTIAL ), file, line );
+	okx ( netdev->tx_stats.csum == 0, file, line );
+
+	/* Verify that received checksum is verified in software */
+	okx ( tcpip_rx_chksum ( iobuf, netdev, TCPIP_EMPTY_CSUM,
+				test->len ) != 0, file, line );
+	okx ( tcpip_rx_chksum ( iobuf, netdev, pshdr_csum,
+				test->len ) == 0, file, line );
+	okx ( netdev->rx_stats.csum == 0, file, line );
+
+	/* Verify hardware completion of partial checksum, emulating
+	 * the hardware by summing over the data including the
+	 * checksum field.
+	 */
+	netdev->offloads = ( NETDEV_OFFLOAD_RX_CSUM | NETDEV_OFFLOAD_TX_CSUM );
+	*csum = pshdr_csum;
+	iob_csum_partial ( iobuf, data, csum );
+	tcpip_tx_chksum ( iobuf, &tcpip_offload_protocol, netdev, csum );
+	okx ( iobuf->csum_flags & IOB_CSUM_PARTIAL, file, line );
+	okx ( ( *csum ^ pshdr_csum ) == 0xffff, file, line );
+	okx ( netdev->tx_stats.csum == 1, file, line );
+	*csum = tcpip_chksum ( data, test->len );
+	if ( ! *csum )
+		*csum = tcpip_offload_protocol.zero_csum;
+	okx ( *csum == expected, file, line );
+
+	/* Verify that received checksum verification is bypassed */
+	iobuf->csum_flags = IOB_CSUM_VALID;
+	okx ( tcpip_rx_chksum ( iobuf, netdev, TCPIP_EMPTY_CSUM,
+				test->len ) == 0, file, line );
+	okx ( netdev->rx_stats.csum == 1, file, line );
+
+	free_iob ( iobuf );
+ err_alloc_iob:
+	netdev_put ( netdev );
+ err_alloc_netdev:
+	return;
+}
+#define tcpip_offload_ok( test ) tcpip_offload_okx ( test, __FILE__, __LINE__ )
+
 /**
  * Perform TCP/IP self-tests
  *
@@ -251,6 +369,8 @@ static void tcpip_test_exec ( void ) {
 	tcpip_random_ok ( &random_unaligned_2 );
 	tcpip_random_ok ( &random_aligned_truncated );
 	tcpip_random_ok ( &partial );
+	tcpip_offload_ok ( &offload_tcp );
+	tcpip_offload_ok ( &offload_udp );
 }
 
 /** TCP/IP self-test */
@@ -37,6 +37,7 @@ REQUIRE_OBJECT ( string_test );
 REQUIRE_OBJECT ( math_test );
 REQUIRE_OBJECT ( vsprintf_test );
 REQUIRE_OBJECT ( list_test );
+REQUIRE_OBJECT ( interface_test );
 REQUIRE_OBJECT ( byteswap_test );
 REQUIRE_OBJECT ( base64_test );
 REQUIRE_OBJECT ( base16_test );
@@ -45,6 +46,10 @@ REQUIRE_OBJECT ( time_test );
 REQUIRE_OBJECT ( tcpip_test );
 REQUIRE_OBJECT ( ipv4_test );
 REQUIRE_OBJECT ( ipv6_test );
+REQUIRE_OBJECT ( udp_test );
+REQUIRE_OBJECT ( tcp_test );
+REQUIRE_OBJECT ( process_test );
+REQUIRE_OBJECT ( retry_test );
 REQUIRE_OBJECT ( crc32_test );
 REQUIRE_OBJECT ( md5_test );
 REQUIRE_OBJECT ( sha1_test );
@@ -57,13 +62,19 @@ REQUIRE_OBJECT ( bigint_test );
 REQUIRE_OBJECT ( rsa_test );
 REQUIRE_OBJECT ( x509_test );
 REQUIRE_OBJECT ( ocsp_test );
+REQUIRE_OBJECT ( validator_test );
+REQUIRE_OBJECT ( tls_test );
 REQUIRE_OBJECT ( cms_test );
 REQUIRE_OBJECT ( pnm_test );
 REQUIRE_OBJECT ( deflate_test );
 REQUIRE_OBJECT ( png_test );
+REQUIRE_OBJECT ( fbcon_test );
 REQUIRE_OBJECT ( dns_test );
 REQUIRE_OBJECT ( uri_test );
 REQUIRE_OBJECT ( profile_test );
 REQUIRE_OBJECT ( setjmp_test );
 REQUIRE_OBJECT ( pccrc_test );
+REQUIRE_OBJECT ( peermux_test );
 REQUIRE_OBJECT ( linebuf_test );
+REQUIRE_OBJECT ( initrd_test );
+REQUIRE_OBJECT ( image_index_test );
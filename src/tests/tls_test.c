@@ -0,0 +1,445 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * TLS self-tests
+ *
+ * These tests drive a TLS session through its ciphertext stream, as
+ * seen by the underlying TCP connection.  No cipher suite has been
+ * negotiated, so all records are exchanged in plaintext.
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <byteswap.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/xfer.h>
+#include <ipxe/interface.h>
+#include <ipxe/process.h>
+#include <ipxe/tls.h>
+#include <ipxe/test.h>
+
+/** Define inline data */
+#define DATA(...) { __VA_ARGS__ }
+
+/** Test server name */
+#define TLS_TEST_NAME "tls.test.ipxe.org"
+
+/** A TLS Certificate Status test */
+struct tls_status_test {
+	/** Certificate Status handshake message body */
+	const void *data;
+	/** Length of message body */
+	size_t len;
+	/** Expected stapled OCSP response, or NULL */
+	const void *stapled;
+	/** Length of expected stapled OCSP response */
+	size_t stapled_len;
+	/** Message is expected to be rejected */
+	int reject;
+};
+
+/**
+ * Define a TLS Certificate Status test
+ *
+ * @v name		Test name
+ * @v DATA		Certificate Status message body
+ * @v STAPLED		Expected stapled OCSP response
+ * @v REJECT		Message is expected to be rejected
+ */
+#define STATUS( name, DATA, STAPLED, REJECT )				\
+	static const uint8_t name ## _data[] = DATA;			\
+	static const uint8_t name ## _stapled[] = STAPLED;		\
+	static struct tls_status_test name = {				\
+		.data = name ## _data,					\
+		.len = sizeof ( name ## _data ),			\
+		.stapled = ( sizeof ( name ## _stapled ) ?		\
+			     name ## _stapled : NULL ),			\
+		.stapled_len = sizeof ( name ## _stapled ),		\
+		.reject = REJECT,					\
+	}
+
+/** A TLS test connection */
+struct tls_test_connection {
+	/** Plaintext stream interface */
+	struct interface plain;
+	/** Ciphertext stream interface */
+	struct interface cipher;
+	/** Most recently transmitted ciphertext, if any */
+	struct io_buffer *tx;
+	/** Connection has been closed */
+	int closed;
+	/** Reason for close */
+	int rc;
+};
+
+/**
+ * Close TLS test connection
+ *
+ * @v conn		TLS test connection
+ * @v rc		Reason for close
+ */
+static void tls_test_close ( struct tls_test_connection *conn, int rc ) {
+
+	intf_shutdown ( &conn->cipher, rc );
+	intf_shutdown ( &conn->plain, rc );
+	conn->rc = rc;
+	conn->closed = 1;
+}
+
+/**
+ * Check TLS test connection flow control window
+ *
+ * @v conn		TLS test connection
+ * @ret len		Length of window
+ */
+static size_t tls_test_window ( struct tls_test_connection *conn __unused ) {
+
+	return 65536;
+}
+
+/**
+ * Receive transmitted ciphertext
+ *
+ * @v conn		TLS test connection
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int tls_test_deliver ( struct tls_test_connection *conn,
+			      struct io_buffer *iobuf,
+			      struct xfer_metadata *meta __unused ) {
+
+	free_iob ( conn->tx );
+	conn->tx = iobuf;
+	return 0;
+}
+
+/** TLS test plaintext stream interface operations */
+static struct interface_operation tls_test_plain_operations[] = {
+	INTF_OP ( intf_close, struct tls_test_connection *, tls_test_close ),
+};
+
+/** TLS test plaintext stream interface descriptor */
+static struct interface_descriptor tls_test_plain_desc =
+	INTF_DESC ( struct tls_test_connection, plain,
+		    tls_test_plain_operations );
+
+/** TLS test ciphertext stream interface operations */
+static struct interface_operation tls_test_cipher_operations[] = {
+	INTF_OP ( xfer_deliver, struct tls_test_connection *,
+		  tls_test_deliver ),
+	INTF_OP ( xfer_window, struct tls_test_connection *,
+		  tls_test_window ),
+	INTF_OP ( intf_close, struct tls_test_connection *, tls_test_close ),
+};
+
+/** TLS test ciphertext stream interface descriptor */
+static struct interface_descriptor tls_test_cipher_desc =
+	INTF_DESC ( struct tls_test_connection, cipher,
+		    tls_test_cipher_operations );
+
+/**
+ * Get TLS session attached to test connection
+ *
+ * @v conn		TLS test connection
+ * @ret tls		TLS session
+ */
+static struct tls_session * tls_test_session ( struct tls_test_connection
+					       *conn ) {
+
+	return container_of ( conn->cipher.dest, struct tls_session,
+			      cipherstream );
+}
+
+/**
+ * Open TLS test connection and wait for Client Hello
+ *
+ * @v conn		TLS test connection
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void tls_test_open ( struct tls_test_connection *conn,
+			    const char *file, unsigned int line ) {
+	struct interface *next;
+	unsigned int i;
+
+	/* Create TLS session */
+	memset ( conn, 0, sizeof ( *conn ) );
+	intf_init ( &conn->plain, &tls_test_plain_desc, NULL );
+	intf_init ( &conn->cipher, &tls_test_cipher_desc, NULL );
+	okx ( add_tls ( &conn->plain, TLS_TEST_NAME, &next ) == 0,
+	      file, line );
+	intf_plug_plug ( next, &conn->cipher );
+
+	/* Open transmit window and wait for Client Hello */
+	xfer_window_changed ( &conn->cipher );
+	for ( i = 0 ; ( ( ! conn->tx ) && ( i < 16 ) ) ; i++ )
+		step();
+	okx ( conn->tx != NULL, file, line );
+	okx ( ! conn->closed, file, line );
+}
+
+/**
+ * Shut down TLS test connection
+ *
+ * @v conn		TLS test connection
+ */
+static void tls_test_shutdown ( struct tls_test_connection *conn ) {
+
+	tls_test_close ( conn, 0 );
+	free_iob ( conn->tx );
+	conn->tx = NULL;
+}
+
+/**
+ * Find extension within transmitted Client Hello
+ *
+ * @v conn		TLS test connection
+ * @v type		Extension type
+ * @v len		Length of extension data to fill in
+ * @ret data		Extension data, or NULL if not found
+ */
+static const void * tls_test_hello_extension ( struct tls_test_connection
+					       *conn, unsigned int type,
+					       size_t *len ) {
+	const struct tls_header *tlshdr = conn->tx->data;
+	const uint8_t *data = ( conn->tx->data + sizeof ( *tlshdr ) );
+	const uint8_t *end = ( conn->tx->data + iob_len ( conn->tx ) );
+	unsigned int ext_type;
+	size_t ext_len;
+
+	/* Check record and handshake types */
+	if ( ( iob_len ( conn->tx ) < ( sizeof ( *tlshdr ) + 4 ) ) ||
+	     ( tlshdr->type != TLS_TYPE_HANDSHAKE ) ||
+	     ( data[0] != TLS_CLIENT_HELLO ) )
+		return NULL;
+
+	/* Skip handshake header, version, and random bytes */
+	data += ( 4 /* header */ + 2 /* version */ + 32 /* random */ );
+
+	/* Skip session ID, cipher suites, and compression methods */
+	if ( ( data + 1 ) > end )
+		return NULL;
+	data += ( 1 + data[0] );
+	if ( ( data + 2 ) > end )
+		return NULL;
+	data += ( 2 + ( ( data[0] << 8 ) | data[1] ) );
+	if ( ( data + 1 ) > end )
+		return NULL;
+	data += ( 1 + data[0] );
+
+	/* Check extensions length */
+	if ( ( data + 2 ) > end )
+		return NULL;
+	if ( ( data + 2 + ( ( data[0] << 8 ) | data[1] ) ) != end )
+		return NULL;
+	data += 2;
+
+	/* Search for extension */
+	while ( ( data + 4 ) <= end ) {
+		ext_type = ( ( data[0] << 8 ) | data[1] );
+		ext_len = ( ( data[2] << 8 ) | data[3] );
+		if ( ( data + 4 + ext_len ) > end )
+			return NULL;
+		if ( ext_type == type ) {
+			*len = ext_len;
+			return ( data + 4 );
+		}
+		data += ( 4 + ext_len );
+	}
+
+	return NULL;
+}
+
+/**
+ * Report Client Hello status_request extension test result
+ *
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void tls_status_request_okx ( const char *file, unsigned int line ) {
+	static const uint8_t expected[] = {
+		TLS_STATUS_REQUEST_OCSP,
+		0x00, 0x00, /* responder_id_list */
+		0x00, 0x00, /* request_extensions */
+	};
+	struct tls_test_connection conn;
+	const void *ext;
+	size_t len = 0;
+
+	/* Open connection */
+	tls_test_open ( &conn, file, line );
+
+	/* Check for OCSP status_request extension */
+	if ( conn.tx ) {
+		ext = tls_test_hello_extension ( &conn, TLS_STATUS_REQUEST,
+						 &len );
+		okx ( ext != NULL, file, line );
+		okx ( len == sizeof ( expected ), file, line );
+		okx ( ( ext != NULL ) && ( len == sizeof ( expected ) ) &&
+		      ( memcmp ( ext, expected, len ) == 0 ), file, line );
+
+		/* Sanity check: server_name extension is also found */
+		ext = tls_test_hello_extension ( &conn, TLS_SERVER_NAME,
+						 &len );
+		okx ( ext != NULL, file, line );
+	}
+
+	/* Close connection */
+	tls_test_shutdown ( &conn );
+}
+#define tls_status_request_ok()						\
+	tls_status_request_okx ( __FILE__, __LINE__ )
+
+/**
+ * Report TLS Certificate Status test result
+ *
+ * @v test		TLS Certificate Status test
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void tls_status_okx ( struct tls_status_test *test,
+			     const char *file, unsigned int line ) {
+	struct tls_test_connection conn;
+	struct tls_session *tls;
+	struct io_buffer *iobuf;
+	struct tls_header *tlshdr;
+	uint8_t *handshake;
+	size_t len = ( 4 /* handshake header */ + test->len );
+
+	/* Open connection */
+	tls_test_open ( &conn, file, line );
+	tls = tls_test_session ( &conn );
+	okx ( tls->stapled == NULL, file, line );
+
+	/* Construct Certificate Status record */
+	iobuf = alloc_iob ( sizeof ( *tlshdr ) + len );
+	okx ( iobuf != NULL, file, line );
+	if ( ! iobuf )
+		goto err_alloc;
+	tlshdr = iob_put ( iobuf, sizeof ( *tlshdr ) );
+	tlshdr->type = TLS_TYPE_HANDSHAKE;
+	tlshdr->version = htons ( TLS_VERSION_TLS_1_2 );
+	tlshdr->length = htons ( len );
+	handshake = iob_put ( iobuf, len );
+	handshake[0] = TLS_CERTIFICATE_STATUS;
+	handshake[1] = ( ( test->len >> 16 ) & 0xff );
+	handshake[2] = ( ( test->len >> 8 ) & 0xff );
+	handshake[3] = ( ( test->len >> 0 ) & 0xff );
+	memcpy ( ( handshake + 4 ), test->data, test->len );
+
+	/* Deliver record and check result */
+	xfer_deliver_iob ( &conn.cipher, iobuf );
+	if ( test->reject ) {
+		okx ( conn.closed, file, line );
+		okx ( conn.rc != 0, file, line );
+	} else {
+		okx ( ! conn.closed, file, line );
+		okx ( tls->stapled_len == test->stapled_len, file, line );
+		if ( test->stapled ) {
+			okx ( tls->stapled != NULL, file, line );
+			okx ( ( tls->stapled != NULL ) &&
+			      ( memcmp ( tls->stapled, test->stapled,
+					 test->stapled_len ) == 0 ),
+			      file, line );
+		} else {
+			okx ( tls->stapled == NULL, file, line );
+		}
+	}
+
+ err_alloc:
+	/* Close connection */
+	tls_test_shutdown ( &conn );
+}
+#define tls_status_ok( test ) tls_status_okx ( test, __FILE__, __LINE__ )
+
+/* OCSP response */
+STATUS ( status_ocsp,
+	 DATA ( TLS_STATUS_REQUEST_OCSP, 0x00, 0x00, 0x05,
+		0x30, 0x03, 0x0a, 0x01, 0x00 ),
+	 DATA ( 0x30, 0x03, 0x0a, 0x01, 0x00 ), 0 );
+
+/* Empty OCSP response */
+STATUS ( status_empty,
+	 DATA ( TLS_STATUS_REQUEST_OCSP, 0x00, 0x00, 0x00 ),
+	 DATA(), 1 );
+
+/* Unknown status type (ignored) */
+STATUS ( status_unknown,
+	 DATA ( 0x02, 0x00, 0x00, 0x02, 0xaa, 0xbb ),
+	 DATA(), 0 );
+
+/* Underlength message */
+STATUS ( status_underlength,
+	 DATA ( TLS_STATUS_REQUEST_OCSP, 0x00, 0x00 ),
+	 DATA(), 1 );
+
+/* Response length exceeds message */
+STATUS ( status_overlength,
+	 DATA ( TLS_STATUS_REQUEST_OCSP, 0x00, 0x00, 0x08,
+		0x30, 0x03, 0x0a, 0x01 ),
+	 DATA(), 1 );
+
+/* Trailing data after response */
+STATUS ( status_trailing,
+	 DATA ( TLS_STATUS_REQUEST_OCSP, 0x00, 0x00, 0x01,
+		0x30, 0x03 ),
+	 DATA(), 1 );
+
+/* Unknown status type with inconsistent length */
+STATUS ( status_unknown_overlength,
+	 DATA ( 0x02, 0x00, 0x01, 0x00, 0xaa ),
+	 DATA(), 1 );
+
+/**
+ * Perform TLS self-tests
+ *
+ */
+static void tls_test_exec ( void ) {
+
+	/* Client Hello */
+	tls_status_request_ok();
+
+	/* Certificate Status */
+	tls_status_ok ( &status_ocsp );
+	tls_status_ok ( &status_empty );
+	tls_status_ok ( &status_unknown );
+	tls_status_ok ( &status_underlength );
+	tls_status_ok ( &status_overlength );
+	tls_status_ok ( &status_trailing );
+	tls_status_ok ( &status_unknown_overlength );
+}
+
+/** TLS self-test */
+struct self_test tls_test __self_test = {
+	.name = "tls",
+	.exec = tls_test_exec,
+};
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * UDP self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <byteswap.h>
+#include <ipxe/test.h>
+#include <ipxe/profile.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/xfer.h>
+#include <ipxe/in.h>
+#include <ipxe/ip.h>
+#include <ipxe/ipstat.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/udp.h>
+
+/** Number of test connections */
+#define UDP_TEST_CONNS 512
+
+/** Base local port for test connections */
+#define UDP_TEST_BASE_PORT 20000
+
+/** Number of sample iterations for profiling */
+#define PROFILE_COUNT 16
+
+/** A UDP test connection */
+struct udp_test_conn {
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Number of datagrams received */
+	unsigned int rx;
+};
+
+/** UDP test connections */
+static struct udp_test_conn udp_test_conns[UDP_TEST_CONNS];
+
+/** UDP demultiplexing profiler */
+static struct profiler udp_test_demux_profiler __profiler =
+	{ .name = "udp.demux" };
+
+/**
+ * Receive datagram
+ *
+ * @v conn		UDP test connection
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int udp_test_deliver ( struct udp_test_conn *conn,
+			      struct io_buffer *iobuf,
+			      struct xfer_metadata *meta __unused ) {
+
+	conn->rx++;
+	free_iob ( iobuf );
+	return 0;
+}
+
+/** UDP test connection interface operations */
+static struct interface_operation udp_test_operations[] = {
+	INTF_OP ( xfer_deliver, struct udp_test_conn *, udp_test_deliver ),
+};
+
+/** UDP test connection interface descriptor */
+static struct interface_descriptor udp_test_desc =
+	INTF_DESC ( struct udp_test_conn, xfer, udp_test_operations );
+
+/**
+ * Inject received datagram
+ *
+ * @v port		Destination port
+ * @ret rc		Return status code
+ */
+static int udp_test_rx ( unsigned int port ) {
+	static const char payload[] = "Hello world";
+	struct ip_statistics stats;
+	struct sockaddr_in src;
+	struct sockaddr_in dest;
+	struct udp_header *udphdr;
+	struct io_buffer *iobuf;
+	size_t len;
+	int rc;
+
+	/* Construct datagram */
+	len = ( sizeof ( *udphdr ) + sizeof ( payload ) );
+	iobuf = alloc_iob ( len );
+	assert ( iobuf != NULL );
+	udphdr = iob_put ( iobuf, sizeof ( *udphdr ) );
+	udphdr->src = htons ( 53 );
+	udphdr->dest = htons ( port );
+	udphdr->len = htons ( len );
+	udphdr->chksum = 0;
+	memcpy ( iob_put ( iobuf, sizeof ( payload ) ), payload,
+		 sizeof ( payload ) );
+
+	/* Construct partially-filled addresses */
+	memset ( &src, 0, sizeof ( src ) );
+	src.sin_family = AF_INET;
+	src.sin_addr.s_addr = htonl ( 0xc0a80001 );
+	memset ( &dest, 0, sizeof ( dest ) );
+	dest.sin_family = AF_INET;
+	dest.sin_addr.s_addr = htonl ( 0xc0a80002 );
+	memset ( &stats, 0, sizeof ( stats ) );
+
+	/* Hand off to UDP */
+	profile_start ( &udp_test_demux_profiler );
+	rc = tcpip_rx ( iobuf, NULL, IP_UDP, ( struct sockaddr_tcpip * ) &src,
+			( struct sockaddr_tcpip * ) &dest, 0, &stats );
+	profile_stop ( &udp_test_demux_profiler );
+
+	return rc;
+}
+
+/**
+ * Perform UDP self-tests
+ *
+ */
+static void udp_test_exec ( void ) {
+	struct udp_test_conn promisc;
+	struct udp_test_conn *conn;
+	struct sockaddr_in peer;
+	struct sockaddr_in local;
+	unsigned int i;
+	unsigned int j;
+
+	/* Open test connections */
+	memset ( &peer, 0, sizeof ( peer ) );
+	peer.sin_family = AF_INET;
+	peer.sin_addr.s_addr = htonl ( 0xc0a80001 );
+	peer.sin_port = htons ( 53 );
+	for ( i = 0 ; i < UDP_TEST_CONNS ; i++ ) {
+		conn = &udp_test_conns[i];
+		memset ( conn, 0, sizeof ( *conn ) );
+		intf_init ( &conn->xfer, &udp_test_desc, NULL );
+		memset ( &local, 0, sizeof ( local ) );
+		local.sin_port = htons ( UDP_TEST_BASE_PORT + i );
+		ok ( udp_open ( &conn->xfer, ( struct sockaddr * ) &peer,
+				( struct sockaddr * ) &local ) == 0 );
+	}
+
+	/* Verify that each local port is now in use */
+	conn = &udp_test_conns[0];
+	memset ( &local, 0, sizeof ( local ) );
+	local.sin_port = htons ( UDP_TEST_BASE_PORT );
+	ok ( udp_open ( &conn->xfer, ( struct sockaddr * ) &peer,
+			( struct sockaddr * ) &local ) != 0 );
+
+	/* Deliver datagrams to each connection */
+	for ( j = 0 ; j < PROFILE_COUNT ; j++ ) {
+		for ( i = 0 ; i < UDP_TEST_CONNS ; i++ )
+			udp_test_rx ( UDP_TEST_BASE_PORT + i );
+	}
+	for ( i = 0 ; i < UDP_TEST_CONNS ; i++ )
+		ok ( udp_test_conns[i].rx == PROFILE_COUNT );
+	DBG ( "UDP demultiplexed across %d connections in %ld +/- %ld "
+	      "ticks\n", UDP_TEST_CONNS,
+	      profile_mean ( &udp_test_demux_profiler ),
+	      profile_stddev ( &udp_test_demux_profiler ) );
+
+	/* Verify that datagrams to unbound ports are rejected */
+	ok ( udp_test_rx ( UDP_TEST_BASE_PORT - 1 ) != 0 );
+	ok ( udp_test_rx ( UDP_TEST_BASE_PORT + UDP_TEST_CONNS ) != 0 );
+
+	/* Verify that connections bound to a specific local port take
+	 * precedence over a promiscuous connection, which receives
+	 * only datagrams to otherwise unbound ports.
+	 */
+	memset ( &promisc, 0, sizeof ( promisc ) );
+	intf_init ( &promisc.xfer, &udp_test_desc, NULL );
+	ok ( udp_open_promisc ( &promisc.xfer ) == 0 );
+	ok ( udp_test_rx ( UDP_TEST_BASE_PORT ) == 0 );
+	ok ( udp_test_conns[0].rx == ( PROFILE_COUNT + 1 ) );
+	ok ( promisc.rx == 0 );
+	ok ( udp_test_rx ( UDP_TEST_BASE_PORT - 1 ) == 0 );
+	ok ( promisc.rx == 1 );
+	intf_shutdown ( &promisc.xfer, 0 );
+	ok ( udp_test_rx ( UDP_TEST_BASE_PORT - 1 ) != 0 );
+
+	/* Close test connections */
+	for ( i = 0 ; i < UDP_TEST_CONNS ; i++ )
+		intf_shutdown ( &udp_test_conns[i].xfer, 0 );
+
+	/* Verify that datagrams are no longer delivered */
+	ok ( udp_test_rx ( UDP_TEST_BASE_PORT ) != 0 );
+	ok ( udp_test_conns[0].rx == ( PROFILE_COUNT + 1 ) );
+}
+
+/** UDP self-test */
+struct self_test udp_test __self_test = {
+	.name = "udp",
+	.exec = udp_test_exec,
+};
@@ -0,0 +1,596 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Certificate validator self-tests
+ *
+ * The validator checks certificates against the current time, so
+ * these tests use a dedicated root and end-entity certificate that
+ * remain valid until 2048.  Test vectors generated using OpenSSL:
+ *
+ *     openssl ocsp -no_nonce -issuer root.crt -cert leaf.crt \
+ *		    -reqout request.der
+ *     openssl ocsp -index index.txt -CA root.crt -rsigner root.crt \
+ *		    -rkey root.key -reqin request.der -resp_no_certs \
+ *		    -ndays 8000 -respout response.der
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/xfer.h>
+#include <ipxe/open.h>
+#include <ipxe/uri.h>
+#include <ipxe/interface.h>
+#include <ipxe/process.h>
+#include <ipxe/x509.h>
+#include <ipxe/validator.h>
+#include <ipxe/test.h>
+
+/** Define inline data */
+#define DATA(...) { __VA_ARGS__ }
+
+/** Test OCSP responder host name */
+#define VALIDATOR_TEST_OCSP_HOST "ocsp.test.ipxe.org"
+
+/** A validator test certificate */
+struct validator_test_certificate {
+	/** Data */
+	const void *data;
+	/** Length of data */
+	size_t len;
+	/** Parsed certificate */
+	struct x509_certificate *cert;
+};
+
+/** A validator test OCSP response */
+struct validator_test_response {
+	/** Data */
+	const void *data;
+	/** Length of data */
+	size_t len;
+};
+
+/** Define a test certificate */
+#define CERTIFICATE( name, DATA )					\
+	static const uint8_t name ## _data[] = DATA;			\
+	static struct validator_test_certificate name = {		\
+		.data = name ## _data,					\
+		.len = sizeof ( name ## _data ),			\
+	}
+
+/** Define a test OCSP response */
+#define RESPONSE( name, DATA )						\
+	static const uint8_t name ## _data[] = DATA;			\
+	static struct validator_test_response name = {			\
+		.data = name ## _data,					\
+		.len = sizeof ( name ## _data ),			\
+	}
+
+/** Define a truncated test OCSP response */
+#define TRUNCATED( name, RESPONSE, LEN )				\
+	static struct validator_test_response name = {			\
+		.data = RESPONSE ## _data,				\
+		.len = (LEN),						\
+	}
+
+/*
+ * subject	iPXE self-test validator root CA
+ * issuer	iPXE self-test validator root CA
+ */
+CERTIFICATE ( root_crt,
+	DATA ( 0x30, 0x82, 0x02, 0x21, 0x30, 0x82, 0x01, 0x8a, 0xa0, 0x03,
+	       0x02, 0x01, 0x02, 0x02, 0x14, 0x27, 0xe9, 0x4a, 0x7c, 0x1e,
+	       0x9f, 0x73, 0xeb, 0x23, 0x06, 0x02, 0x4d, 0x4e, 0x3f, 0xbe,
+	       0x59, 0xfc, 0x1a, 0xcd, 0x10, 0x30, 0x0d, 0x06, 0x09, 0x2a,
+	       0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x0b, 0x05, 0x00,
+	       0x30, 0x2b, 0x31, 0x29, 0x30, 0x27, 0x06, 0x03, 0x55, 0x04,
+	       0x03, 0x0c, 0x20, 0x69, 0x50, 0x58, 0x45, 0x20, 0x73, 0x65,
+	       0x6c, 0x66, 0x2d, 0x74, 0x65, 0x73, 0x74, 0x20, 0x76, 0x61,
+	       0x6c, 0x69, 0x64, 0x61, 0x74, 0x6f, 0x72, 0x20, 0x72, 0x6f,
+	       0x6f, 0x74, 0x20, 0x43, 0x41, 0x30, 0x1e, 0x17, 0x0d, 0x32,
+	       0x36, 0x31, 0x30, 0x31, 0x39, 0x30, 0x34, 0x33, 0x33, 0x34,
+	       0x32, 0x5a, 0x17, 0x0d, 0x34, 0x39, 0x31, 0x30, 0x31, 0x38,
+	       0x30, 0x34, 0x33, 0x33, 0x34, 0x32, 0x5a, 0x30, 0x2b, 0x31,
+	       0x29, 0x30, 0x27, 0x06, 0x03, 0x55, 0x04, 0x03, 0x0c, 0x20,
+	       0x69, 0x50, 0x58, 0x45, 0x20, 0x73, 0x65, 0x6c, 0x66, 0x2d,
+	       0x74, 0x65, 0x73, 0x74, 0x20, 0x76, 0x61, 0x6c, 0x69, 0x64,
+	       0x61, 0x74, 0x6f, 0x72, 0x20, 0x72, 0x6f, 0x6f, 0x74, 0x20,
+	       0x43, 0x41, 0x30, 0x81, 0x9f, 0x30, 0x0d, 0x06, 0x09, 0x2a,
+	       0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x01, 0x05, 0x00,
+	       0x03, 0x81, 0x8d, 0x00, 0x30, 0x81, 0x89, 0x02, 0x81, 0x81,
+	       0x00, 0xca, 0x14, 0xe9, 0xb1, 0x0f, 0x12, 0xdd, 0x6f, 0x6b,
+	       0x70, 0x80, 0xbf, 0xe3, 0x72, 0xb4, 0xf8, 0xfd, 0xf8, 0xab,
+	       0x78, 0x96, 0xea, 0x03, 0x6e, 0xcc, 0x6c, 0x41, 0x3c, 0x11,
+	       0x31, 0x04, 0x4d, 0x48, 0xf5, 0x77, 0xfc, 0x68, 0xfd, 0xdd,
+	       0xf1, 0x75, 0x60, 0xd4, 0xe9, 0x89, 0x56, 0xeb, 0x56, 0x7c,
+	       0x31, 0x07, 0x4e, 0xd0, 0xc9, 0x73, 0xe3, 0x9b, 0xc0, 0x4b,
+	       0x99, 0xa7, 0x1d, 0x11, 0xd6, 0x4d, 0x86, 0x2c, 0x0d, 0x98,
+	       0x86, 0xa4, 0x63, 0xfd, 0xc2, 0x7d, 0x01, 0xfa, 0x0e, 0x73,
+	       0x2b, 0x15, 0x74, 0xcc, 0x05, 0x7f, 0x9d, 0xf7, 0x89, 0x0e,
+	       0x95, 0x95, 0x96, 0x91, 0x85, 0x3e, 0xa9, 0x63, 0x72, 0x84,
+	       0x50, 0x49, 0x64, 0x90, 0xbf, 0x55, 0x2a, 0x42, 0xd1, 0x39,
+	       0x4b, 0xa6, 0x9f, 0xd7, 0xf4, 0x24, 0xe8, 0x7c, 0xfd, 0x88,
+	       0xaa, 0x77, 0xd4, 0xb6, 0x8c, 0x17, 0x18, 0x69, 0x07, 0x02,
+	       0x03, 0x01, 0x00, 0x01, 0xa3, 0x42, 0x30, 0x40, 0x30, 0x0f,
+	       0x06, 0x03, 0x55, 0x1d, 0x13, 0x01, 0x01, 0xff, 0x04, 0x05,
+	       0x30, 0x03, 0x01, 0x01, 0xff, 0x30, 0x0e, 0x06, 0x03, 0x55,
+	       0x1d, 0x0f, 0x01, 0x01, 0xff, 0x04, 0x04, 0x03, 0x02, 0x01,
+	       0x06, 0x30, 0x1d, 0x06, 0x03, 0x55, 0x1d, 0x0e, 0x04, 0x16,
+	       0x04, 0x14, 0x10, 0x11, 0xea, 0x44, 0x33, 0x15, 0x06, 0xb8,
+	       0x3d, 0x78, 0x75, 0x32, 0x9e, 0xbc, 0xc9, 0x45, 0x16, 0xdf,
+	       0xd9, 0xf5, 0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86,
+	       0xf7, 0x0d, 0x01, 0x01, 0x0b, 0x05, 0x00, 0x03, 0x81, 0x81,
+	       0x00, 0x09, 0xf4, 0xfc, 0x51, 0x5a, 0x31, 0x89, 0x1b, 0x58,
+	       0xdd, 0x0a, 0x17, 0x65, 0x3b, 0x9b, 0x46, 0xba, 0xff, 0xc7,
+	       0xea, 0x45, 0xe8, 0x58, 0xa9, 0xc1, 0x0d, 0xbb, 0x07, 0x62,
+	       0x8e, 0x37, 0x2f, 0x76, 0x05, 0x5b, 0x73, 0x0b, 0x8f, 0xb7,
+	       0xf1, 0xfc, 0xec, 0x91, 0x32, 0xdc, 0xd5, 0xeb, 0x0a, 0xc1,
+	       0xf6, 0xe3, 0xcb, 0x2a, 0xd2, 0xba, 0xaf, 0xd9, 0x4b, 0x3b,
+	       0x80, 0xf1, 0xf8, 0xef, 0x48, 0xd4, 0x70, 0xf7, 0x53, 0x2e,
+	       0xa8, 0x31, 0x57, 0x3a, 0x28, 0xcd, 0x25, 0x9f, 0x55, 0xa8,
+	       0x76, 0xa9, 0xc4, 0x0a, 0xda, 0x9c, 0x6d, 0x7c, 0x02, 0xa5,
+	       0x48, 0x9a, 0x33, 0xaf, 0x10, 0x87, 0xfa, 0xc5, 0x27, 0xc1,
+	       0x06, 0x25, 0x70, 0x7e, 0x17, 0x9c, 0x21, 0x34, 0x8f, 0xed,
+	       0x3b, 0xa6, 0xac, 0xc1, 0xce, 0x1b, 0x37, 0xc6, 0x75, 0x5e,
+	       0x88, 0xe2, 0xd6, 0xe4, 0x21, 0x18, 0x14, 0x1d, 0xfa ) );
+
+/*
+ * subject	leaf.test.ipxe.org
+ * issuer	iPXE self-test validator root CA
+ * OCSP		http://ocsp.test.ipxe.org
+ */
+CERTIFICATE ( leaf_crt,
+	DATA ( 0x30, 0x82, 0x02, 0x55, 0x30, 0x82, 0x01, 0xbe, 0xa0, 0x03,
+	       0x02, 0x01, 0x02, 0x02, 0x02, 0x10, 0x01, 0x30, 0x0d, 0x06,
+	       0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x0b,
+	       0x05, 0x00, 0x30, 0x2b, 0x31, 0x29, 0x30, 0x27, 0x06, 0x03,
+	       0x55, 0x04, 0x03, 0x0c, 0x20, 0x69, 0x50, 0x58, 0x45, 0x20,
+	       0x73, 0x65, 0x6c, 0x66, 0x2d, 0x74, 0x65, 0x73, 0x74, 0x20,
+	       0x76, 0x61, 0x6c, 0x69, 0x64, 0x61, 0x74, 0x6f, 0x72, 0x20,
+	       0x72, 0x6f, 0x6f, 0x74, 0x20, 0x43, 0x41, 0x30, 0x1e, 0x17,
+	       0x0d, 0x32, 0x36, 0x31, 0x30, 0x31, 0x39, 0x30, 0x34, 0x33,
+	       0x33, 0x34, 0x32, 0x5a, 0x17, 0x0d, 0x34, 0x38, 0x30, 0x39,
+	       0x31, 0x33, 0x30, 0x34, 0x33, 0x33, 0x34, 0x32, 0x5a, 0x30,
+	       0x1d, 0x31, 0x1b, 0x30, 0x19, 0x06, 0x03, 0x55, 0x04, 0x03,
+	       0x0c, 0x12, 0x6c, 0x65, 0x61, 0x66, 0x2e, 0x74, 0x65, 0x73,
+	       0x74, 0x2e, 0x69, 0x70, 0x78, 0x65, 0x2e, 0x6f, 0x72, 0x67,
+	       0x30, 0x81, 0x9f, 0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48,
+	       0x86, 0xf7, 0x0d, 0x01, 0x01, 0x01, 0x05, 0x00, 0x03, 0x81,
+	       0x8d, 0x00, 0x30, 0x81, 0x89, 0x02, 0x81, 0x81, 0x00, 0xc7,
+	       0x50, 0x0f, 0x0e, 0x2a, 0x52, 0x44, 0xd5, 0x05, 0x28, 0x8e,
+	       0x42, 0x54, 0xd2, 0xea, 0x77, 0x48, 0x35, 0xe1, 0xc7, 0xe4,
+	       0x64, 0x9d, 0x54, 0x82, 0x97, 0xb9, 0xcf, 0x85, 0xb7, 0xa0,
+	       0xc2, 0x24, 0x26, 0x59, 0xd1, 0x49, 0xb6, 0x26, 0xd2, 0x34,
+	       0x8f, 0xb7, 0xf2, 0x87, 0x9f, 0xca, 0x87, 0xf9, 0x65, 0x7f,
+	       0x44, 0x9c, 0x66, 0xb0, 0x6c, 0x69, 0xb1, 0x20, 0xea, 0x68,
+	       0x60, 0x99, 0x93, 0xe5, 0x4b, 0xc6, 0xf4, 0x5e, 0x03, 0x4e,
+	       0xa0, 0xfa, 0x78, 0xd7, 0xc0, 0x0f, 0x3b, 0xa1, 0x71, 0x45,
+	       0xea, 0x8a, 0x7b, 0xaa, 0x57, 0x5a, 0x97, 0xed, 0x3e, 0xce,
+	       0x44, 0x0e, 0x8c, 0x36, 0xcb, 0xb1, 0x5c, 0xaa, 0x4e, 0x4f,
+	       0x2f, 0xc2, 0xd6, 0x2b, 0xda, 0xe9, 0x08, 0x66, 0x63, 0x55,
+	       0x9f, 0xb1, 0xf6, 0x1e, 0x5f, 0xee, 0x10, 0xe1, 0x85, 0xa2,
+	       0x8b, 0x19, 0x34, 0x72, 0x2f, 0xc7, 0x2b, 0x02, 0x03, 0x01,
+	       0x00, 0x01, 0xa3, 0x81, 0x95, 0x30, 0x81, 0x92, 0x30, 0x09,
+	       0x06, 0x03, 0x55, 0x1d, 0x13, 0x04, 0x02, 0x30, 0x00, 0x30,
+	       0x0e, 0x06, 0x03, 0x55, 0x1d, 0x0f, 0x01, 0x01, 0xff, 0x04,
+	       0x04, 0x03, 0x02, 0x07, 0x80, 0x30, 0x35, 0x06, 0x08, 0x2b,
+	       0x06, 0x01, 0x05, 0x05, 0x07, 0x01, 0x01, 0x04, 0x29, 0x30,
+	       0x27, 0x30, 0x25, 0x06, 0x08, 0x2b, 0x06, 0x01, 0x05, 0x05,
+	       0x07, 0x30, 0x01, 0x86, 0x19, 0x68, 0x74, 0x74, 0x70, 0x3a,
+	       0x2f, 0x2f, 0x6f, 0x63, 0x73, 0x70, 0x2e, 0x74, 0x65, 0x73,
+	       0x74, 0x2e, 0x69, 0x70, 0x78, 0x65, 0x2e, 0x6f, 0x72, 0x67,
+	       0x30, 0x1d, 0x06, 0x03, 0x55, 0x1d, 0x0e, 0x04, 0x16, 0x04,
+	       0x14, 0x2b, 0xb1, 0xbf, 0x65, 0x70, 0xea, 0xef, 0x74, 0x48,
+	       0x52, 0x91, 0x7a, 0x9c, 0x09, 0xc5, 0x59, 0xa9, 0x80, 0x56,
+	       0xa4, 0x30, 0x1f, 0x06, 0x03, 0x55, 0x1d, 0x23, 0x04, 0x18,
+	       0x30, 0x16, 0x80, 0x14, 0x10, 0x11, 0xea, 0x44, 0x33, 0x15,
+	       0x06, 0xb8, 0x3d, 0x78, 0x75, 0x32, 0x9e, 0xbc, 0xc9, 0x45,
+	       0x16, 0xdf, 0xd9, 0xf5, 0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86,
+	       0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x0b, 0x05, 0x00, 0x03,
+	       0x81, 0x81, 0x00, 0xc3, 0x6a, 0x3f, 0xa0, 0x54, 0x0c, 0xb1,
+	       0x12, 0xd2, 0xb0, 0xe0, 0xb0, 0xdb, 0xea, 0xf5, 0x04, 0xd0,
+	       0xb8, 0xa3, 0x89, 0x9d, 0xdc, 0xd8, 0x9b, 0x33, 0x74, 0xf4,
+	       0xc1, 0x12, 0xd1, 0x93, 0x58, 0x6c, 0xd5, 0x88, 0x25, 0xc9,
+	       0xee, 0x8c, 0xc7, 0xa0, 0xde, 0xc0, 0xe7, 0xff, 0x69, 0x12,
+	       0xca, 0x04, 0x1e, 0x20, 0x65, 0x3d, 0xa4, 0x21, 0x3c, 0xe4,
+	       0x96, 0x04, 0x91, 0xf7, 0xc3, 0x85, 0xc6, 0x95, 0x68, 0xe3,
+	       0xb7, 0x4b, 0x1f, 0x6b, 0x98, 0x6f, 0x32, 0x70, 0x21, 0x28,
+	       0x6a, 0x44, 0xab, 0x83, 0x4a, 0xc7, 0x46, 0x7a, 0x5d, 0x5f,
+	       0xdd, 0x8a, 0x95, 0xd5, 0x6b, 0xcd, 0xcf, 0x37, 0xf2, 0xbd,
+	       0x81, 0x9d, 0x50, 0xe3, 0x86, 0x88, 0x2c, 0xa7, 0x51, 0xa2,
+	       0x2c, 0x94, 0x09, 0xf2, 0xdb, 0x0c, 0x4e, 0xc1, 0x8f, 0xf8,
+	       0x38, 0x95, 0x75, 0x98, 0xce, 0x48, 0x56, 0x64, 0xf7, 0x4e,
+	       0x8c ) );
+
+/* Response for leaf.test.ipxe.org: good */
+RESPONSE ( leaf_ocsp,
+	DATA ( 0x30, 0x82, 0x01, 0x5b, 0x0a, 0x01, 0x00, 0xa0, 0x82, 0x01,
+	       0x54, 0x30, 0x82, 0x01, 0x50, 0x06, 0x09, 0x2b, 0x06, 0x01,
+	       0x05, 0x05, 0x07, 0x30, 0x01, 0x01, 0x04, 0x82, 0x01, 0x41,
+	       0x30, 0x82, 0x01, 0x3d, 0x30, 0x81, 0xa7, 0xa1, 0x2d, 0x30,
+	       0x2b, 0x31, 0x29, 0x30, 0x27, 0x06, 0x03, 0x55, 0x04, 0x03,
+	       0x0c, 0x20, 0x69, 0x50, 0x58, 0x45, 0x20, 0x73, 0x65, 0x6c,
+	       0x66, 0x2d, 0x74, 0x65, 0x73, 0x74, 0x20, 0x76, 0x61, 0x6c,
+	       0x69, 0x64, 0x61, 0x74, 0x6f, 0x72, 0x20, 0x72, 0x6f, 0x6f,
+	       0x74, 0x20, 0x43, 0x41, 0x18, 0x0f, 0x32, 0x30, 0x32, 0x36,
+	       0x31, 0x30, 0x31, 0x39, 0x30, 0x34, 0x33, 0x33, 0x34, 0x37,
+	       0x5a, 0x30, 0x65, 0x30, 0x63, 0x30, 0x3b, 0x30, 0x09, 0x06,
+	       0x05, 0x2b, 0x0e, 0x03, 0x02, 0x1a, 0x05, 0x00, 0x04, 0x14,
+	       0xba, 0xca, 0x99, 0x7f, 0xfb, 0xbc, 0x00, 0x03, 0x30, 0x53,
+	       0x77, 0x6d, 0xde, 0xcd, 0x3b, 0x2f, 0x11, 0xb0, 0x4f, 0x86,
+	       0x04, 0x14, 0x10, 0x11, 0xea, 0x44, 0x33, 0x15, 0x06, 0xb8,
+	       0x3d, 0x78, 0x75, 0x32, 0x9e, 0xbc, 0xc9, 0x45, 0x16, 0xdf,
+	       0xd9, 0xf5, 0x02, 0x02, 0x10, 0x01, 0x80, 0x00, 0x18, 0x0f,
+	       0x32, 0x30, 0x32, 0x36, 0x31, 0x30, 0x31, 0x39, 0x30, 0x34,
+	       0x33, 0x33, 0x34, 0x37, 0x5a, 0xa0, 0x11, 0x18, 0x0f, 0x32,
+	       0x30, 0x34, 0x38, 0x30, 0x39, 0x31, 0x33, 0x30, 0x34, 0x33,
+	       0x33, 0x34, 0x37, 0x5a, 0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86,
+	       0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x0b, 0x05, 0x00, 0x03,
+	       0x81, 0x81, 0x00, 0xb3, 0xfe, 0xbc, 0x45, 0x27, 0xab, 0xeb,
+	       0x24, 0xad, 0x10, 0x37, 0x7f, 0x32, 0xc0, 0xda, 0x7e, 0xd9,
+	       0xf7, 0x2a, 0xba, 0x37, 0xa6, 0x3b, 0x98, 0x8f, 0x04, 0x9d,
+	       0xd8, 0xea, 0x99, 0xf9, 0x89, 0xe8, 0x01, 0x8f, 0x8b, 0x3a,
+	       0xba, 0xf7, 0xfe, 0xdc, 0x80, 0x9a, 0x03, 0x55, 0x42, 0x70,
+	       0xea, 0xf8, 0x4e, 0xe5, 0x4d, 0xf9, 0xaf, 0xa3, 0x7f, 0x1b,
+	       0xf1, 0x78, 0x64, 0xd8, 0xa8, 0x82, 0xd4, 0x9f, 0xda, 0x47,
+	       0xb7, 0xb6, 0x15, 0x08, 0xa1, 0xd2, 0xa4, 0x52, 0xe0, 0x37,
+	       0x5b, 0xaa, 0xe5, 0xad, 0xba, 0x0d, 0x02, 0x83, 0x3f, 0xe5,
+	       0xc6, 0x99, 0x84, 0xce, 0x58, 0x13, 0x8d, 0x56, 0xd7, 0x78,
+	       0xc3, 0x11, 0x6c, 0x1e, 0x5c, 0xd8, 0x7f, 0x1b, 0x51, 0x8c,
+	       0x9f, 0x51, 0x43, 0xcc, 0x05, 0xca, 0x96, 0x98, 0xb4, 0x51,
+	       0xe5, 0x33, 0x0b, 0x15, 0xae, 0x81, 0x9c, 0x26, 0x9f, 0x28,
+	       0x87 ) );
+
+/* Response for other.test.ipxe.org (serial 0x1002): good */
+RESPONSE ( other_ocsp,
+	DATA ( 0x30, 0x82, 0x01, 0x5b, 0x0a, 0x01, 0x00, 0xa0, 0x82, 0x01,
+	       0x54, 0x30, 0x82, 0x01, 0x50, 0x06, 0x09, 0x2b, 0x06, 0x01,
+	       0x05, 0x05, 0x07, 0x30, 0x01, 0x01, 0x04, 0x82, 0x01, 0x41,
+	       0x30, 0x82, 0x01, 0x3d, 0x30, 0x81, 0xa7, 0xa1, 0x2d, 0x30,
+	       0x2b, 0x31, 0x29, 0x30, 0x27, 0x06, 0x03, 0x55, 0x04, 0x03,
+	       0x0c, 0x20, 0x69, 0x50, 0x58, 0x45, 0x20, 0x73, 0x65, 0x6c,
+	       0x66, 0x2d, 0x74, 0x65, 0x73, 0x74, 0x20, 0x76, 0x61, 0x6c,
+	       0x69, 0x64, 0x61, 0x74, 0x6f, 0x72, 0x20, 0x72, 0x6f, 0x6f,
+	       0x74, 0x20, 0x43, 0x41, 0x18, 0x0f, 0x32, 0x30, 0x32, 0x36,
+	       0x31, 0x30, 0x31, 0x39, 0x30, 0x34, 0x33, 0x33, 0x34, 0x37,
+	       0x5a, 0x30, 0x65, 0x30, 0x63, 0x30, 0x3b, 0x30, 0x09, 0x06,
+	       0x05, 0x2b, 0x0e, 0x03, 0x02, 0x1a, 0x05, 0x00, 0x04, 0x14,
+	       0xba, 0xca, 0x99, 0x7f, 0xfb, 0xbc, 0x00, 0x03, 0x30, 0x53,
+	       0x77, 0x6d, 0xde, 0xcd, 0x3b, 0x2f, 0x11, 0xb0, 0x4f, 0x86,
+	       0x04, 0x14, 0x10, 0x11, 0xea, 0x44, 0x33, 0x15, 0x06, 0xb8,
+	       0x3d, 0x78, 0x75, 0x32, 0x9e, 0xbc, 0xc9, 0x45, 0x16, 0xdf,
+	       0xd9, 0xf5, 0x02, 0x02, 0x10, 0x02, 0x80, 0x00, 0x18, 0x0f,
+	       0x32, 0x30, 0x32, 0x36, 0x31, 0x30, 0x31, 0x39, 0x30, 0x34,
+	       0x33, 0x33, 0x34, 0x37, 0x5a, 0xa0, 0x11, 0x18, 0x0f, 0x32,
+	       0x30, 0x34, 0x38, 0x30, 0x39, 0x31, 0x33, 0x30, 0x34, 0x33,
+	       0x33, 0x34, 0x37, 0x5a, 0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86,
+	       0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x0b, 0x05, 0x00, 0x03,
+	       0x81, 0x81, 0x00, 0x75, 0x7a, 0xf3, 0x55, 0x7a, 0x60, 0x7b,
+	       0x0b, 0x7b, 0x8d, 0xc4, 0x6a, 0x8b, 0xd1, 0x4a, 0xfe, 0x15,
+	       0x27, 0x28, 0x37, 0x77, 0x74, 0xea, 0xb3, 0xc1, 0xc4, 0x01,
+	       0xae, 0x39, 0x91, 0xb8, 0x44, 0x5b, 0x52, 0x6e, 0x8c, 0xb4,
+	       0x49, 0x8e, 0xce, 0x50, 0x65, 0x1d, 0xef, 0x5d, 0x28, 0xc4,
+	       0x38, 0x9b, 0x3b, 0x74, 0xe3, 0x5d, 0xd3, 0xaf, 0x07, 0xae,
+	       0xf2, 0xc8, 0x9c, 0x48, 0xc0, 0x98, 0x40, 0xf7, 0xbe, 0x7c,
+	       0xc9, 0x2f, 0x50, 0xfd, 0x5f, 0x17, 0x54, 0xa2, 0xe6, 0xe7,
+	       0x25, 0x08, 0x20, 0xe9, 0x9c, 0x25, 0xe6, 0xea, 0xe0, 0x9c,
+	       0x69, 0x53, 0x51, 0x7b, 0xde, 0x82, 0x25, 0x70, 0xad, 0xda,
+	       0xad, 0x9a, 0xb5, 0x0e, 0x1f, 0xf0, 0xcd, 0x1c, 0x31, 0x23,
+	       0xa9, 0x5b, 0xb7, 0xf1, 0x7a, 0x36, 0x2a, 0x4a, 0x2d, 0x24,
+	       0x55, 0xa3, 0x62, 0x06, 0x7a, 0xe4, 0x65, 0x0a, 0xbb, 0xc0,
+	       0x2e ) );
+
+/* Truncated response for leaf.test.ipxe.org */
+TRUNCATED ( truncated_ocsp, leaf_ocsp, 64 );
+
+/** Response to be returned by test OCSP responder, or NULL to fail */
+static struct validator_test_response *validator_test_live;
+
+/** Number of requests received by test OCSP responder */
+static unsigned int validator_test_fetches;
+
+/** A test OCSP responder connection */
+struct validator_test_responder {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Response delivery process */
+	struct process process;
+	/** Response, or NULL to fail */
+	struct validator_test_response *response;
+};
+
+/**
+ * Close test OCSP responder connection
+ *
+ * @v responder		Test OCSP responder connection
+ * @v rc		Reason for close
+ */
+static void validator_test_responder_close ( struct validator_test_responder
+					     *responder, int rc ) {
+
+	/* Stop process and shut down interface */
+	process_del ( &responder->process );
+	intf_shutdown ( &responder->xfer, rc );
+}
+
+/**
+ * Deliver test OCSP responder response
+ *
+ * @v responder		Test OCSP responder connection
+ */
+static void validator_test_responder_step ( struct validator_test_responder
+					    *responder ) {
+	struct validator_test_response *response = responder->response;
+	int rc;
+
+	/* Fail if no response is available */
+	if ( ! response ) {
+		rc = -ENOENT;
+		goto done;
+	}
+
+	/* Deliver response */
+	rc = xfer_deliver_raw ( &responder->xfer, response->data,
+				response->len );
+
+ done:
+	validator_test_responder_close ( responder, rc );
+}
+
+/** Test OCSP responder interface operations */
+static struct interface_operation validator_test_responder_operations[] = {
+	INTF_OP ( intf_close, struct validator_test_responder *,
+		  validator_test_responder_close ),
+};
+
+/** Test OCSP responder interface descriptor */
+static struct interface_descriptor validator_test_responder_desc =
+	INTF_DESC ( struct validator_test_responder, xfer,
+		    validator_test_responder_operations );
+
+/** Test OCSP responder process descriptor */
+static struct process_descriptor validator_test_responder_process_desc =
+	PROC_DESC_ONCE ( struct validator_test_responder, process,
+			 validator_test_responder_step );
+
+/**
+ * Open connection to test OCSP responder
+ *
+ * @v xfer		Data transfer interface
+ * @v uri		URI
+ * @ret rc		Return status code
+ *
+ * URIs for any host other than the test OCSP responder are passed
+ * through to the normal HTTP URI opener.
+ */
+static int validator_test_responder_open ( struct interface *xfer,
+					   struct uri *uri ) {
+	struct validator_test_responder *responder;
+	struct uri_opener *opener;
+
+	/* Pass through URIs for any other host */
+	if ( ( ! uri->host ) ||
+	     ( strcmp ( uri->host, VALIDATOR_TEST_OCSP_HOST ) != 0 ) ) {
+		for_each_table_entry ( opener, URI_OPENERS ) {
+			if ( ( opener->open != validator_test_responder_open )&&
+			     ( strcmp ( opener->scheme, "http" ) == 0 ) ) {
+				return opener->open ( xfer, uri );
+			}
+		}
+		return -ENOTSUP;
+	}
+
+	/* Allocate and initialise connection */
+	responder = zalloc ( sizeof ( *responder ) );
+	if ( ! responder )
+		return -ENOMEM;
+	ref_init ( &responder->refcnt, NULL );
+	intf_init ( &responder->xfer, &validator_test_responder_desc,
+		    &responder->refcnt );
+	process_init ( &responder->process,
+		       &validator_test_responder_process_desc,
+		       &responder->refcnt );
+	responder->response = validator_test_live;
+	validator_test_fetches++;
+
+	/* Attach parent interface, mortalise self, and return */
+	intf_plug_plug ( &responder->xfer, xfer );
+	ref_put ( &responder->refcnt );
+	return 0;
+}
+
+/** Test OCSP responder URI opener
+ *
+ * This takes precedence over the normal HTTP URI opener.
+ */
+struct uri_opener validator_test_uri_opener
+	__table_entry ( URI_OPENERS, 00 ) = {
+	.scheme	= "http",
+	.open	= validator_test_responder_open,
+};
+
+/** A validator test job */
+struct validator_test_job {
+	/** Job control interface */
+	struct interface job;
+	/** Validation has completed */
+	int done;
+	/** Validation status code */
+	int rc;
+};
+
+/**
+ * Handle validator test job completion
+ *
+ * @v job		Validator test job
+ * @v rc		Reason for close
+ */
+static void validator_test_job_close ( struct validator_test_job *job,
+				       int rc ) {
+
+	intf_restart ( &job->job, rc );
+	job->rc = rc;
+	job->done = 1;
+}
+
+/** Validator test job interface operations */
+static struct interface_operation validator_test_job_operations[] = {
+	INTF_OP ( intf_close, struct validator_test_job *,
+		  validator_test_job_close ),
+};
+
+/** Validator test job interface descriptor */
+static struct interface_descriptor validator_test_job_desc =
+	INTF_DESC ( struct validator_test_job, job,
+		    validator_test_job_operations );
+
+/**
+ * Report certificate parsing test result
+ *
+ * @v crt		Test certificate
+ */
+#define validator_certificate_ok( crt ) do {				\
+	ok ( x509_certificate ( (crt)->data, (crt)->len,		\
+				&(crt)->cert ) == 0 );			\
+	} while ( 0 )
+
+/**
+ * Report certificate validation test result
+ *
+ * @v stapled		Stapled OCSP response, or NULL
+ * @v live		Live OCSP response, or NULL to fail
+ * @v fetches		Expected number of live OCSP requests
+ * @v valid		Certificate is expected to be validated
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void validator_okx ( struct validator_test_response *stapled,
+			    struct validator_test_response *live,
+			    unsigned int fetches, int valid,
+			    const char *file, unsigned int line ) {
+	struct x509_certificate *leaf = leaf_crt.cert;
+	struct x509_certificate *root = root_crt.cert;
+	struct validator_test_job job;
+	struct x509_chain *chain;
+	unsigned int i;
+
+	/* Invalidate end-entity certificate and any OCSP status */
+	x509_invalidate ( leaf );
+	leaf->extensions.auth_info.ocsp.good = 0;
+
+	/* Force-validate root certificate */
+	root->valid = 1;
+	root->path_remaining = ( root->extensions.basic.path_len + 1 );
+
+	/* Construct chain */
+	chain = x509_alloc_chain();
+	okx ( chain != NULL, file, line );
+	if ( ! chain )
+		return;
+	okx ( x509_append ( chain, leaf ) == 0, file, line );
+	okx ( x509_append ( chain, root ) == 0, file, line );
+
+	/* Run validator */
+	validator_test_live = live;
+	validator_test_fetches = 0;
+	memset ( &job, 0, sizeof ( job ) );
+	intf_init ( &job.job, &validator_test_job_desc, NULL );
+	okx ( create_validator ( &job.job, chain,
+				 ( stapled ? stapled->data : NULL ),
+				 ( stapled ? stapled->len : 0 ) ) == 0,
+	      file, line );
+	for ( i = 0 ; ( ( ! job.done ) && ( i < 64 ) ) ; i++ )
+		step();
+	okx ( job.done, file, line );
+	validator_test_live = NULL;
+
+	/* Check result */
+	okx ( validator_test_fetches == fetches, file, line );
+	if ( valid ) {
+		okx ( job.rc == 0, file, line );
+		okx ( leaf->valid, file, line );
+		okx ( leaf->extensions.auth_info.ocsp.good, file, line );
+	} else {
+		okx ( job.rc != 0, file, line );
+		okx ( ! leaf->valid, file, line );
+	}
+
+	/* Drop chain reference */
+	x509_chain_put ( chain );
+}
+#define validator_ok( stapled, live, fetches, valid )			\
+	validator_okx ( stapled, live, fetches, valid, __FILE__, __LINE__ )
+
+/**
+ * Perform certificate validator self-tests
+ *
+ */
+static void validator_test_exec ( void ) {
+
+	/* Parse certificates */
+	validator_certificate_ok ( &root_crt );
+	validator_certificate_ok ( &leaf_crt );
+
+	/* Valid stapled response: no live OCSP check required */
+	validator_ok ( &leaf_ocsp, &leaf_ocsp, 0, 1 );
+
+	/* No stapled response: live OCSP check */
+	validator_ok ( NULL, &leaf_ocsp, 1, 1 );
+
+	/* Stapled response for wrong certificate: fall back to live check */
+	validator_ok ( &other_ocsp, &leaf_ocsp, 1, 1 );
+
+	/* Malformed stapled response: fall back to live check */
+	validator_ok ( &truncated_ocsp, &leaf_ocsp, 1, 1 );
+
+	/* Unusable stapled and live responses */
+	validator_ok ( &other_ocsp, &other_ocsp, 1, 0 );
+	validator_ok ( &truncated_ocsp, NULL, 1, 0 );
+	validator_ok ( NULL, NULL, 1, 0 );
+
+	/* Drop certificate references */
+	x509_put ( leaf_crt.cert );
+	x509_put ( root_crt.cert );
+}
+
+/** Certificate validator self-test */
+struct self_test validator_test __self_test = {
+	.name = "validator",
+	.exec = validator_test_exec,
+};
+
+/* Drag in algorithms required for tests */
+REQUIRING_SYMBOL ( validator_test );
+REQUIRE_OBJECT ( rsa );
+REQUIRE_OBJECT ( sha1 );
+REQUIRE_OBJECT ( sha256 );
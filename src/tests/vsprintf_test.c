@@ -89,6 +89,10 @@ static void vsprintf_test_exec ( void ) {
 	snprintf_ok ( 16, "-072", "%04d", -72 );
 	snprintf_ok ( 16, "4", "%zd", sizeof ( uint32_t ) );
 	snprintf_ok ( 16, "123456789", "%d", 123456789 );
+	snprintf_ok ( 16, "4294967295", "%u", 0xffffffffU );
+	snprintf_ok ( 16, " 42 0042", "%3u %04u", 42U, 42U );
+	snprintf_ok ( 16, "3000000000", "%lu", 3000000000UL );
+	snprintf_ok ( 32, "18446744073709551615", "%llu", ~0ULL );
 
 	/* Realistic combinations */
 	snprintf_ok ( 64, "DBG 0x1234 thingy at 0x0003f0c0+0x5c\n",
@@ -33,16 +33,25 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #undef NDEBUG
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <ipxe/x509.h>
 #include <ipxe/asn1.h>
 #include <ipxe/sha256.h>
+#include <ipxe/certstore.h>
+#include <ipxe/profile.h>
 #include <ipxe/test.h>
 
 /** Fingerprint algorithm used for X.509 test certificates */
 #define x509_test_algorithm sha256_algorithm
 
+/** Number of additional certificates used to populate the certificate store */
+#define X509_TEST_STORE_COUNT 256
+
+/** Number of sample iterations for profiling */
+#define PROFILE_COUNT 16
+
 /** An X.509 test certificate */
 struct x509_test_certificate {
 	/** Data */
@@ -972,6 +981,199 @@ static void x509_validate_chain_fail_okx ( struct x509_test_chain *chn,
 	x509_validate_chain_fail_okx ( chn, time, store, root,		\
 				       __FILE__, __LINE__ )
 
+/**
+ * Clear certificate chain validation flags
+ *
+ * @v chain		X.509 certificate chain
+ *
+ * This leaves any cached validation results intact, simulating the
+ * effect of certificates being discarded from the certificate store
+ * and subsequently reparsed.
+ */
+static void x509_test_unvalidate ( struct x509_chain *chain ) {
+	struct x509_link *link;
+
+	list_for_each_entry ( link, &chain->links, list ) {
+		link->cert->valid = 0;
+		link->cert->path_remaining = 0;
+	}
+}
+
+/**
+ * Report cached certificate chain validation test result
+ *
+ * @v chn		Test certificate chain
+ * @v time		Test certificate validation time
+ * @v expired		Test certificate expiry time
+ * @v store		Test certificate store
+ * @v root		Test root certificate list
+ * @v other		Other test root certificate list
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void x509_validate_cache_okx ( struct x509_test_chain *chn,
+				      time_t time, time_t expired,
+				      struct x509_chain *store,
+				      struct x509_root *root,
+				      struct x509_root *other,
+				      const char *file, unsigned int line ) {
+	unsigned int hits;
+
+	/* Validate chain, populating cache */
+	x509_invalidate_chain ( chn->chain );
+	hits = x509_cache_stats.hits;
+	okx ( x509_validate_chain ( chn->chain, time, store, root ) == 0,
+	      file, line );
+	okx ( x509_cache_stats.hits == hits, file, line );
+
+	/* Revalidate chain using cache */
+	x509_test_unvalidate ( chn->chain );
+	okx ( x509_validate_chain ( chn->chain, time, store, root ) == 0,
+	      file, line );
+	okx ( x509_cache_stats.hits == ( hits + 1 ), file, line );
+	okx ( x509_first ( chn->chain )->valid, file, line );
+
+	/* Check that cache is not used for a different root list */
+	x509_test_unvalidate ( chn->chain );
+	okx ( x509_validate_chain ( chn->chain, time, store, other ) != 0,
+	      file, line );
+	okx ( x509_cache_stats.hits == ( hits + 1 ), file, line );
+
+	/* Check that cache is not used after expiry */
+	x509_test_unvalidate ( chn->chain );
+	okx ( x509_validate_chain ( chn->chain, expired, store, root ) != 0,
+	      file, line );
+	okx ( x509_cache_stats.hits == ( hits + 1 ), file, line );
+	x509_test_unvalidate ( chn->chain );
+	okx ( x509_validate_chain ( chn->chain, time, store, root ) == 0,
+	      file, line );
+	okx ( x509_cache_stats.hits == ( hits + 1 ), file, line );
+}
+#define x509_validate_cache_ok( chn, time, expired, store, root, other ) \
+	x509_validate_cache_okx ( chn, time, expired, store, root, other, \
+				  __FILE__, __LINE__ )
+
+/**
+ * Report populated certificate store validation test result
+ *
+ * @v crt		Test certificate to be used as a template
+ * @v end		End-entity test certificate
+ * @v time		Test certificate validation time
+ * @v root		Test root certificate list
+ * @v file		Test code file
+ * @v line		Test code line
+ *
+ * The certificate store is populated with many additional
+ * certificates (constructed by varying the subject and signature of
+ * the template certificate).  The time taken to find each stored
+ * certificate by raw data and by subject is measured, as is the time
+ * taken to construct and validate a certificate chain from the
+ * certificate store.
+ */
+static void x509_store_okx ( struct x509_test_certificate *crt,
+			     struct x509_test_certificate *end, time_t time,
+			     struct x509_root *root, const char *file,
+			     unsigned int line ) {
+	static struct x509_certificate *certs[X509_TEST_STORE_COUNT];
+	struct profiler raw_profiler;
+	struct profiler subject_profiler;
+	struct profiler profiler;
+	struct x509_certificate *found;
+	struct x509_certificate *temp;
+	struct x509_chain *chain;
+	uint8_t *data;
+	size_t offset;
+	unsigned int i;
+
+	/* Locate final byte of template certificate's subject */
+	offset = ( crt->cert->subject.raw.data - crt->cert->raw.data +
+		   crt->cert->subject.raw.len - 1 );
+	assert ( offset < crt->len );
+
+	/* Populate certificate store */
+	data = malloc ( crt->len );
+	okx ( data != NULL, file, line );
+	if ( ! data )
+		return;
+	memcpy ( data, crt->data, crt->len );
+	for ( i = 0 ; i < X509_TEST_STORE_COUNT ; i++ ) {
+		/* Vary the subject, and the final bytes of the
+		 * signature (which are used to index the raw data).
+		 * The signature is never checked.
+		 */
+		data[ offset - 1 ] = ( 'A' + ( i % 26 ) );
+		data[offset] = ( 'a' + ( i / 26 ) );
+		data[ crt->len - 2 ] = ( i >> 8 );
+		data[ crt->len - 1 ] = ( i & 0xff );
+		okx ( x509_certificate ( data, crt->len, &certs[i] ) == 0,
+		      file, line );
+	}
+	free ( data );
+
+	/* Find each stored certificate by raw data and by subject */
+	memset ( &raw_profiler, 0, sizeof ( raw_profiler ) );
+	memset ( &subject_profiler, 0, sizeof ( subject_profiler ) );
+	for ( i = 0 ; i < X509_TEST_STORE_COUNT ; i++ ) {
+		if ( ! certs[i] )
+			continue;
+		profile_start ( &raw_profiler );
+		found = certstore_find ( &certs[i]->raw );
+		profile_stop ( &raw_profiler );
+		okx ( found == certs[i], file, line );
+		profile_start ( &subject_profiler );
+		found = certstore_find_subject ( &certs[i]->subject.raw );
+		profile_stop ( &subject_profiler );
+		okx ( found == certs[i], file, line );
+	}
+	DBG ( "X509 found certificate among %d by raw data in %ld +/- %ld "
+	      "ticks\n", X509_TEST_STORE_COUNT, profile_mean ( &raw_profiler ),
+	      profile_stddev ( &raw_profiler ) );
+	DBG ( "X509 found certificate among %d by subject in %ld +/- %ld "
+	      "ticks\n", X509_TEST_STORE_COUNT,
+	      profile_mean ( &subject_profiler ),
+	      profile_stddev ( &subject_profiler ) );
+
+	/* Construct and validate chains using the certificate store.
+	 * Invalidate each chain after use, so that each iteration
+	 * performs the full validation rather than reusing the
+	 * previous result.
+	 */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		okx ( x509_certificate ( end->data, end->len, &temp ) == 0,
+		      file, line );
+		chain = x509_alloc_chain();
+		okx ( chain != NULL, file, line );
+		if ( chain ) {
+			okx ( x509_append ( chain, temp ) == 0, file, line );
+			okx ( x509_validate_chain ( chain, time, NULL,
+						    root ) == 0, file, line );
+			okx ( x509_last ( chain ) != temp, file, line );
+		}
+		profile_stop ( &profiler );
+		if ( chain ) {
+			x509_invalidate_chain ( chain );
+			x509_chain_put ( chain );
+		}
+		x509_put ( temp );
+	}
+	DBG ( "X509 validated chain from %d stored certificates in %ld +/- "
+	      "%ld ticks\n", X509_TEST_STORE_COUNT, profile_mean ( &profiler ),
+	      profile_stddev ( &profiler ) );
+
+	/* Remove additional certificates from certificate store */
+	for ( i = 0 ; i < X509_TEST_STORE_COUNT ; i++ ) {
+		if ( ! certs[i] )
+			continue;
+		certstore_del ( certs[i] );
+		x509_put ( certs[i] );
+		certs[i] = NULL;
+	}
+}
+#define x509_store_ok( crt, end, time, root ) \
+	x509_store_okx ( crt, end, time, root, __FILE__, __LINE__ )
+
 /**
  * Perform X.509 self-tests
  *
@@ -1081,6 +1283,13 @@ static void x509_test_exec ( void ) {
 	x509_validate_chain_fail_ok ( &useless_chain, test_ca_expired,
 				      &empty_store, &test_root );
 
+	/* Check validated certificate cache */
+	x509_validate_cache_ok ( &server_chain, test_time, test_expired,
+				 &empty_store, &test_root, &dummy_root );
+
+	/* Check chain construction from a populated certificate store */
+	x509_store_ok ( &useless_crt, &server_crt, test_time, &test_root );
+
 	/* Sanity check */
 	assert ( list_empty ( &empty_store.links ) );
 
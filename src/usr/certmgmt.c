@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdio.h>
+#include <ipxe/x509.h>
+#include <ipxe/certstore.h>
+#include <usr/certmgmt.h>
+
+/** @file
+ *
+ * Certificate management
+ *
+ */
+
+/**
+ * Print certificate store and validation cache status
+ *
+ */
+void certstat ( void ) {
+	struct x509_certificate *cert;
+
+	/* Print stored certificates */
+	list_for_each_entry ( cert, &certstore.links, store.list ) {
+		printf ( "%s%s\n", x509_name ( cert ),
+			 ( cert->valid ? " [VALIDATED]" : "" ) );
+	}
+
+	/* Print validation cache statistics */
+	printf ( "Validation cache: %u entries, %u hits, %u misses\n",
+		 x509_cache_stats.entries, x509_cache_stats.hits,
+		 x509_cache_stats.misses );
+}
@@ -115,6 +115,14 @@ void ifstat ( struct net_device *netdev ) {
 		printf ( "  [Link status: %s]\n",
 			 strerror ( netdev->link_rc ) );
 	}
+	if ( netdev->offloads ) {
+		printf ( "  [Offload:%s%s, TXCSUM:%u RXCSUM:%u]\n",
+			 ( ( netdev->offloads & NETDEV_OFFLOAD_TX_CSUM ) ?
+			   " tx-csum" : "" ),
+			 ( ( netdev->offloads & NETDEV_OFFLOAD_RX_CSUM ) ?
+			   " rx-csum" : "" ),
+			 netdev->tx_stats.csum, netdev->rx_stats.csum );
+	}
 	ifstat_errors ( &netdev->tx_stats, "TXE" );
 	ifstat_errors ( &netdev->rx_stats, "RXE" );
 }
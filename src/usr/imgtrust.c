@@ -79,7 +79,8 @@ int imgverify ( struct image *image, struct image *signature,
 
 	/* Complete all certificate chains */
 	list_for_each_entry ( info, &sig->info, list ) {
-		if ( ( rc = create_validator ( &monojob, info->chain ) ) != 0 )
+		if ( ( rc = create_validator ( &monojob, info->chain,
+					       NULL, 0 ) ) != 0 )
 			goto err_create_validator;
 		if ( ( rc = monojob_wait ( NULL, 0 ) ) != 0 )
 			goto err_validator_wait;
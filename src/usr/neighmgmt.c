@@ -52,9 +52,14 @@ void nstat ( void ) {
 			 ll_protocol->name,
 			 ( neighbour_has_ll_dest ( neighbour ) ?
 			   ll_protocol->ntoa ( neighbour->ll_dest ) :
-			   "(incomplete)" ) );
+			   ( neighbour_has_failed ( neighbour ) ?
+			     "(failed)" : "(incomplete)" ) ) );
 		if ( neighbour->discovery )
 			printf ( " (%s)", neighbour->discovery->name );
 		printf ( "\n" );
 	}
+	printf ( "[Lookups:%u Hits:%u Discoveries:%u Failures:%u Drops:%u]\n",
+		 neighbour_stats.lookups, neighbour_stats.hits,
+		 neighbour_stats.discoveries, neighbour_stats.failures,
+		 neighbour_stats.drops );
 }
@@ -47,6 +47,8 @@ struct nslookup {
 
 	/** Setting name */
 	char *setting_name;
+	/** Required address family, or zero if any is acceptable */
+	sa_family_t family;
 };
 
 /**
@@ -98,6 +100,14 @@ static void nslookup_resolv_done ( struct nslookup *nslookup,
 		goto err;
 	}
 
+	/* Reject addresses of the wrong family (e.g. a numeric IPv6
+	 * address for an IPv4 setting).
+	 */
+	if ( nslookup->family && ( sa->sa_family != nslookup->family ) ) {
+		rc = -EAFNOSUPPORT;
+		goto err;
+	}
+
 	/* Parse specified setting name */
 	if ( ( rc = parse_setting_name ( nslookup->setting_name,
 					 autovivify_child_settings, &settings,
@@ -138,6 +148,31 @@ static struct interface_descriptor nslookup_job_desc =
 	INTF_DESC_PASSTHRU ( struct nslookup, job,
 			     nslookup_job_operations, resolver );
 
+/**
+ * Determine address family required by setting
+ *
+ * @v setting_name	Setting name
+ * @ret family		Address family, or zero if any is acceptable
+ */
+static sa_family_t nslookup_family ( const char *setting_name ) {
+	char tmp[ strlen ( setting_name ) + 1 /* NUL */ ];
+	struct settings *settings;
+	struct setting setting;
+
+	/* Parse copy of specified setting name */
+	strcpy ( tmp, setting_name );
+	if ( parse_setting_name ( tmp, autovivify_child_settings,
+				  &settings, &setting ) != 0 )
+		return 0;
+
+	/* Determine address family from setting type, if any */
+	if ( setting.type == &setting_type_ipv4 )
+		return AF_INET;
+	if ( setting.type == &setting_type_ipv6 )
+		return AF_INET6;
+	return 0;
+}
+
 /**
  * Initiate standalone name resolution
  *
@@ -165,9 +200,13 @@ static int resolv_setting ( struct interface *job, const char *name,
 	setting_name_copy = ( ( void * ) ( nslookup + 1 ) );
 	strcpy ( setting_name_copy, setting_name );
 	nslookup->setting_name = setting_name_copy;
+	nslookup->family = nslookup_family ( setting_name );
 
-	/* Start name resolution */
+	/* Start name resolution, restricted to the address family
+	 * required by the setting (if any).
+	 */
 	memset ( &sa, 0, sizeof ( sa ) );
+	sa.sa_family = nslookup->family;
 	if ( ( rc = resolv ( &nslookup->resolver, name, &sa ) ) != 0 )
 		goto err_resolv;
 
@@ -23,8 +23,12 @@
 
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
+#include <stdlib.h>
 #include <stdio.h>
+#include <errno.h>
+#include <ipxe/vsprintf.h>
 #include <ipxe/profile.h>
+#include <ipxe/params.h>
 #include <usr/profstat.h>
 
 /** @file
@@ -44,5 +48,104 @@ void profstat ( void ) {
 		printf ( "%s: %ld +/- %ld ticks (%d samples)\n",
 			 profiler->name, profile_mean ( profiler ),
 			 profile_stddev ( profiler ), profiler->count );
+		if ( ! profiler->count )
+			continue;
+		printf ( "  [min:%lu p50:%lu p99:%lu max:%lu]\n",
+			 profiler->min, profile_percentile ( profiler, 50 ),
+			 profile_percentile ( profiler, 99 ), profiler->max );
 	}
 }
+
+/**
+ * Reset profiling statistics
+ *
+ */
+void profstat_reset ( void ) {
+	struct profiler *profiler;
+
+	for_each_table_entry ( profiler, PROFILERS )
+		profile_reset ( profiler );
+}
+
+/**
+ * Construct profiling statistics export record
+ *
+ * @v profiler		Profiler
+ * @v buf		Buffer to contain record
+ * @v len		Length of buffer
+ * @ret len		Length of record (excluding terminating NUL)
+ *
+ * The record is a space-separated list of "key=value" fields,
+ * terminated by a comma-separated list of histogram bucket counts
+ * (omitting any trailing empty buckets).
+ */
+static size_t profstat_record ( struct profiler *profiler, char *buf,
+				size_t len ) {
+	ssize_t remaining = len;
+	size_t frag_len;
+	unsigned int used;
+	unsigned int i;
+
+	/* Construct summary statistics */
+	frag_len = ssnprintf ( buf, remaining, "count=%u mean=%lu stddev=%lu "
+			       "min=%lu max=%lu p50=%lu p99=%lu hist=",
+			       profiler->count, profile_mean ( profiler ),
+			       profile_stddev ( profiler ), profiler->min,
+			       profiler->max,
+			       profile_percentile ( profiler, 50 ),
+			       profile_percentile ( profiler, 99 ) );
+	buf += frag_len;
+	len = frag_len;
+	remaining -= frag_len;
+
+	/* Construct histogram */
+	for ( used = PROFILE_BUCKETS ; used > 1 ; used-- ) {
+		if ( profiler->buckets[ used - 1 ] )
+			break;
+	}
+	for ( i = 0 ; i < used ; i++ ) {
+		frag_len = ssnprintf ( buf, remaining, "%s%u",
+				       ( i ? "," : "" ),
+				       profiler->buckets[i] );
+		buf += frag_len;
+		len += frag_len;
+		remaining -= frag_len;
+	}
+
+	return len;
+}
+
+/**
+ * Export profiling statistics as form parameters
+ *
+ * @v params		Parameter list
+ * @ret rc		Return status code
+ *
+ * One parameter is added for each profiler, with the profiler name
+ * as the key and an export record as the value.  The parameter list
+ * may then be submitted to a server via an HTTP POST request.
+ */
+int profstat_export ( struct parameters *params ) {
+	struct profiler *profiler;
+	struct parameter *param;
+	size_t len;
+	char *record;
+
+	for_each_table_entry ( profiler, PROFILERS ) {
+
+		/* Construct export record */
+		len = profstat_record ( profiler, NULL, 0 );
+		record = malloc ( len + 1 /* NUL */ );
+		if ( ! record )
+			return -ENOMEM;
+		profstat_record ( profiler, record, ( len + 1 /* NUL */ ) );
+
+		/* Add parameter */
+		param = add_parameter ( params, profiler->name, record );
+		free ( record );
+		if ( ! param )
+			return -ENOMEM;
+	}
+
+	return 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdio.h>
+#include <unistd.h>
+#include <ipxe/profile.h>
+#include <ipxe/trace.h>
+#include <usr/tracedump.h>
+
+/** @file
+ *
+ * Event tracing
+ *
+ * Trace events are dumped one per line in the form
+ *
+ *   TRACE <timestamp> <phase> <name> <object> <data>
+ *
+ * where the phase is 'b' or 'e' for the beginning or end of an
+ * operation, or 'i' for an instantaneous event.  This output may be
+ * captured (e.g. via a serial console) and converted into Chrome
+ * trace format using util/trace2json.pl.
+ */
+
+/** Time over which to calibrate profiling timestamps (in ms) */
+#define TRACEDUMP_CALIBRATE_MS 10
+
+/** A trace event type */
+struct trace_type {
+	/** Name */
+	const char *name;
+	/** Phase */
+	char phase;
+};
+
+/** Trace event types */
+static struct trace_type trace_types[TRACE_NUM_TYPES] = {
+	[TRACE_NETDEV_TX] = { "netdev.tx", 'i' },
+	[TRACE_NETDEV_RX] = { "netdev.rx", 'i' },
+	[TRACE_TCP_STATE] = { "tcp.state", 'i' },
+	[TRACE_TCP_RETRANSMIT] = { "tcp.retransmit", 'i' },
+	[TRACE_TLS_START] = { "tls", 'b' },
+	[TRACE_TLS_HANDSHAKE] = { "tls.handshake", 'i' },
+	[TRACE_TLS_READY] = { "tls", 'e' },
+	[TRACE_HTTP_REQUEST] = { "http", 'b' },
+	[TRACE_HTTP_RESPONSE] = { "http.response", 'i' },
+	[TRACE_HTTP_CLOSE] = { "http", 'e' },
+	[TRACE_DNS_START] = { "dns", 'b' },
+	[TRACE_DNS_DONE] = { "dns", 'e' },
+	[TRACE_IMAGE_START] = { "image", 'b' },
+	[TRACE_IMAGE_DONE] = { "image", 'e' },
+};
+
+/**
+ * Dump trace events
+ *
+ */
+void tracedump ( void ) {
+	struct trace_event *event;
+	struct trace_type *type;
+	unsigned long started;
+	unsigned long elapsed;
+	unsigned int count;
+	unsigned int i;
+
+	/* Calibrate profiling timestamps */
+	started = profile_timestamp();
+	mdelay ( TRACEDUMP_CALIBRATE_MS );
+	elapsed = ( profile_timestamp() - started );
+	printf ( "TRACE rate %ld per ms\n",
+		 ( elapsed / TRACEDUMP_CALIBRATE_MS ) );
+
+	/* Dump events in order, starting with the oldest */
+	count = trace_count;
+	if ( count > TRACE_EVENTS )
+		count = TRACE_EVENTS;
+	for ( i = ( trace_count - count ) ; i != trace_count ; i++ ) {
+		event = &trace_events[ i & ( TRACE_EVENTS - 1 ) ];
+		type = &trace_types[event->type];
+		printf ( "TRACE %llu %c %s %p %ld\n",
+			 ( ( unsigned long long ) event->timestamp ),
+			 type->phase, type->name, event->object,
+			 ( ( long ) event->data ) );
+	}
+}
+
+/**
+ * Discard all trace events
+ *
+ */
+void tracedump_reset ( void ) {
+
+	trace_count = 0;
+}
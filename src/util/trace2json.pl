@@ -0,0 +1,55 @@
+#!/usr/bin/env perl
+#
+# Convert iPXE "tracedump" output into Chrome trace event format
+#
+# Usage: trace2json.pl [capture.log ...] > trace.json
+#
+# The input may contain arbitrary other console output; only lines
+# beginning with "TRACE" are used.  The resulting JSON file may be
+# loaded into chrome://tracing or https://ui.perfetto.dev
+#
+
+use strict;
+use warnings;
+
+my $rate;
+my $base;
+my @events;
+
+while ( my $line = <> ) {
+  $line =~ s/\r?\n$//;
+
+  # Parse timestamp calibration
+  if ( $line =~ /^TRACE rate (\d+) per ms$/ ) {
+    $rate = $1;
+    next;
+  }
+
+  # Parse event
+  next unless $line =~ /^TRACE (\d+) ([bei]) (\S+) (\S+) (-?\d+)$/;
+  my ( $timestamp, $phase, $name, $object, $data ) = ( $1, $2, $3, $4, $5 );
+  die "No timestamp calibration found before first event\n"
+      unless $rate;
+  $base = $timestamp unless defined $base;
+
+  # Convert timestamp to microseconds
+  my $ts = ( ( $timestamp - $base ) * 1000 / $rate );
+
+  # Construct event
+  ( my $category = $name ) =~ s/\..*$//;
+  my $event = sprintf ( "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%s\","
+			."\"ts\":%.3f,\"pid\":1,\"tid\":1,",
+			$name, $category, $phase, $ts );
+  if ( $phase eq "i" ) {
+    $event .= "\"s\":\"t\",";
+  } else {
+    $event .= sprintf ( "\"id\":\"%s\",", $object );
+  }
+  $event .= sprintf ( "\"args\":{\"object\":\"%s\",\"data\":%d}}",
+		      $object, $data );
+  push @events, $event;
+}
+
+print "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+print join ( ",\n", @events )."\n";
+print "]}\n";